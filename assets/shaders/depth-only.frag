@@ -0,0 +1,6 @@
+#version 330
+
+// This shader is used by the depth pre-pass with the vertex shader of the lit material
+// The color writes are masked during the pre-pass so there is nothing to output, only the depth is written
+void main(){
+}
@@ -24,10 +24,38 @@ struct Light {
     vec2 cone_angles; // the cone angles of the light are defined for spot lights only
 };
 
+#ifdef CLUSTERED_LIGHTING
+// when the shader is compiled with CLUSTERED_LIGHTING, the lights are read from texture buffers (so there is no maximum number of lights)
+// the view frustum is split into clusters (screen tiles times depth slices) and the renderer gives every cluster the list of lights that can reach it
+uniform samplerBuffer light_data; // 4 texels per light: (position, type), (direction, inner cone angle), (color, outer cone angle), (attenuation, unused)
+uniform usamplerBuffer cluster_grid; // the offset and the count of the light list of every cluster
+uniform usamplerBuffer cluster_light_indices; // the light lists of all the clusters
+uniform int global_light_count; // the lights that reach every cluster are the first ones in light_data
+uniform ivec3 cluster_counts; // the number of tiles along x and y and the number of depth slices
+uniform vec2 cluster_tile_size; // the size of a tile in pixels
+uniform vec2 cluster_depth_scale_bias; // the slice of a depth is floor(log(depth) * scale + bias)
+uniform vec3 camera_forward; // the depth of a fragment is its distance from the camera along this direction
+
+// we read the light at the given index from the light buffer
+Light read_light(int index) {
+    vec4 position_type = texelFetch(light_data, 4 * index);
+    vec4 direction_inner = texelFetch(light_data, 4 * index + 1);
+    vec4 color_outer = texelFetch(light_data, 4 * index + 2);
+    Light light;
+    light.type = int(position_type.w);
+    light.position = position_type.xyz;
+    light.direction = direction_inner.xyz;
+    light.color = color_outer.rgb;
+    light.attenuation = texelFetch(light_data, 4 * index + 3).xyz;
+    light.cone_angles = vec2(direction_inner.w, color_outer.w);
+    return light;
+}
+#else
 #define MAX_LIGHTS 32 // we define the maximum number of lights that can be passed to the shader as a uniform
 
 uniform Light lights[MAX_LIGHTS]; // we define an array of lights that will be passed to the shader as a uniform
 uniform int light_count; // we define the number of lights that will be passed to the shader as a uniform. this number must be less than or equal to MAX_LIGHTS
+#endif
 
 // we define a struct that represents a sky
 // the sky is defined by three colors: the top color, the horizon color and the bottom color
@@ -58,6 +86,23 @@ vec3 compute_sky_light(vec3 normal){
     // hint --> we can use abs(normal.y) instead of normal.y * normal.y to make the interpolation linear but it will be very sharp
 }
 
+#ifdef TEXTURE_ARRAYS
+// when the shader is compiled with TEXTURE_ARRAYS, every texture of the material is a layer of a texture array
+// the arrays are shared by many materials which only differ in their layers, so the layers are given per object by the vertex shader
+// (the order is the order of the texture slots: albedo, specular, roughness, ambient occlusion then emissive)
+struct Material {
+    sampler2DArray albedo;
+    sampler2DArray specular;
+    sampler2DArray roughness;
+    sampler2DArray ambient_occlusion;
+    sampler2DArray emissive;
+};
+
+flat in int material_layer[5];
+
+// we sample the texture of the given slot from its layer
+#define SAMPLE_MATERIAL(name, slot) texture(material.name, vec3(fs_in.tex_coord, material_layer[slot]))
+#else
 // we create a struct that represents the material of the object
 // the material is defined by five textures: the albedo texture, the specular texture, the roughness texture, the ambient occlusion texture and the emissive texture
 struct Material {
@@ -68,9 +113,36 @@ struct Material {
     sampler2D emissive; // the emissive texture is the texture that defines the emissive color of the object (the color of the object when it emits light)
 };
 
+// we sample the texture of the given slot (the slot is only needed by the texture arrays)
+#define SAMPLE_MATERIAL(name, slot) texture(material.name, fs_in.tex_coord)
+#endif
+
 // we define a material that will be passed to the shader as a uniform
 uniform Material material;
 
+#ifdef DEFERRED_LIGHTING
+// when the shader is compiled with DEFERRED_LIGHTING, it is the lighting pass of the deferred renderer (drawn as a fullscreen triangle)
+// the material of every pixel was already written to the G-buffer by the objects (drawn with this shader compiled with GBUFFER)
+uniform sampler2D gbuffer_albedo; // rgb: the albedo
+uniform sampler2D gbuffer_normal_roughness; // xyz: the normal in world space coordinates, w: the roughness
+uniform sampler2D gbuffer_specular; // rgb: the specular color
+uniform sampler2D gbuffer_emissive; // rgb: the emissive color plus the ambient light (which doesn't depend on the lights)
+uniform sampler2D gbuffer_depth; // the depth of the pixel (used to find its position in world space)
+uniform mat4 inverse_VP; // the inverse of the view projection matrix (maps the pixel back to world space)
+uniform vec2 viewport_size; // the size of the viewport (the scene may be drawn to a part of the G-buffer, see "resolution-scaler.hpp")
+uniform vec3 camera_position;
+
+// the same varyings as below but they are computed from the G-buffer at the start of main
+// (so the functions below can read them the same way in both cases)
+struct Varyings {
+    vec4 color;
+    vec2 tex_coord;
+    vec3 normal;
+    vec3 view;
+    vec3 world;
+};
+Varyings fs_in;
+#else
 // the following are the varyings that are passed from the vertex shader to the fragment shader
 in Varyings {
     vec4 color; // the color of the vertex
@@ -79,8 +151,28 @@ in Varyings {
     vec3 view; // the direction of the view in world space coordinates 
     vec3 world; // the position of the vertex in world space coordinates
 } fs_in;
+#endif
 
+#ifdef GBUFFER
+// when the shader is compiled with GBUFFER, it doesn't compute any light and writes the material of the fragment to the G-buffer instead
+// (the lights are added later by the lighting pass of the deferred renderer for the visible pixels only)
+layout(location = 0) out vec4 gbuffer_albedo;
+layout(location = 1) out vec4 gbuffer_normal_roughness;
+layout(location = 2) out vec4 gbuffer_specular;
+layout(location = 3) out vec4 gbuffer_emissive;
+#else
 out vec4 frag_color; // the color of the fragment will be outputted to the fragment shader to be displayed on the screen
+#endif
+
+#ifdef CLUSTERED_LIGHTING
+// we find the cluster of the fragment from its position on the screen and its depth (the same way the renderer split the frustum)
+int find_cluster() {
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / cluster_tile_size), ivec2(0), cluster_counts.xy - 1);
+    float depth = max(dot(-fs_in.view, camera_forward), 1e-4);
+    int slice = clamp(int(floor(log(depth) * cluster_depth_scale_bias.x + cluster_depth_scale_bias.y)), 0, cluster_counts.z - 1);
+    return tile.x + cluster_counts.x * (tile.y + cluster_counts.y * slice);
+}
+#endif
 
 // the following function computes the lambertian reflectance of the object
 // the lambertian reflectance is the amount of light that is reflected by the object in all directions (diffuse light)
@@ -109,65 +201,109 @@ float phong(vec3 reflected, vec3 view, float shininess) {
     return pow(max(0.0, dot(reflected, view)), shininess);
 }
 
+// the following function computes the light that the given light adds to the color of the fragment
+// the color of the fragment for each light is computed by adding the diffuse light and the specular light of the object
+// the diffuse light is computed using the lambertian reflectance of the object
+// the specular light is computed using the phong reflectance of the object
+// the diffuse light and the specular light are attenuated by the attenuation of the light
+vec3 compute_light(Light light, vec3 normal, vec3 view, vec3 diffuse, vec3 specular, float shininess) {
+    vec3 world_to_light_dir; // we define a variable that will hold the direction of the light in world space coordinates
+    float attenuation = 1.0; // we define a variable that will hold the attenuation of the light
+    if(light.type == DIRECTIONAL){ // if the light is a directional light
+        world_to_light_dir = -light.direction; // we set the direction of the light to the opposite of the direction of the light cause all lights are out from the object so that the range of the angle between the normal and the direction of the light is between 0 and 180 degrees
+    } else { // if the light is a point or spot light
+        world_to_light_dir = light.position - fs_in.world; // we compute the direction of the light by subtracting the position of the light from the position of the fragment
+        float d = length(world_to_light_dir); // we compute the distance between the light and the fragment to compute the attenuation of the light
+        world_to_light_dir /= d; // we normalize the direction of the light to make sure that it is a unit vector
+
+        attenuation = 1.0 / dot(light.attenuation, vec3(d*d, d, 1.0)); // we compute the attenuation of the light using the attenuation of the light and the distance between the light and the fragment
+
+        // if the light is a spot light, we compute the attenuation of the light using the cone angles of the light
+        if(light.type == SPOT){
+            float angle = acos(dot(light.direction, -world_to_light_dir));
+            attenuation *= smoothstep(light.cone_angles.y, light.cone_angles.x, angle); // we compute the attenuation of the light using the cone angles of the light. The function smoothstep(a, b, t) returns the interpolation between a and b at t. The interpolation is smooth at the edges. The interpolation is linear between a and b if t is between a and b. The interpolation is constant if t is less than a or greater than b.
+        }
+    }
+
+    // we compute the diffuse light and the specular light of the object
+    vec3 computed_diffuse = light.color * diffuse * lambert(normal, world_to_light_dir);
+
+    // we compute the specular light of the object
+    vec3 reflected = reflect(-world_to_light_dir, normal); // we compute the direction of the reflected light by reflecting the direction of the light around the normal of the object to be able to get the specular light of the object
+    vec3 computed_specular = light.color * specular * phong(reflected, view, shininess); // we compute the specular light of the object using the phong reflectance of the object
+
+    // we return the diffuse light and the specular light of the object (to be added to the color of the fragment)
+    return (computed_diffuse + computed_specular) * attenuation;
+}
+
 void main() {
+#ifdef DEFERRED_LIGHTING
+    // we read the material of the pixel from the G-buffer (the viewport starts at the corner of the G-buffer so the pixels match)
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+    if(depth == 1.0) discard; // no object was drawn on this pixel (the sky will be drawn there)
+    gl_FragDepth = depth; // we keep the depth of the objects so the sky and the transparent objects are depth tested against them
+
+    // we find the position of the pixel in world space by undoing the projection
+    vec4 world = inverse_VP * vec4(vec3(gl_FragCoord.xy / viewport_size, depth) * 2.0 - 1.0, 1.0);
+    fs_in.world = world.xyz / world.w;
+    fs_in.view = camera_position - fs_in.world;
+
+    vec4 normal_roughness = texelFetch(gbuffer_normal_roughness, pixel, 0);
+    vec3 normal = normalize(normal_roughness.xyz);
+    vec3 view = normalize(fs_in.view);
+    vec3 diffuse = texelFetch(gbuffer_albedo, pixel, 0).rgb;
+    vec3 specular = texelFetch(gbuffer_specular, pixel, 0).rgb;
+    float roughness = normal_roughness.w;
+    vec3 color = texelFetch(gbuffer_emissive, pixel, 0).rgb; // the emissive color and the ambient light were added by the G-buffer pass
+#else
     vec3 normal = normalize(fs_in.normal); // we normalize the normal of the fragment to make sure that it is a unit vector
     vec3 view = normalize(fs_in.view); // we normalize the direction of the view to make sure that it is a unit vector
     
     vec3 ambient_light = compute_sky_light(normal); // we compute the color of the sky at the direction of the normal to get the ambient light
 
-    vec3 diffuse = texture(material.albedo, fs_in.tex_coord).rgb; // we get the color of the object from the albedo texture
-    vec3 specular = texture(material.specular, fs_in.tex_coord).rgb; // we get the color of the specular highlights of the object from the specular texture
-    float roughness = texture(material.roughness, fs_in.tex_coord).r; // we get the roughness of the object from the roughness texture
-    vec3 ambient = diffuse * texture(material.ambient_occlusion, fs_in.tex_coord).r; // we get the ambient occlusion of the object from the ambient occlusion texture
-    vec3 emissive = texture(material.emissive, fs_in.tex_coord).rgb; // we get the emissive color of the object from the emissive texture
+    vec3 diffuse = SAMPLE_MATERIAL(albedo, 0).rgb; // we get the color of the object from the albedo texture
+    vec3 specular = SAMPLE_MATERIAL(specular, 1).rgb; // we get the color of the specular highlights of the object from the specular texture
+    float roughness = SAMPLE_MATERIAL(roughness, 2).r; // we get the roughness of the object from the roughness texture
+    vec3 ambient = diffuse * SAMPLE_MATERIAL(ambient_occlusion, 3).r; // we get the ambient occlusion of the object from the ambient occlusion texture
+    vec3 emissive = SAMPLE_MATERIAL(emissive, 4).rgb; // we get the emissive color of the object from the emissive texture
 
+    vec3 color = emissive + ambient_light * ambient; // we compute the color of the fragment by adding the emissive color of the object and the ambient light of the object
+#endif
+
+#ifdef GBUFFER
+    // we store the material and the light that doesn't depend on the lights, and we are done
+    gbuffer_albedo = vec4(diffuse, 1.0);
+    gbuffer_normal_roughness = vec4(normal, roughness);
+    gbuffer_specular = vec4(specular, 1.0);
+    gbuffer_emissive = vec4(color, 1.0);
+#else
     // we compute the shininess of the object from the roughness of the object
     // the shininess is computed using the following formula:
     // shininess = 2 / roughness^4 - 2
     // the shininess is used to compute the specular light of the object
     // we clamp the roughness between 0.001 and 0.999 to avoid division by 0
     float shininess = 2.0 / pow(clamp(roughness, 0.001, 0.999), 4.0) - 2.0;
-    
-    vec3 world_to_light_dir; // we define a variable that will hold the direction of the light in world space coordinates
-    vec3 color = emissive + ambient_light * ambient; // we compute the color of the fragment by adding the emissive color of the object and the ambient light of the object
 
+#ifdef CLUSTERED_LIGHTING
+    // the lights that reach everything (e.g. directional lights) come first and are computed for every fragment
+    for(int light_idx = 0; light_idx < global_light_count; light_idx++){
+        color += compute_light(read_light(light_idx), normal, view, diffuse, specular, shininess);
+    }
+    // then we only loop over the lights that can reach the cluster of the fragment
+    uvec2 cluster = texelFetch(cluster_grid, find_cluster()).xy; // the offset and the count of the light list of the cluster
+    for(uint list_idx = 0u; list_idx < cluster.y; list_idx++){
+        int light_idx = int(texelFetch(cluster_light_indices, int(cluster.x + list_idx)).r);
+        color += compute_light(read_light(light_idx), normal, view, diffuse, specular, shininess);
+    }
+#else
     // we loop over all the lights that are passed to the shader
-    // we compute the color of the fragment for each light
     // we add the color of the fragment for each light to the color of the fragment
-    // the color of the fragment for each light is computed by adding the diffuse light and the specular light of the object
-    // the diffuse light is computed using the lambertian reflectance of the object
-    // the specular light is computed using the phong reflectance of the object
-    // the diffuse light and the specular light are attenuated by the attenuation of the light
     for(int light_idx = 0; light_idx < min(MAX_LIGHTS, light_count); light_idx++){
-        Light light = lights[light_idx]; // we get the light at the current index
-        float attenuation = 1.0; // we define a variable that will hold the attenuation of the light
-        if(light.type == DIRECTIONAL){ // if the light is a directional light
-            world_to_light_dir = -light.direction; // we set the direction of the light to the opposite of the direction of the light cause all lights are out from the object so that the range of the angle between the normal and the direction of the light is between 0 and 180 degrees
-        } else { // if the light is a point or spot light
-            world_to_light_dir = light.position - fs_in.world; // we compute the direction of the light by subtracting the position of the light from the position of the fragment
-            float d = length(world_to_light_dir); // we compute the distance between the light and the fragment to compute the attenuation of the light
-            world_to_light_dir /= d; // we normalize the direction of the light to make sure that it is a unit vector
-
-            attenuation = 1.0 / dot(light.attenuation, vec3(d*d, d, 1.0)); // we compute the attenuation of the light using the attenuation of the light and the distance between the light and the fragment
-
-            // if the light is a spot light, we compute the attenuation of the light using the cone angles of the light
-            if(light.type == SPOT){
-                float angle = acos(dot(light.direction, -world_to_light_dir));
-                attenuation *= smoothstep(light.cone_angles.y, light.cone_angles.x, angle); // we compute the attenuation of the light using the cone angles of the light. The function smoothstep(a, b, t) returns the interpolation between a and b at t. The interpolation is smooth at the edges. The interpolation is linear between a and b if t is between a and b. The interpolation is constant if t is less than a or greater than b.
-            }
-        }
-
-        // we compute the diffuse light and the specular light of the object
-        vec3 computed_diffuse = light.color * diffuse * lambert(normal, world_to_light_dir);
-
-        // we compute the specular light of the object
-        vec3 reflected = reflect(-world_to_light_dir, normal); // we compute the direction of the reflected light by reflecting the direction of the light around the normal of the object to be able to get the specular light of the object
-        vec3 computed_specular = light.color * specular * phong(reflected, view, shininess); // we compute the specular light of the object using the phong reflectance of the object
-
-        // we add the diffuse light and the specular light of the object to the color of the fragment
-        color += (computed_diffuse + computed_specular) * attenuation;
-
+        color += compute_light(lights[light_idx], normal, view, diffuse, specular, shininess);
     }
+#endif
     // we set the color of the fragment to the color of the fragment computed above and we set the alpha of the fragment to 1 (fully opaque) 
     frag_color = vec4(color, 1.0);
+#endif
 }
\ No newline at end of file
@@ -13,6 +13,10 @@ uniform mat4 M;
 //. model inverse transpose matrix
 uniform mat4 M_IT;
 
+//. the depth pre-pass draws with another fragment shader then the objects are drawn again with GL_EQUAL depth testing
+//. so the position must be computed exactly the same way in both programs
+invariant gl_Position;
+
 out Varyings {
     vec4 color;
     vec2 tex_coord;
@@ -21,6 +25,13 @@ out Varyings {
     vec3 world;
 } vs_out;
 
+#ifdef TEXTURE_ARRAYS
+//. the layer of every texture of the material inside its texture array (albedo, specular, roughness, ambient occlusion, emissive)
+//. it is the same for the whole draw so it is a uniform, and it is passed to the fragment shader
+uniform int material_layers[5];
+flat out int material_layer[5];
+#endif
+
 void main() {
     //. position in world space
     vec3 world = (M * vec4(position, 1.0)).xyz;
@@ -32,4 +43,8 @@ void main() {
     vs_out.normal = normalize((M_IT * vec4(normal, 0.0)).xyz);
     vs_out.view = camera_position - world;
     vs_out.world = world;
+#ifdef TEXTURE_ARRAYS
+    for (int slot = 0; slot < 5; slot++)
+        material_layer[slot] = material_layers[slot];
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#version 430
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 tex_coord;
+layout(location = 3) in vec3 normal;
+//. the index of the draw data of this object
+//. it is read per instance from a buffer holding 0, 1, 2, ... and starts from the baseInstance of the indirect command
+layout(location = 12) in uint draw_id;
+
+//. the data of every object drawn by the multi-draw (filled by the renderer once per frame)
+struct DrawData {
+    mat4 M;
+    mat4 M_IT;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+#ifdef TEXTURE_ARRAYS
+//. the layer of every texture of the material of every object inside its texture array
+//. (the objects of a multi-draw can have different materials as long as they share the texture arrays)
+struct DrawLayers {
+    int layers[5];
+};
+
+layout(std430, binding = 1) readonly buffer DrawLayersBuffer {
+    DrawLayers draw_layers[];
+};
+
+flat out int material_layer[5];
+#endif
+
+//. view position matrix
+uniform mat4 VP;
+uniform vec3 camera_position;
+
+//. the depth pre-pass draws with another fragment shader then the objects are drawn again with GL_EQUAL depth testing
+//. so the position must be computed exactly the same way in both programs
+invariant gl_Position;
+
+out Varyings {
+    vec4 color;
+    vec2 tex_coord;
+    vec3 normal;
+    vec3 view;
+    vec3 world;
+} vs_out;
+
+void main() {
+    mat4 M = draws[draw_id].M;
+    mat4 M_IT = draws[draw_id].M_IT;
+    //. position in world space
+    vec3 world = (M * vec4(position, 1.0)).xyz;
+    //. position in clip space
+    gl_Position = VP * vec4(world, 1.0);
+    vs_out.color = color;
+    vs_out.tex_coord = tex_coord;
+    //. make sure normal is still normal after transformation
+    vs_out.normal = normalize((M_IT * vec4(normal, 0.0)).xyz);
+    vs_out.view = camera_position - world;
+    vs_out.world = world;
+#ifdef TEXTURE_ARRAYS
+    for (int slot = 0; slot < 5; slot++)
+        material_layer[slot] = draw_layers[draw_id].layers[slot];
+#endif
+}
@@ -0,0 +1,50 @@
+#version 330
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 tex_coord;
+layout(location = 3) in vec3 normal;
+//. the model matrix and its inverse transpose are read per instance from the instance buffer
+//. each mat4 takes 4 locations (one per column) so M takes 4 to 7 and M_IT takes 8 to 11
+layout(location = 4) in mat4 M;
+layout(location = 8) in mat4 M_IT;
+
+//. view position matrix
+uniform mat4 VP;
+uniform vec3 camera_position;
+
+//. the depth pre-pass draws with another fragment shader then the objects are drawn again with GL_EQUAL depth testing
+//. so the position must be computed exactly the same way in both programs
+invariant gl_Position;
+
+out Varyings {
+    vec4 color;
+    vec2 tex_coord;
+    vec3 normal;
+    vec3 view;
+    vec3 world;
+} vs_out;
+
+#ifdef TEXTURE_ARRAYS
+//. the layer of every texture of the material inside its texture array (albedo, specular, roughness, ambient occlusion, emissive)
+//. it is the same for the whole draw so it is a uniform, and it is passed to the fragment shader
+uniform int material_layers[5];
+flat out int material_layer[5];
+#endif
+
+void main() {
+    //. position in world space
+    vec3 world = (M * vec4(position, 1.0)).xyz;
+    //. position in clip space
+    gl_Position = VP * vec4(world, 1.0);
+    vs_out.color = color;
+    vs_out.tex_coord = tex_coord;
+    //. make sure normal is still normal after transformation
+    vs_out.normal = normalize((M_IT * vec4(normal, 0.0)).xyz);
+    vs_out.view = camera_position - world;
+    vs_out.world = world;
+#ifdef TEXTURE_ARRAYS
+    for (int slot = 0; slot < 5; slot++)
+        material_layer[slot] = material_layers[slot];
+#endif
+}
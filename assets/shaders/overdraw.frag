@@ -0,0 +1,10 @@
+#version 330
+
+// This shader is used by the overdraw view with the vertex shader of the lit material
+// Every fragment adds this color (using additive blending) so a pixel goes from dark red to white
+// as the number of fragments shaded on it grows (1 fragment is dark red, 4 are orange, 8 are yellow and 16 or more are white)
+out vec4 frag_color;
+
+void main(){
+    frag_color = vec4(0.25, 0.125, 0.0625, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330
+// a postprocessing shader that adds a bloom computed by another pass (see "bloom-upsample.frag" or "glow.frag" with BLOOM_ONLY) to the scene
+// the bloom texture may be smaller than the scene, the linear filtering of the sampler upscales it
+// with UPSAMPLE, the bloom is upscaled with a tent filter instead (the same as "bloom-upsample.frag"), so the last level of the bloom
+// can be read straight from a quarter resolution target without its blocks showing up
+
+// the intensity of the bloom effect
+uniform float bloomIntensity = 2.0f;
+#ifdef UPSAMPLE
+// how far (in pixels of the bloom texture) the fetches are from the center
+uniform float bloomSpread = 1.0f;
+#endif
+// The texture holding the scene pixels
+uniform sampler2D tex;
+// The texture holding the bloom of the scene
+uniform sampler2D bloom;
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+void main() {
+    vec4 col = texture(tex, tex_coord);
+#ifdef UPSAMPLE
+    // every bilinear fetch half a pixel away from the center averages 2x2 pixels of the bloom,
+    // so the 4 diagonal fetches add up to a 3x3 tent around the output pixel
+    vec2 offset = 0.5 * bloomSpread / textureSize(bloom, 0);
+    vec3 bloomColor = texture(bloom, tex_coord + offset * vec2(-1, -1)).rgb;
+    bloomColor += texture(bloom, tex_coord + offset * vec2(1, -1)).rgb;
+    bloomColor += texture(bloom, tex_coord + offset * vec2(-1, 1)).rgb;
+    bloomColor += texture(bloom, tex_coord + offset * vec2(1, 1)).rgb;
+    col.rgb += bloomColor * (0.25 * bloomIntensity);
+#else
+    col.rgb += texture(bloom, tex_coord).rgb * bloomIntensity;
+#endif
+    frag_color = col;
+}
@@ -0,0 +1,22 @@
+#version 330
+// a dual Kawase downsample: the output is half the size of the input and every pixel is a weighted average of 5 bilinear fetches
+// (the center and the 4 diagonal corners), so every level of the bloom is blurred while it gets smaller
+// a wide bloom comes from the small levels, where each fetch covers a large part of the screen, so its cost barely grows with its radius
+
+// how far (in pixels of the input) the corner fetches are from the center
+uniform float bloomSpread = 1.0f;
+// The texture holding the previous (twice larger) level of the bloom
+uniform sampler2D tex;
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+void main() {
+    vec2 offset = bloomSpread / textureSize(tex, 0);
+    vec3 color = texture(tex, tex_coord).rgb * 4.0;
+    color += texture(tex, tex_coord + offset * vec2(-1, -1)).rgb;
+    color += texture(tex, tex_coord + offset * vec2(1, -1)).rgb;
+    color += texture(tex, tex_coord + offset * vec2(-1, 1)).rgb;
+    color += texture(tex, tex_coord + offset * vec2(1, 1)).rgb;
+    frag_color = vec4(color / 8.0, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 330
+// the first pass of the bloom: it keeps the bright parts of the scene while downsampling it to a quarter of its resolution
+// every bilinear fetch averages 2x2 pixels so the 4 fetches cover the 4x4 pixels of the scene under the output pixel
+
+// the threshold of the bloom effect (the minimum brightness of a pixel to be considered for the bloom effect)
+uniform float bloomThreshold = 0.5f;
+// the width of the soft transition around the threshold (0 gives a hard cut which flickers when bright pixels move)
+uniform float bloomKnee = 0.25f;
+// The texture holding the scene pixels
+uniform sampler2D tex;
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// fetches the average of 2x2 pixels and weights it by the inverse of its brightness
+// so a single very bright pixel can't dominate the average (which makes the bloom flicker)
+vec3 fetch(vec2 uv, inout float totalWeight) {
+    vec3 color = texture(tex, uv).rgb;
+    float weight = 1.0 / (1.0 + luminance(color));
+    totalWeight += weight;
+    return color * weight;
+}
+
+void main() {
+    vec2 texel = 1.0 / textureSize(tex, 0);
+    float totalWeight = 0.0;
+    vec3 color = fetch(tex_coord + texel * vec2(-1, -1), totalWeight);
+    color += fetch(tex_coord + texel * vec2(1, -1), totalWeight);
+    color += fetch(tex_coord + texel * vec2(-1, 1), totalWeight);
+    color += fetch(tex_coord + texel * vec2(1, 1), totalWeight);
+    color /= totalWeight;
+
+    // the brightness above the threshold with a quadratic curve in [threshold - knee, threshold + knee]
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - bloomThreshold + bloomKnee, 0.0, 2.0 * bloomKnee);
+    soft = soft * soft / (4.0 * bloomKnee + 1e-5);
+    float contribution = max(soft, brightness - bloomThreshold) / max(brightness, 1e-5);
+    frag_color = vec4(color * contribution, 1.0);
+}
@@ -0,0 +1,37 @@
+#version 330
+// a dual Kawase upsample: the output is twice the size of the input and every pixel is a weighted average of 8 bilinear fetches
+// around it (a tent filter) so the blocks of the small level don't show up
+// with COMBINE, the downsampled level of the same size is added so that every level contributes to the final bloom
+// the last upsample can scale the bloom by its intensity, so it can be stored in an 8 bit target without losing the values
+// that would still show up on the screen (anything above 1 after the scale saturates the pixel it is added to anyway)
+
+// how far (in pixels of the input) the fetches are from the center
+uniform float bloomSpread = 1.0f;
+// the intensity of the bloom effect
+uniform float bloomIntensity = 1.0f;
+// The texture holding the next (twice smaller) level of the bloom
+uniform sampler2D tex;
+#ifdef COMBINE
+// The texture holding the downsampled level with the same size as the output
+uniform sampler2D base;
+#endif
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+void main() {
+    vec2 offset = bloomSpread / textureSize(tex, 0);
+    vec3 color = texture(tex, tex_coord + offset * vec2(-1, 0)).rgb;
+    color += texture(tex, tex_coord + offset * vec2(1, 0)).rgb;
+    color += texture(tex, tex_coord + offset * vec2(0, -1)).rgb;
+    color += texture(tex, tex_coord + offset * vec2(0, 1)).rgb;
+    color += texture(tex, tex_coord + offset * vec2(-0.5, -0.5)).rgb * 2.0;
+    color += texture(tex, tex_coord + offset * vec2(0.5, -0.5)).rgb * 2.0;
+    color += texture(tex, tex_coord + offset * vec2(-0.5, 0.5)).rgb * 2.0;
+    color += texture(tex, tex_coord + offset * vec2(0.5, 0.5)).rgb * 2.0;
+    color /= 12.0;
+#ifdef COMBINE
+    color += texture(base, tex_coord).rgb;
+#endif
+    frag_color = vec4(color * bloomIntensity, 1.0);
+}
@@ -1,6 +1,7 @@
 #version 330
 // a postprocessing shader that adds a bloom effect to the scene
 // bloom is the effect of light spreading out from bright areas in an image
+// with BLOOM_ONLY, only the bloom is written (so it can be computed at a lower resolution then added by "bloom-composite.frag")
 
 // the radius of the bloom effect
 uniform float bloomRadius = 1.0f;
@@ -62,8 +63,12 @@ void main() {
     //    we get the size of a pixel by dividing 1 by the texture size
     vec2 TEXTURE_PIXEL_SIZE = 1.0 / textureSize(tex, 0); 
 
-    vec4 col = texture(tex, tex_coord);
     vec3 bloom = GetBloom(tex_coord, TEXTURE_PIXEL_SIZE);
+#ifdef BLOOM_ONLY
+    frag_color = vec4(bloom, 1.0);
+#else
+    vec4 col = texture(tex, tex_coord);
     col.rgb += bloom * bloomIntensity;
     frag_color = col;
+#endif
 }
\ No newline at end of file
@@ -5,7 +5,13 @@ in Varyings {
     vec2 tex_coord;
 } fs_in;
 
+#ifdef WEIGHTED_OIT
+// With WEIGHTED_OIT, the fragment is accumulated like in "tinted.frag"
+layout(location = 0) out vec4 frag_color;
+layout(location = 1) out float oit_weight;
+#else
 out vec4 frag_color;
+#endif
 
 uniform vec4 tint;
 uniform sampler2D tex;
@@ -14,5 +20,9 @@ void main(){
     //TODO: (Req 7) Modify the following line to compute the fragment color
     // by multiplying the tint with the vertex color and with the texture color 
     frag_color = tint * fs_in.color * texture(tex, fs_in.tex_coord);
+#ifdef WEIGHTED_OIT
+    oit_weight = frag_color.a * OIT_WEIGHT(frag_color.a);
+    frag_color = vec4(frag_color.rgb * oit_weight, frag_color.a);
+#endif
   
 }
\ No newline at end of file
@@ -4,7 +4,14 @@ in Varyings {
     vec4 color;
 } fs_in;
 
+#ifdef WEIGHTED_OIT
+// With WEIGHTED_OIT, the fragment is accumulated by the weighted blended transparency (see "weighted-oit-resolve.frag")
+// using the weight OIT_WEIGHT(alpha) defined by the renderer, so every transparent shader weighs its fragments the same way
+layout(location = 0) out vec4 frag_color;
+layout(location = 1) out float oit_weight;
+#else
 out vec4 frag_color;
+#endif
 
 uniform vec4 tint;
 
@@ -12,4 +19,8 @@ void main(){
     //TODO: (Req 7) Modify the following line to compute the fragment color
     // by multiplying the tint with the vertex color
     frag_color = fs_in.color * tint;
+#ifdef WEIGHTED_OIT
+    oit_weight = frag_color.a * OIT_WEIGHT(frag_color.a);
+    frag_color = vec4(frag_color.rgb * oit_weight, frag_color.a);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 330
+
+// The resolve pass of the weighted blended order independent transparency
+// It divides the accumulated colors by the accumulated weights to get the weighted average color of the transparent fragments
+// and outputs it with (1 - revealage) as its alpha, so blending it over the scene covers it as much as all these fragments together
+
+in vec2 tex_coord;
+
+out vec4 frag_color;
+
+uniform sampler2D accumulation; // rgb = the sum of the weighted premultiplied colors, a = the revealage
+uniform sampler2D weight;       // r = the sum of the weighted alphas
+
+void main(){
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accumulated = texelFetch(accumulation, texel, 0);
+    float revealage = accumulated.a;
+    // nothing transparent covers this pixel so the scene is left as it is
+    if(revealage >= 1.0) discard;
+    float totalWeight = texelFetch(weight, texel, 0).r;
+    frag_color = vec4(accumulated.rgb / max(totalWeight, 1e-5), 1.0 - revealage);
+}
@@ -7,6 +7,8 @@
 #include <iomanip>
 #include <ctime>
 #include <queue>
+#include <deque>
+#include <memory>
 #include <tuple>
 #include <filesystem>
 
@@ -23,7 +25,10 @@
 #define ENABLE_OPENGL_DEBUG_MESSAGES
 #endif
 
-#include "texture/screenshot.hpp"
+#include "mesh/mesh-arena.hpp"
+#include "shader/program-cache.hpp"
+#include "texture/texture-streamer.hpp"
+#include "asset-loader.hpp"
 #include "../states/menu-state.hpp"
 
 std::string default_screenshot_filepath() {
@@ -36,6 +41,36 @@ std::string default_screenshot_filepath() {
     return stream.str();
 }
 
+// Returns a new capture file in the given directory with the given extension (e.g. ".y4m")
+std::string default_capture_filepath(const std::filesystem::path &directory, const std::string &extension) {
+    std::stringstream stream;
+    auto time = std::time(nullptr);
+
+    struct tm localtime;
+    localtime_s(&localtime, &time);
+    stream << "capture-" << std::put_time(&localtime, "%Y-%m-%d-%H-%M-%S") << extension;
+    return (directory / stream.str()).string();
+}
+
+// A copy of the GUI draw data of a frame drawn on the render thread
+// (ImGui reuses its draw lists in the next frame so the render thread can't draw from them)
+// It is deleted on the main thread once its frame is done since ImGui's allocator isn't thread safe
+struct GuiFrame {
+    ImDrawData drawData;
+    std::vector<ImDrawList *> lists;
+
+    explicit GuiFrame(const ImDrawData *source) : drawData(*source) {
+        for (int index = 0; index < source->CmdListsCount; index++)
+            lists.push_back(source->CmdLists[index]->CloneOutput());
+        drawData.CmdLists = lists.data();
+    }
+
+    ~GuiFrame() {
+        for (ImDrawList *list: lists)
+            IM_DELETE(list);
+    }
+};
+
 // This function will be used to log errors thrown by GLFW
 void glfw_error_callback(int error, const char *description) {
     std::cerr << "GLFW Error: " << error << ": " << description << std::endl;
@@ -210,6 +245,16 @@ int our::Application::run(int run_for_frames) {
     std::cout << "VERSION         : " << glGetString(GL_VERSION) << std::endl;
     std::cout << "GLSL VERSION    : " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
+    // The linked programs are cached (in memory and in "shader-cache.directory") so the states don't compile the same shaders again
+    bool shader_cache_enabled = true;
+    std::string shader_cache_directory = "cache/shaders";
+    if (auto &shader_cache = app_config["shader-cache"]; shader_cache.is_object()) {
+        shader_cache_enabled = shader_cache.value("enabled", shader_cache_enabled);
+        shader_cache_directory = shader_cache.value("directory", shader_cache_directory);
+    }
+    if (shader_cache_enabled)
+        our::ProgramCache::initialize(shader_cache_directory);
+
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
     // if we have OpenGL debug messages enabled, set the message callback
     glDebugMessageCallback(opengl_callback, nullptr);
@@ -257,6 +302,19 @@ int our::Application::run(int run_for_frames) {
         }
     }
 
+    // The screenshots and the captured frames are read back asynchronously and written by a background thread
+    frameCapture.initialize();
+    // If "capture" is enabled, every frame is streamed to "file" (".y4m" for a YUV4MPEG2 video or ".ppm" for a sequence of PPM images)
+    // F11 starts or stops a capture to a new file in the same directory with the same format
+    std::filesystem::path capture_file = "captures/capture.y4m";
+    int capture_fps = 60;
+    if (auto &capture = app_config["capture"]; capture.is_object()) {
+        capture_file = capture.value("file", capture_file.string());
+        capture_fps = capture.value("fps", capture_fps);
+        if (capture.value("enabled", false))
+            frameCapture.startStream(capture_file.string(), capture_fps);
+    }
+
     // If a scene change was requested, apply it
     if (nextState) {
         currentState = nextState;
@@ -266,6 +324,19 @@ int our::Application::run(int run_for_frames) {
     if (currentState)
         currentState->onInitialize();
 
+    // If enabled, the OpenGL context is given to the render thread which draws every frame while the next one is simulated
+    // "max-frames-in-flight" is how many frames the main thread can get ahead of the render thread
+    int max_frames_in_flight = 0;
+    if (auto &render_thread = app_config["render-thread"]; render_thread.is_object() && render_thread.value("enabled", false))
+        max_frames_in_flight = render_thread.value("max-frames-in-flight", 1);
+    // The GUI frames copied for the frames in flight with the index of their frame
+    std::deque<std::pair<long long, std::unique_ptr<GuiFrame>>> pending_gui_frames;
+    if (max_frames_in_flight > 0) {
+        // ImGui creates its OpenGL objects in its first new frame unless they already exist, so we create them before giving the context away
+        ImGui_ImplOpenGL3_CreateDeviceObjects();
+        renderThread.start(window, max_frames_in_flight);
+    }
+
     // The time at which the last frame started. But there was no frames yet, so we'll just pick the current time.
     double last_frame_time = glfwGetTime();
     int current_frame = 0;
@@ -295,7 +366,13 @@ int our::Application::run(int run_for_frames) {
         // Just in case ImGui changed the OpenGL viewport (the portion of the window to which we render the geometry),
         // we set it back to cover the whole window
         auto frame_buffer_size = getFrameBufferSize();
-        glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
+        submitRenderJob([frame_buffer_size]() {
+            glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
+            // Upload the textures that finished decoding in the background
+            our::TextureStreamer::get().update();
+            // and pack the textures of the materials into texture arrays once they are all uploaded
+            our::updateTextureArrays();
+        });
 
         // Get the current time (the time at which we are starting the current frame).
         double current_frame_time = glfwGetTime();
@@ -305,48 +382,82 @@ int our::Application::run(int run_for_frames) {
             currentState->onDraw(current_frame_time - last_frame_time);
         last_frame_time = current_frame_time; // Then update the last frame start time (this frame is now the last frame)
 
+        // On the render thread, the GUI is drawn from a copy of its draw data
+        GuiFrame *gui_frame = renderThread.isRunning() ? new GuiFrame(ImGui::GetDrawData()) : nullptr;
+        ImDrawData *draw_data = gui_frame ? &gui_frame->drawData : ImGui::GetDrawData();
+        submitRenderJob([draw_data]() {
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
-        // Since ImGui causes many messages to be thrown, we are temporarily disabling the debug messages till we render the ImGui
-        glDisable(GL_DEBUG_OUTPUT);
-        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            // Since ImGui causes many messages to be thrown, we are temporarily disabling the debug messages till we render the ImGui
+            glDisable(GL_DEBUG_OUTPUT);
+            glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render the ImGui to the framebuffer
+            ImGui_ImplOpenGL3_RenderDrawData(draw_data); // Render the ImGui to the framebuffer
+            // ImGui binds its own vertex array so the mesh arena can't assume that its vertex array is still bound
+            our::MeshArena::invalidateBinding();
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
-        // Re-enable the debug messages
-        glEnable(GL_DEBUG_OUTPUT);
-        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            // Re-enable the debug messages
+            glEnable(GL_DEBUG_OUTPUT);
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
+        });
 
         // If F12 is pressed, take a screenshot
+        // The screenshots are only read back here, they are saved (and reported) a few frames later by the frame capture
         if (keyboard.justPressed(GLFW_KEY_F12)) {
-            glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
             std::string path = default_screenshot_filepath();
-            if (our::screenshot_png(path)) {
-                std::cout << "Screenshot saved to: " << path << std::endl;
-            } else {
-                std::cerr << "Failed to save a Screenshot" << std::endl;
-            }
+            submitRenderJob([this, frame_buffer_size, path]() {
+                frameCapture.screenshot(path, frame_buffer_size);
+            });
         }
         // There are any requested screenshots, take them
         while (requested_screenshots.size()) {
             if (const auto &request = requested_screenshots.top(); request.first == current_frame) {
-                if (our::screenshot_png(request.second)) {
-                    std::cout << "Screenshot saved to: " << request.second << std::endl;
-                } else {
-                    std::cerr << "Failed to save a screenshot to: " << request.second << std::endl;
-                }
+                submitRenderJob([this, frame_buffer_size, path = request.second]() {
+                    frameCapture.screenshot(path, frame_buffer_size);
+                });
                 requested_screenshots.pop();
             } else
                 break;
         }
+        // If F11 is pressed, start or stop capturing the frames
+        if (keyboard.justPressed(GLFW_KEY_F11)) {
+            std::string path = default_capture_filepath(capture_file.parent_path(), capture_file.extension().string());
+            submitRenderJob([this, path, capture_fps]() {
+                if (frameCapture.isStreaming())
+                    frameCapture.stopStream();
+                else
+                    frameCapture.startStream(path, capture_fps);
+            });
+        }
+        // Append the frame to the capture (if any) and hand the readbacks that arrived to the writer
+        submitRenderJob([this, frame_buffer_size]() {
+            frameCapture.captureFrame(frame_buffer_size);
+            frameCapture.update();
+        });
 
         // Swap the frame buffers
-        glfwSwapBuffers(window);
+        submitRenderJob([this]() { glfwSwapBuffers(window); });
+
+        // Hand the frame over to the render thread (this waits if it is too far behind)
+        // then delete the GUI copies of the frames that are done
+        if (renderThread.isRunning()) {
+            long long frame_index = renderThread.endFrame();
+            pending_gui_frames.emplace_back(frame_index, gui_frame);
+            long long completed_frames = renderThread.getCompletedFrameCount();
+            while (!pending_gui_frames.empty() && pending_gui_frames.front().first < completed_frames)
+                pending_gui_frames.pop_front();
+        }
 
         // Update the keyboard and mouse data
         keyboard.update();
         mouse.update();
 
+        // The states create and delete OpenGL objects while changing so the context is taken back from the render thread
+        bool restart_render_thread = nextState && renderThread.isRunning();
+        if (restart_render_thread) {
+            renderThread.stop();
+            pending_gui_frames.clear();
+        }
         // If a scene change was requested, apply it
         while (nextState) {
             // If a scene was already running, destroy it (not delete since we can go back to it later)
@@ -358,14 +469,29 @@ int our::Application::run(int run_for_frames) {
             // Initialize the new scene
             currentState->onInitialize();
         }
+        if (restart_render_thread)
+            renderThread.start(window, max_frames_in_flight);
 
         ++current_frame;
     }
 
+    // Wait for the frames in flight and take the context back
+    renderThread.stop();
+    pending_gui_frames.clear();
+    // Write the screenshots and the frames that are still being read back
+    frameCapture.destroy();
+
     // Call for cleaning up
     if (currentState)
         currentState->onDestroy();
 
+    // All the meshes are deleted by now, so we can delete the arena buffers that held them
+    our::MeshArena::destroy();
+    // The same goes for the textures, so we can stop the texture workers
+    our::TextureStreamer::destroy();
+    // The programs are deleted too, so the binaries kept in memory aren't needed anymore
+    our::ProgramCache::destroy();
+
     // Shutdown ImGui & destroy the context
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
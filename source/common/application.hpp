@@ -12,6 +12,8 @@
 
 #include "input/keyboard.hpp"
 #include "input/mouse.hpp"
+#include "render-thread.hpp"
+#include "texture/frame-capture.hpp"
 
 namespace our {
 
@@ -68,6 +70,9 @@ namespace our {
         State *currentState = nullptr;         // This will store the current scene that is being run
         State *nextState = nullptr;            // If it is requested to go to another scene, this will contain a pointer to that scene
 
+        RenderThread renderThread;             // Draws a frame while the next one is simulated (if "render-thread" is enabled in the config)
+        FrameCapture frameCapture;             // Takes the screenshots and streams the frames to a file (only used in render jobs)
+
 
         // Virtual functions to be overridden and change the default behaviour of the application
         // according to the example needs.
@@ -121,6 +126,15 @@ namespace our {
         }
 
 
+        // Runs the OpenGL work of the current frame: right away, or later on the render thread if it is running
+        // The job must not read anything the main thread changes afterwards (e.g. the world), so it should capture copies
+        void submitRenderJob(std::function<void()> job) {
+            if (renderThread.isRunning())
+                renderThread.enqueue(std::move(job));
+            else
+                job();
+        }
+
         // Closes the Application
         void close() {
             glfwSetWindowShouldClose(window, GLFW_TRUE);
@@ -3,6 +3,8 @@
 #include "shader/shader.hpp"
 #include "texture/texture2d.hpp"
 #include "texture/texture-utils.hpp"
+#include "texture/texture-streamer.hpp"
+#include "texture/texture-array.hpp"
 #include "texture/sampler.hpp"
 #include "mesh/mesh.hpp"
 #include "mesh/mesh-utils.hpp"
@@ -10,21 +12,47 @@
 #include "deserialize-utils.hpp"
 #include "imgui.h"
 
+#include <cstdio>
+#include <iostream>
+#include <unordered_set>
+
 namespace our {
 
     // This will load all the shaders defined in "data"
     // data must be in the form:
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
+    // and "defines" (optional) can list names to define in both shaders, e.g. "defines": ["TEXTURE_ARRAYS"]
+    // and "glVersion" (optional) is the OpenGL version that the shaders need, e.g. "glVersion": "4.3" for "#version 430" shaders
+    // A program with a "glVersion" is optional: it is skipped if the context is older or if it fails to compile or link,
+    // so "get" returns nullptr for it (e.g. the materials then have no "indirectShader" and the renderer uses its other paths)
+    // A program without one is required by its materials, so it is kept even if it fails (its draws then render nothing)
     template<>
     void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json &data) {
         if (data.is_object()) {
+            GLint contextMajor = 0, contextMinor = 0;
+            glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+            glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
             for (auto &[name, desc]: data.items()) {
                 std::string vsPath = desc.value("vs", "");
                 std::string fsPath = desc.value("fs", "");
+                std::vector<std::string> defines = desc.value("defines", std::vector<std::string>());
+                int major = 0, minor = 0;
+                std::string glVersion = desc.value("glVersion", "");
+                if (!glVersion.empty())
+                    sscanf(glVersion.c_str(), "%d.%d", &major, &minor);
+                if (contextMajor < major || (contextMajor == major && contextMinor < minor)) {
+                    std::cout << "Skipped the shader \"" << name << "\" since it needs OpenGL " << major << "." << minor << std::endl;
+                    continue;
+                }
                 auto shader = new ShaderProgram();
-                shader->attach(vsPath, GL_VERTEX_SHADER);
-                shader->attach(fsPath, GL_FRAGMENT_SHADER);
-                shader->link();
+                if (!shader->attach(vsPath, GL_VERTEX_SHADER, defines) || !shader->attach(fsPath, GL_FRAGMENT_SHADER, defines) ||
+                    !shader->link()) {
+                    std::cerr << "Failed to load the shader \"" << name << "\"" << std::endl;
+                    if (!glVersion.empty()) {
+                        delete shader;
+                        continue;
+                    }
+                }
                 assets[name] = shader;
             }
         }
@@ -33,12 +61,19 @@ namespace our {
     // This will load all the textures defined in "data"
     // data must be in the form:
     //    { texture_name : "path/to/image", ... }
+    // or, to choose how the texture cook tool compresses the image:
+    //    { texture_name : { "path": "path/to/image", "compression": "bc5" }, ... }
+    // where "compression" (optional, default="auto") is "auto", "bc1", "bc3", "bc4", "bc5" or "none" (see "texture/texture-compression.hpp")
+    // If the image was cooked (see "texture/texture-container.hpp"), the compressed texture is loaded directly.
+    // Otherwise, the image is decoded on worker threads while the rest of the assets are loading (see "texture/texture-streamer.hpp")
+    // so the texture shows a placeholder until its image is uploaded
     template<>
     void AssetLoader<Texture2D>::deserialize(const nlohmann::json &data) {
         if (data.is_object()) {
             for (auto &[name, desc]: data.items()) {
-                std::string path = desc.get<std::string>();
-                assets[name] = texture_utils::loadImage(path);
+                std::string path = desc.is_object() ? desc.value("path", "") : desc.get<std::string>();
+                Texture2D *texture = texture_utils::loadCooked(path);
+                assets[name] = texture ? texture : TextureStreamer::get().load(path);
             }
         }
     };
@@ -64,12 +99,30 @@ namespace our {
     // This will load all the meshes defined in "data"
     // data must be in the form:
     //    { mesh_name : "path/to/3d-model-file", ... }
+    // or, to set some options for the mesh:
+    //    { mesh_name : { "path": "path/to/3d-model-file", "packed": true, "optimize": true }, ... }
+    // where:
+    //      "packed" (optional, default=false) stores the vertices in a compressed format (see "mesh/vertex-packing.hpp")
+    //      "optimize" (optional, default=false) reorders the mesh for the vertex cache and the overdraw (see "mesh/mesh-optimizer.hpp")
+    //      "lods" (optional, default=0) the number of coarser levels of detail to generate (see "mesh/mesh-simplifier.hpp")
+    //      "cache" (optional, default=true) loads the mesh from its binary cache when it is up to date (see "mesh/mesh-cache.hpp")
     template<>
     void AssetLoader<Mesh>::deserialize(const nlohmann::json &data) {
         if (data.is_object()) {
             for (auto &[name, desc]: data.items()) {
-                std::string path = desc.get<std::string>();
-                assets[name] = mesh_utils::loadOBJ(path);
+                std::string path;
+                mesh_utils::MeshLoadOptions options;
+                if (desc.is_object()) {
+                    path = desc.value("path", "");
+                    options.packed = desc.value("packed", false);
+                    options.optimize = desc.value("optimize", false);
+                    options.lods = desc.value("lods", 0);
+                    options.cache = desc.value("cache", true);
+                } else {
+                    path = desc.get<std::string>();
+                }
+                Mesh *mesh = mesh_utils::loadOBJ(path, options);
+                assets[name] = mesh;
             }
         }
     };
@@ -98,6 +151,49 @@ namespace our {
         }
     };
 
+    // The lit materials that use texture arrays and wait for their textures to be packed (see "updateTextureArrays")
+    static std::vector<LitMaterial *> unpackedMaterials;
+    // The arrays built by "packMaterialTextures" and the placeholder bound by the materials till then (deleted by "clearAllAssets")
+    static std::vector<TextureArray *> textureArrays;
+    static TextureArray *placeholderArray = nullptr;
+
+    void updateTextureArrays() {
+        if (unpackedMaterials.empty()) return;
+        //. the size and format of a streamed texture are only known once its image is uploaded, so we wait for all of them
+        //. (the materials keep drawing with the placeholder array meanwhile)
+        TextureStreamer &streamer = TextureStreamer::get();
+        for (LitMaterial *material: unpackedMaterials)
+            for (int slot = 0; slot < LitMaterial::TEXTURE_SLOT_COUNT; slot++)
+                if (streamer.isLoading(material->getTexture((LitMaterial::TextureSlot)slot)))
+                    return;
+
+        std::vector<TextureArray *> arrays = packMaterialTextures(unpackedMaterials);
+        textureArrays.insert(textureArrays.end(), arrays.begin(), arrays.end());
+
+        //. the packed textures are only sampled through their arrays now, so the ones that no other material samples
+        //. are deleted instead of keeping every texel twice in the video memory
+        std::unordered_set<Texture2D *> packed, used;
+        for (LitMaterial *material: unpackedMaterials)
+            for (int slot = 0; slot < LitMaterial::TEXTURE_SLOT_COUNT; slot++)
+                if (material->arrays[slot] && material->arrays[slot] != placeholderArray)
+                    packed.insert(material->getTexture((LitMaterial::TextureSlot)slot));
+        AssetLoader<Material>::forEach([&used](const std::string &, Material *material) {
+            if (auto textured = dynamic_cast<TexturedMaterial *>(material)) {
+                used.insert(textured->texture);
+            } else if (auto lit = dynamic_cast<LitMaterial *>(material); lit && !lit->useTextureArrays) {
+                for (int slot = 0; slot < LitMaterial::TEXTURE_SLOT_COUNT; slot++)
+                    used.insert(lit->getTexture((LitMaterial::TextureSlot)slot));
+            }
+        });
+        for (LitMaterial *material: unpackedMaterials)
+            for (int slot = 0; slot < LitMaterial::TEXTURE_SLOT_COUNT; slot++)
+                if (Texture2D *texture = material->getTexture((LitMaterial::TextureSlot)slot); packed.count(texture) && !used.count(texture))
+                    material->setTexture((LitMaterial::TextureSlot)slot, nullptr);
+        for (Texture2D *texture: packed)
+            if (!used.count(texture))
+                AssetLoader<Texture2D>::remove(texture);
+        unpackedMaterials.clear();
+    }
 
     void deserializeAllAssets(const nlohmann::json &assetData) {
         if (!assetData.is_object()) return;
@@ -109,17 +205,38 @@ namespace our {
             AssetLoader<Sampler>::deserialize(assetData["samplers"]);
         if (assetData.contains("meshes"))
             AssetLoader<Mesh>::deserialize(assetData["meshes"]);
-        if (assetData.contains("materials"))
+        if (assetData.contains("materials")) {
             AssetLoader<Material>::deserialize(assetData["materials"]);
+            //. the lit materials that read their textures from texture arrays bind a placeholder till their arrays are built
+            for (auto &[name, desc]: assetData["materials"].items()) {
+                auto material = dynamic_cast<LitMaterial *>(AssetLoader<Material>::get(name));
+                if (!material || !material->useTextureArrays) continue;
+                if (!placeholderArray) placeholderArray = createPlaceholderArray();
+                for (int slot = 0; slot < LitMaterial::TEXTURE_SLOT_COUNT; slot++)
+                    if (material->getTexture((LitMaterial::TextureSlot)slot))
+                        material->arrays[slot] = placeholderArray;
+                unpackedMaterials.push_back(material);
+            }
+            //. the arrays are built right away if the textures were cooked (or already uploaded)
+            updateTextureArrays();
+        }
 
     }
 
     void clearAllAssets() {
         AssetLoader<ShaderProgram>::clear();
+        // The textures that are still being streamed must not receive their images after they are deleted
+        TextureStreamer::get().cancelAll();
         AssetLoader<Texture2D>::clear();
+        unpackedMaterials.clear();
+        for (TextureArray *array: textureArrays)
+            delete array;
+        textureArrays.clear();
+        delete placeholderArray;
+        placeholderArray = nullptr;
         AssetLoader<Sampler>::clear();
         AssetLoader<Mesh>::clear();
         AssetLoader<Material>::clear();
     }
 
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -32,6 +32,24 @@ namespace our {
             }
             return nullptr;
         };
+        // Calls "function(name, asset)" for every asset
+        template<typename Function>
+        static void forEach(Function function) {
+            for(auto& [name, asset] : assets){
+                function(name, asset);
+            }
+        }
+        // This function deletes the given asset and removes it from the assets map
+        // WARNING: every pointer to the asset must be dropped before calling this function
+        static void remove(T* asset) {
+            for(auto it = assets.begin(); it != assets.end(); ++it){
+                if(it->second == asset){
+                    delete asset;
+                    assets.erase(it);
+                    return;
+                }
+            }
+        }
         // This function deletes all the assets held by this class and clear the assets map 
         static void clear(){
             for(auto& [name, asset] : assets){
@@ -46,6 +64,10 @@ namespace our {
     // For example, a json in the form {"shaders": ... , "textures": ... } will call "deserialize" for:
     // AssetLoader<ShaderProgram> and AssetLoader<Texture2D>
     void deserializeAllAssets(const nlohmann::json& assetData);
+    // Packs the textures of the lit materials loaded with "textureArrays": true into texture arrays (see "packMaterialTextures")
+    // once none of them is still streamed, then deletes the packed textures that no other material uses
+    // This is called by "deserializeAllAssets" then every frame (on the thread that owns the OpenGL context) till the arrays are built
+    void updateTextureArrays();
     // This will call "AssetLoader<T>::clear" for all the different asset types T
     void clearAllAssets();
 }
\ No newline at end of file
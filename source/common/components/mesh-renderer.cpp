@@ -1,6 +1,8 @@
 #include "mesh-renderer.hpp"
 #include "../asset-loader.hpp"
 
+#include <iostream>
+
 namespace our {
     // Receives the mesh & material from the AssetLoader by the names given in the json object
     /// @brief Receives the mesh & material from the AssetLoader by the names given in the json object
@@ -16,7 +18,66 @@ namespace our {
 
         /// get the material and the mesh from the AssetLoader by their names
         /// which are defined with the keys "mesh" and "material" in data.
-        material = AssetLoader<Material>::get(data["material"].get<std::string>());
         mesh = AssetLoader<Mesh>::get(data["mesh"].get<std::string>());
+        /// a mesh with several submeshes can use a material per submesh, given by "materials" which is either
+        /// a list (in the order of the submeshes) or an object from the submesh name to the material name
+        /// the submeshes that are not given a material use "material"
+        material = data.contains("material") ? AssetLoader<Material>::get(data["material"].get<std::string>()) : nullptr;
+        materials.clear();
+        if(data.contains("materials")){
+            const nlohmann::json& list = data["materials"];
+            if(list.is_array()){
+                for(const auto& name : list)
+                    materials.push_back(AssetLoader<Material>::get(name.get<std::string>()));
+            } else if(list.is_object() && mesh){
+                materials.resize(mesh->getSubmeshCount(), nullptr);
+                for(auto& [submeshName, materialName] : list.items()){
+                    int submesh = mesh->findSubmesh(submeshName);
+                    if(submesh < 0){
+                        std::cerr << "The mesh \"" << data["mesh"].get<std::string>() << "\" has no submesh \"" << submeshName << "\"" << std::endl;
+                        continue;
+                    }
+                    materials[submesh] = AssetLoader<Material>::get(materialName.get<std::string>());
+                }
+            }
+            if(!material && !materials.empty())
+                material = materials[0];
+        }
+        if(materials.empty())
+            materials.push_back(material);
+        else if(!materials[0])
+            materials[0] = material;
+        lodScreenSizes = data.value("lodScreenSizes", lodScreenSizes);
+        lodHysteresis = data.value("lodHysteresis", lodHysteresis);
+        occluder = data.value("occluder", occluder);
+    }
+
+    /// @brief checks whether all the submeshes of the mesh use the same material (the material of the first submesh)
+    /// @return true if the mesh can be drawn using one draw call with "getMaterial(0)"
+    bool MeshRendererComponent::hasSingleMaterial() const{
+        if(!mesh) return true;
+        /// the first submesh is compared too since "materials[0]" may differ from "material"
+        /// (e.g. "material" is "b" and "materials" is ["a"], or the first submesh is named in the object form)
+        Material* first = getMaterial(0);
+        for(int submesh = 0; submesh < mesh->getSubmeshCount(); submesh++)
+            if(getMaterial(submesh) != first)
+                return false;
+        return true;
+    }
+
+    /// @brief picks the level of detail for the given projected size using the thresholds in "lodScreenSizes"
+    /// @param screenSize: the fraction of the screen height covered by the bounding sphere of the mesh
+    /// @return the level of detail that should be drawn
+    int MeshRendererComponent::selectLod(float screenSize){
+        int maxLod = std::min((int)lodScreenSizes.size(), mesh->getLodCount() - 1);
+        int lod = std::min(currentLod, maxLod);
+        /// move to a coarser level as long as the mesh is smaller than the threshold of the current level
+        while(lod < maxLod && screenSize < lodScreenSizes[lod])
+            lod++;
+        /// move to a finer level only if the mesh is clearly bigger than the threshold of that level
+        while(lod > 0 && screenSize > lodScreenSizes[lod - 1] * (1.0f + lodHysteresis))
+            lod--;
+        currentLod = lod;
+        return lod;
     }
 }
\ No newline at end of file
@@ -11,13 +11,38 @@ namespace our {
     class MeshRendererComponent : public Component {
     public:
         Mesh* mesh; // The mesh that should be drawn
-        Material* material; // The material used to draw the mesh
+        Material* material; // The material of the submeshes that aren't given one in "materials"
+        // The material of every submesh of the mesh (materials[0] is "material" unless the first submesh is given another one)
+        // If the mesh has more submeshes than materials, the extra submeshes are drawn using "material"
+        // So the mesh must be drawn using "getMaterial(submesh)" (or "getMaterial(0)" if "hasSingleMaterial" is true)
+        std::vector<Material*> materials;
+
+        // The level of detail is picked every frame from the projected size of the mesh (the fraction of the screen height
+        // covered by its bounding sphere). The level i+1 is used when the size is below "lodScreenSizes[i]".
+        std::vector<float> lodScreenSizes = {0.25f, 0.12f, 0.05f};
+        // To avoid flickering between two levels, a finer level is only picked again when the size exceeds its threshold by this ratio
+        float lodHysteresis = 0.15f;
+        // The level of detail picked in the last frame
+        int currentLod = 0;
+        // If true, a simplified copy of the mesh hides the objects behind it in the CPU occlusion culling (see "occlusion-culler.hpp")
+        // It should be set on large solid objects (the road, the ground, the obstacles) since small ones rarely hide anything
+        bool occluder = false;
 
         // The ID of this component type is "Mesh Renderer"
         static std::string getID() { return "Mesh Renderer"; }
 
         // Receives the mesh & material from the AssetLoader by the names given in the json object
         void deserialize(const nlohmann::json& data) override;
+
+        // Picks the level of detail for the given projected size (and remembers it for the next frame)
+        int selectLod(float screenSize);
+
+        // Returns the material used to draw the given submesh
+        Material* getMaterial(int submesh) const {
+            return submesh >= 0 && submesh < (int)materials.size() && materials[submesh] ? materials[submesh] : material;
+        }
+        // Returns true if all the submeshes are drawn using the same material (so the mesh can be drawn in one draw call)
+        bool hasSingleMaterial() const;
     };
 
 }
\ No newline at end of file
@@ -104,6 +104,14 @@ namespace our {
                 {"GL_ONE_MINUS_CONSTANT_ALPHA", GL_ONE_MINUS_CONSTANT_ALPHA}
         };
 
+        inline EnumMap render_target_formats = {
+                {"GL_RGBA8", GL_RGBA8},
+                {"GL_RGB10_A2", GL_RGB10_A2},
+                {"GL_R11F_G11F_B10F", GL_R11F_G11F_B10F},
+                {"GL_RGBA16F", GL_RGBA16F},
+                {"GL_RGBA32F", GL_RGBA32F}
+        };
+
         inline EnumMap blend_equations = {
                 {"GL_FUNC_ADD", GL_FUNC_ADD},
                 {"GL_FUNC_SUBTRACT", GL_FUNC_SUBTRACT},
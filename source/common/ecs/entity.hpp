@@ -22,6 +22,7 @@ namespace our {
         Entity *parent;           // The parent of the entity. The transform of the entity is relative to its parent.
         // If parent is null, the entity is a root entity (has no parent).
         Transform localTransform; // The transform of this entity relative to its parent.
+        bool isStatic = false;    // If true, the entity never moves so the renderer can merge its mesh with other static meshes at load time.
 
         World *getWorld() const { return world; } // Returns the world to which this entity belongs
 
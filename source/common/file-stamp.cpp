@@ -0,0 +1,67 @@
+#include "file-stamp.hpp"
+#include "mapped-file.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace our
+{
+
+    // The FNV-1a hash of the given bytes
+    static std::uint64_t hashBytes(const std::uint8_t *bytes, size_t size)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (size_t index = 0; index < size; index++)
+        {
+            hash ^= bytes[index];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Reads the size and the modification time of the file (without hashing it)
+    static bool readFileInfo(const std::string &path, FileStamp &stamp)
+    {
+        std::error_code error;
+        stamp.size = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+        stamp.time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        return !error;
+    }
+
+    bool readFileStamp(const std::string &path, FileStamp &stamp)
+    {
+        if (!readFileInfo(path, stamp))
+            return false;
+        MappedFile file;
+        //. an empty file can't be mapped, but it also has nothing to hash
+        stamp.hash = file.open(path) ? hashBytes(static_cast<const std::uint8_t *>(file.data()), file.size()) : hashBytes(nullptr, 0);
+        return true;
+    }
+
+    bool matchesFileStamp(const std::string &path, FileStamp &stamp)
+    {
+        FileStamp current;
+        if (!readFileInfo(path, current) || (current.size == stamp.size && current.time == stamp.time))
+            return true;
+        readFileStamp(path, current);
+        if (current.size != stamp.size || current.hash != stamp.hash)
+            return false;
+        stamp.time = current.time;
+        return true;
+    }
+
+    bool writeFileStamp(const std::string &path, std::uint64_t offset, const FileStamp &stamp)
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        if (!file)
+            return false;
+        file.seekp((std::streamoff)offset);
+        file.write(reinterpret_cast<const char *>(&stamp.size), sizeof(stamp.size));
+        file.write(reinterpret_cast<const char *>(&stamp.time), sizeof(stamp.time));
+        file.write(reinterpret_cast<const char *>(&stamp.hash), sizeof(stamp.hash));
+        return (bool)file;
+    }
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace our
+{
+
+    // Identifies the content of a source file so that the files generated from it (such as the caches and the cooked assets)
+    // can tell whether they are still up to date
+    struct FileStamp
+    {
+        std::uint64_t size = 0;
+        std::int64_t time = 0; // The modification time (in the ticks of the file clock)
+        std::uint64_t hash = 0; // The FNV-1a hash of the content
+    };
+
+    // Reads the size, modification time and content hash of the file
+    // Returns false if the file doesn't exist
+    bool readFileStamp(const std::string &path, FileStamp &stamp);
+
+    // Checks whether the file still has the content described by the stamp
+    // The file is only hashed if its size or modification time changed, so touching a file doesn't invalidate its generated files
+    // If only the modification time changed, the stamp gets the new time so the generated file can store it (see "writeFileStamp")
+    // and the next checks don't hash the file again
+    // A missing file matches any stamp, since the generated files can be shipped without their sources
+    bool matchesFileStamp(const std::string &path, FileStamp &stamp);
+
+    // Overwrites the stamp stored at the given offset of a generated file (the size, time and hash one after the other)
+    // The generated file must not be mapped meanwhile (Windows doesn't allow writing to a mapped file)
+    // Returns false if the file can't be written
+    bool writeFileStamp(const std::string &path, std::uint64_t offset, const FileStamp &stamp);
+
+}
@@ -0,0 +1,98 @@
+#include "mapped-file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace our
+{
+
+#ifdef _WIN32
+
+    bool MappedFile::open(const std::string &path)
+    {
+        close();
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr)
+        {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        fileHandle = file;
+        mappingHandle = mapping;
+        address = view;
+        fileSize = (size_t)size.QuadPart;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (address)
+            UnmapViewOfFile(address);
+        if (mappingHandle)
+            CloseHandle(mappingHandle);
+        if (fileHandle)
+            CloseHandle(fileHandle);
+        address = nullptr;
+        mappingHandle = fileHandle = nullptr;
+        fileSize = 0;
+    }
+
+#else
+
+    bool MappedFile::open(const std::string &path)
+    {
+        close();
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size == 0)
+        {
+            ::close(file);
+            return false;
+        }
+        void *view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        //. the mapping stays valid after the file descriptor is closed
+        ::close(file);
+        if (view == MAP_FAILED)
+            return false;
+        address = view;
+        fileSize = (size_t)status.st_size;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (address)
+            munmap(const_cast<void *>(address), fileSize);
+        address = nullptr;
+        fileSize = 0;
+    }
+
+#endif
+
+}
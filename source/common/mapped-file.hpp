@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace our
+{
+
+    // A read-only view of a whole file that is mapped into the address space of the process
+    // The pages are loaded by the OS on demand, so the file content can be handed directly to the GPU without copying it first.
+    class MappedFile
+    {
+        const void *address = nullptr;
+        size_t fileSize = 0;
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#endif
+
+    public:
+        MappedFile() = default;
+        ~MappedFile() { close(); }
+
+        // Maps the file at the given path (any previously mapped file is closed first)
+        // Returns false if the file doesn't exist, is empty or can't be mapped
+        bool open(const std::string &path);
+        // Unmaps the file (does nothing if no file is mapped)
+        void close();
+
+        bool isOpen() const { return address != nullptr; }
+        const void *data() const { return address; }
+        size_t size() const { return fileSize; }
+
+        MappedFile(MappedFile const &) = delete;
+        MappedFile &operator=(MappedFile const &) = delete;
+    };
+
+}
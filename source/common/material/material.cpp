@@ -7,11 +7,11 @@ namespace our
 {
 
     // This function should setup the pipeline state and set the shader to be used
-    void Material::setup() const
+    void Material::setup(ShaderProgram *program) const
     {
         // TODO: (Req 7) Write this function
         pipelineState.setup();
-        shader->use();
+        program->use();
     }
 
     // This function read the material data from a json object
@@ -25,18 +25,23 @@ namespace our
             pipelineState.deserialize(data["pipelineState"]);
         }
         shader = AssetLoader<ShaderProgram>::get(data["shader"].get<std::string>());
+        if (!shader)
+            std::cerr << "The material's shader \"" << data["shader"].get<std::string>() << "\" wasn't loaded" << std::endl;
+        // The optional shaders stay null if the asset loader skipped them (e.g. the indirect shaders need OpenGL 4.3)
+        instancedShader = AssetLoader<ShaderProgram>::get(data.value("instancedShader", ""));
+        indirectShader = AssetLoader<ShaderProgram>::get(data.value("indirectShader", ""));
         transparent = data.value("transparent", false);
     }
 
     // This function should call the setup of its parent and
     // set the "tint" uniform to the value in the member variable tint
-    void TintedMaterial::setup() const
+    void TintedMaterial::setup(ShaderProgram *program) const
     {
         // TODO: (Req 7) Write this function
         // call the setup of the parent
-        Material::setup();
+        Material::setup(program);
         // set the "tint" uniform to the value in the member variable tint
-        shader->set("tint", tint);
+        program->set("tint", tint);
     }
 
     // This function read the material data from a json object
@@ -51,13 +56,13 @@ namespace our
     // This function should call the setup of its parent and
     // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
     // Then it should bind the texture and sampler to a texture unit and send the unit number to the uniform variable "tex"
-    void TexturedMaterial::setup() const
+    void TexturedMaterial::setup(ShaderProgram *program) const
     {
         // TODO: (Req 7) Write this function
-        TintedMaterial::setup();
+        TintedMaterial::setup(program);
 
         // we need to set the alphaThreshold uniform so that we can use it in the shader to discard pixels (Alpha Testing)
-        shader->set("alphaThreshold", alphaThreshold);
+        program->set("alphaThreshold", alphaThreshold);
 
         // we will use UNIT_0 in the next bindings
         glActiveTexture(GL_TEXTURE0);
@@ -68,7 +73,7 @@ namespace our
             sampler->bind(0);
 
         // unit number to the shader
-        shader->set("tex", 0);
+        program->set("tex", 0);
     }
 
     // This function read the material data from a json object
@@ -94,13 +99,83 @@ namespace our
         roughness = AssetLoader<Texture2D>::get(data.value("roughness", ""));
         emissive = AssetLoader<Texture2D>::get(data.value("emissive", ""));
         ambient_occlusion = AssetLoader<Texture2D>::get(data.value("ambient_occlusion", ""));
+        useTextureArrays = data.value("textureArrays", false);
+    }
+
+    Texture2D *LitMaterial::getTexture(TextureSlot slot) const
+    {
+        switch (slot)
+        {
+        case ALBEDO: return albedo;
+        case SPECULAR: return specular;
+        case ROUGHNESS: return roughness;
+        case AMBIENT_OCCLUSION: return ambient_occlusion;
+        case EMISSIVE: return emissive;
+        default: return nullptr;
+        }
+    }
+
+    void LitMaterial::setTexture(TextureSlot slot, Texture2D *texture)
+    {
+        switch (slot)
+        {
+        case ALBEDO: albedo = texture; break;
+        case SPECULAR: specular = texture; break;
+        case ROUGHNESS: roughness = texture; break;
+        case AMBIENT_OCCLUSION: ambient_occlusion = texture; break;
+        case EMISSIVE: emissive = texture; break;
+        default: break;
+        }
+    }
+
+    bool LitMaterial::hasSameState(const LitMaterial &other) const
+    {
+        if (!useTextureArrays || !other.useTextureArrays)
+            return false;
+        for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+            if (arrays[slot] != other.arrays[slot])
+                return false;
+        return pipelineState == other.pipelineState && shader == other.shader && instancedShader == other.instancedShader &&
+               indirectShader == other.indirectShader && transparent == other.transparent && sampler == other.sampler;
+    }
+
+    //. the texture unit and the uniform of every slot (the units are the ones used before the texture arrays were added)
+    static const GLint LIT_TEXTURE_UNITS[LitMaterial::TEXTURE_SLOT_COUNT] = {0, 1, 3, 4, 2};
+    static const char *LIT_TEXTURE_UNIFORMS[LitMaterial::TEXTURE_SLOT_COUNT] = {
+        "material.albedo", "material.specular", "material.roughness", "material.ambient_occlusion", "material.emissive"};
+    static const char *LIT_LAYER_UNIFORMS[LitMaterial::TEXTURE_SLOT_COUNT] = {
+        "material_layers[0]", "material_layers[1]", "material_layers[2]", "material_layers[3]", "material_layers[4]"};
+
+    //. sends the layer of every texture inside its array
+    void LitMaterial::setupDrawData(ShaderProgram *program) const
+    {
+        if (!useTextureArrays)
+            return;
+        for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+            program->set(LIT_LAYER_UNIFORMS[slot], layers[slot]);
     }
 
     // This function should call the setup of its parent and
     // bind the light texture and sampler to a texture unit and send the unit number to the uniform variable "lightTex"
-    void LitMaterial::setup() const
+    void LitMaterial::setup(ShaderProgram *program) const
     {
-        Material::setup();
+        Material::setup(program);
+        //. with texture arrays, we bind the arrays instead of the textures (so the bindings are the same for all the materials
+        //. sharing the arrays) and the shader picks the texture by its layer
+        if (useTextureArrays)
+        {
+            for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+            {
+                if (arrays[slot] == nullptr)
+                    continue;
+                glActiveTexture(GL_TEXTURE0 + LIT_TEXTURE_UNITS[slot]);
+                arrays[slot]->bind();
+                sampler->bind(LIT_TEXTURE_UNITS[slot]);
+                program->set(LIT_TEXTURE_UNIFORMS[slot], LIT_TEXTURE_UNITS[slot]);
+            }
+            setupDrawData(program);
+            return;
+        }
         //. bind the albdeo, roughness, emissive, ambient_occlusion and specular textures to texture units
         //. and send the unit number to the uniform variables "material.albedo", "material.roughness", "material.emissive", "material.ambient_occlusion" and "material.specular"
         
@@ -109,37 +184,73 @@ namespace our
             glActiveTexture(GL_TEXTURE0);
             albedo->bind();
             sampler->bind(0);
-            shader->set("material.albedo", 0);
+            program->set("material.albedo", 0);
         }
         if (roughness != nullptr)
         {
             glActiveTexture(GL_TEXTURE3);
             roughness->bind();
             sampler->bind(3);
-            shader->set("material.roughness", 3);
+            program->set("material.roughness", 3);
         }
         if (emissive != nullptr)
         {
             glActiveTexture(GL_TEXTURE2);
             emissive->bind();
             sampler->bind(2);
-            shader->set("material.emissive", 2);
+            program->set("material.emissive", 2);
         }
         if (ambient_occlusion != nullptr)
         {
             glActiveTexture(GL_TEXTURE4);
             ambient_occlusion->bind();
             sampler->bind(4);
-            shader->set("material.ambient_occlusion", 4);
+            program->set("material.ambient_occlusion", 4);
         }
         if (specular != nullptr)
         {
             glActiveTexture(GL_TEXTURE1);
             specular->bind();
             sampler->bind(1);
-            shader->set("material.specular", 1);
+            program->set("material.specular", 1);
         }
         // glActiveTexture(GL_TEXTURE0);
     }
 
-}
\ No newline at end of file
+    std::vector<TextureArray *> packMaterialTextures(const std::vector<LitMaterial *> &materials)
+    {
+        std::vector<Texture2D *> textures;
+        for (LitMaterial *material : materials)
+            for (int slot = 0; slot < LitMaterial::TEXTURE_SLOT_COUNT; slot++)
+                textures.push_back(material->getTexture((LitMaterial::TextureSlot)slot));
+        std::unordered_map<Texture2D *, TextureArrayLayer> layers;
+        std::vector<TextureArray *> arrays = buildTextureArrays(textures, layers);
+
+        for (size_t index = 0; index < materials.size(); index++)
+        {
+            LitMaterial *material = materials[index];
+            for (int slot = 0; slot < LitMaterial::TEXTURE_SLOT_COUNT; slot++)
+            {
+                Texture2D *texture = material->getTexture((LitMaterial::TextureSlot)slot);
+                if (!texture)
+                    continue;
+                if (auto it = layers.find(texture); it != layers.end())
+                {
+                    material->arrays[slot] = it->second.array;
+                    material->layers[slot] = it->second.layer;
+                }
+                else
+                {
+                    std::cerr << "A texture of a material can't be packed into a texture array (unsupported format)" << std::endl;
+                }
+            }
+            //. the first material with the same state becomes the state owner of this one
+            material->stateOwner = nullptr;
+            for (size_t other = 0; other < index && !material->stateOwner; other++)
+                if (materials[other]->stateOwner == nullptr && material->hasSameState(*materials[other]))
+                    material->stateOwner = materials[other];
+        }
+        return arrays;
+    }
+
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "pipeline-state.hpp"
 #include "../texture/texture2d.hpp"
+#include "../texture/texture-array.hpp"
 #include "../texture/sampler.hpp"
 #include "../shader/shader.hpp"
 
@@ -22,10 +23,25 @@ namespace our
     public:
         PipelineState pipelineState;
         ShaderProgram *shader;
+        // An optional variant of the shader that reads the model matrices from per-instance attributes
+        // If it exists, the renderer can draw all the objects sharing this material and a mesh in one instanced draw call
+        ShaderProgram *instancedShader = nullptr;
+        // An optional variant of the shader that reads the model matrices from a storage buffer indexed by a draw id
+        // If it exists, the renderer can draw all the objects sharing this material in one multi-draw indirect call
+        ShaderProgram *indirectShader = nullptr;
         bool transparent;
 
         // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+        void setup() const { setup(shader); }
+        // Same as setup() but the uniforms are sent to the given program (e.g. the instanced shader) instead of "shader"
+        virtual void setup(ShaderProgram *program) const;
+        // Sends the uniforms that differ between materials sharing a state key (see "getStateKey") to the given program
+        // "setup" already sends them, so this is only called for the objects drawn right after another material with the same key
+        virtual void setupDrawData(ShaderProgram * /*program*/) const {}
+        // Materials with the same state key set the same pipeline state, shaders and texture bindings in "setup"
+        // and only differ in the data sent by "setupDrawData", so the renderer can draw them together without a full setup between them
+        // By default, every material is its own key
+        virtual const void *getStateKey() const { return this; }
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json &data);
     };
@@ -37,7 +53,8 @@ namespace our
     public:
         glm::vec4 tint;
 
-        void setup() const override;
+        using Material::setup;
+        void setup(ShaderProgram *program) const override;
         void deserialize(const nlohmann::json &data) override;
     };
 
@@ -54,7 +71,8 @@ namespace our
         // to be used in alpha testing
         float alphaThreshold;
 
-        void setup() const override;
+        using Material::setup;
+        void setup(ShaderProgram *program) const override;
         void deserialize(const nlohmann::json &data) override;
     };
 
@@ -75,9 +93,47 @@ namespace our
         //. sampler for all the textures
         Sampler *sampler;
 
-        void setup() const override;
+        //. the texture slots in the order used by "arrays" and "layers" (and the "material_layers" uniform)
+        enum TextureSlot
+        {
+            ALBEDO,
+            SPECULAR,
+            ROUGHNESS,
+            AMBIENT_OCCLUSION,
+            EMISSIVE,
+            TEXTURE_SLOT_COUNT
+        };
+        //. if true, the textures are read from texture arrays instead (the shaders must be compiled with TEXTURE_ARRAYS defined)
+        //. the arrays are built once the textures of all such materials are loaded (see "packMaterialTextures" and "updateTextureArrays")
+        //. and the slots show a placeholder array till then
+        //. so the materials whose textures landed in the same arrays can share their bindings and be drawn in the same batch
+        bool useTextureArrays = false;
+        //. the array holding the texture of every slot (nullptr if the slot has no texture) and its layer inside the array
+        TextureArray *arrays[TEXTURE_SLOT_COUNT] = {};
+        GLint layers[TEXTURE_SLOT_COUNT] = {};
+        //. the first material found with the same state (set by "packMaterialTextures"), its address is the state key of this material
+        const LitMaterial *stateOwner = nullptr;
+
+        //. returns the texture of the given slot
+        Texture2D *getTexture(TextureSlot slot) const;
+        //. replaces the texture of the given slot (e.g. by nullptr once the texture is only sampled through its array)
+        void setTexture(TextureSlot slot, Texture2D *texture);
+        //. returns true if both materials use texture arrays and only differ in their layers
+        bool hasSameState(const LitMaterial &other) const;
+
+        using Material::setup;
+        void setup(ShaderProgram *program) const override;
+        void setupDrawData(ShaderProgram *program) const override;
+        const void *getStateKey() const override { return stateOwner ? stateOwner : this; }
         void deserialize(const nlohmann::json &data) override;
     };
+    // Packs the textures of the given lit materials (which use texture arrays) into texture arrays (see "buildTextureArrays"),
+    // then the materials that ended up with the same arrays (and the same shaders, sampler and pipeline state) get the same
+    // state key so the renderer binds their textures once and draws them in the same batch, with their layers as per-draw data
+    // The textures must be loaded (see "TextureStreamer::isLoading") and a slot whose texture can't be packed keeps its array
+    // @return: the created arrays (owned by the caller)
+    std::vector<TextureArray *> packMaterialTextures(const std::vector<LitMaterial *> &materials);
+
     // This function returns a new material instance based on the given type
     // @param type can be "tinted" or "textured" or whatever we will add in the future
     inline Material *createMaterialFromType(const std::string &type)
@@ -88,6 +88,18 @@ namespace our
             glDepthMask(depthMask);  
         }
 
+        // Returns true if both pipeline states configure OpenGL's pipeline the same way
+        bool operator==(const PipelineState &other) const
+        {
+            return faceCulling.enabled == other.faceCulling.enabled && faceCulling.culledFace == other.faceCulling.culledFace &&
+                   faceCulling.frontFace == other.faceCulling.frontFace &&
+                   depthTesting.enabled == other.depthTesting.enabled && depthTesting.function == other.depthTesting.function &&
+                   blending.enabled == other.blending.enabled && blending.equation == other.blending.equation &&
+                   blending.sourceFactor == other.blending.sourceFactor && blending.destinationFactor == other.blending.destinationFactor &&
+                   blending.constantColor == other.blending.constantColor &&
+                   colorMask == other.colorMask && depthMask == other.depthMask;
+        }
+
         // Given a json object, this function deserializes a PipelineState structure
         void deserialize(const nlohmann::json &data);
     };
@@ -0,0 +1,370 @@
+#include "mesh-arena.hpp"
+#include "vertex.hpp"
+#include "vertex-packing.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace our
+{
+
+    // The initial sizes of the arena buffers (they double whenever they get full)
+    static const GLsizei INITIAL_VERTEX_CAPACITY = 1 << 16;           // vertices per format
+    static const GLsizeiptr INITIAL_ELEMENT_CAPACITY = 4 * (1 << 18); // bytes (256K 32-bit indices)
+
+    void RangeAllocator::reset(GLsizeiptr capacity)
+    {
+        this->capacity = capacity;
+        freeRanges.clear();
+        if (capacity > 0)
+            freeRanges[0] = capacity;
+    }
+
+    void RangeAllocator::grow(GLsizeiptr newCapacity)
+    {
+        if (newCapacity <= capacity)
+            return;
+        GLsizeiptr added = newCapacity - capacity;
+        GLsizeiptr start = capacity;
+        capacity = newCapacity;
+        free(start, added);
+    }
+
+    bool RangeAllocator::allocate(GLsizeiptr size, GLsizeiptr alignment, GLsizeiptr &offset)
+    {
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+        {
+            GLsizeiptr rangeStart = it->first, rangeSize = it->second;
+            // round the start up to the alignment and check if the allocation still fits in the range
+            GLsizeiptr alignedStart = (rangeStart + alignment - 1) / alignment * alignment;
+            GLsizeiptr padding = alignedStart - rangeStart;
+            if (padding + size > rangeSize)
+                continue;
+            // split the range: the padding (if any) stays free before the allocation and the remainder stays free after it
+            freeRanges.erase(it);
+            if (padding > 0)
+                freeRanges[rangeStart] = padding;
+            if (padding + size < rangeSize)
+                freeRanges[alignedStart + size] = rangeSize - padding - size;
+            offset = alignedStart;
+            return true;
+        }
+        return false;
+    }
+
+    void RangeAllocator::free(GLsizeiptr offset, GLsizeiptr size)
+    {
+        if (size <= 0)
+            return;
+        auto next = freeRanges.lower_bound(offset);
+        // merge with the following range if it starts exactly where this one ends
+        if (next != freeRanges.end() && next->first == offset + size)
+        {
+            size += next->second;
+            next = freeRanges.erase(next);
+        }
+        // merge with the preceding range if it ends exactly where this one starts
+        if (next != freeRanges.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                previous->second += size;
+                return;
+            }
+        }
+        freeRanges[offset] = size;
+    }
+
+    MeshArena &MeshArena::get()
+    {
+        if (!instance)
+            instance = new MeshArena();
+        return *instance;
+    }
+
+    void MeshArena::destroy()
+    {
+        delete instance;
+        instance = nullptr;
+    }
+
+    MeshArena::MeshArena()
+    {
+        //. the element buffer is shared by all the vertex formats
+        glGenBuffers(1, &elementBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, elementBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_ELEMENT_CAPACITY, nullptr, GL_STATIC_DRAW);
+        elementAllocator.reset(INITIAL_ELEMENT_CAPACITY);
+
+        pools[(int)VertexFormat::STANDARD].stride = sizeof(Vertex);
+        pools[(int)VertexFormat::PACKED].stride = sizeof(PackedVertex);
+        pools[(int)VertexFormat::PACKED_NO_COLOR].stride = sizeof(PackedVertexNoColor);
+
+        for (int index = 0; index < (int)VertexFormat::COUNT; index++)
+        {
+            VertexPool &pool = pools[index];
+            glGenBuffers(1, &pool.buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, pool.buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)INITIAL_VERTEX_CAPACITY * pool.stride, nullptr, GL_STATIC_DRAW);
+            pool.allocator.reset(INITIAL_VERTEX_CAPACITY);
+            glGenVertexArrays(1, &pool.vertexArray);
+            setupAttributes((VertexFormat)index);
+        }
+    }
+
+    MeshArena::~MeshArena()
+    {
+        for (auto &pool : pools)
+        {
+            glDeleteVertexArrays(1, &pool.vertexArray);
+            glDeleteBuffers(1, &pool.buffer);
+        }
+        glDeleteBuffers(1, &elementBuffer);
+        boundVertexArray = 0;
+    }
+
+    void MeshArena::setupAttributes(VertexFormat format)
+    {
+        VertexPool &pool = pools[(int)format];
+        glBindVertexArray(pool.vertexArray);
+        boundVertexArray = pool.vertexArray;
+        glBindBuffer(GL_ARRAY_BUFFER, pool.buffer);
+        //. the element buffer binding is a part of the VAO state so we attach the shared element buffer to every VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+        switch (format)
+        {
+        case VertexFormat::PACKED:
+            //. color: 4 unsigned bytes normalized to [0, 1]
+            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+            glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, true, sizeof(PackedVertex), (void *)offsetof(PackedVertex, color));
+            [[fallthrough]];
+        case VertexFormat::PACKED_NO_COLOR:
+            //. the color attribute stays disabled in PACKED_NO_COLOR so the shader reads the constant set by glVertexAttrib4f
+            //. both packed structs start with the same members so the offsets and the stride of the pool work for both
+            //. position: 3 unsigned shorts normalized to [0, 1] (the mesh position transform maps them back to the local space)
+            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_UNSIGNED_SHORT, true, pool.stride, (void *)offsetof(PackedVertex, position));
+            //. texture coordinates: 2 half floats
+            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_HALF_FLOAT, false, pool.stride, (void *)offsetof(PackedVertex, tex_coord));
+            //. normal: 3 signed normalized 10-bit integers (the 2-bit w is ignored)
+            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 4, GL_INT_2_10_10_10_REV, true, pool.stride, (void *)offsetof(PackedVertex, normal));
+            break;
+        case VertexFormat::STANDARD:
+        default:
+            //. position: 3 floats
+            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, false, sizeof(Vertex), (void *)offsetof(Vertex, position));
+            //. color: 4 unsigned bytes normalized to [0, 1] (devision by 255)
+            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+            glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, true, sizeof(Vertex), (void *)offsetof(Vertex, color));
+            //. texture coordinates: 2 floats
+            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, false, sizeof(Vertex), (void *)offsetof(Vertex, tex_coord));
+            //. normal: 3 floats
+            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, false, sizeof(Vertex), (void *)offsetof(Vertex, normal));
+            break;
+        }
+
+        //. the instanced attributes must be redefined if the VAO is rebuilt
+        if (pool.instanceBuffer != 0)
+        {
+            GLuint buffer = pool.instanceBuffer;
+            pool.instanceBuffer = 0;
+            pool.instancesEnabled = false;
+            attachInstanceBuffer(format, buffer);
+        }
+        if (pool.drawIdBuffer != 0)
+        {
+            GLuint buffer = pool.drawIdBuffer;
+            pool.drawIdBuffer = 0;
+            pool.drawIdsEnabled = false;
+            attachDrawIdBuffer(format, buffer);
+            //. the draw ids are only enabled during a multi-draw, so the rebuilt VAO keeps them disabled
+            detachDrawIdBuffer(format);
+        }
+    }
+
+    GLuint MeshArena::resizeBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize)
+    {
+        //. buffers cannot be resized in place, so we create a bigger one and copy the old content on the GPU side
+        GLuint resized;
+        glGenBuffers(1, &resized);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glDeleteBuffers(1, &buffer);
+        return resized;
+    }
+
+    GLint MeshArena::allocateVertices(VertexFormat format, GLsizei count)
+    {
+        VertexPool &pool = pools[(int)format];
+        GLsizeiptr first;
+        while (!pool.allocator.allocate(count, 1, first))
+        {
+            GLsizeiptr oldCapacity = pool.allocator.getCapacity();
+            GLsizeiptr newCapacity = std::max(oldCapacity * 2, oldCapacity + count);
+            pool.buffer = resizeBuffer(pool.buffer, oldCapacity * pool.stride, newCapacity * pool.stride);
+            pool.allocator.grow(newCapacity);
+            //. the VAO still points to the deleted buffer so we redefine its attributes
+            setupAttributes(format);
+        }
+        return (GLint)first;
+    }
+
+    void MeshArena::freeVertices(VertexFormat format, GLint first, GLsizei count)
+    {
+        pools[(int)format].allocator.free(first, count);
+    }
+
+    GLintptr MeshArena::allocateElements(GLsizeiptr size)
+    {
+        GLsizeiptr offset;
+        //. the offsets are aligned to 4 bytes so that any index type can start there
+        while (!elementAllocator.allocate(size, 4, offset))
+        {
+            GLsizeiptr oldCapacity = elementAllocator.getCapacity();
+            GLsizeiptr newCapacity = std::max(oldCapacity * 2, oldCapacity + size);
+            elementBuffer = resizeBuffer(elementBuffer, oldCapacity, newCapacity);
+            elementAllocator.grow(newCapacity);
+            //. every VAO still points to the deleted element buffer
+            for (int index = 0; index < (int)VertexFormat::COUNT; index++)
+                setupAttributes((VertexFormat)index);
+        }
+        return (GLintptr)offset;
+    }
+
+    void MeshArena::freeElements(GLintptr offset, GLsizeiptr size)
+    {
+        elementAllocator.free(offset, size);
+    }
+
+    void MeshArena::uploadVertices(VertexFormat format, GLint first, GLsizei count, const void *data)
+    {
+        const VertexPool &pool = pools[(int)format];
+        //. we use the copy-write target so that we don't disturb the GL_ARRAY_BUFFER or the bound VAO
+        glBindBuffer(GL_COPY_WRITE_BUFFER, pool.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)first * pool.stride, (GLsizeiptr)count * pool.stride, data);
+    }
+
+    void MeshArena::uploadElements(GLintptr offset, GLsizeiptr size, const void *data)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, elementBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    }
+
+    void MeshArena::downloadVertices(VertexFormat format, GLint first, GLsizei count, void *data) const
+    {
+        const VertexPool &pool = pools[(int)format];
+        glBindBuffer(GL_COPY_READ_BUFFER, pool.buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)first * pool.stride, (GLsizeiptr)count * pool.stride, data);
+    }
+
+    void MeshArena::downloadElements(GLintptr offset, GLsizeiptr size, void *data) const
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, elementBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, offset, size, data);
+    }
+
+    void MeshArena::bind(VertexFormat format)
+    {
+        GLuint vertexArray = pools[(int)format].vertexArray;
+        if (boundVertexArray == vertexArray)
+            return;
+        glBindVertexArray(vertexArray);
+        boundVertexArray = vertexArray;
+    }
+
+    void MeshArena::releaseBuffer(GLuint buffer)
+    {
+        if (!instance)
+            return;
+        for (auto &pool : instance->pools)
+        {
+            if (pool.instanceBuffer == buffer)
+                pool.instanceBuffer = 0;
+            if (pool.drawIdBuffer == buffer)
+                pool.drawIdBuffer = 0;
+        }
+    }
+
+    void MeshArena::attachDrawIdBuffer(VertexFormat format, GLuint buffer)
+    {
+        VertexPool &pool = pools[(int)format];
+        if (pool.drawIdBuffer == buffer && pool.drawIdsEnabled)
+            return;
+        if (pool.drawIdBuffer != buffer)
+        {
+            pool.drawIdBuffer = buffer;
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            //. the "I" version of the function keeps the value as an integer instead of converting it to a float
+            glVertexAttribIPointer(ATTRIB_LOC_DRAW_ID, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)0);
+            glVertexAttribDivisor(ATTRIB_LOC_DRAW_ID, 1);
+        }
+        glEnableVertexAttribArray(ATTRIB_LOC_DRAW_ID);
+        pool.drawIdsEnabled = true;
+    }
+
+    void MeshArena::detachDrawIdBuffer(VertexFormat format)
+    {
+        VertexPool &pool = pools[(int)format];
+        if (!pool.drawIdsEnabled)
+            return;
+        //. the draw id buffer is sized to the indirect batch, so an instanced draw with more instances would read past its end
+        glDisableVertexAttribArray(ATTRIB_LOC_DRAW_ID);
+        pool.drawIdsEnabled = false;
+    }
+
+    void MeshArena::attachInstanceBuffer(VertexFormat format, GLuint buffer)
+    {
+        VertexPool &pool = pools[(int)format];
+        //. the instanced attributes are stored in the VAO so we only need to define them once per buffer
+        if (pool.instanceBuffer == buffer && pool.instancesEnabled)
+            return;
+        if (pool.instanceBuffer != buffer)
+        {
+            pool.instanceBuffer = buffer;
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            //. a mat4 attribute is read as 4 vec4 attributes (one per column)
+            //. the divisor = 1 tells OpenGL to advance the attribute once per instance instead of once per vertex
+            for (GLuint column = 0; column < 4; column++)
+            {
+                glVertexAttribPointer(ATTRIB_LOC_INSTANCE_M + column, 4, GL_FLOAT, false, sizeof(InstanceData),
+                                      (void *)(offsetof(InstanceData, M) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_M + column, 1);
+
+                glVertexAttribPointer(ATTRIB_LOC_INSTANCE_M_IT + column, 4, GL_FLOAT, false, sizeof(InstanceData),
+                                      (void *)(offsetof(InstanceData, M_IT) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_M_IT + column, 1);
+            }
+        }
+        //. the attributes may have been disabled by an indirect draw (the pointers and divisors are kept so only the switches change)
+        for (GLuint column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_M + column);
+            glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_M_IT + column);
+        }
+        pool.instancesEnabled = true;
+    }
+
+    void MeshArena::detachInstanceBuffer(VertexFormat format)
+    {
+        VertexPool &pool = pools[(int)format];
+        if (!pool.instancesEnabled)
+            return;
+        //. a disabled attribute is never fetched, the shader reads its current value instead
+        for (GLuint column = 0; column < 4; column++)
+        {
+            glDisableVertexAttribArray(ATTRIB_LOC_INSTANCE_M + column);
+            glDisableVertexAttribArray(ATTRIB_LOC_INSTANCE_M_IT + column);
+        }
+        pool.instancesEnabled = false;
+    }
+
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <map>
+
+namespace our
+{
+
+#define ATTRIB_LOC_POSITION 0
+#define ATTRIB_LOC_COLOR 1
+#define ATTRIB_LOC_TEXCOORD 2
+#define ATTRIB_LOC_NORMAL 3
+// The instanced attributes are matrices so each one of them takes 4 consecutive locations (one per column)
+#define ATTRIB_LOC_INSTANCE_M 4
+#define ATTRIB_LOC_INSTANCE_M_IT 8
+// The index of the per-draw data used by the multi-draw indirect path (an unsigned integer per instance)
+#define ATTRIB_LOC_DRAW_ID 12
+
+    // The layouts in which the vertices can be stored in the arena
+    // Each format has its own vertex buffer and its own vertex array object
+    enum class VertexFormat
+    {
+        STANDARD,        // our::Vertex (vec3 position, RGBA8 color, vec2 tex_coord, vec3 normal)
+        PACKED,          // our::PackedVertex (unorm16 position, 10-10-10-2 normal, half2 tex_coord, RGBA8 color)
+        PACKED_NO_COLOR, // our::PackedVertexNoColor (the same as PACKED but the color is a constant attribute)
+        COUNT
+    };
+
+    // A first-fit sub-allocator that manages the free ranges of a buffer
+    // It does not touch OpenGL at all, it only decides where each allocation should live inside the buffer
+    class RangeAllocator
+    {
+        // The free ranges of the buffer where the key is the range start and the value is its size
+        // Adjacent free ranges are always merged so the map never contains two touching ranges
+        std::map<GLsizeiptr, GLsizeiptr> freeRanges;
+        GLsizeiptr capacity = 0;
+
+    public:
+        // Marks the whole buffer [0, capacity) as free
+        void reset(GLsizeiptr capacity);
+        // Extends the managed buffer to the new capacity (the added part is marked as free)
+        void grow(GLsizeiptr newCapacity);
+        // Finds a free range of the given size and returns its start in "offset"
+        // The start is rounded up to a multiple of "alignment"
+        // Returns false if no free range is big enough (the caller should grow the buffer then try again)
+        bool allocate(GLsizeiptr size, GLsizeiptr alignment, GLsizeiptr &offset);
+        // Returns the range to the free list and merges it with its free neighbours
+        void free(GLsizeiptr offset, GLsizeiptr size);
+
+        GLsizeiptr getCapacity() const { return capacity; }
+    };
+
+    // The mesh arena stores the vertices and elements of all the meshes in a few large buffers
+    // instead of giving every mesh its own VAO, VBO and EBO.
+    // - There is one vertex buffer and one VAO per vertex format.
+    // - There is one element buffer shared by all the formats (it is attached to every VAO).
+    // A mesh is then just a view into the arena (where its vertices and elements start and how many they are)
+    // and it is drawn using base-vertex draw calls. Since consecutive draws usually use the same VAO,
+    // the VAO doesn't have to be rebound between them.
+    // The buffers grow (by doubling) when they are full.
+    class MeshArena
+    {
+        struct VertexPool
+        {
+            GLuint buffer = 0;          // The vertex buffer
+            GLuint vertexArray = 0;     // The VAO that reads this vertex buffer using the pool format
+            GLsizei stride = 0;         // The size of a single vertex in bytes
+            RangeAllocator allocator;   // Manages the vertex buffer (in units of vertices)
+            GLuint instanceBuffer = 0;  // The instance buffer that is currently attached to the VAO (0 if none)
+            bool instancesEnabled = false; // Whether the instanced attributes of the attached instance buffer are enabled
+            GLuint drawIdBuffer = 0;    // The draw id buffer that is currently attached to the VAO (0 if none)
+            bool drawIdsEnabled = false; // Whether the draw id attribute of the attached draw id buffer is enabled
+        };
+
+        VertexPool pools[(int)VertexFormat::COUNT];
+        GLuint elementBuffer = 0;
+        RangeAllocator elementAllocator; // Manages the element buffer (in bytes)
+
+        // The VAO that we think is bound now (0 if unknown), so we can skip binding it again
+        static inline GLuint boundVertexArray = 0;
+        static inline MeshArena *instance = nullptr;
+
+        MeshArena();
+        ~MeshArena();
+
+        // Defines the vertex attributes of the given pool format in its VAO
+        void setupAttributes(VertexFormat format);
+        // Moves the content of the buffer to a new buffer with the given size and returns the new buffer
+        static GLuint resizeBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize);
+
+    public:
+        // Returns the arena (it is created on the first call so an OpenGL context must be current)
+        static MeshArena &get();
+        // Deletes the arena and all its buffers (all the meshes should be deleted before calling this)
+        static void destroy();
+
+        // Allocates space for "count" vertices of the given format and returns the index of the first one
+        GLint allocateVertices(VertexFormat format, GLsizei count);
+        void freeVertices(VertexFormat format, GLint first, GLsizei count);
+        // Allocates "size" bytes in the element buffer and returns their offset in bytes
+        GLintptr allocateElements(GLsizeiptr size);
+        void freeElements(GLintptr offset, GLsizeiptr size);
+
+        // Copy the given data into the arena buffers
+        void uploadVertices(VertexFormat format, GLint first, GLsizei count, const void *data);
+        void uploadElements(GLintptr offset, GLsizeiptr size, const void *data);
+        // Copy data from the arena buffers back to the RAM (slow, it should only be used while loading)
+        void downloadVertices(VertexFormat format, GLint first, GLsizei count, void *data) const;
+        void downloadElements(GLintptr offset, GLsizeiptr size, void *data) const;
+
+        // Binds the VAO of the given format (does nothing if it is already bound)
+        void bind(VertexFormat format);
+        // Attaches the instance buffer to the VAO of the given format as the source of the instanced attributes
+        // The VAO of the given format must be bound first
+        void attachInstanceBuffer(VertexFormat format, GLuint buffer);
+        // Disables the instanced attributes of the VAO of the given format until the next "attachInstanceBuffer"
+        // This must be done before an indirect draw, since its "baseInstance" would make them read past the end of the instance buffer
+        // The VAO of the given format must be bound first
+        void detachInstanceBuffer(VertexFormat format);
+        // Attaches a buffer of consecutive unsigned integers (0, 1, 2, ...) as the per-instance "draw id" attribute
+        // Since instanced attributes start from the "baseInstance" of an indirect command, this gives every draw its own index
+        // The VAO of the given format must be bound first
+        void attachDrawIdBuffer(VertexFormat format, GLuint buffer);
+        // Disables the draw id attribute of the VAO of the given format until the next "attachDrawIdBuffer"
+        // This must be done after every multi-draw, since the draw id buffer may be smaller than the instance count of a later instanced draw
+        // The VAO of the given format must be bound first
+        void detachDrawIdBuffer(VertexFormat format);
+        // Should be called before deleting an instance or a draw id buffer, since a new buffer could reuse its name
+        static void releaseBuffer(GLuint buffer);
+        // Should be called whenever a VAO is bound outside the arena, so that the next "bind" doesn't get skipped
+        static void invalidateBinding() { boundVertexArray = 0; }
+
+        GLuint getVertexBuffer(VertexFormat format) const { return pools[(int)format].buffer; }
+        GLuint getElementBuffer() const { return elementBuffer; }
+        GLsizei getStride(VertexFormat format) const { return pools[(int)format].stride; }
+
+        MeshArena(MeshArena const &) = delete;
+        MeshArena &operator=(MeshArena const &) = delete;
+    };
+
+}
@@ -0,0 +1,227 @@
+#include "mesh-cache.hpp"
+#include "../mapped-file.hpp"
+#include "../file-stamp.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+namespace our::mesh_cache
+{
+    // The cache file starts with this header (all the fields are little endian since we only target x86 and ARM)
+    // The version must be increased whenever the header, the vertex formats or the processing steps change
+    struct CacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t sourceSize;
+        std::int64_t sourceTime;
+        std::uint64_t sourceHash;
+        std::uint32_t packed, optimize, lods;
+        std::uint32_t format;
+        std::uint32_t vertexCount;
+        std::uint32_t elementType;
+        std::uint32_t levelCount;
+        std::uint32_t submeshCount; // 0 if every level is a single submesh
+        float positionTransform[16];
+        float constantColor[4];
+        float boundsMin[3], boundsMax[3];
+        std::uint64_t vertexOffset, vertexSize;
+        std::uint64_t elementOffset, elementSize;
+    };
+
+    static const char CACHE_MAGIC[4] = {'W', 'R', 'M', 'C'};
+    static const std::uint32_t CACHE_VERSION = 3;
+    static const std::uint64_t BLOB_ALIGNMENT = 16;
+    //. "writeFileStamp" writes the three fields of the stamp one after the other
+    static_assert(offsetof(CacheHeader, sourceHash) == offsetof(CacheHeader, sourceSize) + 16, "The source stamp must be contiguous");
+
+    // Reads the tables that follow the header while making sure that we don't read past the end of the file
+    struct TableReader
+    {
+        const std::uint8_t *cursor, *end;
+
+        bool read(void *value, size_t size)
+        {
+            if ((size_t)(end - cursor) < size)
+                return false;
+            std::memcpy(value, cursor, size);
+            cursor += size;
+            return true;
+        }
+    };
+
+    static std::uint64_t alignBlob(std::uint64_t offset) { return (offset + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT; }
+
+    std::string getCachePath(const std::string &source, const mesh_utils::MeshLoadOptions &options)
+    {
+        return source + ".p" + std::to_string(options.packed) + "o" + std::to_string(options.optimize) +
+               "l" + std::to_string(options.lods) + ".meshcache";
+    }
+
+    Mesh *load(const std::string &source, const mesh_utils::MeshLoadOptions &options)
+    {
+        MappedFile file;
+        if (!file.open(getCachePath(source, options)) || file.size() < sizeof(CacheHeader))
+            return nullptr;
+        const std::uint8_t *bytes = static_cast<const std::uint8_t *>(file.data());
+        CacheHeader header;
+        std::memcpy(&header, bytes, sizeof(CacheHeader));
+
+        //. the cache must be made by this version with the same options
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION)
+            return nullptr;
+        if (header.packed != (std::uint32_t)options.packed || header.optimize != (std::uint32_t)options.optimize ||
+            header.lods != (std::uint32_t)options.lods)
+            return nullptr;
+        //. and it must not be truncated or corrupted: the tables, then the vertices, then the elements must follow each other
+        //. without overlapping inside the file (the sizes are compared with what is left of the file so the sums can't overflow)
+        if (header.format >= (std::uint32_t)VertexFormat::COUNT || header.levelCount == 0 ||
+            header.vertexOffset < sizeof(CacheHeader) || header.vertexOffset > file.size() ||
+            header.vertexSize > file.size() - header.vertexOffset ||
+            header.elementOffset < header.vertexOffset + header.vertexSize || header.elementOffset > file.size() ||
+            header.elementSize > file.size() - header.elementOffset)
+            return nullptr;
+
+        //. if the size or the modification time of the source changed, we only trust the cache if the content is the same
+        //. (a missing source is fine, since the cache can be shipped without the source)
+        FileStamp stamp = {header.sourceSize, header.sourceTime, header.sourceHash};
+        if (!matchesFileStamp(source, stamp))
+            return nullptr;
+
+        MeshData data;
+        data.format = (VertexFormat)header.format;
+        data.vertexCount = (GLsizei)header.vertexCount;
+        data.elementType = (GLenum)header.elementType;
+        //. the tables: the level counts, then the submesh counts of every level, then the submesh names (length + characters)
+        TableReader reader = {bytes + sizeof(CacheHeader), bytes + header.vertexOffset};
+        std::uint32_t count;
+        for (std::uint32_t level = 0; level < header.levelCount; level++)
+        {
+            if (!reader.read(&count, sizeof(count)))
+                return nullptr;
+            data.levelElementCounts.push_back((GLsizei)count);
+        }
+        for (std::uint32_t index = 0; index < header.levelCount * header.submeshCount; index++)
+        {
+            if (!reader.read(&count, sizeof(count)))
+                return nullptr;
+            data.submeshElementCounts.push_back((GLsizei)count);
+        }
+        for (std::uint32_t submesh = 0; submesh < header.submeshCount; submesh++)
+        {
+            if (!reader.read(&count, sizeof(count)) || (size_t)(reader.end - reader.cursor) < count)
+                return nullptr;
+            data.submeshNames.emplace_back(reinterpret_cast<const char *>(reader.cursor), count);
+            reader.cursor += count;
+        }
+        //. the submeshes of every level must cover the whole level
+        for (std::uint32_t level = 0; level < header.levelCount && header.submeshCount > 0; level++)
+        {
+            GLsizei total = 0;
+            for (std::uint32_t submesh = 0; submesh < header.submeshCount; submesh++)
+                total += data.submeshElementCounts[level * header.submeshCount + submesh];
+            if (total != data.levelElementCounts[level])
+                return nullptr;
+        }
+        std::memcpy(&data.positionTransform[0][0], header.positionTransform, sizeof(header.positionTransform));
+        std::memcpy(&data.constantColor[0], header.constantColor, sizeof(header.constantColor));
+        std::memcpy(&data.boundsMin[0], header.boundsMin, sizeof(header.boundsMin));
+        std::memcpy(&data.boundsMax[0], header.boundsMax, sizeof(header.boundsMax));
+        if (header.vertexSize != data.getVertexDataSize() || header.elementSize != data.getElementDataSize())
+            return nullptr;
+        //. the blobs are not copied, the mesh uploads them to the arena straight from the mapped file
+        data.vertices = bytes + header.vertexOffset;
+        data.elements = bytes + header.elementOffset;
+        Mesh *mesh = new Mesh(data);
+        //. the source was only touched (e.g. by a checkout or a copy), so the cache takes its new modification time
+        //. otherwise every later load would hash the whole source again (the blobs are uploaded, so the file can be unmapped)
+        if (stamp.time != header.sourceTime)
+        {
+            file.close();
+            writeFileStamp(getCachePath(source, options), offsetof(CacheHeader, sourceSize), stamp);
+        }
+        return mesh;
+    }
+
+    bool save(const std::string &source, const mesh_utils::MeshLoadOptions &options, const MeshData &data)
+    {
+        CacheHeader header = {};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        FileStamp stamp;
+        if (!readFileStamp(source, stamp))
+            return false;
+        header.sourceSize = stamp.size;
+        header.sourceTime = stamp.time;
+        header.sourceHash = stamp.hash;
+        header.packed = options.packed;
+        header.optimize = options.optimize;
+        header.lods = options.lods;
+        header.format = (std::uint32_t)data.format;
+        header.vertexCount = (std::uint32_t)data.vertexCount;
+        header.elementType = (std::uint32_t)data.elementType;
+        header.levelCount = (std::uint32_t)data.levelElementCounts.size();
+        header.submeshCount = (std::uint32_t)data.submeshNames.size();
+        std::memcpy(header.positionTransform, &data.positionTransform[0][0], sizeof(header.positionTransform));
+        std::memcpy(header.constantColor, &data.constantColor[0], sizeof(header.constantColor));
+        std::memcpy(header.boundsMin, &data.boundsMin[0], sizeof(header.boundsMin));
+        std::memcpy(header.boundsMax, &data.boundsMax[0], sizeof(header.boundsMax));
+        header.vertexSize = data.getVertexDataSize();
+        header.elementSize = data.getElementDataSize();
+        //. the tables that follow the header (see "load")
+        std::vector<std::uint32_t> tables;
+        for (GLsizei count : data.levelElementCounts)
+            tables.push_back((std::uint32_t)count);
+        for (GLsizei count : data.submeshElementCounts)
+            tables.push_back((std::uint32_t)count);
+        std::string names;
+        for (const std::string &name : data.submeshNames)
+        {
+            std::uint32_t length = (std::uint32_t)name.size();
+            names.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            names += name;
+        }
+        header.vertexOffset = alignBlob(sizeof(CacheHeader) + tables.size() * sizeof(std::uint32_t) + names.size());
+        header.elementOffset = alignBlob(header.vertexOffset + header.vertexSize);
+
+        //. we write to a temporary file then rename it, so a crash can never leave a half written cache behind
+        std::string path = getCachePath(source, options), temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+            auto pad = [&file](std::uint64_t offset)
+            {
+                while ((std::uint64_t)file.tellp() < offset)
+                    file.put(0);
+            };
+            file.write(reinterpret_cast<const char *>(&header), sizeof(CacheHeader));
+            file.write(reinterpret_cast<const char *>(tables.data()), tables.size() * sizeof(std::uint32_t));
+            file.write(names.data(), names.size());
+            pad(header.vertexOffset);
+            file.write(static_cast<const char *>(data.vertices), header.vertexSize);
+            pad(header.elementOffset);
+            file.write(static_cast<const char *>(data.elements), header.elementSize);
+            if (!file)
+            {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            std::cerr << "Failed to write the mesh cache \"" << path << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+}
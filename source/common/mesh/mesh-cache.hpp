@@ -0,0 +1,35 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "mesh-data.hpp"
+#include "mesh-utils.hpp"
+
+#include <string>
+
+// The binary mesh cache stores the final data of a mesh (welded, optimized, packed and with its levels of detail)
+// so that loading it again doesn't need to parse the source file or run any of the processing steps.
+// The cache file is written next to the source file and its name holds the load options (e.g. "assets/models/duck.obj.p1o1l3.meshcache")
+// since the same source can be loaded with different options by different scenes. The file contains:
+//.--------------------------------------------------------------------
+//. header: magic, version, the source size, modification time and hash, the load options,
+//.         the mesh format, counts, position transform, constant color and bounds
+//. the element count of every level of detail, the element count of every submesh in every level and the submesh names
+//. the vertex blob (aligned to 16 bytes), in the exact layout of the vertex format
+//. the element blob (aligned to 16 bytes), all the levels one after the other
+//.--------------------------------------------------------------------
+// The file is memory mapped while loading and the blobs are uploaded to the mesh arena directly from the mapping.
+namespace our::mesh_cache
+{
+    // Returns the path of the cache file of the given source file loaded with the given options
+    std::string getCachePath(const std::string &source, const mesh_utils::MeshLoadOptions &options);
+
+    // Loads the mesh from the cache of the given source file
+    // Returns nullptr if there is no cache, or if it was made by another version, with other options or from another source
+    // The cache is still valid if only the source modification time changed but its content (hash) is the same
+    // (the new time is then written in the cache so the next loads don't hash the source again)
+    Mesh *load(const std::string &source, const mesh_utils::MeshLoadOptions &options);
+
+    // Writes the mesh data into the cache of the given source file
+    // Returns false if the cache could not be written
+    bool save(const std::string &source, const mesh_utils::MeshLoadOptions &options, const MeshData &data);
+}
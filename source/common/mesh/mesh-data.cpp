@@ -0,0 +1,96 @@
+#include "mesh-data.hpp"
+#include "vertex-packing.hpp"
+
+#include <cstring>
+
+namespace our
+{
+
+    GLsizei MeshData::getTotalElementCount() const
+    {
+        GLsizei total = 0;
+        for (GLsizei count : levelElementCounts)
+            total += count;
+        return total;
+    }
+
+    GLsizei MeshData::getVertexSize(VertexFormat format)
+    {
+        switch (format)
+        {
+        case VertexFormat::PACKED:
+            return sizeof(PackedVertex);
+        case VertexFormat::PACKED_NO_COLOR:
+            return sizeof(PackedVertexNoColor);
+        case VertexFormat::STANDARD:
+        default:
+            return sizeof(Vertex);
+        }
+    }
+
+    void buildMeshData(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements, bool packed,
+                       const std::vector<std::vector<unsigned int>> &lodElements, MeshData &data)
+    {
+        data.vertexCount = (GLsizei)vertices.size();
+        //. the elements are relative to the first vertex so 16-bit indices are enough for meshes with up to 65536 vertices
+        data.elementType = vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        if (!vertices.empty())
+        {
+            data.boundsMin = data.boundsMax = vertices[0].position;
+            for (const Vertex &vertex : vertices)
+            {
+                data.boundsMin = glm::min(data.boundsMin, vertex.position);
+                data.boundsMax = glm::max(data.boundsMax, vertex.position);
+            }
+        }
+
+        //. the vertices are stored as they are, or packed into one of the compressed formats
+        if (packed)
+        {
+            PackedVertices packedVertices;
+            packVertices(vertices, packedVertices);
+            data.format = packedVertices.format;
+            data.positionTransform = packedVertices.positionTransform;
+            data.constantColor = packedVertices.constantColor;
+            data.vertexStorage = std::move(packedVertices.data);
+        }
+        else
+        {
+            data.format = VertexFormat::STANDARD;
+            data.vertexStorage.resize(vertices.size() * sizeof(Vertex));
+            if (!vertices.empty())
+                std::memcpy(data.vertexStorage.data(), vertices.data(), data.vertexStorage.size());
+        }
+
+        //. all the levels are stored one after the other (the full mesh first)
+        data.levelElementCounts.clear();
+        data.levelElementCounts.push_back((GLsizei)elements.size());
+        for (const auto &level : lodElements)
+            data.levelElementCounts.push_back((GLsizei)level.size());
+
+        data.elementStorage.resize(data.getElementDataSize());
+        size_t written = 0;
+        auto writeElements = [&](const std::vector<unsigned int> &source)
+        {
+            if (data.elementType == GL_UNSIGNED_SHORT)
+            {
+                GLushort *output = reinterpret_cast<GLushort *>(data.elementStorage.data()) + written;
+                for (size_t index = 0; index < source.size(); index++)
+                    output[index] = (GLushort)source[index];
+            }
+            else if (!source.empty())
+            {
+                std::memcpy(reinterpret_cast<GLuint *>(data.elementStorage.data()) + written, source.data(), source.size() * sizeof(GLuint));
+            }
+            written += source.size();
+        };
+        writeElements(elements);
+        for (const auto &level : lodElements)
+            writeElements(level);
+
+        data.vertices = data.vertexStorage.data();
+        data.elements = data.elementStorage.data();
+    }
+
+}
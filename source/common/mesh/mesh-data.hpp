@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vertex.hpp"
+#include "mesh-arena.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace our
+{
+
+    // The data of a mesh in the exact layout in which it is uploaded to the mesh arena
+    // (the vertices are already packed if needed and the elements already have their final type)
+    // "vertices" and "elements" either point to "vertexStorage" and "elementStorage" (when the data is built in memory)
+    // or to data owned by someone else (e.g. a memory mapped cache file), so a MeshData should not be copied after it is built.
+    struct MeshData
+    {
+        VertexFormat format = VertexFormat::STANDARD;
+        GLsizei vertexCount = 0;
+        GLenum elementType = GL_UNSIGNED_INT;
+        // The element count of every level of detail (the levels are stored one after the other, the full mesh first)
+        std::vector<GLsizei> levelElementCounts;
+        // The names of the submeshes (the parts of the mesh that use different materials) and the element count of every
+        // submesh in every level, stored as submeshElementCounts[level * submeshNames.size() + submesh]
+        // The submeshes of a level are stored one after the other. If there are no names, every level is a single submesh.
+        std::vector<std::string> submeshNames;
+        std::vector<GLsizei> submeshElementCounts;
+        // See Mesh::positionTransform and Mesh::constantColor
+        glm::mat4 positionTransform = glm::mat4(1.0f);
+        glm::vec4 constantColor = glm::vec4(1.0f);
+        // The bounding box of the mesh in its local space
+        glm::vec3 boundsMin = glm::vec3(0), boundsMax = glm::vec3(0);
+
+        const void *vertices = nullptr;
+        const void *elements = nullptr;
+        std::vector<std::uint8_t> vertexStorage, elementStorage;
+
+        // The total number of elements of all the levels
+        GLsizei getTotalElementCount() const;
+        size_t getVertexDataSize() const { return (size_t)vertexCount * getVertexSize(format); }
+        size_t getElementDataSize() const { return (size_t)getTotalElementCount() * getElementSize(elementType); }
+
+        // The size in bytes of a vertex of the given format
+        static GLsizei getVertexSize(VertexFormat format);
+        // The size in bytes of an element of the given type
+        static GLsizei getElementSize(GLenum elementType) { return elementType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+    };
+
+    // Builds the mesh data from the given vertices and elements
+    // - If "packed" is true, the vertices are compressed into one of the packed formats (see "vertex-packing.hpp").
+    // - The elements are stored as 16-bit integers if all the vertices can be indexed by 16 bits.
+    // - "lodElements" contains the elements of the coarser levels of detail (from the finest to the coarsest).
+    void buildMeshData(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements, bool packed,
+                       const std::vector<std::vector<unsigned int>> &lodElements, MeshData &data);
+
+}
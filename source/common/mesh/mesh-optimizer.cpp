@@ -0,0 +1,220 @@
+#include "mesh-optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace our::mesh_optimizer {
+
+    VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int> &elements, size_t vertexCount, int cacheSize) {
+        VertexCacheStatistics statistics;
+        if (elements.empty() || vertexCount == 0) return statistics;
+
+        // a vertex is in a FIFO cache if fewer than "cacheSize" vertices were pushed since it was pushed
+        std::vector<size_t> pushTime(vertexCount, 0);
+        size_t time = cacheSize + 1, misses = 0;
+        for (unsigned int element : elements) {
+            if (time - pushTime[element] > (size_t) cacheSize) {
+                pushTime[element] = time++;
+                misses++;
+            }
+        }
+        statistics.acmr = (float) misses / (float) (elements.size() / 3);
+        statistics.atvr = (float) misses / (float) vertexCount;
+        return statistics;
+    }
+
+    // The constants of the Forsyth algorithm (the values suggested in the original article)
+    static const int FORSYTH_CACHE_SIZE = 32;
+    static const float CACHE_DECAY_POWER = 1.5f;
+    static const float LAST_TRIANGLE_SCORE = 0.75f;
+    static const float VALENCE_BOOST_SCALE = 2.0f;
+    static const float VALENCE_BOOST_POWER = 0.5f;
+
+    // The score of a vertex depends on its position in the cache (recently used vertices are better)
+    // and on the number of triangles that still use it (finishing off vertices is better)
+    static float vertexScore(int cachePosition, int remainingTriangles) {
+        if (remainingTriangles == 0) return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // the vertices of the last triangle get a fixed score so that the next triangle doesn't just reuse the same edge
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        score += VALENCE_BOOST_SCALE * std::pow((float) remainingTriangles, -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    void optimizeVertexCache(std::vector<unsigned int> &elements, size_t vertexCount) {
+        size_t triangleCount = elements.size() / 3;
+        if (triangleCount == 0) return;
+
+        // build the vertex to triangle adjacency (the triangles of vertex v are in adjacency[offsets[v], offsets[v+1]))
+        std::vector<int> remaining(vertexCount, 0);
+        for (unsigned int element : elements) remaining[element]++;
+        std::vector<size_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+        std::vector<unsigned int> adjacency(elements.size());
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[elements[3 * t + k]]++] = (unsigned int) t;
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) vertexScores[v] = vertexScore(-1, remaining[v]);
+
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScores[t] = vertexScores[elements[3 * t]] + vertexScores[elements[3 * t + 1]] + vertexScores[elements[3 * t + 2]];
+
+        std::vector<unsigned int> output;
+        output.reserve(elements.size());
+        // the cache holds up to FORSYTH_CACHE_SIZE vertices (+3 temporarily while adding a triangle)
+        std::vector<unsigned int> cache, newCache;
+        size_t scanPosition = 0;
+        long bestTriangle = -1;
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            // if no cached vertex has a remaining triangle, we pick the first triangle that was not emitted yet
+            // (the scan position only moves forward so this costs O(triangleCount) in total)
+            if (bestTriangle < 0) {
+                while (emitted[scanPosition]) scanPosition++;
+                bestTriangle = (long) scanPosition;
+            }
+
+            size_t t = (size_t) bestTriangle;
+            emitted[t] = true;
+            const unsigned int *triangle = &elements[3 * t];
+            output.insert(output.end(), triangle, triangle + 3);
+
+            // the triangle vertices go to the front of the cache and the rest of the cache is shifted back
+            newCache.assign(triangle, triangle + 3);
+            for (unsigned int v : cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) newCache.push_back(v);
+
+            // remove the emitted triangle from the adjacency of its vertices
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = triangle[k];
+                unsigned int *begin = &adjacency[offsets[v]], *end = begin + remaining[v];
+                *std::find(begin, end, (unsigned int) t) = end[-1];
+                remaining[v]--;
+            }
+
+            // update the scores of the vertices in the cache (and of the ones that just got pushed out)
+            for (size_t position = 0; position < newCache.size(); position++) {
+                unsigned int v = newCache[position];
+                cachePosition[v] = position < (size_t) FORSYTH_CACHE_SIZE ? (int) position : -1;
+                vertexScores[v] = vertexScore(cachePosition[v], remaining[v]);
+            }
+
+            // update the scores of the triangles that use these vertices and find the best one among them
+            float bestScore = -1.0f;
+            bestTriangle = -1;
+            for (unsigned int v : newCache) {
+                for (size_t index = offsets[v]; index < offsets[v] + remaining[v]; index++) {
+                    unsigned int adjacent = adjacency[index];
+                    const unsigned int *other = &elements[3 * adjacent];
+                    float score = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+                    triangleScores[adjacent] = score;
+                    if (score > bestScore) {
+                        bestScore = score;
+                        bestTriangle = adjacent;
+                    }
+                }
+            }
+
+            if (newCache.size() > (size_t) FORSYTH_CACHE_SIZE) newCache.resize(FORSYTH_CACHE_SIZE);
+            std::swap(cache, newCache);
+        }
+
+        elements.swap(output);
+    }
+
+    void optimizeOverdraw(std::vector<unsigned int> &elements, const std::vector<Vertex> &vertices, int cacheSize) {
+        size_t triangleCount = elements.size() / 3;
+        if (triangleCount == 0) return;
+
+        // find the cluster boundaries: a new cluster starts at a triangle whose 3 vertices all miss the cache
+        // reordering whole clusters keeps almost the same cache behaviour since a cluster doesn't reuse the previous cluster
+        std::vector<size_t> clusterStarts;
+        std::vector<size_t> pushTime(vertices.size(), 0);
+        size_t time = cacheSize + 1;
+        for (size_t t = 0; t < triangleCount; t++) {
+            int misses = 0;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = elements[3 * t + k];
+                if (time - pushTime[v] > (size_t) cacheSize) {
+                    pushTime[v] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3) clusterStarts.push_back(t);
+        }
+        clusterStarts.push_back(triangleCount);
+        size_t clusterCount = clusterStarts.size() - 1;
+        if (clusterCount < 2) return;
+
+        // compute the area-weighted centroid and normal of every cluster and of the whole mesh
+        std::vector<glm::vec3> centroids(clusterCount), normals(clusterCount);
+        glm::vec3 meshCentroid(0);
+        float meshArea = 0;
+        for (size_t c = 0; c < clusterCount; c++) {
+            glm::vec3 centroid(0), normal(0);
+            float clusterArea = 0;
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+                const glm::vec3 &a = vertices[elements[3 * t]].position;
+                const glm::vec3 &b = vertices[elements[3 * t + 1]].position;
+                const glm::vec3 &d = vertices[elements[3 * t + 2]].position;
+                glm::vec3 cross = glm::cross(b - a, d - a);
+                float area = glm::length(cross);
+                centroid += (a + b + d) * (area / 3.0f);
+                normal += cross;
+                clusterArea += area;
+            }
+            meshCentroid += centroid;
+            meshArea += clusterArea;
+            centroids[c] = clusterArea > 0 ? centroid / clusterArea : centroid;
+            float length = glm::length(normal);
+            normals[c] = length > 0 ? normal / length : glm::vec3(0);
+        }
+        if (meshArea > 0) meshCentroid /= meshArea;
+
+        // the clusters that face away from the center are usually on the outside so they should be drawn first
+        std::vector<float> keys(clusterCount);
+        std::vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++) {
+            keys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&keys](size_t first, size_t second) {
+            return keys[first] > keys[second];
+        });
+
+        std::vector<unsigned int> output;
+        output.reserve(elements.size());
+        for (size_t c : order)
+            output.insert(output.end(), elements.begin() + 3 * clusterStarts[c], elements.begin() + 3 * clusterStarts[c + 1]);
+        elements.swap(output);
+    }
+
+    void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &elements) {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> output;
+        output.reserve(vertices.size());
+        for (unsigned int &element : elements) {
+            if (remap[element] == unused) {
+                remap[element] = (unsigned int) output.size();
+                output.push_back(vertices[element]);
+            }
+            element = remap[element];
+        }
+        vertices.swap(output);
+    }
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <vector>
+
+namespace our::mesh_optimizer {
+
+    // The statistics of the post-transform vertex cache while drawing a mesh
+    // - ACMR (average cache miss ratio): the number of transformed vertices per triangle (best is ~0.5, worst is 3)
+    // - ATVR (average transformed vertex ratio): the number of transformed vertices per vertex (best is 1)
+    struct VertexCacheStatistics {
+        float acmr = 0;
+        float atvr = 0;
+    };
+
+    // Simulates a FIFO post-transform cache of the given size while drawing the triangles in order
+    VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int> &elements, size_t vertexCount, int cacheSize = 16);
+
+    // Reorders the triangles to increase the post-transform cache hits (Tom Forsyth's linear-speed vertex cache optimization)
+    void optimizeVertexCache(std::vector<unsigned int> &elements, size_t vertexCount);
+
+    // Splits the triangles (which should be already optimized for the vertex cache) into clusters at the points where
+    // the cache is completely missed, then sorts the clusters so that the ones facing away from the mesh center are drawn first.
+    // Since the outer surfaces usually hide the inner ones, this reduces the overdraw without hurting the cache much.
+    void optimizeOverdraw(std::vector<unsigned int> &elements, const std::vector<Vertex> &vertices, int cacheSize = 16);
+
+    // Reorders the vertices in the order in which they are first used by the triangles (and drops the unused ones)
+    // so that the vertex fetches read the memory as linearly as possible. The elements are remapped accordingly.
+    void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &elements);
+
+}
@@ -0,0 +1,210 @@
+#include "mesh-simplifier.hpp"
+
+#include <glm/gtx/hash.hpp>
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <unordered_map>
+
+namespace our::mesh_simplifier {
+
+    // A symmetric 4x4 matrix storing the sum of the squared distances to a set of planes
+    // (only the 10 unique coefficients are stored)
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        static Quadric fromPlane(double a, double b, double c, double d, double weight) {
+            Quadric q;
+            q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+            q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+            q.c2 = c * c * weight; q.cd = c * d * weight;
+            q.d2 = d * d * weight;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &other) {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+            return *this;
+        }
+
+        // The sum of the squared distances from the point to the planes
+        double error(const glm::vec3 &p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                   + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                   + c2 * z * z + 2 * cd * z
+                   + d2;
+        }
+    };
+
+    // A possible collapse of the point "from" into the point "to"
+    // "version" is the version of "from" when the candidate was created (it is stale if the point changed since then)
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int version;
+
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    // The distance between the attributes of two vertices that share a position (used to pick which one of the
+    // vertices at the collapse target replaces a moved vertex, so that the uvs and normals stay as continuous as possible)
+    static float attributeDistance(const Vertex &first, const Vertex &second) {
+        glm::vec2 uv = first.tex_coord - second.tex_coord;
+        glm::vec3 normal = first.normal - second.normal;
+        return glm::dot(uv, uv) + glm::dot(normal, normal);
+    }
+
+    std::vector<unsigned int> simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements,
+                                       size_t targetElementCount) {
+        size_t vertexCount = vertices.size(), triangleCount = elements.size() / 3;
+        std::vector<unsigned int> triangles(elements.begin(), elements.begin() + triangleCount * 3);
+        std::vector<bool> removed(triangleCount, false);
+
+        // the topology is built on the positions (the vertices that only differ in their attributes are the same point)
+        std::unordered_map<glm::vec3, unsigned int> positionMap;
+        std::vector<unsigned int> pointOf(vertexCount);
+        std::vector<std::vector<unsigned int>> pointVertices;
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            auto [it, inserted] = positionMap.try_emplace(vertices[v].position, (unsigned int) pointVertices.size());
+            if (inserted) pointVertices.emplace_back();
+            pointOf[v] = it->second;
+            pointVertices[it->second].push_back(v);
+        }
+        size_t pointCount = pointVertices.size();
+        auto pointAt = [&](size_t t, int k) { return pointOf[triangles[3 * t + k]]; };
+        auto hasPoint = [&](size_t t, unsigned int point) {
+            return pointAt(t, 0) == point || pointAt(t, 1) == point || pointAt(t, 2) == point;
+        };
+
+        // the triangles around every point (it may contain removed triangles which are skipped lazily)
+        std::vector<std::vector<unsigned int>> pointTriangles(pointCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                pointTriangles[pointAt(t, k)].push_back((unsigned int) t);
+
+        // an edge that is not shared by exactly 2 triangles is a border (or a non-manifold edge), and its points are locked
+        std::vector<bool> locked(pointCount, false);
+        {
+            std::map<std::pair<unsigned int, unsigned int>, int> edgeUses;
+            for (size_t t = 0; t < triangleCount; t++)
+                for (int k = 0; k < 3; k++) {
+                    unsigned int a = pointAt(t, k), b = pointAt(t, (k + 1) % 3);
+                    edgeUses[{std::min(a, b), std::max(a, b)}]++;
+                }
+            for (auto &[edge, uses]: edgeUses)
+                if (uses != 2) locked[edge.first] = locked[edge.second] = true;
+        }
+
+        // every point starts with the (area weighted) planes of its triangles
+        std::vector<Quadric> quadrics(pointCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            const glm::vec3 &p0 = vertices[triangles[3 * t]].position;
+            const glm::vec3 &p1 = vertices[triangles[3 * t + 1]].position;
+            const glm::vec3 &p2 = vertices[triangles[3 * t + 2]].position;
+            glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+            double area = glm::length(normal);
+            if (area <= 0) continue;
+            normal /= area;
+            Quadric q = Quadric::fromPlane(normal.x, normal.y, normal.z, -glm::dot(normal, glm::dvec3(p0)), area);
+            for (int k = 0; k < 3; k++) quadrics[pointAt(t, k)] += q;
+        }
+        auto positionOf = [&](unsigned int point) { return vertices[pointVertices[point][0]].position; };
+
+        std::vector<unsigned int> versions(pointCount, 0);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        auto pushCollapses = [&](unsigned int from) {
+            if (locked[from]) return;
+            for (unsigned int t: pointTriangles[from]) {
+                if (removed[t]) continue;
+                for (int k = 0; k < 3; k++) {
+                    unsigned int to = pointAt(t, k);
+                    if (to == from) continue;
+                    Quadric q = quadrics[from];
+                    q += quadrics[to];
+                    queue.push({q.error(positionOf(to)), from, to, versions[from]});
+                }
+            }
+        };
+        for (unsigned int point = 0; point < pointCount; point++) pushCollapses(point);
+
+        // checks that moving "from" to the position of "to" doesn't flip any of the triangles that will remain
+        auto flipsTriangles = [&](unsigned int from, unsigned int to) {
+            for (unsigned int t: pointTriangles[from]) {
+                if (removed[t] || hasPoint(t, to)) continue;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++) {
+                    before[k] = vertices[triangles[3 * t + k]].position;
+                    after[k] = pointAt(t, k) == from ? positionOf(to) : before[k];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= 0) return true;
+            }
+            return false;
+        };
+
+        size_t remainingTriangles = triangleCount;
+        while (remainingTriangles * 3 > targetElementCount && !queue.empty()) {
+            Collapse collapse = queue.top();
+            queue.pop();
+            unsigned int from = collapse.from, to = collapse.to;
+            // skip the stale candidates (the point changed or was already collapsed)
+            if (collapse.version != versions[from] || pointTriangles[from].empty()) continue;
+            // the edge must still exist (the neighbours of "from" may have changed)
+            bool adjacent = false;
+            for (unsigned int t: pointTriangles[from])
+                if (!removed[t] && hasPoint(t, to)) { adjacent = true; break; }
+            if (!adjacent || flipsTriangles(from, to)) continue;
+
+            // the triangles sharing the edge disappear and the others move from "from" to "to"
+            for (unsigned int t: pointTriangles[from]) {
+                if (removed[t]) continue;
+                if (hasPoint(t, to)) {
+                    removed[t] = true;
+                    remainingTriangles--;
+                    continue;
+                }
+                for (int k = 0; k < 3; k++) {
+                    unsigned int &corner = triangles[3 * t + k];
+                    if (pointOf[corner] != from) continue;
+                    // pick the vertex at "to" whose attributes are the closest to the moved vertex
+                    unsigned int best = pointVertices[to][0];
+                    for (unsigned int candidate: pointVertices[to])
+                        if (attributeDistance(vertices[candidate], vertices[corner]) < attributeDistance(vertices[best], vertices[corner]))
+                            best = candidate;
+                    corner = best;
+                }
+                pointTriangles[to].push_back(t);
+            }
+            pointTriangles[from].clear();
+            versions[from]++;
+            quadrics[to] += quadrics[from];
+
+            // drop the removed triangles from the list of "to" so that it doesn't grow forever
+            auto &list = pointTriangles[to];
+            list.erase(std::remove_if(list.begin(), list.end(), [&removed](unsigned int t) { return removed[t]; }), list.end());
+
+            // the costs of the collapses around "to" changed so we push new candidates for it and its neighbours
+            versions[to]++;
+            pushCollapses(to);
+            for (unsigned int t: pointTriangles[to])
+                for (int k = 0; k < 3; k++) {
+                    unsigned int neighbour = pointAt(t, k);
+                    if (neighbour == to) continue;
+                    versions[neighbour]++;
+                    pushCollapses(neighbour);
+                }
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(remainingTriangles * 3);
+        for (size_t t = 0; t < triangleCount; t++)
+            if (!removed[t]) result.insert(result.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+        return result;
+    }
+
+}
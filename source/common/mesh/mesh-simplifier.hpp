@@ -0,0 +1,20 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <vector>
+
+namespace our::mesh_simplifier {
+
+    // Simplifies the mesh using edge collapses ordered by the quadric error metric (Garland & Heckbert)
+    // The collapses work on points (the vertices with the same position are one point even if their uvs or normals differ).
+    // Every collapse merges a point into one of its neighbours and the moved corners pick the vertex of the target point
+    // with the closest attributes. So the simplified triangles still index the original vertices and the level of detail
+    // can share the vertex buffer of the full mesh (only the elements differ).
+    // The points on the open borders of the mesh are never moved so that the silhouette doesn't shrink.
+    // The simplification stops when the number of elements reaches "targetElementCount" or no valid collapse is left.
+    // Returns the elements of the simplified mesh.
+    std::vector<unsigned int> simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements,
+                                       size_t targetElementCount);
+
+}
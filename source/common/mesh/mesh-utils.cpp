@@ -1,83 +1,105 @@
 #include "mesh-utils.hpp"
+#include "mesh-optimizer.hpp"
+#include "mesh-simplifier.hpp"
+#include "mesh-cache.hpp"
+#include "obj-parser.hpp"
 
-// We will use "Tiny OBJ Loader" to read and process '.obj" files
-#define TINYOBJLOADER_IMPLEMENTATION
-
-#include <tinyobj/tiny_obj_loader.h>
+#include <glm/gtc/constants.hpp>
 
 #include <iostream>
 #include <vector>
-#include <unordered_map>
-
-our::Mesh *our::mesh_utils::loadOBJ(const std::string &filename) {
-
-    // The data that we will use to initialize our mesh
-    std::vector<our::Vertex> vertices;
-    std::vector<GLuint> elements;
-
-    // Since the OBJ can have duplicated vertices, we make them unique using this map
-    // The key is the vertex, the value is its index in the vector "vertices".
-    // That index will be used to populate the "elements" vector.
-    std::unordered_map<our::Vertex, GLuint> vertex_map;
 
-    // The data loaded by Tiny OBJ Loader
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+our::Mesh *our::mesh_utils::loadOBJ(const std::string &filename, const MeshLoadOptions &options) {
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str(), "assets/models")) {
-        std::cerr << "Failed to load obj file \"" << filename << "\" due to error: " << err << std::endl;
-        return nullptr;
-    }
-    if (!warn.empty()) {
-        std::cout << "WARN while loading obj file \"" << filename << "\": " << warn << std::endl;
+    // If the binary cache is up to date, the mesh is uploaded straight from it without parsing the OBJ
+    if (options.cache) {
+        if (our::Mesh *mesh = mesh_cache::load(filename, options)) return mesh;
     }
 
-    // An obj file can have multiple shapes where each shape can have its own material
-    // Ideally, we would load each shape into a separate mesh or store the start and end of it in the element buffer to be able to draw each shape separately
-    // But we ignored this fact since we don't plan to use multiple materials in the examples
-    for (const auto &shape: shapes) {
-        for (const auto &index: shape.mesh.indices) {
-            Vertex vertex = {};
-
-            // Read the data for a vertex from the "attrib" object
-            vertex.position = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]};
+    MeshData data;
+    if (!buildOBJ(filename, options, data)) return nullptr;
+    // Write the cache so that the next runs can skip all the processing
+    if (options.cache && !mesh_cache::save(filename, options, data)) {
+        std::cout << "WARN could not write the mesh cache of \"" << filename << "\"" << std::endl;
+    }
+    return new our::Mesh(data);
+}
 
-            vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]};
+// Copies every range of "elements" (their sizes are given by "counts") to its own vector, passes it to "process",
+// then writes the processed ranges back one after the other (the processing may change the size of a range)
+template<typename Process>
+static void processRanges(std::vector<GLuint> &elements, std::vector<size_t> &counts, Process process) {
+    std::vector<GLuint> result, range;
+    size_t offset = 0;
+    for (size_t &count: counts) {
+        range.assign(elements.begin() + offset, elements.begin() + offset + count);
+        offset += count;
+        process(range);
+        result.insert(result.end(), range.begin(), range.end());
+        count = range.size();
+    }
+    elements.swap(result);
+}
 
-            vertex.tex_coord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    attrib.texcoords[2 * index.texcoord_index + 1]};
+bool our::mesh_utils::buildOBJ(const std::string &filename, const MeshLoadOptions &options, MeshData &data) {
 
-            vertex.color = {
-                    attrib.colors[3 * index.vertex_index + 0] * 255,
-                    attrib.colors[3 * index.vertex_index + 1] * 255,
-                    attrib.colors[3 * index.vertex_index + 2] * 255,
-                    255};
+    // The data that we will use to initialize our mesh
+    std::vector<our::Vertex> vertices;
+    std::vector<GLuint> elements;
+    // The faces of every material of the OBJ are stored in a contiguous range of the elements (they will become the submeshes)
+    std::vector<obj_parser::MaterialGroup> groups;
+
+    // The OBJ is parsed in parallel and its duplicated vertices are welded (made unique) while reading it
+    // so "elements" holds the indices of the unique vertices of every triangle (see "obj-parser.hpp")
+    if (!obj_parser::parse(filename, vertices, elements, &groups)) return false;
+    std::vector<size_t> groupCounts;
+    for (const auto &group: groups) groupCounts.push_back(group.elementCount);
+
+    // Optionally, we reorder the welded mesh (the triangles are in the OBJ face order which is rarely cache friendly)
+    // The triangles are only reordered inside their submesh so that every submesh stays a contiguous range
+    if (options.optimize) {
+        auto before = mesh_optimizer::analyzeVertexCache(elements, vertices.size());
+        processRanges(elements, groupCounts, [&](std::vector<GLuint> &range) {
+            mesh_optimizer::optimizeVertexCache(range, vertices.size());
+            mesh_optimizer::optimizeOverdraw(range, vertices);
+        });
+        mesh_optimizer::optimizeVertexFetch(vertices, elements);
+        auto after = mesh_optimizer::analyzeVertexCache(elements, vertices.size());
+        std::cout << "Optimized \"" << filename << "\": ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    }
 
-            // See if we already stored a similar vertex
-            auto it = vertex_map.find(vertex);
-            if (it == vertex_map.end()) {
-                // if no, add it to the vertices and record its index
-                auto new_vertex_index = static_cast<GLuint>(vertices.size());
-                vertex_map[vertex] = new_vertex_index;
-                elements.push_back(new_vertex_index);
-                vertices.push_back(vertex);
-            } else {
-                // if yes, just add its index in the elements vector
-                elements.push_back(it->second);
-            }
-        }
+    // Then we generate the levels of detail by simplifying each level to half the triangles of the previous one
+    // The levels share the vertices of the full mesh so only their elements are stored
+    // Every submesh is simplified on its own, so the seams between the materials are kept (they are borders of the submeshes)
+    std::vector<std::vector<GLuint>> lodElements;
+    std::vector<std::vector<size_t>> lodGroupCounts;
+    for (int level = 1; level <= options.lods; level++) {
+        std::vector<GLuint> simplified = lodElements.empty() ? elements : lodElements.back();
+        std::vector<size_t> counts = lodGroupCounts.empty() ? groupCounts : lodGroupCounts.back();
+        size_t previousSize = simplified.size();
+        processRanges(simplified, counts, [&](std::vector<GLuint> &range) {
+            std::vector<GLuint> result = mesh_simplifier::simplify(vertices, range, range.size() / 6 * 3);
+            // a submesh that can't be simplified anymore is kept as it is
+            if (result.size() < range.size()) range.swap(result);
+            if (options.optimize) mesh_optimizer::optimizeVertexCache(range, vertices.size());
+        });
+        // stop if the mesh can't be simplified anymore (e.g. all its vertices are on the borders)
+        if (simplified.size() >= previousSize) break;
+        std::cout << "LOD " << level << " of \"" << filename << "\": " << simplified.size() / 3 << " triangles (full mesh: "
+                  << elements.size() / 3 << ")" << std::endl;
+        lodElements.push_back(std::move(simplified));
+        lodGroupCounts.push_back(std::move(counts));
     }
 
-    return new our::Mesh(vertices, elements);
+    buildMeshData(vertices, elements, options.packed, lodElements, data);
+    // A mesh with a single material doesn't need to store its submeshes (the whole level is one submesh)
+    if (groups.size() > 1) {
+        for (const auto &group: groups) data.submeshNames.push_back(group.name);
+        data.submeshElementCounts.assign(groupCounts.begin(), groupCounts.end());
+        for (const auto &counts: lodGroupCounts) data.submeshElementCounts.insert(data.submeshElementCounts.end(), counts.begin(), counts.end());
+    }
+    return true;
 }
 
 // Create a sphere (the vertex order in the triangles are CCW from the outside)
@@ -4,8 +4,19 @@
 #include <string>
 
 namespace our::mesh_utils {
+    // The options used while loading a mesh (they can be set per mesh in the asset json)
+    struct MeshLoadOptions {
+        bool packed = false;    // Store the vertices in one of the compressed vertex formats (see "vertex-packing.hpp")
+        bool optimize = false;  // Reorder the triangles and the vertices for the vertex cache, the overdraw and the vertex fetch
+        int lods = 0;           // The number of coarser levels of detail to generate (each one has half the triangles of the previous one)
+        bool cache = true;      // Read the mesh from its binary cache if it is up to date, otherwise write the cache (see "mesh-cache.hpp")
+    };
+
     // Load an ".obj" file into the mesh
-    Mesh* loadOBJ(const std::string& filename);
+    Mesh* loadOBJ(const std::string& filename, const MeshLoadOptions& options = {});
+    // Read an ".obj" file and process it (weld, optimize, simplify and pack) into the data that will be uploaded to the GPU
+    // This doesn't need an OpenGL context so it can also be used by offline tools
+    bool buildOBJ(const std::string& filename, const MeshLoadOptions& options, MeshData& data);
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
@@ -2,145 +2,277 @@
 
 #include <glad/gl.h>
 #include "vertex.hpp"
+#include "mesh-arena.hpp"
+#include "mesh-data.hpp"
+#include "vertex-packing.hpp"
+
+#include <vector>
+#include <string>
 
 namespace our
 {
 
-#define ATTRIB_LOC_POSITION 0
-#define ATTRIB_LOC_COLOR 1
-#define ATTRIB_LOC_TEXCOORD 2
-#define ATTRIB_LOC_NORMAL 3
+    // A submesh is a range of elements that is drawn using its own material (e.g. the glass and the metal of a lamp)
+    struct SubmeshRange
+    {
+        GLintptr elementOffset; // The byte offset of the first element of the submesh inside the element buffer
+        GLsizei elementCount;   // The number of elements of the submesh (it can be 0 in the coarser levels)
+    };
+
+    // A level of detail of a mesh is a range of elements inside the element buffer
+    // All the levels of a mesh index the same vertices (the coarser levels just use fewer of them)
+    // and all of them have the same submeshes stored one after the other inside the level range
+    struct LevelOfDetail
+    {
+        GLintptr elementOffset; // The byte offset of the first element of the level inside the element buffer
+        GLsizei elementCount;   // The number of elements of the level
+        std::vector<SubmeshRange> submeshes;
+    };
 
     class Mesh
     {
-        // Here, we store the object names of the 3 main components of a mesh:
-        // A vertex array object, A vertex buffer and an element buffer
+        // The mesh doesn't own any OpenGL objects. Its vertices and elements live inside the shared buffers of the mesh arena
+        // (see "mesh-arena.hpp") so the mesh only remembers where its data is stored inside these buffers:
         //.--------------------------------------------------------------------
-        //. VBO (vertex buffer object): store verticies data                  |
-        //. VAO (vecter array object): store the specifications of the data stored in buffer  |
-        //. EBO (element buffer object): store the indicies of the verticies  |
+        //. format: the layout of the vertices (decides which vertex buffer and VAO of the arena are used)
+        //. baseVertex & vertexCount: the range of the mesh vertices inside the vertex buffer
+        //. elementOffset: the byte offset of the first element of the mesh inside the element buffer
+        //. elementType: GL_UNSIGNED_SHORT if all the indices fit in 16 bits, otherwise GL_UNSIGNED_INT
+        //. levels: the element ranges of the levels of detail (levels[0] is the full mesh), all of them are stored
+        //.         one after the other in a single range of the element buffer that starts at elementOffset
+        //. submeshNames: the names of the submeshes (the material groups of the source file), all the levels have these submeshes
         //.--------------------------------------------------------------------
-        unsigned int VBO, EBO;
-        unsigned int VAO;
+        VertexFormat format = VertexFormat::STANDARD;
+        GLint baseVertex;
+        GLsizei vertexCount;
+        GLintptr elementOffset;
+        GLenum elementType = GL_UNSIGNED_INT;
         // We need to remember the number of elements that will be draw by glDrawElements
         GLsizei elementCount;
+        // The total number of elements of all the levels (the size of the element range allocated in the arena)
+        GLsizei allocatedElementCount;
+        std::vector<LevelOfDetail> levels;
+        std::vector<std::string> submeshNames;
+        // The bounding box of the mesh in its local space
+        glm::vec3 boundsMin = glm::vec3(0), boundsMax = glm::vec3(0);
+        // The packed formats store the positions relative to the mesh bounding box, so this matrix must be applied
+        // to the positions before the model matrix (it is the identity for the standard format)
+        glm::mat4 positionTransform = glm::mat4(1.0f);
+        // The color of all the vertices if the format doesn't store a color per vertex
+        glm::vec4 constantColor = glm::vec4(1.0f);
+
+    public:
+        // Allocates space for the given data inside the arena buffers (VRAM) and copies the data there
+        void create(const MeshData &data)
+        {
+            format = data.format;
+            vertexCount = data.vertexCount;
+            elementType = data.elementType;
+            positionTransform = data.positionTransform;
+            constantColor = data.constantColor;
+            boundsMin = data.boundsMin;
+            boundsMax = data.boundsMax;
+            allocatedElementCount = data.getTotalElementCount();
+
+            MeshArena &arena = MeshArena::get();
+            //. reserve a range for the vertices and another for the elements (of all the levels) inside the arena buffers
+            baseVertex = arena.allocateVertices(format, vertexCount);
+            elementOffset = arena.allocateElements(allocatedElementCount * getElementSize());
+            //. the levels are stored one after the other starting from elementOffset
+            //. and the submeshes of every level are stored one after the other inside the level
+            submeshNames = data.submeshNames.empty() ? std::vector<std::string>{""} : data.submeshNames;
+            GLintptr levelOffset = elementOffset;
+            for (size_t level = 0; level < data.levelElementCounts.size(); level++)
+            {
+                GLsizei count = data.levelElementCounts[level];
+                LevelOfDetail lod = {levelOffset, count, {}};
+                if (data.submeshNames.empty())
+                {
+                    lod.submeshes.push_back({levelOffset, count});
+                }
+                else
+                {
+                    GLintptr submeshOffset = levelOffset;
+                    for (size_t submesh = 0; submesh < submeshNames.size(); submesh++)
+                    {
+                        GLsizei submeshCount = data.submeshElementCounts[level * submeshNames.size() + submesh];
+                        lod.submeshes.push_back({submeshOffset, submeshCount});
+                        submeshOffset += submeshCount * getElementSize();
+                    }
+                }
+                levels.push_back(lod);
+                levelOffset += count * getElementSize();
+            }
+            elementCount = levels[0].elementCount;
+            //. then copy the data to these ranges
+            arena.uploadVertices(format, baseVertex, vertexCount, data.vertices);
+            arena.uploadElements(elementOffset, allocatedElementCount * getElementSize(), data.elements);
+        }
 
     public:
         // The constructor takes two vectors:
         // - vertices which contain the vertex data.
         // - elements which contain the indices of the vertices out of which each rectangle will be constructed.
-        // The mesh class does not keep a these data on the RAM. Instead, it should create
-        // a vertex buffer to store the vertex data on the VRAM,
-        // an element buffer to store the element data on the VRAM,
-        // a vertex array object to define how to read the vertex & element buffer during rendering
-        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements)
+        // The mesh class does not keep a these data on the RAM. Instead, it allocates space for them in the arena buffers (VRAM)
+        // and copies them there. The elements are relative to the first vertex of the mesh so they don't need to be offset
+        // since we draw using the base vertex of the mesh.
+        // If "packed" is true, the vertices are compressed into one of the packed formats (see "vertex-packing.hpp").
+        // "lodElements" (optional) contains the elements of the coarser levels of detail (from the finest to the coarsest)
+        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements, bool packed = false,
+             const std::vector<std::vector<unsigned int>> &lodElements = {})
         {
             // TODO: (Req 2) Write this function
             //  remember to store the number of elements in "elementCount" since you will need it for drawing
-            // For the attribute locations, use the constants defined above: ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, etc
-            elementCount = (GLsizei)elements.size();
-            //. generation of vertex array
-            //. @param n=1 --> generates only one vertex array
-            //. @param *array = &VAO --> that stores all of the state (attributes) needed to supply vertex data
-            glGenVertexArrays(1, &VAO);
-            //. bind the vertex array. function that takes the generated vertex array as a parameter
-            glBindVertexArray(VAO);
-            //. generation of vertex buffer object
-            //. @param n=1 --> generates only one vertex buffer object
-            //. @param *array = &VBO --> where the verticies will be stored
-            glGenBuffers(1, &VBO);
-            //. bind the vertex buffer object function that takes the generated vertex buffer object as a parameter
-            //. and target = GL_ARRAY_BUFFER to bind vertex array
-            //. note that it is the same function using for binding texture data buffer just change the target
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            //. creates and initializes a buffer object's data store
-            //. @param target buffer = GL_ARRAY_BUFFER --> specify the target buffer
-            //. @parram size = vertices.size() * sizeof(Vertex) --> the size of vertex buffer object
-            //. @param *data = (void *)vertices.data() --> which is the array to be saved into the buffer
-            //. @param usage = GL_STATIC_DRAW --> STATIC : The data store contents will be stored once.
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), (void *)vertices.data(), GL_STATIC_DRAW);
-            //. Enable a vertex location array
-            //. @param attribute = location --> used the defined constanst above
-            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
-            //. configure an array of vertex location data (Vertex Array will store these commands as configuration)
-            //. @param index = ATTRIB_LOC_POSITION(0)
-            //. size = 3 --> Specifies the number of components per vertex location.
-            //. type = GL_FLOAT --> Specifies type of eeach data
-            //. normalized = false (we do not devide by the maximum to normalize)
-            //. stride = sizeof(Vertex) --> Specifies the byte offset between consecutive vertex locations.
-            //. offest = (void *)offsetof(Vertex, position) --> specify the offset of the component for data stord to be stored
-            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, false, sizeof(Vertex), (void *)offsetof(Vertex, position));
-            //. Enable a vertex color array
-            //. @param attribute = color --> used the defined constanst above
-            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
-            //. define an array of vertex color data (Vertex Array will store these commands as configuration)
-            //. @param index = ATTRIB_LOC_COLOR(1)
-            //. size = 4 --> Specifies the number of components per vertex color (R,G,B,alpha).
-            //. normalized = true (devision by 255 to be ranged from 0 to 1)
-            //. stride = sizeof(Vertex) --> Specifies the byte offset between consecutive generic vertex colors.
-            //. offest = (void *)offsetof(Vertex, color) --> specify the offset of the component for data stord to be stored
-            glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, true, sizeof(Vertex), (void *)(offsetof(Vertex, color)));
-            //. Enable a vertex texcoord array
-            //. @param attribute = texcoord --> used the defined constanst above
-            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
-            //. define an array of vertex texcoord data (Vertex Array will store these commands as configuration)
-            //. @param index = ATTRIB_LOC_TEXCOORD(2)
-            //. size = 2 --> Specifies the number of components per vertex texcoord.
-            //. normalized = false
-            //. stride = sizeof(Vertex) --> Specifies the byte offset between consecutive vertex texcoords.
-            //. (void *)offsetof(Vertex, tex_coord) --> specify the offset of the component for data stord to be stored
-            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, false, sizeof(Vertex), (void *)(offsetof(Vertex, tex_coord)));
-            //. Enable a vertex normal array
-            //. @param attribute = ATTRIB_LOC_NORMAL --> used the defined constanst above
-            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
-            //. define an array of vertex normal data (Vertex Array will store these commands as configuration)
-            //. @param index = ATTRIB_LOC_NORMAL(4)
-            //. size = 3 --> Specifies the number of components per vertex normal.
-            //. normalized = false
-            //. stride = sizeof(Vertex) --> Specifies the byte offset between consecutive vertex texcoords.
-            //. (void *)offsetof(Vertex, tex_coord) --> specify the offset of the component for data stord to be stored
-            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, false, sizeof(Vertex), (void *)(offsetof(Vertex, normal)));
-            //. generation of element buffer object
-            //. @param n=1 --> generates only one element buffer object
-            //. @param *array = &EBO --> that stores elements
-            glGenBuffers(1, &EBO);
-            //. bind the element buffer object. function that takes the generated  element buffer object as a parameter
-            //. and target = GL_ELEMENT_ARRAY_BUFFER to bind Vertex array indices
-            //. not that it is the same function using for binding texture data buffer just change the target
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            //. creates and initializes a buffer object's data store
-            //. @param target buffer = GL_ELEMENT_ARRAY_BUFFER --> for the purpose of Vertex array indices
-            //. @parram size = elementCount * sizeof(GL_UNSIGNED_INT) --> the size of the buffer
-            //. @param *data = (void *)elements.data() --> which is the array to be saved into the buffer
-            //. @param usage = GL_STATIC_DRAW --> STATIC : The data store contents will be modified once and used many times.
-            //.                                   DRAW : The data store contents are modified by the application
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementCount * sizeof(GL_UNSIGNED_INT), (void *)elements.data(), GL_STATIC_DRAW);
+            MeshData data;
+            buildMeshData(vertices, elements, packed, lodElements, data);
+            create(data);
+        }
+
+        // This constructor takes data that is already in its final layout (e.g. read from the binary mesh cache)
+        explicit Mesh(const MeshData &data)
+        {
+            create(data);
+        }
+
+        // the formats that don't store a color per vertex read it from the current value of the color attribute
+        // so this should be called before drawing the mesh (draw and drawInstanced call it)
+        void applyConstantColor() const
+        {
+            if (format == VertexFormat::PACKED_NO_COLOR)
+                glVertexAttrib4fv(ATTRIB_LOC_COLOR, &constantColor[0]);
         }
 
-        // this function should render the mesh
-        void draw()
+        // this function should render the mesh (using the given level of detail)
+        // if "submesh" is not -1, only this submesh is drawn, otherwise all the submeshes are drawn in one draw call
+        void draw(int lod = 0, int submesh = -1)
         {
             // TODO: (Req 2) Write this function
-            //. bind the vertex array object. function that takes the generated vertex array object as a parameter
-            //. and target = GL_ARRAY_BUFFER to bind vertex array
-            //. not that it is the same function using for binding texture data buffer just change the target
-            glBindVertexArray(VAO);
+            //. bind the arena VAO of our vertex format (it is skipped if it is already bound by the previous draw)
+            MeshArena::get().bind(format);
+            applyConstantColor();
             //. rendereing from array
             //. @param mode = GL_TRIANGLES
-            //. @param count = elementCount --> number of elements to be rendered
-            //. @param type = GL_UNSIGNED_INT --> Specifies the type of the values in indices
-            //. @param index = 0 --> Specifies a pointer to the location where the indices are stored.
-            glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, (void *)0);
+            //. @param count = getElementCount(lod, submesh) --> number of elements to be rendered
+            //. @param type = elementType --> Specifies the type of the values in indices (16 or 32 bits)
+            //. @param indices = getElementOffset(lod, submesh) --> the byte offset of our first element inside the element buffer
+            //. @param basevertex = baseVertex --> a constant added to every index to reach our vertices inside the vertex buffer
+            glDrawElementsBaseVertex(GL_TRIANGLES, getElementCount(lod, submesh), elementType, (void *)getElementOffset(lod, submesh), baseVertex);
+        }
+
+        // this function renders "instanceCount" copies of the mesh in a single draw call
+        // the per-instance data is read from "buffer" which must contain "instanceCount" items of type "InstanceData"
+        void drawInstanced(GLuint buffer, GLsizei instanceCount, int lod = 0, int submesh = -1)
+        {
+            MeshArena &arena = MeshArena::get();
+            arena.bind(format);
+            arena.attachInstanceBuffer(format, buffer);
+            applyConstantColor();
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, getElementCount(lod, submesh), elementType, (void *)getElementOffset(lod, submesh),
+                                              instanceCount, baseVertex);
+        }
+
+        // this function reads the mesh data (the full level) back from the arena (slow, it should only be used while loading)
+        // the elements are relative to the first vertex of the mesh (as they were given to the constructor)
+        // only the standard format can be read back (returns false for the packed formats)
+        bool download(std::vector<Vertex> &vertices, std::vector<unsigned int> &elements) const
+        {
+            if (format != VertexFormat::STANDARD)
+                return false;
+            MeshArena &arena = MeshArena::get();
+            vertices.resize(vertexCount);
+            arena.downloadVertices(format, baseVertex, vertexCount, vertices.data());
+            if (elementType == GL_UNSIGNED_SHORT)
+            {
+                std::vector<GLushort> shortElements(elementCount);
+                arena.downloadElements(elementOffset, elementCount * sizeof(GLushort), shortElements.data());
+                elements.assign(shortElements.begin(), shortElements.end());
+            }
+            else
+            {
+                elements.resize(elementCount);
+                arena.downloadElements(elementOffset, elementCount * sizeof(GLuint), elements.data());
+            }
+            return true;
+        }
+
+        // this function reads the local space positions and the elements of the given level of detail back from the arena
+        // (slow, it should only be used while loading). Unlike "download", it works for every vertex format since the packed
+        // positions are mapped back to the local space using the position transform
+        void downloadPositions(std::vector<glm::vec3> &positions, std::vector<unsigned int> &elements, int lod = 0) const
+        {
+            MeshArena &arena = MeshArena::get();
+            GLsizei stride = arena.getStride(format);
+            std::vector<std::uint8_t> vertexData((size_t)vertexCount * stride);
+            arena.downloadVertices(format, baseVertex, vertexCount, vertexData.data());
+            positions.resize(vertexCount);
+            for (GLsizei vertex = 0; vertex < vertexCount; vertex++)
+            {
+                const std::uint8_t *data = vertexData.data() + (size_t)vertex * stride;
+                //. the position is the first attribute of every format (see "Vertex" and "PackedVertex")
+                if (format == VertexFormat::STANDARD)
+                {
+                    std::memcpy(&positions[vertex], data, sizeof(glm::vec3));
+                }
+                else
+                {
+                    glm::u16vec4 quantized;
+                    std::memcpy(&quantized, data, sizeof(quantized));
+                    positions[vertex] = glm::vec3(positionTransform * glm::vec4(glm::vec3(quantized) / 65535.0f, 1.0f));
+                }
+            }
+            GLsizei count = levels[lod].elementCount;
+            if (elementType == GL_UNSIGNED_SHORT)
+            {
+                std::vector<GLushort> shortElements(count);
+                arena.downloadElements(levels[lod].elementOffset, count * sizeof(GLushort), shortElements.data());
+                elements.assign(shortElements.begin(), shortElements.end());
+            }
+            else
+            {
+                elements.resize(count);
+                arena.downloadElements(levels[lod].elementOffset, count * sizeof(GLuint), elements.data());
+            }
+        }
+
+        // Getters for the location of the mesh data inside the arena (useful to batch multiple meshes in one submission)
+        VertexFormat getFormat() const { return format; }
+        GLint getBaseVertex() const { return baseVertex; }
+        GLsizei getVertexCount() const { return vertexCount; }
+        // The range of the given level of detail (or of one of its submeshes if "submesh" is not -1)
+        GLintptr getElementOffset(int lod = 0, int submesh = -1) const
+        {
+            return submesh < 0 ? levels[lod].elementOffset : levels[lod].submeshes[submesh].elementOffset;
+        }
+        GLsizei getElementCount(int lod = 0, int submesh = -1) const
+        {
+            return submesh < 0 ? levels[lod].elementCount : levels[lod].submeshes[submesh].elementCount;
+        }
+        int getLodCount() const { return (int)levels.size(); }
+        int getSubmeshCount() const { return (int)submeshNames.size(); }
+        const std::string &getSubmeshName(int submesh) const { return submeshNames[submesh]; }
+        // Returns the index of the submesh with the given name (or -1 if there is no such submesh)
+        int findSubmesh(const std::string &name) const
+        {
+            for (size_t submesh = 0; submesh < submeshNames.size(); submesh++)
+                if (submeshNames[submesh] == name)
+                    return (int)submesh;
+            return -1;
         }
+        const glm::vec3 &getBoundsMin() const { return boundsMin; }
+        const glm::vec3 &getBoundsMax() const { return boundsMax; }
+        GLenum getElementType() const { return elementType; }
+        GLsizei getElementSize() const { return MeshData::getElementSize(elementType); }
+        GLsizei getVertexSize() const { return MeshArena::get().getStride(format); }
+        const glm::mat4 &getPositionTransform() const { return positionTransform; }
+        const glm::vec4 &getConstantColor() const { return constantColor; }
 
-        // this function should delete the vertex & element buffers and the vertex array object
+        // this function should return the ranges of the mesh to the arena so that they can be reused by other meshes
         ~Mesh()
         {
             // TODO: (Req 2) Write this function
-            // delete vertex array object, vertex buffer object and element buffer object
-            glDeleteVertexArrays(1, &VAO);
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
+            MeshArena &arena = MeshArena::get();
+            arena.freeVertices(format, baseVertex, vertexCount);
+            arena.freeElements(elementOffset, allocatedElementCount * getElementSize());
         }
 
         Mesh(Mesh const &) = delete;
@@ -0,0 +1,441 @@
+#include "obj-parser.hpp"
+#include "../mapped-file.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+
+namespace our::obj_parser {
+
+    // Files smaller than this are parsed by a single thread (starting the threads would cost more than parsing)
+    static const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+    // A corner of a face, the indices are 0-based and -1 means that the corner doesn't have this attribute
+    struct Corner {
+        int position, tex_coord, normal;
+    };
+
+    // The data read from one chunk of the file
+    // The indices of the corners are global, except the negative (relative) indices of the file which can only be resolved
+    // after we know how many attributes came before the chunk. These are stored relative to the chunk start and listed in "relative".
+    struct Chunk {
+        const char *begin, *end;
+        std::vector<glm::vec3> positions;
+        std::vector<Color> colors;
+        std::vector<glm::vec2> tex_coords;
+        std::vector<glm::vec3> normals;
+        std::vector<Corner> corners; // The corners of all the faces one after the other
+        std::vector<unsigned int> faceSizes; // The number of corners of every face
+        size_t triangleCornerCount = 0; // The number of corners after triangulating the faces (3 per triangle)
+        std::vector<size_t> relative; // (corner index * 3 + attribute) of the corners that have relative indices
+        // The material names used by "usemtl" lines in the chunk and the index of the material of every face in this list
+        // The faces before the first "usemtl" of the chunk have the index -1 since they use the last material of the previous chunks
+        std::vector<std::string> materialNames;
+        std::vector<int> faceMaterials;
+        std::string error;
+        size_t errorLine = 0; // The line of the error counted from the chunk start
+        // The number of attributes and corners in all the chunks before this one
+        size_t positionOffset = 0, texCoordOffset = 0, normalOffset = 0, cornerOffset = 0;
+        // The material group of the faces with no "usemtl" in the chunk and the group of every name in "materialNames"
+        int firstGroup = -1;
+        std::vector<int> nameGroups;
+    };
+
+    // Runs "task(index)" for every index in [0, count) where each index gets its own thread
+    template<typename Task>
+    static void runParallel(size_t count, Task task) {
+        std::vector<std::thread> threads;
+        for (size_t index = 1; index < count; index++) threads.emplace_back(task, index);
+        task(0);
+        for (auto &thread : threads) thread.join();
+    }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+    static void skipSpaces(const char *&cursor, const char *end) {
+        while (cursor < end && isSpace(*cursor)) cursor++;
+    }
+
+    // Parses a float in the usual OBJ notation ([-]digits[.digits][e[-]digits])
+    // The digits are accumulated in an integer and scaled once by an exact power of ten, which gives the correctly rounded
+    // double whenever the mantissa fits in 53 bits and the exponent is small (always the case for OBJ files).
+    // Anything else (long mantissas, huge exponents, "nan", "inf") falls back to strtod.
+    static bool parseFloat(const char *&cursor, const char *end, float &value) {
+        static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char *start = cursor;
+        bool negative = false;
+        if (cursor < end && (*cursor == '-' || *cursor == '+')) negative = *cursor++ == '-';
+        std::uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, any = true) {
+            if (digits < 19) { mantissa = mantissa * 10 + (*cursor - '0'); if (mantissa) digits++; }
+            else exponent++;
+        }
+        if (cursor < end && *cursor == '.') {
+            for (cursor++; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, any = true) {
+                if (digits < 19) { mantissa = mantissa * 10 + (*cursor - '0'); if (mantissa) digits++; exponent--; }
+            }
+        }
+        if (any && cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+            const char *exponentStart = cursor++;
+            bool negativeExponent = false;
+            if (cursor < end && (*cursor == '-' || *cursor == '+')) negativeExponent = *cursor++ == '-';
+            if (cursor < end && *cursor >= '0' && *cursor <= '9') {
+                int written = 0;
+                for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++) if (written < 10000) written = written * 10 + (*cursor - '0');
+                exponent += negativeExponent ? -written : written;
+            } else {
+                cursor = exponentStart; // "1e" is just "1" followed by garbage
+            }
+        }
+        if (any && mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+            double result = (double) mantissa;
+            result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+            value = (float) (negative ? -result : result);
+            return true;
+        }
+        // the slow path needs a null terminated string so we copy the token
+        cursor = start;
+        const char *tokenEnd = start;
+        while (tokenEnd < end && !isSpace(*tokenEnd) && *tokenEnd != '\n' && *tokenEnd != '\r') tokenEnd++;
+        std::string token(start, tokenEnd);
+        char *parsedEnd = nullptr;
+        value = (float) std::strtod(token.c_str(), &parsedEnd);
+        if (parsedEnd == token.c_str()) return false;
+        cursor = start + (parsedEnd - token.c_str());
+        return true;
+    }
+
+    static bool parseInt(const char *&cursor, const char *end, int &value) {
+        bool negative = false;
+        if (cursor < end && (*cursor == '-' || *cursor == '+')) negative = *cursor++ == '-';
+        if (cursor >= end || *cursor < '0' || *cursor > '9') return false;
+        long long result = 0;
+        for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++) if (result < (1ll << 40)) result = result * 10 + (*cursor - '0');
+        value = (int) (negative ? -result : result);
+        return true;
+    }
+
+    // Converts an index from the file (1-based, or negative to count back from the last attribute) to a 0-based index
+    // "isRelative" is set for the negative indices, which are returned relative to the chunk start
+    static bool resolveIndex(int index, size_t countInChunk, int &resolved, bool &isRelative) {
+        if (index > 0) { resolved = index - 1; isRelative = false; return true; }
+        if (index < 0) { resolved = (int) countInChunk + index; isRelative = true; return true; }
+        return false; // 0 is not a valid index
+    }
+
+    // Parses all the lines of the chunk
+    static void parseChunk(Chunk &chunk) {
+        const char *cursor = chunk.begin, *end = chunk.end;
+        std::vector<Corner> polygon;
+        std::vector<unsigned char> polygonRelative;
+        size_t line = 0;
+        while (cursor < end && chunk.error.empty()) {
+            line++;
+            const char *lineEnd = cursor;
+            while (lineEnd < end && *lineEnd != '\n') lineEnd++;
+            skipSpaces(cursor, lineEnd);
+
+            if (lineEnd - cursor >= 2 && cursor[0] == 'v' && isSpace(cursor[1])) {
+                // "v x y z [w]" or "v x y z [r g b]"
+                cursor += 2;
+                glm::vec3 position(0.0f), color(1.0f);
+                bool valid = true;
+                for (int axis = 0; axis < 3 && valid; axis++) { skipSpaces(cursor, lineEnd); valid = parseFloat(cursor, lineEnd, position[axis]); }
+                // the values after the position are a color only if there are exactly 3 of them (a single one is the weight "w" which we ignore)
+                float extra[3];
+                int extraCount = 0;
+                while (valid) {
+                    skipSpaces(cursor, lineEnd);
+                    if (cursor >= lineEnd || *cursor == '\r' || *cursor == '#') break;
+                    float value;
+                    valid = parseFloat(cursor, lineEnd, value);
+                    if (valid && extraCount < 3) extra[extraCount] = value;
+                    extraCount++;
+                }
+                if (valid && extraCount == 3) color = glm::vec3(extra[0], extra[1], extra[2]);
+                if (!valid) { chunk.error = "invalid vertex position"; break; }
+                chunk.positions.push_back(position);
+                chunk.colors.push_back(Color(color.r * 255, color.g * 255, color.b * 255, 255));
+            } else if (lineEnd - cursor >= 3 && cursor[0] == 'v' && cursor[1] == 't' && isSpace(cursor[2])) {
+                // "vt u [v [w]]"
+                cursor += 3;
+                glm::vec2 tex_coord(0.0f);
+                skipSpaces(cursor, lineEnd);
+                if (!parseFloat(cursor, lineEnd, tex_coord.x)) { chunk.error = "invalid texture coordinate"; break; }
+                skipSpaces(cursor, lineEnd);
+                if (cursor < lineEnd && *cursor != '\r') parseFloat(cursor, lineEnd, tex_coord.y);
+                chunk.tex_coords.push_back(tex_coord);
+            } else if (lineEnd - cursor >= 3 && cursor[0] == 'v' && cursor[1] == 'n' && isSpace(cursor[2])) {
+                // "vn x y z"
+                cursor += 3;
+                glm::vec3 normal(0.0f);
+                bool valid = true;
+                for (int axis = 0; axis < 3 && valid; axis++) { skipSpaces(cursor, lineEnd); valid = parseFloat(cursor, lineEnd, normal[axis]); }
+                if (!valid) { chunk.error = "invalid normal"; break; }
+                chunk.normals.push_back(normal);
+            } else if (lineEnd - cursor >= 2 && cursor[0] == 'f' && isSpace(cursor[1])) {
+                // "f v[/[vt][/vn]] v[/[vt][/vn]] v[/[vt][/vn]] ..."
+                cursor += 2;
+                polygon.clear();
+                polygonRelative.clear();
+                while (true) {
+                    skipSpaces(cursor, lineEnd);
+                    if (cursor >= lineEnd || *cursor == '\r' || *cursor == '#') break;
+                    Corner corner = {-1, -1, -1};
+                    unsigned char relativeMask = 0;
+                    int index;
+                    bool isRelative;
+                    if (!parseInt(cursor, lineEnd, index) || !resolveIndex(index, chunk.positions.size(), corner.position, isRelative)) {
+                        chunk.error = "invalid face";
+                        break;
+                    }
+                    if (isRelative) relativeMask |= 1;
+                    if (cursor < lineEnd && *cursor == '/') {
+                        cursor++;
+                        if (cursor < lineEnd && *cursor != '/') {
+                            if (!parseInt(cursor, lineEnd, index) || !resolveIndex(index, chunk.tex_coords.size(), corner.tex_coord, isRelative)) {
+                                chunk.error = "invalid face";
+                                break;
+                            }
+                            if (isRelative) relativeMask |= 2;
+                        }
+                        if (cursor < lineEnd && *cursor == '/') {
+                            cursor++;
+                            if (!parseInt(cursor, lineEnd, index) || !resolveIndex(index, chunk.normals.size(), corner.normal, isRelative)) {
+                                chunk.error = "invalid face";
+                                break;
+                            }
+                            if (isRelative) relativeMask |= 4;
+                        }
+                    }
+                    polygon.push_back(corner);
+                    polygonRelative.push_back(relativeMask);
+                }
+                if (!chunk.error.empty()) break;
+                if (polygon.size() < 3) { chunk.error = "face with less than 3 corners"; break; }
+                for (size_t corner = 0; corner < polygon.size(); corner++) {
+                    for (int attribute = 0; attribute < 3; attribute++) {
+                        if (polygonRelative[corner] & (1 << attribute)) chunk.relative.push_back(chunk.corners.size() * 3 + attribute);
+                    }
+                    chunk.corners.push_back(polygon[corner]);
+                }
+                chunk.faceSizes.push_back((unsigned int) polygon.size());
+                chunk.faceMaterials.push_back((int) chunk.materialNames.size() - 1);
+                chunk.triangleCornerCount += 3 * (polygon.size() - 2);
+            } else if (lineEnd - cursor >= 7 && std::equal(cursor, cursor + 6, "usemtl") && isSpace(cursor[6])) {
+                // "usemtl name" (the following faces use this material)
+                cursor += 7;
+                skipSpaces(cursor, lineEnd);
+                const char *nameEnd = lineEnd;
+                while (nameEnd > cursor && (isSpace(nameEnd[-1]) || nameEnd[-1] == '\r')) nameEnd--;
+                chunk.materialNames.emplace_back(cursor, nameEnd);
+            }
+            // any other line (comments, material libraries, groups, ...) is ignored
+            cursor = lineEnd + 1;
+        }
+        if (!chunk.error.empty()) chunk.errorLine = line;
+    }
+
+    bool parse(const std::string &filename, std::vector<Vertex> &vertices, std::vector<GLuint> &elements,
+               std::vector<MaterialGroup> *groups, unsigned int threadCount) {
+        MappedFile file;
+        if (!file.open(filename)) {
+            std::cerr << "Failed to load obj file \"" << filename << "\": the file can't be opened or is empty" << std::endl;
+            return false;
+        }
+        const char *data = static_cast<const char *>(file.data());
+        const char *dataEnd = data + file.size();
+
+        // Split the file into chunks that start at the beginning of a line
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, file.size() / MIN_CHUNK_SIZE));
+        std::vector<Chunk> chunks(chunkCount);
+        const char *chunkBegin = data;
+        for (size_t index = 0; index < chunkCount; index++) {
+            const char *chunkEnd = index + 1 == chunkCount ? dataEnd : data + file.size() * (index + 1) / chunkCount;
+            if (chunkEnd < chunkBegin) chunkEnd = chunkBegin;
+            while (chunkEnd < dataEnd && chunkEnd[-1] != '\n') chunkEnd++;
+            chunks[index].begin = chunkBegin;
+            chunks[index].end = chunkEnd;
+            chunkBegin = chunkEnd;
+        }
+
+        // 1. parse the chunks in parallel
+        runParallel(chunkCount, [&](size_t index) { parseChunk(chunks[index]); });
+        for (const Chunk &chunk : chunks) {
+            if (!chunk.error.empty()) {
+                size_t line = std::count(data, chunk.begin, '\n') + chunk.errorLine;
+                std::cerr << "Failed to load obj file \"" << filename << "\": " << chunk.error << " at line " << line << std::endl;
+                return false;
+            }
+        }
+
+        // 2. find where the data of every chunk goes in the combined arrays
+        size_t positionCount = 0, texCoordCount = 0, normalCount = 0, cornerCount = 0;
+        for (Chunk &chunk : chunks) {
+            chunk.positionOffset = positionCount;
+            chunk.texCoordOffset = texCoordCount;
+            chunk.normalOffset = normalCount;
+            chunk.cornerOffset = cornerCount;
+            positionCount += chunk.positions.size();
+            texCoordCount += chunk.tex_coords.size();
+            normalCount += chunk.normals.size();
+            cornerCount += chunk.triangleCornerCount;
+        }
+        // every distinct material name becomes a group (in the order of their first "usemtl")
+        // the faces before the first "usemtl" of the file go to a group with an empty name
+        std::vector<std::string> groupNames;
+        auto findGroup = [&groupNames](const std::string &name) {
+            auto it = std::find(groupNames.begin(), groupNames.end(), name);
+            if (it != groupNames.end()) return (int) (it - groupNames.begin());
+            groupNames.push_back(name);
+            return (int) groupNames.size() - 1;
+        };
+        int currentGroup = -1;
+        for (Chunk &chunk : chunks) {
+            bool inherits = chunk.faceMaterials.empty() ? false : chunk.faceMaterials.front() < 0;
+            if (inherits && currentGroup < 0) currentGroup = findGroup("");
+            chunk.firstGroup = currentGroup;
+            for (const std::string &name : chunk.materialNames) chunk.nameGroups.push_back(findGroup(name));
+            if (!chunk.nameGroups.empty()) currentGroup = chunk.nameGroups.back();
+        }
+
+        std::vector<glm::vec3> positions(positionCount), normals(normalCount);
+        std::vector<Color> colors(positionCount);
+        std::vector<glm::vec2> tex_coords(texCoordCount);
+        runParallel(chunkCount, [&](size_t index) {
+            Chunk &chunk = chunks[index];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionOffset);
+            std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + chunk.positionOffset);
+            std::copy(chunk.tex_coords.begin(), chunk.tex_coords.end(), tex_coords.begin() + chunk.texCoordOffset);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalOffset);
+        });
+
+        // 3. triangulate the faces then build the vertex of every corner and its hash in parallel
+        std::vector<Vertex> cornerVertices(cornerCount);
+        std::vector<std::uint64_t> cornerHashes(cornerCount);
+        std::vector<int> triangleGroups(cornerCount / 3);
+        std::vector<char> invalid(chunkCount, 0);
+        runParallel(chunkCount, [&](size_t index) {
+            Chunk &chunk = chunks[index];
+            size_t offsets[3] = {chunk.positionOffset, chunk.texCoordOffset, chunk.normalOffset};
+            for (size_t relative : chunk.relative) {
+                int *indices = &chunk.corners[relative / 3].position;
+                indices[relative % 3] += (int) offsets[relative % 3];
+            }
+            for (const Corner &corner : chunk.corners) {
+                if (corner.position < 0 || (size_t) corner.position >= positionCount ||
+                    (corner.tex_coord >= 0 && (size_t) corner.tex_coord >= texCoordCount) ||
+                    (corner.normal >= 0 && (size_t) corner.normal >= normalCount)) {
+                    invalid[index] = 1;
+                    return;
+                }
+            }
+            size_t written = chunk.cornerOffset;
+            auto emit = [&](const Corner &source) {
+                Vertex &vertex = cornerVertices[written];
+                vertex.position = positions[source.position];
+                vertex.color = colors[source.position];
+                vertex.tex_coord = source.tex_coord >= 0 ? tex_coords[source.tex_coord] : glm::vec2(0.0f);
+                vertex.normal = source.normal >= 0 ? normals[source.normal] : glm::vec3(0.0f);
+                cornerHashes[written++] = hashVertex(vertex);
+            };
+            const Corner *face = chunk.corners.data();
+            for (size_t faceIndex = 0; faceIndex < chunk.faceSizes.size(); faceIndex++) {
+                unsigned int size = chunk.faceSizes[faceIndex];
+                int material = chunk.faceMaterials[faceIndex];
+                int group = material < 0 ? chunk.firstGroup : chunk.nameGroups[material];
+                // the faces are triangulated as fans, but a fan from the first corner of a quad is only correct if the first
+                // and third corners are convex, otherwise we start the fan from the second corner (the other diagonal)
+                size_t start = 0;
+                if (size == 4) {
+                    glm::vec3 points[4];
+                    for (int corner = 0; corner < 4; corner++) points[corner] = positions[face[corner].position];
+                    // the quad normal computed with Newell's method (so that it works for warped quads)
+                    glm::vec3 normal(0.0f);
+                    for (int corner = 0; corner < 4; corner++) normal += glm::cross(points[corner], points[(corner + 1) % 4]);
+                    auto isReflex = [&](int corner) {
+                        glm::vec3 turn = glm::cross(points[corner] - points[(corner + 3) % 4], points[(corner + 1) % 4] - points[corner]);
+                        return glm::dot(turn, normal) < 0.0f;
+                    };
+                    if (isReflex(0) || isReflex(2)) start = 1;
+                }
+                for (size_t corner = 1; corner + 1 < size; corner++) {
+                    triangleGroups[written / 3] = group;
+                    emit(face[start]);
+                    emit(face[(start + corner) % size]);
+                    emit(face[(start + corner + 1) % size]);
+                }
+                face += size;
+            }
+        });
+        for (char isInvalid : invalid) {
+            if (isInvalid) {
+                std::cerr << "Failed to load obj file \"" << filename << "\": a face uses an index that is out of range" << std::endl;
+                return false;
+            }
+        }
+
+        // 4. weld the corners into unique vertices using an open-addressing table (with linear probing)
+        // The table size is a power of two at least twice the number of corners, so it is never more than half full.
+        // The slots store the index of the vertex + 1 (0 marks an empty slot) and the hashes of the unique vertices are kept
+        // so that most of the mismatches are rejected without comparing the vertices.
+        size_t tableSize = 1;
+        while (tableSize < cornerCount * 2) tableSize <<= 1;
+        std::vector<GLuint> table(tableSize, 0);
+        std::vector<std::uint64_t> vertexHashes;
+        vertices.clear();
+        elements.resize(cornerCount);
+        vertices.reserve(cornerCount / 3);
+        vertexHashes.reserve(cornerCount / 3);
+        for (size_t corner = 0; corner < cornerCount; corner++) {
+            std::uint64_t hash = cornerHashes[corner];
+            size_t slot = (size_t) hash & (tableSize - 1);
+            while (true) {
+                GLuint stored = table[slot];
+                if (stored == 0) {
+                    // the first time we see this vertex
+                    table[slot] = (GLuint) vertices.size() + 1;
+                    elements[corner] = (GLuint) vertices.size();
+                    vertices.push_back(cornerVertices[corner]);
+                    vertexHashes.push_back(hash);
+                    break;
+                }
+                if (vertexHashes[stored - 1] == hash && vertices[stored - 1] == cornerVertices[corner]) {
+                    elements[corner] = stored - 1;
+                    break;
+                }
+                slot = (slot + 1) & (tableSize - 1);
+            }
+        }
+
+        // 5. sort the triangles by their material group (keeping their order inside the group) so every group is a contiguous range
+        std::vector<size_t> groupCounts(groupNames.size(), 0);
+        for (int group : triangleGroups) groupCounts[group]++;
+        if (groupNames.size() > 1) {
+            std::vector<size_t> groupStarts(groupNames.size(), 0);
+            for (size_t group = 1; group < groupNames.size(); group++) groupStarts[group] = groupStarts[group - 1] + groupCounts[group - 1];
+            std::vector<GLuint> sorted(elements.size());
+            for (size_t triangle = 0; triangle < triangleGroups.size(); triangle++) {
+                size_t target = groupStarts[triangleGroups[triangle]]++;
+                for (int corner = 0; corner < 3; corner++) sorted[target * 3 + corner] = elements[triangle * 3 + corner];
+            }
+            elements.swap(sorted);
+        }
+        if (groups) {
+            groups->clear();
+            for (size_t group = 0; group < groupNames.size(); group++) {
+                // a material can be selected without any face using it
+                if (groupCounts[group] > 0) groups->push_back({groupNames[group], groupCounts[group] * 3});
+            }
+        }
+        return true;
+    }
+
+}
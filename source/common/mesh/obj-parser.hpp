@@ -0,0 +1,32 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <glad/gl.h>
+#include <string>
+#include <vector>
+
+// A fast reader for ".obj" files that only extracts what our meshes need (positions, vertex colors, texture coordinates,
+// normals and faces). The file is memory mapped then split into line-aligned chunks that are parsed in parallel,
+// after which the corners of all the faces are welded into unique vertices using an open-addressing hash table.
+// The faces are grouped by their material name ("usemtl"), while the material libraries, the object groups and the
+// smoothing groups are ignored (the materials themselves are defined in the scene config).
+namespace our::obj_parser
+{
+    // A range of the elements whose faces use the same material (selected by the "usemtl" lines of the file)
+    // The faces that come before the first "usemtl" belong to a group with an empty name
+    struct MaterialGroup
+    {
+        std::string name;
+        size_t elementCount;
+    };
+
+    // Reads the ".obj" file into welded vertices and triangle elements
+    // The polygons are triangulated as fans (concave quads are split along their inner diagonal),
+    // and the missing texture coordinates and normals are set to zero
+    // The triangles are sorted by material so the elements of every material group are contiguous (in the order of "groups")
+    // "threadCount" is the maximum number of threads to use (0 means one per hardware thread)
+    // Returns false (after printing the error) if the file can't be read or contains an invalid face
+    bool parse(const std::string &filename, std::vector<Vertex> &vertices, std::vector<GLuint> &elements,
+               std::vector<MaterialGroup> *groups = nullptr, unsigned int threadCount = 0);
+}
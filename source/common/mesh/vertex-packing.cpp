@@ -0,0 +1,74 @@
+#include "vertex-packing.hpp"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace our
+{
+
+    // Quantizes a position inside the given box to 16 bits per component
+    static glm::u16vec4 packPosition(const glm::vec3 &position, const glm::vec3 &boundsMin, const glm::vec3 &extent)
+    {
+        glm::vec3 normalized = glm::clamp((position - boundsMin) / extent, 0.0f, 1.0f);
+        glm::vec3 quantized = glm::round(normalized * 65535.0f);
+        return glm::u16vec4(quantized, 0);
+    }
+
+    // Packs a template vertex into the packed struct T (PackedVertex or PackedVertexNoColor)
+    template <typename T>
+    static void packAll(const std::vector<Vertex> &vertices, const glm::vec3 &boundsMin, const glm::vec3 &extent, std::vector<std::uint8_t> &data)
+    {
+        data.resize(vertices.size() * sizeof(T));
+        T *output = reinterpret_cast<T *>(data.data());
+        for (size_t index = 0; index < vertices.size(); index++)
+        {
+            const Vertex &vertex = vertices[index];
+            T packed;
+            packed.position = packPosition(vertex.position, boundsMin, extent);
+            //. the 4th component (2 bits) of the normal is unused
+            glm::vec3 normal = glm::length(vertex.normal) > 0 ? glm::normalize(vertex.normal) : glm::vec3(0, 0, 1);
+            packed.normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+            packed.tex_coord = glm::packHalf2x16(vertex.tex_coord);
+            if constexpr (std::is_same<T, PackedVertex>::value)
+                packed.color = vertex.color;
+            output[index] = packed;
+        }
+    }
+
+    void packVertices(const std::vector<Vertex> &vertices, PackedVertices &packed)
+    {
+        //. compute the bounding box of the positions so that the 16 bits are spent inside the box only
+        glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+        bool constantColor = true;
+        for (const Vertex &vertex : vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+            constantColor = constantColor && vertex.color == vertices[0].color;
+        }
+        if (vertices.empty())
+            boundsMin = boundsMax = glm::vec3(0);
+        //. avoid dividing by zero for flat meshes (e.g. a plane)
+        glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+        //. the shader reads the quantized position as a number in [0, 1], so we scale and translate it back to the local space
+        packed.positionTransform = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), extent);
+        packed.constantColor = vertices.empty() ? glm::vec4(1.0f) : glm::vec4(vertices[0].color) / 255.0f;
+
+        if (constantColor)
+        {
+            packed.format = VertexFormat::PACKED_NO_COLOR;
+            packAll<PackedVertexNoColor>(vertices, boundsMin, extent, packed.data);
+        }
+        else
+        {
+            packed.format = VertexFormat::PACKED;
+            packAll<PackedVertex>(vertices, boundsMin, extent, packed.data);
+        }
+    }
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vertex.hpp"
+#include "mesh-arena.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace our
+{
+
+    // A compressed version of our::Vertex (20 bytes instead of 36) used by the PACKED vertex format
+    // - position: 3 unsigned shorts normalized to [0, 1] inside the mesh bounding box (the 4th one is padding)
+    // - normal: a signed normalized 10-10-10-2 integer (GL_INT_2_10_10_10_REV)
+    // - tex_coord: 2 half floats
+    // - color: RGBA8 (the same as our::Vertex)
+    struct PackedVertex
+    {
+        glm::u16vec4 position;
+        glm::uint32 normal;
+        glm::uint32 tex_coord;
+        Color color;
+    };
+
+    // The same as PackedVertex but without the color (16 bytes), used by the PACKED_NO_COLOR vertex format
+    // It is picked when all the vertices have the same color, so the color is sent once per draw as a constant attribute
+    struct PackedVertexNoColor
+    {
+        glm::u16vec4 position;
+        glm::uint32 normal;
+        glm::uint32 tex_coord;
+    };
+
+    // The output of "packVertices"
+    struct PackedVertices
+    {
+        VertexFormat format;            // PACKED or PACKED_NO_COLOR
+        std::vector<std::uint8_t> data; // The packed vertices (ready to be uploaded to the arena)
+        glm::mat4 positionTransform;    // Maps the quantized positions (in [0, 1]) back to the local space of the mesh
+        glm::vec4 constantColor;        // The color of all the vertices (only used if the format is PACKED_NO_COLOR)
+    };
+
+    // Packs the given vertices into one of the packed vertex formats
+    void packVertices(const std::vector<Vertex> &vertices, PackedVertices &packed);
+
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp>
+#include <functional>
+#include <cstdint>
+#include <cstring>
 
 namespace our {
 
@@ -24,21 +26,42 @@ namespace our {
         }
     };
 
+    // A strong 64-bit hash of the vertex (used to weld the duplicated vertices while loading the meshes)
+    // Every 32-bit word of the vertex is mixed with a multiply-xorshift step, so vertices that differ in a single bit
+    // get unrelated hashes (combining the glm hashes with "h1 ^ (h2 << 1)" made many similar vertices collide)
+    inline std::uint64_t hashVertex(const Vertex& vertex) {
+        static_assert(sizeof(Vertex) == 9 * sizeof(std::uint32_t), "Vertex must not contain any padding");
+        std::uint32_t words[9];
+        std::memcpy(words, &vertex, sizeof(words));
+        std::uint64_t hash = 0x9E3779B97F4A7C15ull;
+        for (int index = 0; index < 9; index++) {
+            std::uint32_t word = words[index];
+            // -0.0 and 0.0 are equal (see operator==) so they must have the same hash (word 3 is the color, not a float)
+            if (word == 0x80000000u && index != 3) word = 0;
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 32;
+        }
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // When the same mesh is drawn many times using the same material, we draw all the copies in one instanced draw call.
+    // This struct holds the data that differs between the copies and it is read from an instance buffer (one item per instance)
+    struct InstanceData {
+        glm::mat4 M;            // The model matrix (local to world) of the instance
+        glm::mat4 M_IT;         // The inverse transpose of the model matrix (used to transform the normals)
+    };
+
 }
 
 // We plan to use struct Vertex as a key for a map so we need to define a hash function for it
 namespace std {
-    //A Simple method to combine two hash values
-    inline size_t hash_combine(size_t h1, size_t h2){ return h1 ^ (h2 << 1); }
-
     //A Hash function for struct Vertex
     template<> struct hash<our::Vertex> {
         size_t operator()(our::Vertex const& vertex) const {
-            size_t combined = hash<glm::vec3>()(vertex.position);
-            combined = hash_combine(combined, hash<our::Color>()(vertex.color));
-            combined = hash_combine(combined, hash<glm::vec2>()(vertex.tex_coord));
-            combined = hash_combine(combined, hash<glm::vec3>()(vertex.normal));
-            return combined;
+            return (size_t)our::hashVertex(vertex);
         }
     };
 }
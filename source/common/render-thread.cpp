@@ -0,0 +1,76 @@
+#include "render-thread.hpp"
+
+#include <algorithm>
+
+void our::RenderThread::start(GLFWwindow *window, int maxFramesInFlight) {
+    if (isRunning()) return;
+    this->window = window;
+    this->maxFramesInFlight = std::max(maxFramesInFlight, 1);
+    stopping = false;
+    // A context can only be current on one thread at a time, so the main thread must release it first
+    glfwMakeContextCurrent(nullptr);
+    thread = std::thread(&RenderThread::run, this);
+}
+
+void our::RenderThread::stop() {
+    if (!isRunning()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!recording.empty()) {
+            frames.push_back(std::move(recording));
+            recording.clear();
+            framesInFlight++;
+            submittedFrames++;
+        }
+        stopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+    glfwMakeContextCurrent(window);
+}
+
+void our::RenderThread::enqueue(Job job) {
+    // Only the main thread touches the recorded frame so it doesn't need the lock
+    recording.push_back(std::move(job));
+}
+
+long long our::RenderThread::endFrame() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() { return framesInFlight < maxFramesInFlight; });
+    frames.push_back(std::move(recording));
+    recording.clear();
+    framesInFlight++;
+    long long index = submittedFrames++;
+    lock.unlock();
+    condition.notify_all();
+    return index;
+}
+
+long long our::RenderThread::getCompletedFrameCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completedFrames;
+}
+
+void our::RenderThread::run() {
+    glfwMakeContextCurrent(window);
+    while (true) {
+        std::vector<Job> frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !frames.empty(); });
+            // When stopping, the thread only exits after running all the frames that were handed over
+            if (frames.empty()) break;
+            frame = std::move(frames.front());
+            frames.pop_front();
+        }
+        for (auto &job: frame)
+            job();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            framesInFlight--;
+            completedFrames++;
+        }
+        condition.notify_all();
+    }
+    glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace our {
+
+    // The render thread owns the OpenGL context while it runs and executes all the OpenGL work of every frame.
+    // The main thread updates the world, extracts what should be drawn (see "ForwardRenderer::extractFrame") and records
+    // the OpenGL work of the frame as jobs, then it hands the frame over and starts the next one.
+    // So the simulation of frame N+1 overlaps the submission of frame N.
+    // The main thread can only get ahead by "maxFramesInFlight" frames, then "endFrame" waits for the render thread.
+    // The context can't be used by the main thread while the render thread runs, so the thread must be stopped
+    // (which waits for the frames in flight and gives the context back) before creating or deleting OpenGL objects (e.g. loading a state).
+    class RenderThread {
+    public:
+        using Job = std::function<void()>;
+
+    private:
+        GLFWwindow *window = nullptr;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable condition;
+
+        std::vector<Job> recording;             // The jobs of the frame recorded by the main thread
+        std::deque<std::vector<Job>> frames;    // The frames that were handed over and didn't start yet
+        int maxFramesInFlight = 1;
+        int framesInFlight = 0;                 // The frames that were handed over and didn't finish yet
+        long long submittedFrames = 0, completedFrames = 0;
+        bool stopping = false;
+
+        // The loop of the render thread: it takes the frames one by one and runs their jobs in order
+        void run();
+
+    public:
+        // Gives the context of the window to a new render thread
+        // This must be called from the thread that currently owns the context (the main thread)
+        void start(GLFWwindow *window, int maxFramesInFlight);
+        // Hands over the recorded jobs (if any), waits for all the frames to finish then makes the context current on the calling thread
+        void stop();
+        [[nodiscard]] bool isRunning() const { return thread.joinable(); }
+
+        // Adds a job to the frame being recorded
+        void enqueue(Job job);
+        // Hands the recorded frame over to the render thread (waiting first if "maxFramesInFlight" frames are still in flight)
+        // Returns the index of the frame (frames are numbered from 0 in the order they are handed over)
+        long long endFrame();
+        // Returns the number of frames that finished (so every frame whose index is less than this number is done)
+        long long getCompletedFrameCount();
+
+        RenderThread() = default;
+        ~RenderThread() { stop(); }
+
+        RenderThread(const RenderThread &) = delete;
+        RenderThread &operator=(const RenderThread &) = delete;
+    };
+
+}
@@ -0,0 +1,188 @@
+#include "program-cache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace our
+{
+    // The cache file starts with this header (see "program-cache.hpp")
+    // The version must be increased whenever the header or the way the key is computed change
+    struct ProgramCacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t format;
+        std::uint32_t size;
+    };
+
+    static const char CACHE_MAGIC[4] = {'W', 'R', 'P', 'B'};
+    static const std::uint32_t CACHE_VERSION = 1;
+
+    // Adds the given bytes to an FNV-1a hash
+    static void hashBytes(std::uint64_t &hash, const void *data, size_t size)
+    {
+        const std::uint8_t *bytes = static_cast<const std::uint8_t *>(data);
+        for (size_t index = 0; index < size; ++index)
+        {
+            hash ^= bytes[index];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    ProgramCache::ProgramCache(const std::string &directory) : directory(directory)
+    {
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION})
+        {
+            const GLubyte *string = glGetString(name);
+            driverString += string ? reinterpret_cast<const char *>(string) : "";
+            driverString += '\n';
+        }
+    }
+
+    void ProgramCache::initialize(const std::string &directory)
+    {
+        if (instance)
+            return;
+        // Program binaries are core since OpenGL 4.1 and the driver may still support no binary format at all
+        GLint formatCount = 0;
+        if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if (formatCount <= 0)
+        {
+            std::cerr << "The driver can't give program binaries, so the shaders will always be compiled" << std::endl;
+            return;
+        }
+        instance = new ProgramCache(directory);
+    }
+
+    void ProgramCache::destroy()
+    {
+        delete instance;
+        instance = nullptr;
+    }
+
+    std::uint64_t ProgramCache::getKey(const std::vector<GLenum> &types, const std::vector<std::string> &sources) const
+    {
+        std::uint64_t key = 14695981039346656037ull;
+        hashBytes(key, driverString.data(), driverString.size());
+        for (size_t stage = 0; stage < types.size() && stage < sources.size(); ++stage)
+        {
+            //. the size separates the stages so moving text from a stage to the next one changes the key
+            std::uint64_t size = sources[stage].size();
+            hashBytes(key, &types[stage], sizeof(GLenum));
+            hashBytes(key, &size, sizeof(size));
+            hashBytes(key, sources[stage].data(), sources[stage].size());
+        }
+        return key;
+    }
+
+    std::string ProgramCache::getCachePath(std::uint64_t key) const
+    {
+        std::stringstream stream;
+        stream << std::hex << std::setw(16) << std::setfill('0') << key << ".programcache";
+        return (std::filesystem::path(directory) / stream.str()).string();
+    }
+
+    bool ProgramCache::readBinary(std::uint64_t key, Binary &binary) const
+    {
+        if (directory.empty())
+            return false;
+        std::ifstream file(getCachePath(key), std::ios::binary);
+        ProgramCacheHeader header;
+        if (!file || !file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return false;
+        //. the file must be made by this version for the same key
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION ||
+            header.key != key || header.size == 0)
+            return false;
+        binary.format = (GLenum)header.format;
+        binary.data.resize(header.size);
+        //. and it must not be truncated
+        return (bool)file.read(reinterpret_cast<char *>(binary.data.data()), header.size);
+    }
+
+    void ProgramCache::writeBinary(std::uint64_t key, const Binary &binary) const
+    {
+        if (directory.empty())
+            return;
+        ProgramCacheHeader header = {};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.key = key;
+        header.format = (std::uint32_t)binary.format;
+        header.size = (std::uint32_t)binary.data.size();
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        //. we write to a temporary file then rename it, so a crash can never leave a half written cache behind
+        std::string path = getCachePath(key), temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return;
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(binary.data.data()), binary.data.size());
+            if (!file)
+            {
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return;
+            }
+        }
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            std::cerr << "Failed to write the program cache \"" << path << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    bool ProgramCache::load(GLuint program, std::uint64_t key)
+    {
+        auto it = binaries.find(key);
+        bool inMemory = it != binaries.end();
+        if (!inMemory)
+        {
+            Binary binary;
+            if (!readBinary(key, binary))
+                return false;
+            it = binaries.emplace(key, std::move(binary)).first;
+        }
+
+        glProgramBinary(program, it->second.format, it->second.data.data(), (GLsizei)it->second.data.size());
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (!status)
+        {
+            //. the caller compiles the program and stores its new binary over this one
+            binaries.erase(it);
+            ++statistics.rejected;
+            return false;
+        }
+        ++(inMemory ? statistics.memoryHits : statistics.diskHits);
+        return true;
+    }
+
+    void ProgramCache::store(GLuint program, std::uint64_t key)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        Binary binary;
+        binary.data.resize(length);
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &binary.format, binary.data.data());
+        if (written <= 0)
+            return;
+        binary.data.resize(written);
+        writeBinary(key, binary);
+        binaries[key] = std::move(binary);
+    }
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace our
+{
+
+    // The program cache keeps the binaries of the linked programs (from "glGetProgramBinary") so that linking the same program again
+    // (e.g. the sky, postprocess and material programs created again on every state change) loads its binary with "glProgramBinary"
+    // instead of compiling and linking its shaders.
+    // A program is identified by a key which hashes the final source of every stage (so their defines and thus their variants
+    // are part of it) with the vendor, renderer and version strings of the driver, since a binary only works on the driver that made it.
+    // The binaries are kept in memory and written to the cache directory (one file per program named after its key):
+    //.--------------------------------------------------------------------
+    //. header: magic, version, key, binary format and size
+    //. the binary
+    //.--------------------------------------------------------------------
+    // The driver may still refuse a binary (e.g. after an update that didn't change its version string), then the program is
+    // compiled from its sources as if it wasn't cached and the new binary replaces the old one.
+    class ProgramCache
+    {
+    public:
+        // Some numbers about the programs linked so far (shown in the statistics window of the renderer)
+        // They are atomic since the programs may be linked by the render thread while the main thread shows them
+        struct Statistics
+        {
+            std::atomic<int> memoryHits = 0; // The programs loaded from a binary that was already in memory
+            std::atomic<int> diskHits = 0;   // The programs loaded from a binary read from the cache directory
+            std::atomic<int> misses = 0;     // The programs compiled from their sources
+            std::atomic<int> rejected = 0;   // The binaries refused by the driver (these programs were compiled too)
+        };
+
+    private:
+        struct Binary
+        {
+            GLenum format = 0;
+            std::vector<std::uint8_t> data;
+        };
+
+        std::string directory;    // Empty if the binaries are only kept in memory
+        std::string driverString; // The vendor, renderer and version strings of the driver
+        std::unordered_map<std::uint64_t, Binary> binaries;
+
+        static inline ProgramCache *instance = nullptr;
+
+        explicit ProgramCache(const std::string &directory);
+
+        std::string getCachePath(std::uint64_t key) const;
+        // Reads the binary of the key from the cache directory into "binary"
+        bool readBinary(std::uint64_t key, Binary &binary) const;
+        void writeBinary(std::uint64_t key, const Binary &binary) const;
+
+    public:
+        // The statistics since the cache was created
+        Statistics statistics;
+
+        // Creates the cache (an OpenGL context must be current)
+        // If "directory" is empty, the binaries are only kept in memory
+        // Nothing is created if the driver can't give program binaries (so "get" keeps returning nullptr)
+        static void initialize(const std::string &directory);
+        // Returns the cache or nullptr if there is none (then the programs are always compiled)
+        static ProgramCache *get() { return instance; }
+        // Forgets the binaries kept in memory (the files stay in the cache directory)
+        static void destroy();
+
+        // Returns the key of the program made of the given stages
+        // @param sources: the final source of every stage (with its defines)
+        std::uint64_t getKey(const std::vector<GLenum> &types, const std::vector<std::string> &sources) const;
+
+        // Loads the cached binary of the key into the program (which must have no attached shaders)
+        // Returns false if there is no binary for the key or if the driver refused it (then the program should be compiled)
+        bool load(GLuint program, std::uint64_t key);
+        // Stores the binary of the linked program (which should be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+        void store(GLuint program, std::uint64_t key);
+
+        ProgramCache(ProgramCache const &) = delete;
+        ProgramCache &operator=(ProgramCache const &) = delete;
+    };
+
+}
@@ -1,4 +1,5 @@
 #include "shader.hpp"
+#include "program-cache.hpp"
 
 #include <cassert>
 #include <iostream>
@@ -9,7 +10,7 @@
 std::string checkForShaderCompilationErrors(GLuint shader);
 std::string checkForLinkingErrors(GLuint program);
 
-bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const
+bool our::ShaderProgram::attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines)
 {
     // Here, we open the file and read a string from it containing the GLSL code of our shader
     std::ifstream file(filename);
@@ -19,45 +20,125 @@ bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const
         return false;
     }
     std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char *sourceCStr = sourceString.c_str();
+    // The defines must come after "#version" (which must be the first statement of the shader)
+    if (!defines.empty())
+    {
+        size_t insertAt = 0;
+        if (sourceString.compare(0, 8, "#version") == 0)
+        {
+            insertAt = sourceString.find('\n');
+            insertAt = insertAt == std::string::npos ? sourceString.size() : insertAt + 1;
+        }
+        std::string defineLines;
+        for (const std::string &define : defines)
+            defineLines += "#define " + define + "\n";
+        sourceString.insert(insertAt, defineLines);
+    }
     file.close();
 
+    // The shader is compiled by "link" unless the program cache already has the linked program
+    stages.push_back({filename, type, defines});
+    sources.push_back(std::move(sourceString));
+    return true;
+}
+
+bool our::ShaderProgram::link()
+{
+    // The key covers the final sources so every set of defines (every variant) gets its own binary
+    ProgramCache *cache = ProgramCache::get();
+    std::uint64_t key = 0;
+    if (cache)
+    {
+        std::vector<GLenum> types;
+        for (const Stage &stage : stages)
+            types.push_back(stage.type);
+        key = cache->getKey(types, sources);
+        if (cache->load(program, key))
+        {
+            sources.clear();
+            return true;
+        }
+        ++cache->statistics.misses;
+    }
+
     // TODO: Complete this function
     // Note: The function "checkForShaderCompilationErrors" checks if there is
     //  an error in the given shader. You should use it to check if there is a
     //  compilation error and print it so that you can know what is wrong with
     //  the shader. The returned string will be empty if there is no errors.
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &sourceCStr, NULL);
-    glCompileShader(shader);
-    if (checkForShaderCompilationErrors(shader) != "")
+    std::vector<GLuint> shaders;
+    bool compiled = true;
+    for (size_t index = 0; index < stages.size() && compiled; ++index)
     {
-        std::cerr << "Error in shader: " << filename << std::endl;
-        std::cerr << checkForShaderCompilationErrors(shader) << std::endl;
-        return false;
+        const char *sourceCStr = sources[index].c_str();
+        GLuint shader = glCreateShader(stages[index].type);
+        glShaderSource(shader, 1, &sourceCStr, NULL);
+        glCompileShader(shader);
+        if (checkForShaderCompilationErrors(shader) != "")
+        {
+            std::cerr << "Error in shader: " << stages[index].filename << std::endl;
+            std::cerr << checkForShaderCompilationErrors(shader) << std::endl;
+            glDeleteShader(shader);
+            compiled = false;
+        }
+        else
+        {
+            glAttachShader(program, shader);
+            shaders.push_back(shader);
+        }
     }
+    sources.clear();
 
-    glAttachShader(program, shader);
-    glDeleteShader(shader);
-    // We return true if the compilation succeeded
-    return true;
-}
-
-bool our::ShaderProgram::link() const
-{
-    // TODO: Complete this function
     // Note: The function "checkForLinkingErrors" checks if there is
     //  an error in the given program. You should use it to check if there is a
     //  linking error and print it so that you can know what is wrong with the
     //  program. The returned string will be empty if there is no errors.
-    glLinkProgram(program);
-    if (checkForLinkingErrors(program) != "")
+    bool linked = false;
+    if (compiled)
     {
-        std::cerr << "Error in linking program" << std::endl;
-        std::cerr << checkForLinkingErrors(program) << std::endl;
-        return false;
+        // The driver may only keep what "glGetProgramBinary" needs if it is told before linking
+        if (cache)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        if (checkForLinkingErrors(program) != "")
+        {
+            std::cerr << "Error in linking program" << std::endl;
+            std::cerr << checkForLinkingErrors(program) << std::endl;
+        }
+        else
+            linked = true;
     }
-    return true;
+    // The linked program doesn't need its shaders anymore
+    for (GLuint shader : shaders)
+    {
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    if (linked && cache)
+        cache->store(program, key);
+    return linked;
+}
+
+our::ShaderProgram *our::ShaderProgram::createVariant(const std::vector<std::string> &extraDefines, const std::string &fragmentShader) const
+{
+    ShaderProgram *variant = new ShaderProgram();
+    for (const Stage &stage : stages)
+    {
+        std::vector<std::string> defines = stage.defines;
+        defines.insert(defines.end(), extraDefines.begin(), extraDefines.end());
+        const std::string &filename = stage.type == GL_FRAGMENT_SHADER && !fragmentShader.empty() ? fragmentShader : stage.filename;
+        if (!variant->attach(filename, stage.type, defines))
+        {
+            delete variant;
+            return nullptr;
+        }
+    }
+    if (!variant->link())
+    {
+        delete variant;
+        return nullptr;
+    }
+    return variant;
 }
 
 ////////////////////////////////////////////////////////////////////
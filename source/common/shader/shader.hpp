@@ -2,6 +2,7 @@
 #define SHADER_HPP
 
 #include <string>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
@@ -13,9 +14,22 @@ namespace our
     class ShaderProgram
     {
 
+    public:
+        // A shader file compiled into this program and the defines it was compiled with
+        struct Stage
+        {
+            std::string filename;
+            GLenum type;
+            std::vector<std::string> defines;
+        };
+
     private:
         // Shader Program Handle (OpenGL object name)
         GLuint program;
+        // The shaders attached to this program (kept so the program can be compiled again with more defines)
+        std::vector<Stage> stages;
+        // The final source (with the defines) of every stage, kept till the program is linked
+        std::vector<std::string> sources;
 
     public:
         ShaderProgram()
@@ -29,9 +43,26 @@ namespace our
             glDeleteProgram(program);
         }
 
-        bool attach(const std::string &filename, GLenum type) const;
+        // Reads the shader file and adds it to the program
+        // Every name in "defines" is defined (as "#define NAME") right after the "#version" line
+        // so one file can be compiled into variants (e.g. "TEXTURE_ARRAYS" in the lit shaders)
+        // The shader is only compiled by "link" (and not at all if the program cache has the program)
+        bool attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines = {});
+
+        // Loads the program from the program cache (see "program-cache.hpp") if it has a binary for these exact sources
+        // Otherwise, compiles the attached shaders, links them and gives the program binary to the cache
+        // Returns false if a shader fails to compile or the program fails to link
+        bool link();
+
+        const std::vector<Stage> &getStages() const { return stages; }
 
-        bool link() const;
+        GLuint getOpenGLName() const { return program; }
+
+        // Compiles and links a new program from the same shader files with the given defines added to every stage
+        // If "fragmentShader" isn't empty, it replaces the fragment shader file (e.g. a depth-only shader for the depth pre-pass)
+        // (the renderer uses it to get the variants of a material's lit shader, such as the G-buffer variant)
+        // Returns nullptr if the new program fails to compile or link (the caller owns the returned program)
+        ShaderProgram *createVariant(const std::vector<std::string> &extraDefines, const std::string &fragmentShader = "") const;
 
         void use()
         {
@@ -80,6 +111,11 @@ namespace our
             glUniform4fv(getUniformLocation(uniform), 1, glm::value_ptr(value));
         }
 
+        void set(const std::string &uniform, glm::ivec3 value)
+        {
+            glUniform3iv(getUniformLocation(uniform), 1, glm::value_ptr(value));
+        }
+
         void set(const std::string &uniform, glm::mat4 matrix)
         {
             // TODO: (Req 1) Send the given matrix 4x4 value to the given uniform
@@ -0,0 +1,124 @@
+#include "deferred-renderer.hpp"
+#include "../texture/texture-utils.hpp"
+
+namespace our
+{
+    void DeferredRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json &config)
+    {
+        ForwardRenderer::initialize(windowSize, config);
+
+        //. create the G-buffer (the targets have the size of the window like the postprocess targets)
+        const GLenum targetFormats[GBUFFER_TARGET_COUNT] = {GL_RGBA8, GL_RGBA16F, GL_RGBA8, GL_RGBA16F};
+        GLenum drawBuffers[GBUFFER_TARGET_COUNT];
+        glGenFramebuffers(1, &gBufferFrameBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gBufferFrameBuffer);
+        for (int target = 0; target < GBUFFER_TARGET_COUNT; target++)
+        {
+            gBufferTargets[target] = texture_utils::empty(targetFormats[target], windowSize);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + target, GL_TEXTURE_2D,
+                                   gBufferTargets[target]->getOpenGLName(), 0);
+            drawBuffers[target] = GL_COLOR_ATTACHMENT0 + target;
+        }
+        gBufferDepth = texture_utils::empty(GL_DEPTH_COMPONENT24, windowSize);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gBufferDepth->getOpenGLName(), 0);
+        //. the G-buffer shaders write their outputs 0, 1, 2 and 3 to the 4 targets
+        glDrawBuffers(GBUFFER_TARGET_COUNT, drawBuffers);
+        if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR: The G-buffer of the deferred renderer is incomplete" << std::endl;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+        //. the lighting pass reads the lights from the light clusters (if they are enabled) so only the lights near a pixel are computed
+        std::vector<std::string> defines = {"DEFERRED_LIGHTING"};
+        if (clusteredLighting)
+            defines.push_back("CLUSTERED_LIGHTING");
+        lightingProgram = new ShaderProgram();
+        lightingProgram->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+        lightingProgram->attach("assets/shaders/lightened.frag", GL_FRAGMENT_SHADER, defines);
+        lightingProgram->link();
+        glGenVertexArrays(1, &lightingVertexArray);
+
+        lightingPipelineState.depthTesting.enabled = true;
+        lightingPipelineState.depthTesting.function = GL_ALWAYS;
+    }
+
+    void DeferredRenderer::destroy()
+    {
+        delete lightingProgram;
+        lightingProgram = nullptr;
+        glDeleteVertexArrays(1, &lightingVertexArray);
+        lightingVertexArray = 0;
+        for (auto &target : gBufferTargets)
+        {
+            delete target;
+            target = nullptr;
+        }
+        delete gBufferDepth;
+        gBufferDepth = nullptr;
+        glDeleteFramebuffers(1, &gBufferFrameBuffer);
+        gBufferFrameBuffer = 0;
+        ForwardRenderer::destroy();
+    }
+
+    ShaderProgram *DeferredRenderer::selectProgram(const Material *material, ShaderProgram *program)
+    {
+        //. only the lit materials are drawn to the G-buffer (the pre-pass still uses their depth-only variant)
+        if (!gBufferPass || program == nullptr || opaquePass != OpaquePass::SHADING || dynamic_cast<const LitMaterial *>(material) == nullptr)
+            return ForwardRenderer::selectProgram(material, program);
+        return getProgramVariant(program, ProgramVariant::GBUFFER);
+    }
+
+    void DeferredRenderer::renderOpaquePass(const glm::vec3 &cameraPosition, const glm::mat4 &VP)
+    {
+        //. the overdraw view shows how many fragments are shaded when drawing the objects so there is nothing to light
+        if (toggles.overdrawView)
+        {
+            ForwardRenderer::renderOpaquePass(cameraPosition, VP);
+            return;
+        }
+
+        //. move the unlit commands out of the opaque commands (their order doesn't matter since they are sorted later)
+        auto firstUnlit = std::partition(opaqueCommands.begin(), opaqueCommands.end(), [](const RenderCommand &command)
+                                         { return dynamic_cast<const LitMaterial *>(command.material) != nullptr; });
+        unlitCommands.assign(firstUnlit, opaqueCommands.end());
+        opaqueCommands.erase(firstUnlit, opaqueCommands.end());
+
+        //. 1- the G-buffer pass (the masks were already enabled by "render" to clear the scene framebuffer)
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gBufferFrameBuffer);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        gBufferPass = true;
+        ForwardRenderer::renderOpaquePass(cameraPosition, VP);
+        gBufferPass = false;
+        double gBufferSubmitTime = statistics.opaqueSubmitTime;
+
+        //. 2- the lighting pass: a fullscreen triangle drawn to the scene framebuffer
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebuffer);
+        lightingPipelineState.setup();
+        lightingProgram->use();
+        const char *targetUniforms[GBUFFER_TARGET_COUNT] = {"gbuffer_albedo", "gbuffer_normal_roughness", "gbuffer_specular", "gbuffer_emissive"};
+        //. the texels are fetched one by one so the samplers left on these units by the materials are unbound
+        for (int target = 0; target < GBUFFER_TARGET_COUNT; target++)
+        {
+            glActiveTexture(GL_TEXTURE0 + target);
+            gBufferTargets[target]->bind();
+            glBindSampler(target, 0);
+            lightingProgram->set(targetUniforms[target], target);
+        }
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_TARGET_COUNT);
+        gBufferDepth->bind();
+        glBindSampler(GBUFFER_TARGET_COUNT, 0);
+        lightingProgram->set("gbuffer_depth", GBUFFER_TARGET_COUNT);
+        setLightingUniforms(lightingProgram, cameraPosition, VP);
+        lightingProgram->set("inverse_VP", glm::inverse(VP));
+        lightingProgram->set("viewport_size", glm::vec2(renderSize));
+        glBindVertexArray(lightingVertexArray);
+        //. we bound a VAO that doesn't belong to the mesh arena so the arena must rebind its VAO in the next draw
+        MeshArena::invalidateBinding();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        //. 3- the unlit opaque objects are drawn forward on top (depth tested against the depth copied by the lighting pass)
+        opaqueCommands.swap(unlitCommands);
+        ForwardRenderer::renderOpaquePass(cameraPosition, VP);
+        statistics.opaqueSubmitTime += gBufferSubmitTime;
+    }
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "forward-renderer.hpp"
+
+namespace our
+{
+
+    // A deferred renderer splits the lighting of the opaque lit objects from drawing them:
+    // 1- The G-buffer pass draws the opaque objects (using the same sorted, instanced and multi-draw submission as the forward renderer)
+    //    with a variant of their lit shader compiled with GBUFFER, which writes their material to the G-buffer instead of lighting them
+    // 2- The lighting pass draws a fullscreen triangle to the scene framebuffer (compiled from "lightened.frag" with DEFERRED_LIGHTING)
+    //    which reads the G-buffer and adds the lights of the cluster of every pixel (see "light-clusters.hpp"), and copies the depth
+    // So every visible pixel is lit once no matter how many objects were drawn over each other.
+    // The overdraw view skips the G-buffer and draws the opaque objects like the forward renderer.
+    // The sky, the transparent objects (which are still lit forward) and the postprocessing are drawn after that as in the forward renderer.
+    //.--------------------------------------------------------------------
+    //. G-buffer targets:
+    //. 0- albedo (RGBA8): rgb = albedo
+    //. 1- normal & roughness (RGBA16F): xyz = world space normal, w = roughness
+    //. 2- specular (RGBA8): rgb = specular color
+    //. 3- emissive (RGBA16F): rgb = emissive color + ambient sky light (everything that doesn't depend on the lights)
+    //. depth (DEPTH_COMPONENT24)
+    //.--------------------------------------------------------------------
+    class DeferredRenderer : public ForwardRenderer
+    {
+        static constexpr int GBUFFER_TARGET_COUNT = 4;
+
+        GLuint gBufferFrameBuffer = 0;
+        Texture2D *gBufferTargets[GBUFFER_TARGET_COUNT] = {};
+        Texture2D *gBufferDepth = nullptr;
+
+        // The program of the lighting pass and the (empty) vertex array used to draw its fullscreen triangle
+        ShaderProgram *lightingProgram = nullptr;
+        GLuint lightingVertexArray = 0;
+        // The depth test always passes in the lighting pass since it only copies the depth of the G-buffer
+        PipelineState lightingPipelineState;
+
+        // True while the G-buffer pass is drawn (the lit materials use the GBUFFER variant of their programs in its shading pass)
+        bool gBufferPass = false;
+        // The opaque commands whose material isn't lit (they have nothing to write to the G-buffer so they are drawn forward after the lighting pass)
+        std::vector<RenderCommand> unlitCommands;
+
+        ShaderProgram *selectProgram(const Material *material, ShaderProgram *program) override;
+        void renderOpaquePass(const glm::vec3 &cameraPosition, const glm::mat4 &VP) override;
+
+    public:
+        // Initialize the forward renderer parts (see "ForwardRenderer::initialize") then the G-buffer and the lighting pass
+        void initialize(glm::ivec2 windowSize, const nlohmann::json &config) override;
+        void destroy() override;
+    };
+
+    // This function returns a new renderer based on the given type
+    // @param type can be "forward" or "deferred" (anything else gives the forward renderer)
+    inline ForwardRenderer *createRendererFromType(const std::string &type)
+    {
+        if (type == "deferred")
+        {
+            return new DeferredRenderer();
+        }
+        else
+        {
+            return new ForwardRenderer();
+        }
+    }
+
+}
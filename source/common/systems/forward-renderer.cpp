@@ -1,13 +1,98 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
 #include "../texture/texture-utils.hpp"
+#include "../deserialize-utils.hpp"
+#include <chrono>
+#include <map>
+#include <set>
+#include <limits>
 
 namespace our
 {
+    //. the weight of a transparent fragment in the weighted blended transparency, defined in every shader compiled with WEIGHTED_OIT
+    //. it favors the opaque and the near fragments so they dominate the average color of the pixel (see "weighted-oit-resolve.frag")
+    static const char *OIT_WEIGHT_DEFINE =
+        "OIT_WEIGHT(alpha) clamp(pow(min(1.0, (alpha) * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3)";
+
+    //. checks if a world space box may be visible using the given view projection matrix
+    //. the box is hidden only if all of its corners are outside the same clip plane
+    static bool isBoxVisible(const glm::mat4 &VP, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec4 corners[8];
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x,
+                             (i & 2) ? boundsMax.y : boundsMin.y,
+                             (i & 4) ? boundsMax.z : boundsMin.z);
+            corners[i] = VP * glm::vec4(corner, 1.0f);
+        }
+        //. for each axis, test the planes (-w <= x) and (x <= w)
+        for (int axis = 0; axis < 3; axis++)
+        {
+            bool allBelow = true, allAbove = true;
+            for (auto &corner : corners)
+            {
+                allBelow = allBelow && corner[axis] < -corner.w;
+                allAbove = allAbove && corner[axis] > corner.w;
+            }
+            if (allBelow || allAbove)
+                return false;
+        }
+        return true;
+    }
+
+    //. returns the radius of the bounding sphere of the mesh relative to half the screen height (used to pick the levels of detail and the occluders)
+    static float getProjectedSize(const glm::mat4 &M, const Mesh *mesh, const glm::mat4 &projection, const glm::vec3 &eye, float near, bool perspective)
+    {
+        glm::vec3 localCenter = (mesh->getBoundsMin() + mesh->getBoundsMax()) * 0.5f;
+        glm::vec3 center = M * glm::vec4(localCenter, 1.0f);
+        float scale = std::max({glm::length(glm::vec3(M[0])), glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2]))});
+        float radius = 0.5f * glm::length(mesh->getBoundsMax() - mesh->getBoundsMin()) * scale;
+        //. projection[1][1] is 1/tan(fovY/2) so radius * projection[1][1] / distance is the radius relative to half the screen height
+        float screenSize = radius * projection[1][1];
+        if (perspective)
+            screenSize /= std::max(glm::distance(center, eye), near);
+        return screenSize;
+    }
+
     void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json &config)
     {
         this->windowSize = windowSize;
 
+        //. create the buffer that will hold the per-instance data of the instanced draw calls
+        glGenBuffers(1, &instanceBuffer);
+
+        //. the multi-draw indirect path needs OpenGL 4.3 (indirect multi-draws and shader storage buffers)
+        //. since we only request a 3.3 context, we check what the driver actually gave us
+        indirectSupported = GLAD_GL_VERSION_4_3 != 0;
+        useIndirect = config.value("indirect", true);
+        //. the light clusters are read through texture buffers which only need OpenGL 3.1
+        clusteredLighting = config.value("clusteredLighting", true);
+        if (clusteredLighting)
+            lightClusters.initialize();
+        depthPrepass = config.value("depthPrepass", false);
+        overdrawView = config.value("overdrawView", false);
+        frustumCulling = config.value("frustumCulling", true);
+        weightedTransparency = config.value("transparency", std::string("sorted")) == "weighted";
+        //. the occlusion culling only allocates its depth buffer if it is enabled (the occluder meshes are made by "buildOccluders")
+        if (config.value("occlusionCulling", false))
+        {
+            occlusionCulling = true;
+            occlusionCuller.initialize(config.value("occlusionBufferSize", glm::ivec2(256, 128)));
+            maxOccluders = config.value("maxOccluders", maxOccluders);
+            occluderTriangles = config.value("occluderTriangles", occluderTriangles);
+        }
+        if (unsigned int threads = config.value("extractionThreads", 0u); threads != 1)
+            extractionWorkers = std::make_unique<WorkerPool>(threads);
+        glGenQueries(2, sampleQueries);
+        if (indirectSupported)
+        {
+            glGenBuffers(1, &indirectBuffer);
+            glGenBuffers(1, &drawDataBuffer);
+            glGenBuffers(1, &drawLayersBuffer);
+            glGenBuffers(1, &drawIdBuffer);
+        }
+
         // Then we check if there is a sky texture in the configuration
         if (config.contains("sky"))
         {
@@ -55,7 +140,9 @@ namespace our
         }
 
         // Then we check if there is a postprocessing shader in the configuration
-        if (config.contains("postprocess"))
+        //. (the weighted transparency also needs the scene in these targets since it shares their depth,
+        //. and the dynamic resolution draws the scene to a part of them)
+        if (config.contains("postprocess") || weightedTransparency || config.contains("dynamicResolution"))
         {
             // TODO: (Req 11) Create a framebuffer
             //. generation of framebuffer object
@@ -96,35 +183,99 @@ namespace our
             // TODO: (Req 11) Unbind the framebuffer just to be safe
             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
-            // Create a vertex array to use for drawing the texture
-            glGenVertexArrays(1, &postProcessVertexArray);
-
-            // Create a sampler to use for sampling the scene texture in the post processing shader
-            Sampler *postprocessSampler = new Sampler();
-            postprocessSampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            postprocessSampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            postprocessSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            postprocessSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            // Create the post processing shader
-            ShaderProgram *postprocessShader = new ShaderProgram();
-            postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-            postprocessShader->attach(config.value<std::string>("postprocess", ""), GL_FRAGMENT_SHADER);
-            postprocessShader->link();
-
-            // Create a post-processing material
-            postprocessMaterial = new TexturedMaterial();
-            postprocessMaterial->shader = postprocessShader;
-            postprocessMaterial->texture = colorTarget;
-            postprocessMaterial->sampler = postprocessSampler;
-            // The default options are fine but we don't need to interact with the depth buffer
-            // so it is more performant to disable the depth mask
-            postprocessMaterial->pipelineState.depthMask = false;
+            //. create the passes that read the scene from these targets (a single shader or a chain of passes, see "postprocess-chain.hpp")
+            if (config.contains("postprocess"))
+            {
+                postprocessChain = new PostprocessChain();
+                if (!postprocessChain->initialize(windowSize, config["postprocess"]))
+                {
+                    delete postprocessChain;
+                    postprocessChain = nullptr;
+                }
+            }
+        }
+
+        //. the scene is stretched to the targets of the upscale framebuffer before the postprocess chain reads it
+        //. (the passes sample their inputs over the whole texture so they can't read a part of the scene targets)
+        if (config.contains("dynamicResolution"))
+        {
+            resolutionScaler.initialize(config["dynamicResolution"]);
+            dynamicResolutionSupported = dynamicResolution = true;
+            if (postprocessChain)
+            {
+                upscaledColor = texture_utils::empty(GL_RGBA8, windowSize);
+                upscaledDepth = texture_utils::empty(GL_DEPTH_COMPONENT24, windowSize);
+                glGenFramebuffers(1, &upscaleFrameBuffer);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, upscaleFrameBuffer);
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, upscaledColor->getOpenGLName(), 0);
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, upscaledDepth->getOpenGLName(), 0);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            }
+        }
+
+        //. the transparent objects are accumulated to their own targets which share the depth of the scene
+        //. so they are depth tested against the opaque objects (the default framebuffer's depth can't be attached to them)
+        if (weightedTransparency)
+        {
+            oitAccumulationTarget = texture_utils::empty(GL_RGBA16F, windowSize);
+            oitWeightTarget = texture_utils::empty(GL_R16F, windowSize);
+            glGenFramebuffers(1, &oitFrameBuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oitFrameBuffer);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oitAccumulationTarget->getOpenGLName(), 0);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, oitWeightTarget->getOpenGLName(), 0);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTarget->getOpenGLName(), 0);
+            const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+            glDrawBuffers(2, drawBuffers);
+            bool complete = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+            oitResolveProgram = new ShaderProgram();
+            bool compiled = oitResolveProgram->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER) &&
+                            oitResolveProgram->attach("assets/shaders/weighted-oit-resolve.frag", GL_FRAGMENT_SHADER) &&
+                            oitResolveProgram->link();
+            glGenVertexArrays(1, &oitVertexArray);
+
+            //. the average color is blended over the scene with (1 - revealage) as its alpha
+            oitResolvePipelineState.blending.enabled = true;
+            oitResolvePipelineState.blending.sourceFactor = GL_SRC_ALPHA;
+            oitResolvePipelineState.blending.destinationFactor = GL_ONE_MINUS_SRC_ALPHA;
+            oitResolvePipelineState.depthMask = false;
+
+            weightedTransparencySupported = complete && compiled;
+            if (!weightedTransparencySupported)
+                std::cerr << "ERROR: Couldn't create the weighted transparency targets, the transparent objects will be sorted instead" << std::endl;
         }
     }
 
     void ForwardRenderer::destroy()
     {
+        //. delete the instance buffer (after telling the mesh arena to forget it since its VAOs may be pointing to it)
+        MeshArena::releaseBuffer(instanceBuffer);
+        glDeleteBuffers(1, &instanceBuffer);
+        instanceBuffer = 0;
+        //. delete the buffers of the multi-draw indirect path
+        if (indirectSupported)
+        {
+            MeshArena::releaseBuffer(drawIdBuffer);
+            glDeleteBuffers(1, &indirectBuffer);
+            glDeleteBuffers(1, &drawDataBuffer);
+            glDeleteBuffers(1, &drawLayersBuffer);
+            glDeleteBuffers(1, &drawIdBuffer);
+            indirectBuffer = drawDataBuffer = drawLayersBuffer = drawIdBuffer = 0;
+            drawIdCapacity = 0;
+        }
+        if (clusteredLighting)
+            lightClusters.destroy();
+        //. delete the program variants (the ones that failed to compile map to the original programs which we don't own)
+        for (auto &[key, variant] : programVariants)
+            if (variant != key.first)
+                delete variant;
+        programVariants.clear();
+        freeSnapshots.clear();
+        extractionWorkers.reset();
+        extractionChunks.clear();
+        glDeleteQueries(2, sampleQueries);
+        sampleQueryPending[0] = sampleQueryPending[1] = false;
         // Delete all objects related to the sky
         if (skyMaterial)
         {
@@ -135,49 +286,193 @@ namespace our
             delete skyMaterial;
         }
         // Delete all objects related to post processing
-        if (postprocessMaterial)
+        if (postprocessFrameBuffer)
         {
             glDeleteFramebuffers(1, &postprocessFrameBuffer);
-            glDeleteVertexArrays(1, &postProcessVertexArray);
+            postprocessFrameBuffer = 0;
             delete colorTarget;
             delete depthTarget;
-            delete postprocessMaterial->sampler;
-            delete postprocessMaterial->shader;
-            delete postprocessMaterial;
+            colorTarget = depthTarget = nullptr;
+        }
+        delete postprocessChain;
+        postprocessChain = nullptr;
+        //. delete the objects of the weighted transparency
+        if (oitFrameBuffer)
+        {
+            glDeleteFramebuffers(1, &oitFrameBuffer);
+            glDeleteVertexArrays(1, &oitVertexArray);
+            oitFrameBuffer = oitVertexArray = 0;
+            delete oitAccumulationTarget;
+            delete oitWeightTarget;
+            delete oitResolveProgram;
+            oitAccumulationTarget = oitWeightTarget = nullptr;
+            oitResolveProgram = nullptr;
+        }
+        weightedTransparencySupported = false;
+        sortedTransparentCommands.clear();
+        occlusionCuller.destroy();
+        occluderCandidates.clear();
+        //. delete the objects of the dynamic resolution
+        if (dynamicResolutionSupported)
+        {
+            resolutionScaler.destroy();
+            dynamicResolutionSupported = false;
+        }
+        if (upscaleFrameBuffer)
+        {
+            glDeleteFramebuffers(1, &upscaleFrameBuffer);
+            upscaleFrameBuffer = 0;
+            delete upscaledColor;
+            delete upscaledDepth;
+            upscaledColor = upscaledDepth = nullptr;
         }
+        frameOccluders.clear();
+        //. delete the merged meshes of the static batches
+        for (auto &batch : staticBatches)
+            delete batch.mesh;
+        staticBatches.clear();
+        batchedRenderers.clear();
     }
 
-    void ForwardRenderer::render(World *world)
+    void ForwardRenderer::buildStaticBatches(World *world)
     {
-        // First of all, we search for a camera and for all the mesh renderers
-        CameraComponent *camera = nullptr;
-        opaqueCommands.clear();
-        transparentCommands.clear();
-        light_sources.clear();
+        //. collect the opaque static mesh renderers grouped by material
+        //. the transparent ones are not merged since they have to be sorted one by one from far to near
+        std::map<Material *, std::vector<MeshRendererComponent *>> groups;
+        for (auto entity : world->getEntities())
+        {
+            if (!entity->isStatic)
+                continue;
+            auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+            if (!meshRenderer || !meshRenderer->mesh)
+                continue;
+            //. a mesh whose submeshes use different materials would have to be split between the batches so we leave it out
+            if (!meshRenderer->hasSingleMaterial())
+                continue;
+            Material *material = meshRenderer->getMaterial(0);
+            if (!material || material->transparent)
+                continue;
+            //. only the standard vertex format can be transformed on the CPU
+            if (meshRenderer->mesh->getFormat() != VertexFormat::STANDARD)
+                continue;
+            groups[material].push_back(meshRenderer);
+        }
 
+        std::vector<Vertex> meshVertices, batchVertices;
+        std::vector<unsigned int> meshElements, batchElements;
+        for (auto &[material, meshRenderers] : groups)
+        {
+            batchVertices.clear();
+            batchElements.clear();
+            glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+            for (auto meshRenderer : meshRenderers)
+            {
+                //. transform the positions and normals of the mesh to the world space
+                glm::mat4 M = meshRenderer->getOwner()->getLocalToWorldMatrix();
+                glm::mat3 M_IT = glm::transpose(glm::inverse(glm::mat3(M)));
+                meshRenderer->mesh->download(meshVertices, meshElements);
+
+                unsigned int firstVertex = (unsigned int)batchVertices.size();
+                for (Vertex vertex : meshVertices)
+                {
+                    vertex.position = glm::vec3(M * glm::vec4(vertex.position, 1.0f));
+                    vertex.normal = glm::normalize(M_IT * vertex.normal);
+                    boundsMin = glm::min(boundsMin, vertex.position);
+                    boundsMax = glm::max(boundsMax, vertex.position);
+                    batchVertices.push_back(vertex);
+                }
+                for (unsigned int element : meshElements)
+                    batchElements.push_back(firstVertex + element);
+                batchedRenderers.insert(meshRenderer);
+            }
+            staticBatches.push_back({new Mesh(batchVertices, batchElements), material, boundsMin, boundsMax});
+        }
+    }
+
+    void ForwardRenderer::buildOccluders(World *world)
+    {
+        if (!isOcclusionCullingSupported())
+            return;
+        //. the entities that share a mesh share its copy (and a mesh that is too detailed is only reported once)
+        std::set<const Mesh *> rejected;
         for (auto entity : world->getEntities())
         {
-            // If we hadn't found a camera yet, we look for a camera in this entity
-            if (!camera)
-                camera = entity->getComponent<CameraComponent>();
+            auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+            if (!meshRenderer || !meshRenderer->occluder || !meshRenderer->mesh || rejected.count(meshRenderer->mesh))
+                continue;
+            if (!occlusionCuller.addOccluderMesh(meshRenderer->mesh, occluderTriangles))
+            {
+                rejected.insert(meshRenderer->mesh);
+                std::cerr << "ERROR: An occluder has more than " << occluderTriangles << " triangles (\"occluderTriangles\"), it won't hide other objects" << std::endl;
+            }
+        }
+    }
+
+    void ForwardRenderer::extractEntities(Entity *const *entities, size_t count, const ExtractionView &view, ExtractionChunk &chunk) const
+    {
+        chunk.opaqueCommands.clear();
+        chunk.transparentCommands.clear();
+        chunk.lights.clear();
+        chunk.hasSkyLight = false;
+        chunk.culledCommands = 0;
+        chunk.occludedCommands = 0;
+
+        for (size_t index = 0; index < count; index++)
+        {
+            Entity *entity = entities[index];
             // If this entity has a mesh renderer component
-            if (auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer)
+            if (auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer && !batchedRenderers.count(meshRenderer))
             {
                 // We construct a command from it
                 RenderCommand command;
                 command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
                 command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
                 command.mesh = meshRenderer->mesh;
-                command.material = meshRenderer->material;
-                // if it is transparent, we add it to the transparent commands list
-                if (command.material->transparent)
+                command.material = meshRenderer->getMaterial(0);
+                int submeshCount = meshRenderer->hasSingleMaterial() ? 1 : command.mesh->getSubmeshCount();
+
+                //. skip the mesh if its bounding box is completely outside the view (the entity may still have a light)
+                const glm::mat4 &M = command.localToWorld;
+                if (view.cull && !isBoxVisible(view.VP * M, command.mesh->getBoundsMin(), command.mesh->getBoundsMax()))
                 {
-                    transparentCommands.push_back(command);
+                    chunk.culledCommands += submeshCount;
+                    submeshCount = 0;
                 }
-                else
+                //. then skip it if it is hidden behind the occluders (the occluders aren't tested since they can't hide themselves
+                //. but a face of their box may be at the same depth as their rasterized face, e.g. a cube facing the camera)
+                else if (view.occlusion && !meshRenderer->occluder &&
+                         occlusionCuller.isBoxOccluded(view.VP * M, command.mesh->getBoundsMin(), command.mesh->getBoundsMax()))
                 {
-                    // Otherwise, we add it to the opaque command list
-                    opaqueCommands.push_back(command);
+                    chunk.occludedCommands += submeshCount;
+                    submeshCount = 0;
+                }
+
+                //. pick the level of detail of the mesh from its projected size (the fraction of the screen height covered by its bounding sphere)
+                if (submeshCount > 0 && command.mesh->getLodCount() >= 2)
+                {
+                    float screenSize = getProjectedSize(M, command.mesh, view.projection, view.eye, view.near, view.perspective);
+                    command.lod = meshRenderer->selectLod(screenSize);
+                }
+
+                //. if all the submeshes share the material, the whole mesh is drawn by one command
+                //. otherwise every submesh gets its own command so that it can be sorted with the other commands of its material
+                for (int submesh = 0; submesh < submeshCount; submesh++)
+                {
+                    if (submeshCount > 1)
+                    {
+                        command.submesh = submesh;
+                        command.material = meshRenderer->getMaterial(submesh);
+                    }
+                    // if it is transparent, we add it to the transparent commands list
+                    if (command.material->transparent)
+                    {
+                        chunk.transparentCommands.push_back(command);
+                    }
+                    else
+                    {
+                        // Otherwise, we add it to the opaque command list
+                        chunk.opaqueCommands.push_back(command);
+                    }
                 }
             }
 
@@ -188,21 +483,22 @@ namespace our
                 if (light->lightType == LightType::SKY)
                 {
 
-                    //. is enabled
-                    sky_light_effect.isOn = light->isOn;
+                    //. is enabled (if there are many sky lights, the last one in the order of the entities is used)
+                    chunk.hasSkyLight = true;
+                    chunk.skyLight.isOn = light->isOn;
                     if (!light->isOn)
                     {
                         //. make the sky light effect black
-                        sky_light_effect.top = glm::vec3(0, 0, 0);
-                        sky_light_effect.horizon = glm::vec3(0, 0, 0);
-                        sky_light_effect.bottom = glm::vec3(0, 0, 0);
+                        chunk.skyLight.top = glm::vec3(0, 0, 0);
+                        chunk.skyLight.horizon = glm::vec3(0, 0, 0);
+                        chunk.skyLight.bottom = glm::vec3(0, 0, 0);
                     }
                     else
                     {
                         //. we need to add the sky light effect
-                        sky_light_effect.top = light->sky_top;
-                        sky_light_effect.horizon = light->sky_middle;
-                        sky_light_effect.bottom = light->sky_bottom;
+                        chunk.skyLight.top = light->sky_top;
+                        chunk.skyLight.horizon = light->sky_middle;
+                        chunk.skyLight.bottom = light->sky_bottom;
                     }
                     continue;
                 }
@@ -239,9 +535,35 @@ namespace our
                 light_source.direction = glm::normalize(glm::vec3(light->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, -1, 0, 0)));
 
                 //. add the light source to the light sources list
-                light_sources.push_back(light_source);
+                chunk.lights.push_back(light_source);
             }
         }
+    }
+
+    void ForwardRenderer::extract(World *world, RenderSnapshot &snapshot)
+    {
+        auto extractStart = std::chrono::steady_clock::now();
+        std::vector<RenderCommand> &opaqueCommands = snapshot.opaqueCommands;
+        std::vector<RenderCommand> &transparentCommands = snapshot.transparentCommands;
+        opaqueCommands.clear();
+        transparentCommands.clear();
+        snapshot.lights.clear();
+        snapshot.skyLight = {};
+        snapshot.toggles = {effect, useIndirect, depthPrepass, overdrawView, weightedTransparency && weightedTransparencySupported,
+                            dynamicResolution && dynamicResolutionSupported};
+        snapshot.hasCamera = false;
+        snapshot.culledCommands = 0;
+        snapshot.occludedCommands = 0;
+        snapshot.occlusion = {};
+
+        // First of all, we search for a camera (the first one in the order of the entities)
+        CameraComponent *camera = nullptr;
+        extractionEntities.assign(world->getEntities().begin(), world->getEntities().end());
+        for (Entity *entity : extractionEntities)
+        {
+            if ((camera = entity->getComponent<CameraComponent>()))
+                break;
+        }
 
         // If there is no camera, we return (we cannot render without a camera)
         if (camera == nullptr)
@@ -254,25 +576,176 @@ namespace our
         //. we use the camera's local to world matrix to transform the forward vector of the camera
         glm::vec3 cameraForward = camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, -1, 0.0);
 
-        std::sort(transparentCommands.begin(), transparentCommands.end(),
-                  [cameraForward](const RenderCommand &first, const RenderCommand &second)
-                  {
-                      // TODO: (Req 9) Finish this function
-                      //  HINT: the following return should return true "first" should be drawn before "second".
-                      //. we draw the transparent objects from far to near
-                      //. the dot product between the center of the object and the camera forward vector gives
-                      //. the projection of the object on the camera forward vector,
-                      //. the bigger the dot product the farther the object
-                      return glm::dot(first.center, cameraForward) > glm::dot(second.center, cameraForward);
-                  });
-
         // TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
-        glm::mat4 VP = camera->getProjectionMatrix(windowSize) * camera->getViewMatrix();
+        glm::mat4 projection = camera->getProjectionMatrix(windowSize);
+        glm::mat4 VP = projection * camera->getViewMatrix();
+        glm::vec3 eye = camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1);
+        bool perspective = camera->cameraType == CameraType::PERSPECTIVE;
+        bool occlusion = occlusionCulling && isOcclusionCullingSupported();
+        ExtractionView view = {VP, projection, eye, camera->near, perspective, frustumCulling, occlusion};
+
+        //. rasterize the occluders with the largest projected size so the chunks can test their meshes against them
+        if (occlusion)
+        {
+            occluderCandidates.clear();
+            for (Entity *entity : extractionEntities)
+            {
+                auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+                if (!meshRenderer || !meshRenderer->occluder || !occlusionCuller.hasOccluderMesh(meshRenderer->mesh))
+                    continue;
+                glm::mat4 M = entity->getLocalToWorldMatrix();
+                glm::mat4 MVP = VP * M;
+                if (!isBoxVisible(MVP, meshRenderer->mesh->getBoundsMin(), meshRenderer->mesh->getBoundsMax()))
+                    continue;
+                float screenSize = getProjectedSize(M, meshRenderer->mesh, projection, eye, camera->near, perspective);
+                occluderCandidates.push_back({screenSize, {meshRenderer->mesh, MVP}});
+            }
+            size_t occluderCount = std::min(occluderCandidates.size(), maxOccluders);
+            std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + occluderCount, occluderCandidates.end(),
+                              [](const auto &first, const auto &second)
+                              { return first.first > second.first; });
+            frameOccluders.clear();
+            for (size_t index = 0; index < occluderCount; index++)
+                frameOccluders.push_back(occluderCandidates[index].second);
+            occlusionCuller.render(frameOccluders, extractionWorkers.get());
+            snapshot.occlusion = occlusionCuller.statistics;
+        }
+
+        //. then we search for the mesh renderers and the lights: the entities are split into chunks that are extracted in parallel
+        //. every chunk has its own lists so the threads never share anything, then the lists are appended in the order of the chunks
+        //. (so the commands and the lights are in the same order as if a single thread extracted them)
+        size_t entityCount = extractionEntities.size();
+        size_t chunkCount = 1;
+        if (extractionWorkers)
+            chunkCount = std::clamp<size_t>(entityCount / minEntitiesPerChunk, 1, extractionWorkers->getThreadCount() * chunksPerThread);
+        size_t chunkSize = (entityCount + chunkCount - 1) / chunkCount;
+        if (extractionChunks.size() < chunkCount)
+            extractionChunks.resize(chunkCount);
+        auto extractChunk = [&](size_t chunk)
+        {
+            size_t first = std::min(chunk * chunkSize, entityCount), last = std::min(first + chunkSize, entityCount);
+            extractEntities(extractionEntities.data() + first, last - first, view, extractionChunks[chunk]);
+        };
+        if (chunkCount > 1)
+            extractionWorkers->run(chunkCount, extractChunk);
+        else
+            extractChunk(0);
+
+        size_t opaqueCount = 0, transparentCount = 0, lightCount = 0;
+        for (size_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            opaqueCount += extractionChunks[chunk].opaqueCommands.size();
+            transparentCount += extractionChunks[chunk].transparentCommands.size();
+            lightCount += extractionChunks[chunk].lights.size();
+        }
+        opaqueCommands.reserve(opaqueCount + staticBatches.size());
+        transparentCommands.reserve(transparentCount);
+        snapshot.lights.reserve(lightCount);
+        for (size_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            ExtractionChunk &extracted = extractionChunks[chunk];
+            opaqueCommands.insert(opaqueCommands.end(), extracted.opaqueCommands.begin(), extracted.opaqueCommands.end());
+            transparentCommands.insert(transparentCommands.end(), extracted.transparentCommands.begin(), extracted.transparentCommands.end());
+            snapshot.lights.insert(snapshot.lights.end(), extracted.lights.begin(), extracted.lights.end());
+            if (extracted.hasSkyLight)
+                snapshot.skyLight = extracted.skyLight;
+            snapshot.culledCommands += extracted.culledCommands;
+            snapshot.occludedCommands += extracted.occludedCommands;
+        }
+
+        //. the weighted transparency doesn't depend on the order of the transparent objects so they aren't sorted
+        if (!snapshot.toggles.weightedTransparency)
+        {
+            std::sort(transparentCommands.begin(), transparentCommands.end(),
+                      [cameraForward](const RenderCommand &first, const RenderCommand &second)
+                      {
+                          // TODO: (Req 9) Finish this function
+                          //  HINT: the following return should return true "first" should be drawn before "second".
+                          //. we draw the transparent objects from far to near
+                          //. the dot product between the center of the object and the camera forward vector gives
+                          //. the projection of the object on the camera forward vector,
+                          //. the bigger the dot product the farther the object
+                          return glm::dot(first.center, cameraForward) > glm::dot(second.center, cameraForward);
+                      });
+        }
+
+        //. the static batches are already in the world space so they are drawn with an identity model matrix
+        //. they are large so we skip the ones that are completely outside the view
+        for (auto &batch : staticBatches)
+        {
+            if (!isBoxVisible(VP, batch.boundsMin, batch.boundsMax))
+            {
+                snapshot.culledCommands++;
+                continue;
+            }
+            RenderCommand command;
+            command.localToWorld = glm::mat4(1.0f);
+            command.center = (batch.boundsMin + batch.boundsMax) * 0.5f;
+            command.mesh = batch.mesh;
+            command.material = batch.material;
+            opaqueCommands.push_back(command);
+        }
+
+        snapshot.hasCamera = true;
+        snapshot.view = camera->getViewMatrix();
+        snapshot.projection = projection;
+        //. the camera position is needed by the lit materials to compute the specular light
+        snapshot.cameraPosition = eye;
+        snapshot.cameraForward = cameraForward;
+        snapshot.near = camera->near;
+        snapshot.far = camera->far;
+        snapshot.perspective = view.perspective;
+        snapshot.extractTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - extractStart).count();
+    }
+
+    void ForwardRenderer::submit(RenderSnapshot &snapshot)
+    {
+        statistics = RendererStatistics();
+        statistics.culledObjects = snapshot.culledCommands;
+        statistics.extractTime = snapshot.extractTime;
+        statistics.occludedObjects = snapshot.occludedCommands;
+        statistics.occluders = snapshot.occlusion.occluders;
+        statistics.occluderTriangles = snapshot.occlusion.triangles;
+        statistics.occlusionTime = snapshot.occlusion.rasterTime;
+        sampleQueryIssued = false;
+
+        // If there is no camera, we return (we cannot render without a camera)
+        if (!snapshot.hasCamera)
+            return;
+
+        //. the snapshot is drawn using the per-frame members, its vectors are swapped back at the end so it keeps their memory
+        opaqueCommands.swap(snapshot.opaqueCommands);
+        transparentCommands.swap(snapshot.transparentCommands);
+        light_sources.swap(snapshot.lights);
+        sky_light_effect = snapshot.skyLight;
+        toggles = snapshot.toggles;
+        glm::mat4 VP = snapshot.projection * snapshot.view;
+        glm::vec3 cameraPosition = snapshot.cameraPosition;
+        glm::vec3 cameraForward = snapshot.cameraForward;
+
+        //. with the dynamic resolution, the GPU time of the frame is measured and the scene is drawn to a part of the scene targets
+        renderSize = windowSize;
+        if (toggles.dynamicResolution)
+        {
+            resolutionScaler.beginFrame();
+            renderSize = resolutionScaler.getRenderSize(windowSize);
+            statistics.renderScale = resolutionScaler.getScale();
+            statistics.frameGpuTime = resolutionScaler.getGpuTime();
+        }
+
         // TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
         glm::ivec2 viewportStart = glm::ivec2(0, 0);
-        glm::ivec2 viewportSize = windowSize;
+        glm::ivec2 viewportSize = renderSize;
         glViewport(viewportStart.x, viewportStart.y, viewportSize.x, viewportSize.y);
 
+        //. assign the lights to the clusters of this view once for the whole frame
+        if (clusteredLighting)
+        {
+            lightClusters.update(light_sources, snapshot.view, snapshot.projection, snapshot.near, snapshot.far,
+                                 snapshot.perspective, viewportSize);
+            statistics.lights = lightClusters.statistics;
+        }
+
         // TODO: (Req 9) Set the clear color to black and the clear depth to 1
         glClearColor(0, 0, 0, 1);
         glClearDepth(1.0);
@@ -281,10 +754,13 @@ namespace our
         glColorMask(true, true, true, true);
         glDepthMask(true);
 
-        // If there is a postprocess material, bind the framebuffer so that we can render to it
-        if (postprocessMaterial && effect)
+        // If there is a postprocess chain, bind the framebuffer so that we can render to it
+        //. (the weighted transparency needs it too since its targets share the depth of the scene, and so does the dynamic resolution)
+        sceneFramebuffer = 0;
+        if ((postprocessChain && toggles.effect) || toggles.weightedTransparency || toggles.dynamicResolution)
         {
             // TODO: (Req 11) bind the framebuffer
+            sceneFramebuffer = postprocessFrameBuffer;
             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postprocessFrameBuffer);
         }
 
@@ -293,51 +769,7 @@ namespace our
 
         // TODO: (Req 9) Draw all the opaque commands
         //  Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        for (auto command : opaqueCommands)
-        {
-            command.material->setup();
-
-            //. if the material is lighted material
-            if (auto lightedMaterial = dynamic_cast<LitMaterial *>(command.material); lightedMaterial)
-            {
-                //. send the camera position to the shader
-                command.material->shader->set("camera_position", glm::vec3(camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1)));
-                //. send the VP matrix to the shader
-                command.material->shader->set("VP", VP);
-                //. send the model matrix to the shader
-                command.material->shader->set("M", command.localToWorld);
-                //. send the inverse transpose of the model matrix to the shader
-                command.material->shader->set("M_IT", glm::transpose(glm::inverse(command.localToWorld)));
-                //. send the light sources count to the shader
-                size_t light_sources_count = light_sources.size();
-
-                //. send the sky light effect to the shader
-                command.material->shader->set("sky.top", sky_light_effect.top);
-                command.material->shader->set("sky.horizon", sky_light_effect.horizon);
-                command.material->shader->set("sky.bottom", sky_light_effect.bottom);
-
-                //. single pass forward lighting approach
-                //. send the light sources count to the shader
-                command.material->shader->set("light_count", (int)light_sources_count);
-                //. send the light sources to the shader
-                for (size_t i = 0; i < light_sources_count; i++)
-                {
-                    std::string light_sources_prefix = "lights[" + std::to_string(i) + "].";
-                    command.material->shader->set(light_sources_prefix + "type", light_sources[i].type);
-                    command.material->shader->set(light_sources_prefix + "position", light_sources[i].position);
-                    command.material->shader->set(light_sources_prefix + "direction", light_sources[i].direction);
-                    command.material->shader->set(light_sources_prefix + "color", light_sources[i].color);
-                    command.material->shader->set(light_sources_prefix + "attenuation", light_sources[i].attenuation);
-                    command.material->shader->set(light_sources_prefix + "cone_angles", light_sources[i].cone_angles);
-                }
-            }
-            else
-            {
-                //. if the material is not lighted material
-                command.material->shader->set("transform", VP * command.localToWorld);
-            }
-            command.mesh->draw();
-        }
+        renderOpaquePass(cameraPosition, VP);
 
         // If there is a sky material, draw the sky
         if (this->skyMaterial)
@@ -346,10 +778,7 @@ namespace our
             skyMaterial->setup(); // first we will setup the material
 
             // TODO: (Req 10) Get the camera position  // TO ASK
-            /// why does the camera position is the origin?
-            /// because the camera is at the origin of the world
-            glm::vec3 cameraPosition =
-                camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1); // the camera eye is @ origin
+            /// the camera position was extracted with the snapshot (see "cameraPosition" above)
 
             // TODO: (Req 10) Create a model matrix for the sky such that it always follows the camera (sky sphere center = camera position)
             /// then we will create a model matrix
@@ -379,8 +808,8 @@ namespace our
                 0.0f, 0.0f, 1.0f, 1.0f);
 
             // TODO: (Req 10) set the "transform" uniform
-            skyMaterial->shader->set("transform", alwaysBehindTransform * camera->getProjectionMatrix(windowSize) *
-                                                      camera->getViewMatrix() * skyModelMat);
+            skyMaterial->shader->set("transform", alwaysBehindTransform * snapshot.projection *
+                                                      snapshot.view * skyModelMat);
             // model --> matrix for the sky as it transform from local space to world space
             // view --> matrix for the camera as it transform from world space to camera space
             // projection --> matrix for the camera as it transform from camera space to NDC space (canonical view volume) is this right?
@@ -391,66 +820,622 @@ namespace our
         }
         // TODO: (Req 9) Draw all the transparent commands
         //  Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        for (auto command : transparentCommands)
+        if (toggles.weightedTransparency)
+        {
+            drawTransparentCommandsWeighted(cameraPosition, cameraForward, VP);
+        }
+        else
         {
-            command.material->setup();
+            for (auto &command : transparentCommands)
+            {
+                drawCommand(command, cameraPosition, VP);
+            }
+        }
 
-            //. if the material is lighted material
-            if (auto lightedMaterial = dynamic_cast<LitMaterial *>(command.material); lightedMaterial)
+        //. If there is a postprocess chain, apply its passes to the scene, the last one draws to the screen
+        if (postprocessChain && toggles.effect)
+        {
+            //. a scene drawn at a lower resolution is stretched to the upscale targets first
+            Texture2D *sceneColor = colorTarget, *sceneDepth = depthTarget;
+            if (renderSize != windowSize)
             {
-                //. send the camera position to the shader
-                command.material->shader->set("camera_position", glm::vec3(camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1)));
-                //. send the VP matrix to the shader
-                command.material->shader->set("VP", VP);
-                //. send the model matrix to the shader
-                command.material->shader->set("M", command.localToWorld);
-                //. send the inverse transpose of the model matrix to the shader
-                command.material->shader->set("M_IT", glm::transpose(glm::inverse(command.localToWorld)));
-                //. send the light sources count to the shader
-                size_t light_sources_count = light_sources.size();
-
-                //. send the sky light effect to the shader
-                command.material->shader->set("sky.top", sky_light_effect.top);
-                command.material->shader->set("sky.horizon", sky_light_effect.horizon);
-                command.material->shader->set("sky.bottom", sky_light_effect.bottom);
-
-                //. single pass forward lighting approach
-                //. send the light sources count to the shader
-                command.material->shader->set("light_count", (int)light_sources_count);
-                //. send the light sources to the shader
-                for (size_t i = 0; i < light_sources_count; i++)
-                {
-                    std::string light_sources_prefix = "lights[" + std::to_string(i) + "].";
-                    command.material->shader->set(light_sources_prefix + "type", light_sources[i].type);
-                    command.material->shader->set(light_sources_prefix + "position", light_sources[i].position);
-                    command.material->shader->set(light_sources_prefix + "direction", light_sources[i].direction);
-                    command.material->shader->set(light_sources_prefix + "color", light_sources[i].color);
-                    command.material->shader->set(light_sources_prefix + "attenuation", light_sources[i].attenuation);
-                    command.material->shader->set(light_sources_prefix + "cone_angles", light_sources[i].cone_angles);
-                }
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, postprocessFrameBuffer);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, upscaleFrameBuffer);
+                glBlitFramebuffer(0, 0, renderSize.x, renderSize.y, 0, 0, windowSize.x, windowSize.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                //. the depth can't be filtered
+                glBlitFramebuffer(0, 0, renderSize.x, renderSize.y, 0, 0, windowSize.x, windowSize.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+                sceneColor = upscaledColor;
+                sceneDepth = upscaledDepth;
+            }
+
+            // TODO: (Req 11) Return to the default framebuffer
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+            postprocessChain->render(sceneColor, sceneDepth, 0, windowSize);
+            statistics.postprocessPasses = (int)postprocessChain->getPassCount();
+            statistics.postprocessTargets = (int)postprocessChain->getTargetCount();
+            statistics.postprocessGpuTime = postprocessChain->getGpuTime();
+            for (size_t index = 0; index < postprocessChain->getPassCount(); index++)
+                statistics.postprocessPassTimes.push_back({postprocessChain->getPassName(index), postprocessChain->getPassTime(index)});
+            //. the chain bound a VAO that doesn't belong to the mesh arena so the arena must rebind its VAO in the next draw
+            MeshArena::invalidateBinding();
+        }
+        else if (sceneFramebuffer != 0)
+        {
+            //. the scene was drawn offscreen for the weighted transparency or the dynamic resolution so it is copied
+            //. to the screen as is, or stretched (with bilinear filtering) if it was drawn at a lower resolution
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, renderSize.x, renderSize.y, 0, 0, windowSize.x, windowSize.y, GL_COLOR_BUFFER_BIT,
+                              renderSize != windowSize ? GL_LINEAR : GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, windowSize.x, windowSize.y);
+        }
+        if (toggles.dynamicResolution)
+            resolutionScaler.endFrame();
+
+        opaqueCommands.swap(snapshot.opaqueCommands);
+        transparentCommands.swap(snapshot.transparentCommands);
+        light_sources.swap(snapshot.lights);
+
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        publishedStatistics = statistics;
+    }
+
+    std::function<void()> ForwardRenderer::extractFrame(World *world)
+    {
+        std::shared_ptr<RenderSnapshot> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            if (!freeSnapshots.empty())
+            {
+                snapshot = std::move(freeSnapshots.back());
+                freeSnapshots.pop_back();
+            }
+        }
+        if (!snapshot)
+            snapshot = std::make_shared<RenderSnapshot>();
+        extract(world, *snapshot);
+        return [this, snapshot]()
+        {
+            submit(*snapshot);
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            freeSnapshots.push_back(snapshot);
+        };
+    }
+
+    void ForwardRenderer::render(World *world)
+    {
+        extractFrame(world)();
+    }
+
+    RendererStatistics ForwardRenderer::getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        return publishedStatistics;
+    }
+
+    void ForwardRenderer::renderOpaquePass(const glm::vec3 &cameraPosition, const glm::mat4 &VP)
+    {
+        //. sort the opaque commands by material state key, then by vertex format, then by material, then by mesh
+        //. (then its level of detail and submesh) so that the commands sharing the same state (and the same mesh) are adjacent
+        //. the materials sharing a state key (e.g. lit materials sharing texture arrays) are interleaved inside a format
+        //. so they end up in the same multi-draw bucket
+        //. the order of opaque objects doesn't matter (the depth test handles it) so we are free to reorder them
+        std::sort(opaqueCommands.begin(), opaqueCommands.end(),
+                  [](const RenderCommand &first, const RenderCommand &second)
+                  {
+                      const void *firstKey = first.material->getStateKey(), *secondKey = second.material->getStateKey();
+                      if (firstKey != secondKey)
+                          return std::less<const void *>()(firstKey, secondKey);
+                      if (first.mesh->getFormat() != second.mesh->getFormat())
+                          return first.mesh->getFormat() < second.mesh->getFormat();
+                      if (first.mesh->getElementType() != second.mesh->getElementType())
+                          return first.mesh->getElementType() < second.mesh->getElementType();
+                      if (first.material != second.material)
+                          return std::less<Material *>()(first.material, second.material);
+                      if (first.mesh != second.mesh)
+                          return std::less<Mesh *>()(first.mesh, second.mesh);
+                      if (first.lod != second.lod)
+                          return first.lod < second.lod;
+                      return first.submesh < second.submesh;
+                  });
+
+        //. we measure the CPU time spent submitting the opaque pass so that the two paths can be compared
+        auto opaqueStart = std::chrono::steady_clock::now();
+        //. the indirect commands are built and uploaded once, then both the depth pre-pass and the shading pass draw them
+        if (indirectSupported && toggles.useIndirect)
+            buildIndirectCommands();
+        //. the depth pre-pass fills the depth buffer so the shading pass only shades the nearest fragment of every pixel
+        if (toggles.depthPrepass)
+        {
+            opaquePass = OpaquePass::DEPTH_PREPASS;
+            submitOpaqueCommands(cameraPosition, VP);
+        }
+
+        //. count the samples that pass the depth test in the shading pass (only once per frame)
+        //. first, read the query we are about to reuse, if it isn't done yet, we skip counting in this frame instead of waiting
+        bool countSamples = !sampleQueryIssued;
+        int queryIndex = sampleQueryIndex;
+        if (countSamples && sampleQueryPending[queryIndex])
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(sampleQueries[queryIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint samples = 0;
+                glGetQueryObjectuiv(sampleQueries[queryIndex], GL_QUERY_RESULT, &samples);
+                statistics.shadedSamples = samples;
+                sampleQueryPending[queryIndex] = false;
             }
             else
             {
-                //. if the material is not lighted material
-                command.material->shader->set("transform", VP * command.localToWorld);
+                countSamples = false;
             }
-            command.mesh->draw();
         }
+        if (countSamples)
+            glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[queryIndex]);
+        sampleQueryIssued = true;
+
+        opaquePass = OpaquePass::SHADING;
+        submitOpaqueCommands(cameraPosition, VP);
+        opaquePass = OpaquePass::NONE;
 
-        //. If there is a postprocess material, apply postprocessing then draw the fullscreen triangle to the screen
-        //. note that we might want to change this behavior later
-        if (postprocessMaterial && effect)
+        if (countSamples)
         {
-            // TODO: (Req 11) Return to the default framebuffer
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glEndQuery(GL_SAMPLES_PASSED);
+            sampleQueryPending[queryIndex] = true;
+            sampleQueryIndex = 1 - queryIndex;
+        }
+        statistics.opaqueSubmitTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - opaqueStart).count();
+    }
+
+    void ForwardRenderer::submitOpaqueCommands(const glm::vec3 &cameraPosition, const glm::mat4 &VP)
+    {
+        if (indirectSupported && toggles.useIndirect)
+            drawOpaqueCommandsIndirect(cameraPosition, VP);
+        else
+            drawOpaqueCommands(0, opaqueCommands.size(), cameraPosition, VP);
+    }
 
-            // TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
-            // we use the texture we rendered to as the input texture in a TexturedMaterial
-            // we setup the material to apply the postprocess effect
-            postprocessMaterial->setup();
-            glBindVertexArray(postProcessVertexArray);
+    ShaderProgram *ForwardRenderer::getProgramVariant(ShaderProgram *program, ProgramVariant variant)
+    {
+        auto key = std::make_pair(program, variant);
+        if (auto it = programVariants.find(key); it != programVariants.end())
+            return it->second;
 
+        ShaderProgram *created = nullptr;
+        switch (variant)
+        {
+        case ProgramVariant::DEPTH_ONLY:
+            created = program->createVariant({}, "assets/shaders/depth-only.frag");
+            break;
+        case ProgramVariant::OVERDRAW:
+            created = program->createVariant({}, "assets/shaders/overdraw.frag");
+            break;
+        case ProgramVariant::GBUFFER:
+            //. the variant is compiled from the same files with the same defines (e.g. TEXTURE_ARRAYS) so it takes the same uniforms
+            created = program->createVariant({"GBUFFER"});
+            break;
+        case ProgramVariant::WEIGHTED_OIT:
+            //. only the shaders that write "oit_weight" when compiled with WEIGHTED_OIT can be accumulated (see "tinted.frag")
+            //. the others map to their original program and are sorted and blended after the resolve (it isn't an error)
+            created = program->createVariant({"WEIGHTED_OIT", OIT_WEIGHT_DEFINE});
+            if (created && glGetFragDataLocation(created->getOpenGLName(), "oit_weight") < 0)
+            {
+                delete created;
+                programVariants[key] = program;
+                return program;
+            }
+            break;
+        }
+        if (created == nullptr)
+        {
+            std::cerr << "ERROR: Couldn't compile a variant of a material's shader, the original shader will be used instead" << std::endl;
+            created = program;
+        }
+        programVariants[key] = created;
+        return created;
+    }
+
+    ShaderProgram *ForwardRenderer::selectProgram(const Material *material, ShaderProgram *program)
+    {
+        if (program && weightedPass)
+            return getProgramVariant(program, ProgramVariant::WEIGHTED_OIT);
+        if (program == nullptr || opaquePass == OpaquePass::NONE)
+            return program;
+        //. the overdraw view shades every opaque object with the overdraw shader
+        //. (the materials that discard fragments won't discard them in this view so they may look a bit bigger)
+        if (opaquePass == OpaquePass::SHADING && toggles.overdrawView)
+            return getProgramVariant(program, ProgramVariant::OVERDRAW);
+        //. the lit shaders never discard fragments so the pre-pass only needs their depth
+        //. the other materials keep their programs since they may discard fragments (e.g. alpha testing)
+        if (opaquePass == OpaquePass::DEPTH_PREPASS && dynamic_cast<const LitMaterial *>(material))
+            return getProgramVariant(program, ProgramVariant::DEPTH_ONLY);
+        return program;
+    }
+
+    void ForwardRenderer::setupMaterial(const Material *material, ShaderProgram *program)
+    {
+        material->setup(program);
+        statistics.materialSetups++;
+
+        //. in the pre-pass, the colors are masked so only the depth is written
+        //. then the shading pass only draws the fragments whose depth is equal to the depth in the depth buffer
+        //. (no depth is written since it is already there) and the overdraw view adds the colors of all the shaded fragments
+        bool maskColor = opaquePass == OpaquePass::DEPTH_PREPASS;
+        bool equalDepth = opaquePass == OpaquePass::SHADING && toggles.depthPrepass && material->pipelineState.depthTesting.enabled;
+        bool additive = opaquePass == OpaquePass::SHADING && toggles.overdrawView;
+        if (!maskColor && !equalDepth && !additive && !weightedPass)
+            return;
+        PipelineState state = material->pipelineState;
+        if (maskColor)
+            state.colorMask = glm::bvec4(false);
+        if (equalDepth)
+        {
+            state.depthTesting.function = GL_EQUAL;
+            state.depthMask = false;
+        }
+        if (additive)
+        {
+            state.blending.enabled = true;
+            state.blending.equation = GL_FUNC_ADD;
+            state.blending.sourceFactor = GL_ONE;
+            state.blending.destinationFactor = GL_ONE;
+        }
+        if (weightedPass)
+        {
+            //. the accumulated objects are depth tested against the opaque ones but they don't hide each other
+            state.blending.enabled = true;
+            state.blending.equation = GL_FUNC_ADD;
+            state.depthMask = false;
+        }
+        state.setup();
+        //. the pipeline state has one blend function for the color and the alpha but the accumulation needs two:
+        //. the premultiplied colors and the weights are added while the alpha keeps the product of (1 - alpha) (the revealage)
+        if (weightedPass)
+            glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    void ForwardRenderer::drawTransparentCommandsWeighted(const glm::vec3 &cameraPosition, const glm::vec3 &cameraForward, const glm::mat4 &VP)
+    {
+        //. the accumulation starts at 0 and the revealage at 1 (nothing covers the scene yet)
+        const GLfloat accumulationClear[] = {0.0f, 0.0f, 0.0f, 1.0f}, weightClear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oitFrameBuffer);
+        glColorMask(true, true, true, true);
+        glClearBufferfv(GL_COLOR, 0, accumulationClear);
+        glClearBufferfv(GL_COLOR, 1, weightClear);
+
+        sortedTransparentCommands.clear();
+        bool accumulated = false;
+        weightedPass = true;
+        for (auto &command : transparentCommands)
+        {
+            //. the commands whose shaders have no WEIGHTED_OIT output are kept for the sorted pass
+            if (getProgramVariant(command.material->shader, ProgramVariant::WEIGHTED_OIT) == command.material->shader)
+            {
+                sortedTransparentCommands.push_back(command);
+                continue;
+            }
+            drawCommand(command, cameraPosition, VP);
+            accumulated = true;
+        }
+        weightedPass = false;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebuffer);
+
+        //. the resolve pass blends the average color of the accumulated objects over the scene
+        if (accumulated)
+        {
+            oitResolvePipelineState.setup();
+            oitResolveProgram->use();
+            //. the texels are fetched one by one so the samplers left on these units by the materials are unbound
+            glActiveTexture(GL_TEXTURE0);
+            oitAccumulationTarget->bind();
+            glBindSampler(0, 0);
+            glActiveTexture(GL_TEXTURE1);
+            oitWeightTarget->bind();
+            glBindSampler(1, 0);
+            oitResolveProgram->set("accumulation", 0);
+            oitResolveProgram->set("weight", 1);
+            glBindVertexArray(oitVertexArray);
+            //. we bound a VAO that doesn't belong to the mesh arena so the arena must rebind its VAO in the next draw
+            MeshArena::invalidateBinding();
             glDrawArrays(GL_TRIANGLES, 0, 3);
         }
+
+        //. the rest are drawn from far to near over the resolved objects using the same view depth as the sorted transparency
+        //. (the distance to the camera would order two objects at the same depth differently depending on how far they are from the view center)
+        std::sort(sortedTransparentCommands.begin(), sortedTransparentCommands.end(),
+                  [&cameraForward](const RenderCommand &first, const RenderCommand &second)
+                  {
+                      return glm::dot(first.center, cameraForward) > glm::dot(second.center, cameraForward);
+                  });
+        for (auto &command : sortedTransparentCommands)
+        {
+            drawCommand(command, cameraPosition, VP);
+        }
+    }
+
+    void ForwardRenderer::setLightingUniforms(ShaderProgram *program, const glm::vec3 &cameraPosition, const glm::mat4 &VP)
+    {
+        //. send the camera position to the shader
+        program->set("camera_position", cameraPosition);
+        //. send the VP matrix to the shader
+        program->set("VP", VP);
+
+        //. send the sky light effect to the shader
+        program->set("sky.top", sky_light_effect.top);
+        program->set("sky.horizon", sky_light_effect.horizon);
+        program->set("sky.bottom", sky_light_effect.bottom);
+
+        //. the shaders compiled with CLUSTERED_LIGHTING read the lights from the light clusters instead of the uniform array
+        if (clusteredLighting && program->getUniformLocation("cluster_grid") != (GLuint)-1)
+        {
+            lightClusters.setUniforms(program);
+            return;
+        }
+        //. the program may not read any light (e.g. a G-buffer shader of the deferred renderer)
+        if (program->getUniformLocation("light_count") == (GLuint)-1)
+            return;
+
+        //. single pass forward lighting approach
+        //. send the light sources count to the shader
+        size_t light_sources_count = light_sources.size();
+        program->set("light_count", (int)light_sources_count);
+        //. send the light sources to the shader
+        for (size_t i = 0; i < light_sources_count; i++)
+        {
+            std::string light_sources_prefix = "lights[" + std::to_string(i) + "].";
+            program->set(light_sources_prefix + "type", light_sources[i].type);
+            program->set(light_sources_prefix + "position", light_sources[i].position);
+            program->set(light_sources_prefix + "direction", light_sources[i].direction);
+            program->set(light_sources_prefix + "color", light_sources[i].color);
+            program->set(light_sources_prefix + "attenuation", light_sources[i].attenuation);
+            program->set(light_sources_prefix + "cone_angles", light_sources[i].cone_angles);
+        }
+    }
+
+    void ForwardRenderer::drawCommand(const RenderCommand &command, const glm::vec3 &cameraPosition, const glm::mat4 &VP, bool fullSetup)
+    {
+        ShaderProgram *program = selectProgram(command.material, command.material->shader);
+        if (fullSetup)
+        {
+            setupMaterial(command.material, program);
+        }
+        else
+        {
+            command.material->setupDrawData(program);
+        }
+
+        //. the positions of packed meshes must be mapped back to the local space before applying the model matrix
+        //. the normals are not affected by this mapping so M_IT is computed from the model matrix alone
+        glm::mat4 M = command.localToWorld * command.mesh->getPositionTransform();
+
+        //. if the material is lighted material
+        if (auto lightedMaterial = dynamic_cast<LitMaterial *>(command.material); lightedMaterial)
+        {
+            //. the uniforms stay in the program so they are only sent after a full setup
+            if (fullSetup)
+                setLightingUniforms(program, cameraPosition, VP);
+            //. send the model matrix to the shader
+            program->set("M", M);
+            //. send the inverse transpose of the model matrix to the shader
+            program->set("M_IT", glm::transpose(glm::inverse(command.localToWorld)));
+        }
+        else
+        {
+            //. if the material is not lighted material
+            program->set("transform", VP * M);
+        }
+        command.mesh->draw(command.lod, command.submesh);
+        //. the depth pre-pass draws the same commands again, so only the shading pass is counted
+        if (opaquePass != OpaquePass::DEPTH_PREPASS)
+        {
+            statistics.drawCalls++;
+            statistics.triangles += command.mesh->getElementCount(command.lod, command.submesh) / 3;
+        }
+    }
+
+    void ForwardRenderer::drawInstancedCommands(const RenderCommand *commands, size_t count, const glm::vec3 &cameraPosition, const glm::mat4 &VP)
+    {
+        //. collect the model matrices of the whole group
+        instances.clear();
+        const glm::mat4 &positionTransform = commands[0].mesh->getPositionTransform();
+        for (size_t index = 0; index < count; index++)
+        {
+            const glm::mat4 &M = commands[index].localToWorld;
+            instances.push_back({M * positionTransform, glm::transpose(glm::inverse(M))});
+        }
+
+        //. stream the instance data to the instance buffer
+        //. we orphan the old storage first (glBufferData with nullptr) so that the driver doesn't wait for the previous draw that reads it
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
+
+        //. the uniforms are shared by all the instances so they are sent once for the whole group
+        Material *material = commands[0].material;
+        ShaderProgram *program = selectProgram(material, material->instancedShader);
+        setupMaterial(material, program);
+        if (auto lightedMaterial = dynamic_cast<LitMaterial *>(material); lightedMaterial)
+            setLightingUniforms(program, cameraPosition, VP);
+        else
+            program->set("VP", VP);
+
+        commands[0].mesh->drawInstanced(instanceBuffer, (GLsizei)count, commands[0].lod, commands[0].submesh);
+        if (opaquePass != OpaquePass::DEPTH_PREPASS)
+        {
+            statistics.drawCalls++;
+            statistics.triangles += (long long)count * (commands[0].mesh->getElementCount(commands[0].lod, commands[0].submesh) / 3);
+        }
+    }
+
+    void ForwardRenderer::drawOpaqueCommands(size_t first, size_t last, const glm::vec3 &cameraPosition, const glm::mat4 &VP)
+    {
+        //. the state key of the last single draw (nullptr if the last draw was instanced since it used another program)
+        //. a single draw with the same key doesn't need a full material setup
+        const void *lastStateKey = nullptr;
+        for (size_t start = first, end; start < last; start = end)
+        {
+            //. find the end of the group of commands sharing the same mesh (and level of detail and submesh) and material
+            end = start + 1;
+            while (end < last &&
+                   opaqueCommands[end].material == opaqueCommands[start].material &&
+                   opaqueCommands[end].mesh == opaqueCommands[start].mesh &&
+                   opaqueCommands[end].lod == opaqueCommands[start].lod &&
+                   opaqueCommands[end].submesh == opaqueCommands[start].submesh)
+                end++;
+
+            //. if the material has an instanced shader, the whole group is drawn in one draw call
+            //. otherwise (or if the group has only one command), we draw the commands one by one
+            if (opaqueCommands[start].material->instancedShader && end - start > 1)
+            {
+                drawInstancedCommands(&opaqueCommands[start], end - start, cameraPosition, VP);
+                lastStateKey = nullptr;
+            }
+            else
+            {
+                for (size_t index = start; index < end; index++)
+                {
+                    const void *stateKey = opaqueCommands[index].material->getStateKey();
+                    drawCommand(opaqueCommands[index], cameraPosition, VP, stateKey != lastStateKey);
+                    lastStateKey = stateKey;
+                }
+            }
+        }
+    }
+
+    void ForwardRenderer::buildIndirectCommands()
+    {
+        indirectBuckets.clear();
+        indirectCommands.clear();
+        drawData.clear();
+        drawLayers.clear();
+
+        //. build the indirect commands and the draw data of all the buckets
+        //. (the opaque commands are already sorted by state key, then format, then material, then mesh)
+        for (size_t start = 0, end; start < opaqueCommands.size(); start = end)
+        {
+            Material *material = opaqueCommands[start].material;
+            const void *stateKey = material->getStateKey();
+            const Mesh *first = opaqueCommands[start].mesh;
+            end = start + 1;
+            while (end < opaqueCommands.size() &&
+                   opaqueCommands[end].material->getStateKey() == stateKey &&
+                   opaqueCommands[end].mesh->getFormat() == first->getFormat() &&
+                   opaqueCommands[end].mesh->getElementType() == first->getElementType() &&
+                   (first->getFormat() != VertexFormat::PACKED_NO_COLOR ||
+                    opaqueCommands[end].mesh->getConstantColor() == first->getConstantColor()))
+                end++;
+
+            IndirectBucket bucket{start, end, indirectCommands.size(), 0};
+            //. materials without an indirect shader are drawn later by the draw loop so they don't need any data
+            if (material->indirectShader)
+            {
+                const LitMaterial *litMaterial = nullptr;
+                for (size_t index = start; index < end; index++)
+                {
+                    const RenderCommand &command = opaqueCommands[index];
+                    //. consecutive commands using the same mesh (and level of detail and submesh) become instances of a single indirect command
+                    //. (the commands of a material are adjacent so the cast is only needed when the material changes)
+                    if (index == start || opaqueCommands[index - 1].material != command.material)
+                        litMaterial = dynamic_cast<const LitMaterial *>(command.material);
+                    if (index > start && opaqueCommands[index - 1].mesh == command.mesh && opaqueCommands[index - 1].lod == command.lod &&
+                        opaqueCommands[index - 1].submesh == command.submesh)
+                    {
+                        indirectCommands.back().instanceCount++;
+                    }
+                    else
+                    {
+                        DrawElementsIndirectCommand indirect;
+                        indirect.count = (GLuint)command.mesh->getElementCount(command.lod, command.submesh);
+                        indirect.instanceCount = 1;
+                        indirect.firstIndex = (GLuint)(command.mesh->getElementOffset(command.lod, command.submesh) / command.mesh->getElementSize());
+                        indirect.baseVertex = command.mesh->getBaseVertex();
+                        indirect.baseInstance = (GLuint)drawData.size();
+                        indirectCommands.push_back(indirect);
+                        bucket.indirectCount++;
+                    }
+                    //. since the instances of a command are consecutive, the draw data is stored in the same order
+                    const glm::mat4 &M = command.localToWorld;
+                    drawData.push_back({M * command.mesh->getPositionTransform(), glm::transpose(glm::inverse(M))});
+                    DrawLayers layers = {};
+                    if (litMaterial)
+                        std::copy(std::begin(litMaterial->layers), std::end(litMaterial->layers), layers.layers);
+                    drawLayers.push_back(layers);
+                    statistics.triangles += command.mesh->getElementCount(command.lod, command.submesh) / 3;
+                }
+            }
+            indirectBuckets.push_back(bucket);
+        }
+
+        //. upload the data of all the buckets once (orphaning the old storage so we don't wait for the previous frame)
+        if (!indirectCommands.empty())
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCommands.size() * sizeof(DrawElementsIndirectCommand), indirectCommands.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(InstanceData), drawData.data(), GL_STREAM_DRAW);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawDataBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawLayersBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, drawLayers.size() * sizeof(DrawLayers), drawLayers.data(), GL_STREAM_DRAW);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, drawLayersBuffer);
+
+            //. the draw ids never change so the buffer is only refilled when it needs to grow
+            if ((GLsizei)drawData.size() > drawIdCapacity)
+            {
+                drawIdCapacity = std::max<GLsizei>(1024, drawIdCapacity);
+                while (drawIdCapacity < (GLsizei)drawData.size())
+                    drawIdCapacity *= 2;
+                std::vector<GLuint> ids(drawIdCapacity);
+                for (GLsizei id = 0; id < drawIdCapacity; id++)
+                    ids[id] = (GLuint)id;
+                glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+                glBufferData(GL_ARRAY_BUFFER, drawIdCapacity * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+            }
+        }
+
+    }
+
+    void ForwardRenderer::drawOpaqueCommandsIndirect(const glm::vec3 &cameraPosition, const glm::mat4 &VP)
+    {
+        //. submit every bucket built by "buildIndirectCommands" using a single multi-draw (or fall back to the draw loop)
+        MeshArena &arena = MeshArena::get();
+        for (const IndirectBucket &bucket : indirectBuckets)
+        {
+            Material *material = opaqueCommands[bucket.start].material;
+            ShaderProgram *program = selectProgram(material, material->indirectShader);
+            if (!program)
+            {
+                drawOpaqueCommands(bucket.start, bucket.end, cameraPosition, VP);
+                continue;
+            }
+
+            //. every material of the bucket has the same state so the first one sets it up for the whole bucket
+            setupMaterial(material, program);
+            if (auto lightedMaterial = dynamic_cast<LitMaterial *>(material); lightedMaterial)
+                setLightingUniforms(program, cameraPosition, VP);
+            else
+                program->set("VP", VP);
+
+            const Mesh *mesh = opaqueCommands[bucket.start].mesh;
+            VertexFormat format = mesh->getFormat();
+            arena.bind(format);
+            arena.attachDrawIdBuffer(format, drawIdBuffer);
+            //. the instanced draws leave the model matrix attributes enabled, but the indirect shaders read the matrices from the draw data
+            //. and the base instances index the draw data, so these attributes would read past the end of the instance buffer
+            //. (the next instanced draw of this format enables them again)
+            arena.detachInstanceBuffer(format);
+            mesh->applyConstantColor();
+            //. the indirect buffer binding is not part of the VAO state, but we rebind it since the fallback may not preserve it
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, mesh->getElementType(),
+                                        (void *)(bucket.firstIndirect * sizeof(DrawElementsIndirectCommand)),
+                                        (GLsizei)bucket.indirectCount, 0);
+            arena.detachDrawIdBuffer(format);
+            if (opaquePass != OpaquePass::DEPTH_PREPASS)
+                statistics.drawCalls++;
+        }
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -5,11 +5,21 @@
 #include "../components/mesh-renderer.hpp"
 #include "../asset-loader.hpp"
 #include "../components/light.hpp"
+#include "light-clusters.hpp"
+#include "postprocess-chain.hpp"
+#include "occlusion-culler.hpp"
+#include "resolution-scaler.hpp"
+#include "worker-pool.hpp"
 #include <iostream>
 #include <fstream>
 #include <glad/gl.h>
 #include <vector>
+#include <map>
+#include <unordered_set>
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 namespace our
 {
@@ -23,21 +33,59 @@ namespace our
         glm::vec3 center;
         Mesh *mesh;
         Material *material;
+        int lod = 0;                                     // The level of detail of the mesh that should be drawn
+        int submesh = -1;                                // The submesh that should be drawn (-1 draws all the submeshes at once)
     };
 
-    //. this is a struct for lights like the one in the lightened.frag
-    //. it is used to pass light data to the shader
-    struct LightSource
+    // A static batch holds the meshes of all the opaque static entities that share a material
+    // The meshes are transformed to the world space and merged into a single mesh when the scene is loaded
+    // so the whole batch is drawn using one draw call with an identity model matrix
+    struct StaticBatch
     {
-        int type;
-        bool isOn;
-        glm::vec3 position;
-        glm::vec3 direction;
-        glm::vec3 color;
-        // glm::vec3 diffuse;
-        // glm::vec3 specular;
-        glm::vec3 attenuation;
-        glm::vec2 cone_angles;
+        Mesh *mesh;
+        Material *material;
+        glm::vec3 boundsMin, boundsMax; // The world space bounding box of the batch (used to skip it if it is outside the view)
+    };
+
+    // The layout of a single draw inside the indirect buffer read by glMultiDrawElementsIndirect (defined by OpenGL)
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;         // The number of elements to draw
+        GLuint instanceCount; // The number of instances to draw
+        GLuint firstIndex;    // The first element (in units of elements, not bytes) inside the element buffer
+        GLint baseVertex;     // The constant added to every element to find the vertex
+        GLuint baseInstance;  // The first instance (the instanced attributes start from this index)
+    };
+
+    // The layer of every texture of the material of an object drawn by the multi-draw (read by the lit shaders compiled with TEXTURE_ARRAYS)
+    // It matches "DrawLayers" in the indirect shader (std430 packs the 5 integers without padding)
+    struct DrawLayers
+    {
+        GLint layers[LitMaterial::TEXTURE_SLOT_COUNT];
+    };
+
+    // Some numbers collected while rendering a frame so that we can compare different rendering paths
+    struct RendererStatistics
+    {
+        int drawCalls = 0;              // The number of draw calls issued for the scene objects (sky and postprocessing excluded)
+        int materialSetups = 0;         // The number of full material setups (shader, pipeline state and texture bindings) for these draw calls
+        long long triangles = 0;        // The number of triangles submitted by these draw calls
+        double opaqueSubmitTime = 0;    // The CPU time (in milliseconds) spent submitting the opaque pass
+        long long shadedSamples = -1;   // The number of samples that passed the depth test in the opaque shading pass (-1 if it isn't known yet)
+                                        // it is read from a query issued 2 frames before so that we never wait for the GPU
+        LightClusters::Statistics lights; // The light clustering numbers (all zeros if clustered lighting is disabled)
+        int postprocessPasses = 0;      // The number of postprocessing passes (0 if there is no postprocessing)
+        int postprocessTargets = 0;     // The number of intermediate targets shared by these passes
+        int culledObjects = 0;          // The number of commands skipped since their bounding box is outside the view
+        int occludedObjects = 0;        // The number of commands skipped since their bounding box is behind the occluders
+        int occluders = 0;              // The number of occluders rasterized by the occlusion culling
+        int occluderTriangles = 0;      // The number of their triangles that reached the screen
+        double occlusionTime = 0;       // The CPU time (in milliseconds) spent rasterizing the occluders (part of the extraction)
+        double extractTime = 0;         // The CPU time (in milliseconds) spent extracting the commands and the lights from the world
+        double postprocessGpuTime = -1; // The GPU time (in milliseconds) of all the postprocessing passes (-1 if it isn't known yet)
+        std::vector<std::pair<std::string, double>> postprocessPassTimes; // The name and the GPU time of every postprocessing pass
+        float renderScale = 1.0f;       // The scale of the resolution the scene was drawn at (see "resolution-scaler.hpp")
+        double frameGpuTime = -1;       // The GPU time (in milliseconds) of a recent frame measured by the dynamic resolution (-1 if it isn't known)
     };
 
     //. this is for the sky light effect on objects
@@ -48,51 +96,313 @@ namespace our
         glm::vec3 top, horizon, bottom;
     };
 
+    // The toggles of the renderer when a frame was extracted
+    // (they are copied so the main thread can change them while the render thread draws the frame)
+    struct RenderToggles
+    {
+        bool effect = false;
+        bool useIndirect = true;
+        bool depthPrepass = false;
+        bool overdrawView = false;
+        bool weightedTransparency = false;
+        bool dynamicResolution = false;
+    };
+
+    // Everything extracted from the world that is needed to draw a frame (see "ForwardRenderer::extract")
+    // It holds no OpenGL objects and the world isn't read while it is drawn, so a snapshot can be drawn on the render thread
+    // while the main thread updates the world and extracts the next one (see "render-thread.hpp")
+    // The meshes and the materials it points to must stay alive until it is drawn (the assets are only deleted when the state changes)
+    struct RenderSnapshot
+    {
+        bool hasCamera = false;
+        std::vector<RenderCommand> opaqueCommands;
+        std::vector<RenderCommand> transparentCommands; // sorted from far to near (unless the weighted transparency is used)
+        std::vector<LightSource> lights;
+        SkyLightEffect skyLight = {};
+        glm::mat4 view, projection;
+        glm::vec3 cameraPosition;
+        glm::vec3 cameraForward; // The transparent commands are sorted by their depth along this direction
+        float near, far;
+        bool perspective;
+        RenderToggles toggles;
+        int culledCommands = 0;  // The commands that were skipped by the frustum culling
+        int occludedCommands = 0; // The commands that were skipped by the occlusion culling
+        OcclusionCuller::Statistics occlusion; // The occluders rasterized for this snapshot
+        double extractTime = 0;  // The CPU time (in milliseconds) spent extracting the snapshot
+    };
+
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
     // In other words, the fragment shader in the material should output the color that we should see on the screen
     // This is different from more complex renderers that could draw intermediate data to a framebuffer before computing the final color
-    // In this project, we only need to implement a forward renderer
+    // (see "DeferredRenderer" which derives from this class and only replaces the opaque pass)
     class ForwardRenderer
     {
+    protected:
+        // The variants of the lit programs that the renderer compiles by itself from the programs of the materials (see "getProgramVariant")
+        enum class ProgramVariant
+        {
+            DEPTH_ONLY, // The vertex shader of the material with "depth-only.frag" (used by the depth pre-pass)
+            OVERDRAW,   // The vertex shader of the material with "overdraw.frag" (used by the overdraw view)
+            GBUFFER,    // The program of the material compiled with GBUFFER (used by the deferred renderer)
+            WEIGHTED_OIT // The program of the material compiled with WEIGHTED_OIT (used by the weighted blended transparency)
+        };
+        // The opaque pass being drawn (the lit materials are drawn with other programs and pipeline states in each pass)
+        enum class OpaquePass
+        {
+            NONE,          // Not drawing the opaque objects (e.g. drawing the sky or the transparent objects)
+            DEPTH_PREPASS, // Only writing the depth of the lit objects
+            SHADING        // Shading the opaque objects (with GL_EQUAL depth testing for the lit ones if the pre-pass was drawn)
+        };
 
- 
         //. create light sources vector to store all enabled lights in the scene
+        //. this and the other per-frame data below are swapped in from the snapshot being drawn
         std::vector<LightSource> light_sources;
 
         //. store the sky light data
         SkyLightEffect sky_light_effect;
 
+        //. the lights are assigned to the clusters of the view frustum every frame (see "light-clusters.hpp")
+        //. so the lit shaders compiled with CLUSTERED_LIGHTING only compute the lights that can reach their fragments
+        bool clusteredLighting = false;
+        LightClusters lightClusters;
+
         // These window size will be used on multiple occasions (setting the viewport, computing the aspect ratio, etc.)
         glm::ivec2 windowSize;
+        // The size of the viewport that the scene is drawn to in the current frame (smaller than the window if the dynamic resolution lowered it)
+        glm::ivec2 renderSize;
         // These are two vectors in which we will store the opaque and the transparent commands.
-        // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
+        // They are swapped with the vectors of the snapshot being drawn (the snapshots are reused so they aren't reallocated every frame)
         std::vector<RenderCommand> opaqueCommands;
         std::vector<RenderCommand> transparentCommands;
+        // The toggles of the frame being drawn
+        RenderToggles toggles;
+
+        // The extraction splits the entities into chunks that are extracted in parallel by "extractionWorkers" (see "extract")
+        // A chunk is worth sending to a worker only if it has at least "minEntitiesPerChunk" entities
+        // and there are a few chunks per thread so a thread that gets the expensive entities doesn't hold up the others
+        // (they are not constants so the extraction benchmark in "source/tools" can try other values)
+        size_t minEntitiesPerChunk = 1024, chunksPerThread = 4;
+        // The camera data needed to extract the entities (computed once before the chunks are extracted)
+        struct ExtractionView
+        {
+            glm::mat4 VP, projection;
+            glm::vec3 eye;
+            float near;
+            bool perspective;
+            bool cull;      // Skip the meshes whose bounding box is outside the view
+            bool occlusion; // Skip the meshes whose bounding box is behind the occluders
+        };
+        // The commands and the lights extracted from a chunk of entities by a single thread
+        struct ExtractionChunk
+        {
+            std::vector<RenderCommand> opaqueCommands, transparentCommands;
+            std::vector<LightSource> lights;
+            bool hasSkyLight = false;
+            SkyLightEffect skyLight = {};
+            int culledCommands = 0;
+            int occludedCommands = 0;
+        };
+        std::unique_ptr<WorkerPool> extractionWorkers; // nullptr if the extraction uses a single thread
+        bool frustumCulling = true;
+        // These are kept between frames to avoid reallocating them (they are only used by "extract")
+        std::vector<Entity *> extractionEntities;
+        std::vector<ExtractionChunk> extractionChunks;
+
+        // The occluders are rasterized by "occlusionCuller" before the chunks are extracted, then every chunk tests its meshes
+        // against them. Only the "maxOccluders" occluders with the largest projected size are rasterized in a frame
+        // and the meshes with more than "occluderTriangles" triangles are not used as occluders (see "buildOccluders")
+        OcclusionCuller occlusionCuller;
+        size_t maxOccluders = 16, occluderTriangles = 512;
+        std::vector<std::pair<float, OcclusionCuller::Occluder>> occluderCandidates;
+        std::vector<OcclusionCuller::Occluder> frameOccluders;
+        // Builds the commands of the mesh renderers and collects the lights of the given entities into the chunk
+        // It only reads the renderer so it can run on many threads at once (each with its own chunk)
+        void extractEntities(Entity *const *entities, size_t count, const ExtractionView &view, ExtractionChunk &chunk) const;
+
+        // The snapshots that aren't being extracted or drawn (a new one is only created when all of them are in flight)
+        std::mutex snapshotMutex;
+        std::vector<std::shared_ptr<RenderSnapshot>> freeSnapshots;
+        // The statistics of the frame being drawn, then copied to "publishedStatistics" (read by the main thread) when it is done
+        RendererStatistics statistics;
+        mutable std::mutex statisticsMutex;
+        RendererStatistics publishedStatistics;
+
+        // Opaque commands that share the same mesh and material are drawn using a single instanced draw call
+        // The per-instance data (model matrices) of each group are collected in "instances" then streamed to "instanceBuffer"
+        GLuint instanceBuffer = 0;
+        std::vector<InstanceData> instances;
+
+        // The multi-draw indirect path (requires OpenGL 4.3 and is detected at runtime)
+        // Every state bucket (opaque commands sharing a material state key) is submitted using a single glMultiDrawElementsIndirect.
+        // - "indirectBuffer" holds a DrawElementsIndirectCommand per mesh in the bucket (one instance per object using it)
+        // - "drawDataBuffer" is a shader storage buffer holding the matrices of every object (indexed by its draw id)
+        // - "drawLayersBuffer" is a shader storage buffer holding the texture array layers of the material of every object
+        // - "drawIdBuffer" holds the numbers 0, 1, 2, ... and is read as the per-instance draw id starting from baseInstance
+        bool indirectSupported = false;
+        GLuint indirectBuffer = 0, drawDataBuffer = 0, drawLayersBuffer = 0, drawIdBuffer = 0;
+        GLsizei drawIdCapacity = 0;
+        std::vector<DrawElementsIndirectCommand> indirectCommands;
+        std::vector<InstanceData> drawData;
+        std::vector<DrawLayers> drawLayers;
+        // A bucket is a range of opaque commands sharing the same material state key, vertex format and index type
+        // (and the same constant color if the format has no per-vertex color) since these are fixed during a multi-draw
+        // Its indirect commands are stored in indirectCommands[firstIndirect, firstIndirect + indirectCount)
+        struct IndirectBucket
+        {
+            size_t start, end;
+            size_t firstIndirect, indirectCount;
+        };
+        std::vector<IndirectBucket> indirectBuckets;
+
+        // The static batches built by "buildStaticBatches" and the mesh renderers that were merged into them
+        // (these mesh renderers are skipped while collecting the render commands)
+        std::vector<StaticBatch> staticBatches;
+        std::unordered_set<const MeshRendererComponent *> batchedRenderers;
 
         // Objects used for rendering a skybox
         // sky is just a sphere with a texture that is drawn behind everything else
-        Mesh *skySphere;
-        TexturedMaterial *skyMaterial; // to store its texture
+        Mesh *skySphere = nullptr;
+        TexturedMaterial *skyMaterial = nullptr; // to store its texture
         // Objects used for Postprocessing
-        GLuint postprocessFrameBuffer, postProcessVertexArray;
-        Texture2D *colorTarget, *depthTarget;
-        TexturedMaterial *postprocessMaterial;
+        GLuint postprocessFrameBuffer = 0;
+        Texture2D *colorTarget = nullptr, *depthTarget = nullptr;
+        PostprocessChain *postprocessChain = nullptr;
+        // The framebuffer that the scene is drawn to in the current frame
+        // (the postprocess framebuffer if the effect or the weighted transparency is on, otherwise the default one)
+        GLuint sceneFramebuffer = 0;
+
+        // Weighted blended order independent transparency (see "drawTransparentCommandsWeighted")
+        // The transparent objects are accumulated without sorting them in "oitFrameBuffer" which shares the depth of the scene:
+        //.--------------------------------------------------------------------
+        //. 0- accumulation (RGBA16F): rgb = the sum of the weighted premultiplied colors, a = the product of (1 - alpha) (the revealage)
+        //. 1- weight (R16F): the sum of the weighted alphas
+        //.--------------------------------------------------------------------
+        // then a fullscreen pass divides the colors by the weights and blends the average over the scene using the revealage
+        bool weightedTransparencySupported = false;
+        GLuint oitFrameBuffer = 0, oitVertexArray = 0;
+        Texture2D *oitAccumulationTarget = nullptr, *oitWeightTarget = nullptr;
+        ShaderProgram *oitResolveProgram = nullptr;
+        PipelineState oitResolvePipelineState;
+        // True while the transparent objects are accumulated (their materials use the WEIGHTED_OIT variant of their programs)
+        bool weightedPass = false;
+        // The transparent commands whose shaders can't be accumulated (they are sorted and blended over the resolved ones)
+        std::vector<RenderCommand> sortedTransparentCommands;
+        // Accumulates the transparent commands, resolves them over the scene framebuffer then draws the ones that couldn't be accumulated
+        void drawTransparentCommandsWeighted(const glm::vec3 &cameraPosition, const glm::vec3 &cameraForward, const glm::mat4 &VP);
+
+        // Dynamic resolution (see "resolution-scaler.hpp"): the scene is drawn to the bottom left "renderSize" part of the scene targets
+        // then stretched to the window, either by the blit to the screen or by a blit to the targets of "upscaleFrameBuffer"
+        // which the postprocess chain reads instead of the scene targets
+        bool dynamicResolutionSupported = false;
+        ResolutionScaler resolutionScaler;
+        GLuint upscaleFrameBuffer = 0;
+        Texture2D *upscaledColor = nullptr, *upscaledDepth = nullptr;
+
+        OpaquePass opaquePass = OpaquePass::NONE;
+        // The variants created so far (it maps to the original program if the variant couldn't be compiled)
+        std::map<std::pair<ShaderProgram *, ProgramVariant>, ShaderProgram *> programVariants;
+        // Two GL_SAMPLES_PASSED queries used alternately to count the samples of the opaque shading pass
+        // a query is only read when it is reused 2 frames later (if its result is available) so reading it never stalls
+        GLuint sampleQueries[2] = {};
+        bool sampleQueryPending[2] = {};
+        int sampleQueryIndex = 0;
+        // True once the samples of the current frame are being counted (a derived renderer may draw more than one shading pass)
+        bool sampleQueryIssued = false;
+
+        // Sends the camera, sky and light sources data to the given program (used by the lit materials)
+        void setLightingUniforms(ShaderProgram *program, const glm::vec3 &cameraPosition, const glm::mat4 &VP);
+        // Draws a single command (setup its material, send its matrices and draw its mesh)
+        // If "fullSetup" is false, the previous draw used a material with the same state key and the same shader
+        // so only the per-draw data of the material is sent (the state and the lighting uniforms are still set)
+        void drawCommand(const RenderCommand &command, const glm::vec3 &cameraPosition, const glm::mat4 &VP, bool fullSetup = true);
+        // Draws a group of commands sharing the same mesh and material using one instanced draw call
+        void drawInstancedCommands(const RenderCommand *commands, size_t count, const glm::vec3 &cameraPosition, const glm::mat4 &VP);
+        // Splits the sorted opaque commands into buckets, builds their indirect commands and draw data and uploads them
+        // This is done once per opaque pass, the depth pre-pass and the shading pass both draw the same buffers
+        void buildIndirectCommands();
+        // Draws the opaque commands one state bucket at a time using glMultiDrawElementsIndirect ("buildIndirectCommands" must be called first)
+        // Buckets whose material has no indirect shader fall back to the instanced/single draws
+        void drawOpaqueCommandsIndirect(const glm::vec3 &cameraPosition, const glm::mat4 &VP);
+        // Draws the opaque commands in [first, last) using instanced draws for groups and single draws for the rest
+        void drawOpaqueCommands(size_t first, size_t last, const glm::vec3 &cameraPosition, const glm::mat4 &VP);
+
+        // Returns the given variant of the program, compiling it the first time it is requested
+        ShaderProgram *getProgramVariant(ShaderProgram *program, ProgramVariant variant);
+        // Returns the program that should be used to draw with the given material instead of "program"
+        // (which is one of its shader, instancedShader or indirectShader and may be nullptr)
+        // The forward renderer uses the program of the material except for the lit materials in the depth pre-pass and the overdraw view
+        virtual ShaderProgram *selectProgram(const Material *material, ShaderProgram *program);
+        // Sets up the material with the given program then changes the pipeline state as needed by the current opaque pass
+        void setupMaterial(const Material *material, ShaderProgram *program);
+        // Draws the sorted opaque commands using the multi-draw indirect path or the draw loop
+        void submitOpaqueCommands(const glm::vec3 &cameraPosition, const glm::mat4 &VP);
+        // Sorts and draws the opaque commands to the scene framebuffer (which is bound and cleared before this is called)
+        virtual void renderOpaquePass(const glm::vec3 &cameraPosition, const glm::mat4 &VP);
 
     public:
+        virtual ~ForwardRenderer() = default;
+
         // Initialize the renderer including the sky and the Postprocessing objects.
         // @param windowSize: the width & height of the window (in pixels).
         // @param config: the configuration of the renderer, it may contain the following:
         //      - sky: the path to the sky texture
-        //      - postprocess: the path to the postprocessing shader
-        //      - postprocessUniforms: a list of uniforms to set on the postprocessing shader
-        //      - postprocessUniforms[i].name: the name of the uniform to set
-        void initialize(glm::ivec2 windowSize, const nlohmann::json &config);
+        //      - postprocess: the path to the postprocessing shader or a list of postprocessing passes (see "postprocess-chain.hpp")
+        //      - indirect: (default: true) use multi-draw indirect submission for the opaque pass if the driver supports it
+        //      - clusteredLighting: (default: true) assign the lights to clusters for the lit shaders compiled with CLUSTERED_LIGHTING
+        //      - type: (default: "forward") the renderer to create, read by "createRendererFromType" (see "deferred-renderer.hpp")
+        //      - depthPrepass: (default: false) draw the depth of the lit opaque objects first so every pixel is shaded once
+        //      - overdrawView: (default: false) draw the lit opaque objects with additive blending to show how many times every pixel is shaded
+        //      - extractionThreads: (default: 0) the number of threads extracting the world (0 uses all the hardware threads, 1 disables the workers)
+        //      - frustumCulling: (default: true) skip the objects whose bounding box is outside the view while extracting them
+        //      - occlusionCulling: (default: false) skip the objects hidden behind the mesh renderers marked as "occluder" (see "occlusion-culler.hpp")
+        //      - occlusionBufferSize: (default: [256, 128]) the size of the CPU depth buffer of the occlusion culling
+        //      - maxOccluders: (default: 16) the number of occluders rasterized every frame (the largest ones on the screen)
+        //      - occluderTriangles: (default: 512) the meshes of the occluders with more triangles are not used (they are never simplified)
+        //      - dynamicResolution: (optional) lowers the resolution of the scene to keep the GPU time of the frames near a target
+        //        (see "resolution-scaler.hpp" for its keys)
+        //      - transparency: (default: "sorted") "sorted" draws the transparent objects from far to near,
+        //        "weighted" blends them in any order using weighted blended order independent transparency
+        virtual void initialize(glm::ivec2 windowSize, const nlohmann::json &config);
         // Clean up the renderer
-        void destroy();
-        // This function should be called every frame to draw the given world
+        virtual void destroy();
+        // Merges the meshes of the opaque static entities (marked with "static": true) into one mesh per material
+        // This should be called after the world is loaded. The static entities must not move or be removed afterwards.
+        void buildStaticBatches(World *world);
+        // Makes the simplified meshes of the mesh renderers marked as "occluder" (if the occlusion culling is enabled)
+        // This should be called after the world is loaded, the occluders can move but the ones created later are ignored
+        void buildOccluders(World *world);
+        // Collects the camera, the render commands and the lights of the world into the snapshot (it doesn't call OpenGL)
+        void extract(World *world, RenderSnapshot &snapshot);
+        // Draws an extracted snapshot (this must be called on the thread that owns the OpenGL context)
+        void submit(RenderSnapshot &snapshot);
+        // Extracts the world to a free snapshot and returns the job that draws it then frees the snapshot
+        // The job can run right away or later on the render thread (see "Application::submitRenderJob")
+        std::function<void()> extractFrame(World *world);
+        // This function should be called every frame to draw the given world (it extracts then draws it right away)
         void render(World *world);
         // use this boolean to enable or disable post processing effect when collision happens
         bool effect = false;
+        // use this boolean to switch between the multi-draw indirect path and the draw loop (it is ignored if indirect is not supported)
+        bool useIndirect = true;
+        // use these booleans to toggle the depth pre-pass and the overdraw view (they can be changed every frame)
+        bool depthPrepass = false;
+        bool overdrawView = false;
+        // use this boolean to toggle the dynamic resolution (it is ignored if the config didn't enable it, the scene is drawn at full resolution then)
+        bool dynamicResolution = false;
+        // use this boolean to toggle the occlusion culling (it is ignored if the config didn't enable it)
+        bool occlusionCulling = false;
+        // use this boolean to switch between the weighted and the sorted transparency (it is ignored if the weighted transparency is not supported)
+        bool weightedTransparency = false;
+        // Returns the statistics of the last drawn frame (it can be called while the render thread draws the next one)
+        RendererStatistics getStatistics() const;
+        // Returns true if the driver supports the multi-draw indirect path
+        bool isIndirectSupported() const { return indirectSupported; }
+        // Returns true if the resources of the weighted transparency were created (the config asked for it and they are complete)
+        bool isWeightedTransparencySupported() const { return weightedTransparencySupported; }
+        // Returns true if the config enabled the dynamic resolution
+        bool isDynamicResolutionSupported() const { return dynamicResolutionSupported; }
+        // Returns true if the config enabled the occlusion culling (so its depth buffer and occluders exist)
+        bool isOcclusionCullingSupported() const { return occlusionCuller.getSize().x > 0; }
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "framebuffer-pool.hpp"
+#include "../texture/texture-utils.hpp"
+
+#include <iostream>
+
+namespace our
+{
+    RenderTarget *FramebufferPool::acquire(glm::ivec2 size, GLenum format)
+    {
+        for (size_t index = 0; index < targets.size(); index++)
+        {
+            if (!inUse[index] && targets[index]->size == size && targets[index]->format == format)
+            {
+                inUse[index] = true;
+                return targets[index];
+            }
+        }
+
+        RenderTarget *target = new RenderTarget();
+        target->size = size;
+        target->format = format;
+        target->texture = texture_utils::empty(format, size);
+        glGenFramebuffers(1, &target->framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->framebuffer);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture->getOpenGLName(), 0);
+        if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR: A render target of the framebuffer pool is incomplete" << std::endl;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        targets.push_back(target);
+        inUse.push_back(true);
+        return target;
+    }
+
+    void FramebufferPool::release(RenderTarget *target)
+    {
+        for (size_t index = 0; index < targets.size(); index++)
+        {
+            if (targets[index] == target)
+            {
+                inUse[index] = false;
+                return;
+            }
+        }
+    }
+
+    void FramebufferPool::destroy()
+    {
+        for (RenderTarget *target : targets)
+        {
+            glDeleteFramebuffers(1, &target->framebuffer);
+            delete target->texture;
+            delete target;
+        }
+        targets.clear();
+        inUse.clear();
+    }
+
+}
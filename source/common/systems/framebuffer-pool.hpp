@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../texture/texture2d.hpp"
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <vector>
+
+namespace our
+{
+
+    // A color texture and a framebuffer that draws to it
+    struct RenderTarget
+    {
+        Texture2D *texture = nullptr;
+        GLuint framebuffer = 0;
+        glm::ivec2 size;
+        GLenum format;
+    };
+
+    // A framebuffer pool hands out render targets and takes them back once their content is no longer needed
+    // so the passes that don't need their targets at the same time can share them instead of each pass having its own
+    // A released target is given to the next request with the same size and format (a new one is created if there is none)
+    class FramebufferPool
+    {
+        std::vector<RenderTarget *> targets;
+        std::vector<bool> inUse;
+
+    public:
+        // Returns a target with the given size and format that isn't in use
+        RenderTarget *acquire(glm::ivec2 size, GLenum format);
+        // Marks the target as free so that it can be returned by "acquire"
+        void release(RenderTarget *target);
+        // The number of targets created by the pool
+        size_t getTargetCount() const { return targets.size(); }
+        // Deletes all the targets (even the ones in use)
+        void destroy();
+
+        FramebufferPool() = default;
+        ~FramebufferPool() { destroy(); }
+
+        FramebufferPool(const FramebufferPool &) = delete;
+        FramebufferPool &operator=(const FramebufferPool &) = delete;
+    };
+
+}
@@ -0,0 +1,279 @@
+#include "light-clusters.hpp"
+#include "../components/light.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+//. SSE2 is part of every x86-64 CPU so the binning only falls back to the scalar loop on other architectures
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE2 1
+#else
+#define LIGHT_CLUSTERS_SSE2 0
+#endif
+
+namespace our
+{
+    static_assert(LightClusters::TILES_X % 4 == 0 && LightClusters::TILES_X <= 32, "the tile rows are tested 4 tiles at a time into a 32 bit mask");
+
+    void LightClusters::initialize()
+    {
+        //. a texture buffer is a view of a buffer object that the shader reads with texelFetch
+        //. the textures keep pointing to their buffers even when the buffer storage is reallocated by glBufferData
+        GLuint *buffers[] = {&lightDataBuffer, &clusterGridBuffer, &clusterLightIndicesBuffer};
+        GLuint *textures[] = {&lightDataTexture, &clusterGridTexture, &clusterLightIndicesTexture};
+        GLenum formats[] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for (int index = 0; index < 3; index++)
+        {
+            glGenBuffers(1, buffers[index]);
+            glBindBuffer(GL_TEXTURE_BUFFER, *buffers[index]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glGenTextures(1, textures[index]);
+            glBindTexture(GL_TEXTURE_BUFFER, *textures[index]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[index], *buffers[index]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void LightClusters::destroy()
+    {
+        glDeleteTextures(1, &lightDataTexture);
+        glDeleteTextures(1, &clusterGridTexture);
+        glDeleteTextures(1, &clusterLightIndicesTexture);
+        glDeleteBuffers(1, &lightDataBuffer);
+        glDeleteBuffers(1, &clusterGridBuffer);
+        glDeleteBuffers(1, &clusterLightIndicesBuffer);
+        lightDataTexture = clusterGridTexture = clusterLightIndicesTexture = 0;
+        lightDataBuffer = clusterGridBuffer = clusterLightIndicesBuffer = 0;
+    }
+
+    float LightClusters::getLightRadius(const LightSource &light)
+    {
+        //. the attenuated intensity is max(color) / (a*d^2 + b*d + c), so we solve a*d^2 + b*d + c = max(color) / cutoff
+        float a = light.attenuation.x, b = light.attenuation.y, c = light.attenuation.z;
+        float target = std::max({light.color.r, light.color.g, light.color.b}) / LIGHT_CUTOFF;
+        if (target <= c)
+            return 0.0f;
+        if (a > 0.0f)
+            return (-b + std::sqrt(b * b - 4.0f * a * (c - target))) / (2.0f * a);
+        if (b > 0.0f)
+            return (target - c) / b;
+        return std::numeric_limits<float>::infinity();
+    }
+
+    void LightClusters::assign(GLuint light, const glm::vec3 &center, float radius)
+    {
+        //. the depth is the distance along the camera forward direction (-Z in the view space)
+        float depth = -center.z;
+        float minDepth = std::max(depth - radius, sliceDepths[0]), maxDepth = std::min(depth + radius, sliceDepths[SLICES]);
+        if (minDepth > maxDepth)
+            return;
+
+        //. the slices are found from the boundaries since the slicing is the same one used by the shader
+        int firstSlice = int(std::upper_bound(sliceDepths, sliceDepths + SLICES + 1, minDepth) - sliceDepths) - 1;
+        int lastSlice = int(std::lower_bound(sliceDepths, sliceDepths + SLICES + 1, maxDepth) - sliceDepths) - 1;
+        firstSlice = glm::clamp(firstSlice, 0, SLICES - 1);
+        lastSlice = glm::clamp(lastSlice, firstSlice, SLICES - 1);
+
+        //. the tiles are found from the range of x/depth and y/depth covered by the box around the sphere
+        //. (the ratio is extreme at the nearest or the farthest depth of the box)
+        auto tileRange = [&](float low, float high, const float *tileMin, const float *tileMax, int count, int &first, int &last)
+        {
+            float minRatio = std::min(low / minDepth, low / maxDepth), maxRatio = std::max(high / minDepth, high / maxDepth);
+            first = 0;
+            while (first < count && tileMax[first] < minRatio)
+                first++;
+            last = count - 1;
+            while (last >= first && tileMin[last] > maxRatio)
+                last--;
+        };
+        int firstX, lastX, firstY, lastY;
+        tileRange(center.x - radius, center.x + radius, tileMinX, tileMaxX, TILES_X, firstX, lastX);
+        tileRange(center.y - radius, center.y + radius, tileMinY, tileMaxY, TILES_Y, firstY, lastY);
+        if (firstX > lastX || firstY > lastY)
+            return;
+
+        //. then every cluster in that range is tested against the sphere using the distance to its bounding box
+        float radiusSquared = radius * radius;
+        //. the bit x of a row mask is set if the tile x of the row is hit (only the tiles in [firstX, lastX] are kept)
+        unsigned int rangeMask = (unsigned int)((2ull << lastX) - 1) & ~((1u << firstX) - 1);
+#if LIGHT_CLUSTERS_SSE2
+        const __m128 centerX = _mm_set1_ps(center.x), zero = _mm_setzero_ps();
+#endif
+        for (int slice = firstSlice; slice <= lastSlice; slice++)
+        {
+            float nearDepth = sliceDepths[slice], farDepth = sliceDepths[slice + 1];
+            float dz = std::max({nearDepth - depth, 0.0f, depth - farDepth});
+            const float *minX = clusterMinX[slice], *maxX = clusterMaxX[slice];
+            for (int y = firstY; y <= lastY; y++)
+            {
+                float dy = std::max({clusterMinY[slice][y] - center.y, 0.0f, center.y - clusterMaxY[slice][y]});
+                float rest = radiusSquared - dz * dz - dy * dy;
+                if (rest < 0.0f)
+                    continue;
+                //. the distance from the center to the x range of every tile of the row is compared with what is left of the radius
+                unsigned int hits = 0;
+#if LIGHT_CLUSTERS_SSE2
+                const __m128 rest4 = _mm_set1_ps(rest);
+                for (int x = firstX & ~3; x <= lastX; x += 4)
+                {
+                    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(minX + x), centerX), zero), _mm_sub_ps(centerX, _mm_load_ps(maxX + x)));
+                    hits |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), rest4)) << x;
+                }
+#else
+                for (int x = firstX; x <= lastX; x++)
+                {
+                    float dx = std::max({minX[x] - center.x, 0.0f, center.x - maxX[x]});
+                    hits |= (unsigned int)(dx * dx <= rest) << x;
+                }
+#endif
+                hits &= rangeMask;
+                GLuint rowStart = (GLuint)((slice * TILES_Y + y) * TILES_X);
+                for (int x = firstX; hits >> x; x++)
+                    if (hits & (1u << x))
+                        assignments.push_back({rowStart + x, light});
+            }
+        }
+    }
+
+    void LightClusters::bin(const std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                            float near, float far, bool perspective)
+    {
+
+        //. the lights that reach everything are put first since the shader loops over them for every fragment
+        std::vector<float> radii(lights.size());
+        lightOrder.clear();
+        for (size_t index = 0; index < lights.size(); index++)
+        {
+            radii[index] = lights[index].type == (int)LightType::DIRECTIONAL ? std::numeric_limits<float>::infinity() : getLightRadius(lights[index]);
+            if (!perspective || std::isinf(radii[index]))
+                lightOrder.push_back((int)index);
+        }
+        globalLightCount = (GLint)lightOrder.size();
+        for (size_t index = 0; index < lights.size(); index++)
+            if (perspective && !std::isinf(radii[index]))
+                lightOrder.push_back((int)index);
+
+        lightData.clear();
+        for (int index : lightOrder)
+        {
+            const LightSource &light = lights[index];
+            lightData.push_back(glm::vec4(light.position, (float)light.type));
+            lightData.push_back(glm::vec4(light.direction, light.cone_angles.x));
+            lightData.push_back(glm::vec4(light.color, light.cone_angles.y));
+            lightData.push_back(glm::vec4(light.attenuation, 0.0f));
+        }
+
+        //. the bounds of the tiles at a depth of 1 come from the projection (x_ndc = x * P[0][0] / depth for a symmetric frustum)
+        for (int x = 0; x < TILES_X; x++)
+        {
+            tileMinX[x] = (-1.0f + 2.0f * x / TILES_X) / projection[0][0];
+            tileMaxX[x] = (-1.0f + 2.0f * (x + 1) / TILES_X) / projection[0][0];
+        }
+        for (int y = 0; y < TILES_Y; y++)
+        {
+            tileMinY[y] = (-1.0f + 2.0f * y / TILES_Y) / projection[1][1];
+            tileMaxY[y] = (-1.0f + 2.0f * (y + 1) / TILES_Y) / projection[1][1];
+        }
+        //. the first slice goes from the near plane to "firstDepth" then the other slices split the rest exponentially
+        //. so the slice of a depth is floor(log(depth) * scale + bias) (clamped to the valid slices)
+        float firstDepth = glm::clamp(FIRST_SLICE_DEPTH, near * 2.0f, far * 0.5f);
+        float scale = (SLICES - 1) / std::log(far / firstDepth);
+        depthScaleBias = glm::vec2(scale, 1.0f - std::log(firstDepth) * scale);
+        sliceDepths[0] = near;
+        for (int slice = 1; slice <= SLICES; slice++)
+            sliceDepths[slice] = firstDepth * std::pow(far / firstDepth, float(slice - 1) / (SLICES - 1));
+        //. the box of a cluster bounds its tile at the near and the far depth of its slice
+        for (int slice = 0; slice < SLICES; slice++)
+        {
+            float nearDepth = sliceDepths[slice], farDepth = sliceDepths[slice + 1];
+            for (int x = 0; x < TILES_X; x++)
+            {
+                clusterMinX[slice][x] = std::min(tileMinX[x] * nearDepth, tileMinX[x] * farDepth);
+                clusterMaxX[slice][x] = std::max(tileMaxX[x] * nearDepth, tileMaxX[x] * farDepth);
+            }
+            for (int y = 0; y < TILES_Y; y++)
+            {
+                clusterMinY[slice][y] = std::min(tileMinY[y] * nearDepth, tileMinY[y] * farDepth);
+                clusterMaxY[slice][y] = std::max(tileMaxY[y] * nearDepth, tileMaxY[y] * farDepth);
+            }
+        }
+
+        assignments.clear();
+        for (size_t order = globalLightCount; order < lightOrder.size(); order++)
+        {
+            const LightSource &light = lights[lightOrder[order]];
+            assign((GLuint)order, glm::vec3(view * glm::vec4(light.position, 1.0f)), radii[lightOrder[order]]);
+        }
+
+        //. sort the assignments by cluster (a counting sort since the clusters are few) to build the light lists
+        clusterGrid.assign(CLUSTER_COUNT, glm::uvec2(0));
+        for (const glm::uvec2 &assignment : assignments)
+            clusterGrid[assignment.x].y++;
+        GLuint offset = 0;
+        for (glm::uvec2 &cluster : clusterGrid)
+        {
+            cluster.x = offset;
+            offset += cluster.y;
+            statistics.maxClusterLights = std::max(statistics.maxClusterLights, (int)cluster.y);
+            cluster.y = 0;
+        }
+        clusterLightIndices.resize(std::max<size_t>(assignments.size(), 1));
+        for (const glm::uvec2 &assignment : assignments)
+        {
+            glm::uvec2 &cluster = clusterGrid[assignment.x];
+            clusterLightIndices[cluster.x + cluster.y++] = assignment.y;
+        }
+        if (lightData.empty())
+            lightData.push_back(glm::vec4(0.0f));
+    }
+
+    void LightClusters::update(const std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                               float near, float far, bool perspective, glm::ivec2 viewportSize)
+    {
+        statistics = Statistics();
+        auto start = std::chrono::steady_clock::now();
+        bin(lights, view, projection, near, far, perspective);
+        statistics.binTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        //. upload the buffers (orphaning the old storage so we don't wait for the previous frame)
+        glBindBuffer(GL_TEXTURE_BUFFER, lightDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, lightData.size() * sizeof(glm::vec4), lightData.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, clusterGridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, clusterGrid.size() * sizeof(glm::uvec2), clusterGrid.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, clusterLightIndicesBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, clusterLightIndices.size() * sizeof(GLuint), clusterLightIndices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        //. the shader measures the depth along the camera forward direction (the view matrix has no scaling)
+        cameraForward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+        tileSize = glm::vec2(viewportSize) / glm::vec2(TILES_X, TILES_Y);
+
+        statistics.lightCount = (int)lights.size();
+        statistics.globalLightCount = globalLightCount;
+        statistics.assignments = (int)assignments.size();
+    }
+
+    void LightClusters::setUniforms(ShaderProgram *program) const
+    {
+        GLuint textures[] = {lightDataTexture, clusterGridTexture, clusterLightIndicesTexture};
+        GLint units[] = {LIGHT_DATA_UNIT, CLUSTER_GRID_UNIT, CLUSTER_LIGHT_INDICES_UNIT};
+        const char *uniforms[] = {"light_data", "cluster_grid", "cluster_light_indices"};
+        for (int index = 0; index < 3; index++)
+        {
+            glActiveTexture(GL_TEXTURE0 + units[index]);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[index]);
+            program->set(uniforms[index], units[index]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        program->set("global_light_count", globalLightCount);
+        program->set("cluster_counts", glm::ivec3(TILES_X, TILES_Y, SLICES));
+        program->set("cluster_tile_size", tileSize);
+        program->set("cluster_depth_scale_bias", depthScaleBias);
+        program->set("camera_forward", cameraForward);
+    }
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../shader/shader.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace our
+{
+
+    //. this is a struct for lights like the one in the lightened.frag
+    //. it is used to pass light data to the shader
+    struct LightSource
+    {
+        int type;
+        bool isOn;
+        glm::vec3 position;
+        glm::vec3 direction;
+        glm::vec3 color;
+        // glm::vec3 diffuse;
+        // glm::vec3 specular;
+        glm::vec3 attenuation;
+        glm::vec2 cone_angles;
+    };
+
+    // Clustered forward lighting: the view frustum is split into a grid of clusters (screen tiles times depth slices
+    // that get thicker with the distance) and every frame, each point and spot light is added to the list of the clusters
+    // that its sphere of influence touches. The lit shader compiled with CLUSTERED_LIGHTING finds the cluster of its fragment
+    // and only loops over the lights in that list, so the cost per fragment depends on the lights near it instead of all the lights.
+    // The lights are read from texture buffers (supported since OpenGL 3.1) so there is no MAX_LIGHTS limit:
+    //.--------------------------------------------------------------------
+    //. light_data (RGBA32F): 4 texels per light (position + type, direction + inner cone angle, color + outer cone angle, attenuation)
+    //.                       the lights that reach everything (directional lights and lights without attenuation) come first
+    //. cluster_grid (RG32UI): the offset and the count of the light list of every cluster
+    //. cluster_light_indices (R32UI): the light lists of all the clusters, one after the other
+    //.--------------------------------------------------------------------
+    class LightClusters
+    {
+    public:
+        static constexpr int TILES_X = 16, TILES_Y = 9, SLICES = 24;
+        static constexpr int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+        // The depth of the end of the first slice is "FIRST_SLICE_DEPTH" (the near plane is usually too close to start the
+        // exponential slicing from it since the first slices would be too thin to hold anything)
+        static constexpr float FIRST_SLICE_DEPTH = 1.0f;
+        // A light is assumed to have no effect once its attenuated intensity goes below this value
+        static constexpr float LIGHT_CUTOFF = 1.0f / 256.0f;
+        // The texture units used by the light buffers (the lit materials use units 0 to 4)
+        static constexpr GLint LIGHT_DATA_UNIT = 5, CLUSTER_GRID_UNIT = 6, CLUSTER_LIGHT_INDICES_UNIT = 7;
+
+        // Some numbers about the last update
+        struct Statistics
+        {
+            int lightCount = 0;         // The number of lights
+            int globalLightCount = 0;   // The number of lights that reach every cluster (looped by every fragment)
+            int assignments = 0;        // The number of (cluster, light) pairs
+            int maxClusterLights = 0;   // The longest light list of a cluster
+            double binTime = 0;         // The CPU time (in milliseconds) spent assigning the lights to the clusters
+        };
+
+    private:
+        GLuint lightDataBuffer = 0, clusterGridBuffer = 0, clusterLightIndicesBuffer = 0;
+        GLuint lightDataTexture = 0, clusterGridTexture = 0, clusterLightIndicesTexture = 0;
+
+        // The data of the last update that the shader needs to find the cluster of a fragment
+        glm::vec2 tileSize = glm::vec2(1.0f);
+        glm::vec2 depthScaleBias = glm::vec2(0.0f);
+        glm::vec3 cameraForward = glm::vec3(0, 0, -1);
+        GLint globalLightCount = 0;
+
+        // These are kept between frames to avoid reallocating them
+        std::vector<glm::vec4> lightData;
+        std::vector<int> lightOrder;
+        std::vector<glm::uvec2> clusterGrid;
+        std::vector<GLuint> clusterLightIndices;
+        std::vector<glm::uvec2> assignments; // (cluster, light) pairs before they are sorted by cluster
+        // The x and y bounds of every tile column and row at a depth of 1 (so the bounds at depth d are these times d)
+        float tileMinX[TILES_X], tileMaxX[TILES_X], tileMinY[TILES_Y], tileMaxY[TILES_Y];
+        // The depth of the start of every slice and the end of the last one
+        float sliceDepths[SLICES + 1];
+        // The view space x bounds of every tile column and y bounds of every tile row in every slice (the bounds of the cluster boxes)
+        // They are computed once per update so testing a light against a row of 4 clusters is a few SIMD operations
+        alignas(16) float clusterMinX[SLICES][TILES_X], clusterMaxX[SLICES][TILES_X];
+        float clusterMinY[SLICES][TILES_Y], clusterMaxY[SLICES][TILES_Y];
+
+        // Adds the light with the given view space position and radius to all the clusters its sphere touches
+        void assign(GLuint light, const glm::vec3 &center, float radius);
+        // Orders the lights and builds the light lists of the clusters (everything "update" does on the CPU)
+        void bin(const std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                 float near, float far, bool perspective);
+
+    public:
+        // The statistics of the last update
+        Statistics statistics;
+
+        // Creates the buffers and their textures
+        void initialize();
+        // Deletes the buffers and their textures
+        void destroy();
+
+        // Returns the distance beyond which the attenuated light is below "LIGHT_CUTOFF"
+        // Returns infinity if the light doesn't get weaker with the distance
+        static float getLightRadius(const LightSource &light);
+
+        // Assigns the lights to the clusters of the given camera and uploads the light buffers
+        // @param perspective: if false, the camera is orthographic so all the lights are treated as global
+        void update(const std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                    float near, float far, bool perspective, glm::ivec2 viewportSize);
+
+        // Binds the light buffers and sends the uniforms needed to find the cluster of a fragment
+        void setUniforms(ShaderProgram *program) const;
+    };
+
+}
@@ -0,0 +1,315 @@
+#include "occlusion-culler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+//. SSE2 is part of every x86-64 CPU so the rasterizer only falls back to the scalar loop on other architectures
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_CULLER_SSE2 1
+#else
+#define OCCLUSION_CULLER_SSE2 0
+#endif
+
+namespace our
+{
+    void OcclusionCuller::initialize(glm::ivec2 size)
+    {
+        tileCount = (glm::max(size, glm::ivec2(1)) + glm::ivec2(TILE_WIDTH - 1, TILE_HEIGHT - 1)) / glm::ivec2(TILE_WIDTH, TILE_HEIGHT);
+        this->size = tileCount * glm::ivec2(TILE_WIDTH, TILE_HEIGHT);
+        depth.assign((size_t)this->size.x * this->size.y, 1.0f);
+        blockDepth.assign((size_t)(this->size.x / HIZ_BLOCK) * (this->size.y / HIZ_BLOCK), 1.0f);
+        tileTriangles.assign((size_t)tileCount.x * tileCount.y, {});
+    }
+
+    void OcclusionCuller::destroy()
+    {
+        size = tileCount = glm::ivec2(0);
+        depth.clear();
+        blockDepth.clear();
+        tileTriangles.clear();
+        triangles.clear();
+        occluderMeshes.clear();
+    }
+
+    bool OcclusionCuller::addOccluderMesh(const Mesh *mesh, size_t maxTriangles)
+    {
+        if (mesh == nullptr)
+            return false;
+        if (hasOccluderMesh(mesh))
+            return true;
+        //. an occluder must never cover more than the mesh does, otherwise it hides the objects that are in front of the real surface,
+        //. so the full detail level is used: the coarser levels and the simplifier move the vertices and can bulge out of the surface
+        //. (a mesh that is too detailed for the budget is left out instead of being simplified)
+        if ((size_t)mesh->getElementCount(0) > maxTriangles * 3)
+            return false;
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> elements;
+        mesh->downloadPositions(positions, elements, 0);
+
+        //. only keep the vertices used by the remaining triangles (and drop the triangles that collapsed to a line)
+        OccluderMesh &occluder = occluderMeshes[mesh];
+        std::vector<unsigned int> remap(positions.size(), std::numeric_limits<unsigned int>::max());
+        for (size_t first = 0; first + 2 < elements.size(); first += 3)
+        {
+            unsigned int a = elements[first], b = elements[first + 1], c = elements[first + 2];
+            if (a == b || b == c || c == a)
+                continue;
+            for (unsigned int element : {a, b, c})
+            {
+                if (remap[element] == std::numeric_limits<unsigned int>::max())
+                {
+                    remap[element] = (unsigned int)occluder.positions.size();
+                    occluder.positions.push_back(positions[element]);
+                }
+                occluder.elements.push_back(remap[element]);
+            }
+        }
+        return true;
+    }
+
+    void OcclusionCuller::addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+    {
+        //. the triangle is clipped against the near plane (z >= -w) since the vertices behind the camera can't be projected
+        //. the other planes don't need to be clipped since the bounds of the triangle are clamped to the buffer
+        const glm::vec4 input[3] = {a, b, c};
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int index = 0; index < 3; index++)
+        {
+            const glm::vec4 &current = input[index], &next = input[(index + 1) % 3];
+            float currentDistance = current.z + current.w, nextDistance = next.z + next.w;
+            if (currentDistance >= 0)
+                polygon[count++] = current;
+            if ((currentDistance >= 0) != (nextDistance >= 0))
+                polygon[count++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+        }
+        if (count < 3)
+            return;
+
+        //. project the vertices to the pixel coordinates (the pixel centers are at x + 0.5) with the depth mapped to [0, 1]
+        glm::vec3 screen[4];
+        for (int index = 0; index < count; index++)
+        {
+            glm::vec3 ndc = glm::vec3(polygon[index]) / polygon[index].w;
+            screen[index] = glm::vec3((ndc.x * 0.5f + 0.5f) * size.x, (ndc.y * 0.5f + 0.5f) * size.y, ndc.z * 0.5f + 0.5f);
+        }
+
+        //. the clipped polygon is a triangle or a quad which is split into a fan of triangles
+        for (int third = 2; third < count; third++)
+        {
+            glm::vec3 p0 = screen[0], p1 = screen[third - 1], p2 = screen[third];
+            float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+            if (std::abs(area) < 1e-6f)
+                continue;
+            //. both faces are rasterized (the occluders may be planes seen from either side) so the back faces are flipped
+            if (area < 0)
+            {
+                std::swap(p1, p2);
+                area = -area;
+            }
+
+            ScreenTriangle triangle;
+            const glm::vec3 corners[3] = {p0, p1, p2};
+            for (int edge = 0; edge < 3; edge++)
+            {
+                const glm::vec3 &from = corners[edge], &to = corners[(edge + 1) % 3];
+                triangle.edges[edge] = glm::vec3(from.y - to.y, to.x - from.x, from.x * to.y - to.x * from.y);
+            }
+            float depthX = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / area;
+            float depthY = ((p2.z - p0.z) * (p1.x - p0.x) - (p1.z - p0.z) * (p2.x - p0.x)) / area;
+            triangle.depth = glm::vec3(depthX, depthY, p0.z - depthX * p0.x - depthY * p0.y);
+
+            //. the pixels whose centers may be inside the triangle (the bounds are clamped before they are converted
+            //. since the vertices near the near plane may be projected very far from the screen)
+            glm::vec2 minimum = glm::max(glm::vec2(glm::min(p0, glm::min(p1, p2))), glm::vec2(-1.0f));
+            glm::vec2 maximum = glm::min(glm::vec2(glm::max(p0, glm::max(p1, p2))), glm::vec2(size) + 1.0f);
+            triangle.min = glm::max(glm::ivec2(glm::ceil(minimum - 0.5f)), glm::ivec2(0));
+            triangle.max = glm::min(glm::ivec2(glm::floor(maximum - 0.5f)), size - 1);
+            if (triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y)
+                continue;
+            triangles.push_back(triangle);
+        }
+    }
+
+    void OcclusionCuller::rasterizeTile(int tile)
+    {
+        glm::ivec2 tileMin = glm::ivec2(tile % tileCount.x, tile / tileCount.x) * glm::ivec2(TILE_WIDTH, TILE_HEIGHT);
+        glm::ivec2 tileMax = tileMin + glm::ivec2(TILE_WIDTH - 1, TILE_HEIGHT - 1);
+        for (int y = tileMin.y; y <= tileMax.y; y++)
+            std::fill_n(depth.data() + (size_t)y * size.x + tileMin.x, TILE_WIDTH, 1.0f);
+
+        for (unsigned int index : tileTriangles[tile])
+        {
+            const ScreenTriangle &triangle = triangles[index];
+            glm::ivec2 first = glm::max(triangle.min, tileMin), last = glm::min(triangle.max, tileMax);
+#if OCCLUSION_CULLER_SSE2
+            //. the rows are rasterized 4 pixels at a time starting from a multiple of 4
+            //. (the tiles start at multiples of 4 so the pixels before the triangle are still inside the tile, they just fail the edge test)
+            first.x &= ~3;
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f), zero = _mm_setzero_ps();
+            const __m128 edgeX0 = _mm_set1_ps(triangle.edges[0].x), edgeX1 = _mm_set1_ps(triangle.edges[1].x), edgeX2 = _mm_set1_ps(triangle.edges[2].x);
+            const __m128 depthX = _mm_set1_ps(triangle.depth.x);
+            for (int y = first.y; y <= last.y; y++)
+            {
+                float centerY = y + 0.5f;
+                //. the part of every edge function (and of the depth) that only depends on the row
+                const __m128 row0 = _mm_set1_ps(triangle.edges[0].y * centerY + triangle.edges[0].z);
+                const __m128 row1 = _mm_set1_ps(triangle.edges[1].y * centerY + triangle.edges[1].z);
+                const __m128 row2 = _mm_set1_ps(triangle.edges[2].y * centerY + triangle.edges[2].z);
+                const __m128 rowDepth = _mm_set1_ps(triangle.depth.y * centerY + triangle.depth.z);
+                float *row = depth.data() + (size_t)y * size.x;
+                for (int x = first.x; x <= last.x; x += 4)
+                {
+                    __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                    __m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeX0, centerX), row0);
+                    __m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeX1, centerX), row1);
+                    __m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeX2, centerX), row2);
+                    __m128 inside = _mm_cmpge_ps(_mm_min_ps(edge0, _mm_min_ps(edge1, edge2)), zero);
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    __m128 fragmentDepth = _mm_add_ps(_mm_mul_ps(depthX, centerX), rowDepth);
+                    __m128 stored = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(stored, fragmentDepth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+                }
+            }
+#else
+            for (int y = first.y; y <= last.y; y++)
+            {
+                float centerY = y + 0.5f;
+                float *row = depth.data() + (size_t)y * size.x;
+                for (int x = first.x; x <= last.x; x++)
+                {
+                    glm::vec3 center(x + 0.5f, centerY, 1.0f);
+                    if (glm::dot(triangle.edges[0], center) < 0 || glm::dot(triangle.edges[1], center) < 0 || glm::dot(triangle.edges[2], center) < 0)
+                        continue;
+                    row[x] = std::min(row[x], glm::dot(triangle.depth, center));
+                }
+            }
+#endif
+        }
+
+        //. the farthest depth of every block of the tile
+        int blocksPerRow = size.x / HIZ_BLOCK;
+        for (int blockY = tileMin.y; blockY < tileMax.y; blockY += HIZ_BLOCK)
+        {
+            for (int blockX = tileMin.x; blockX < tileMax.x; blockX += HIZ_BLOCK)
+            {
+                float farthest = 0.0f;
+                for (int y = blockY; y < blockY + HIZ_BLOCK; y++)
+                {
+                    const float *row = depth.data() + (size_t)y * size.x;
+                    farthest = std::max(farthest, *std::max_element(row + blockX, row + blockX + HIZ_BLOCK));
+                }
+                blockDepth[(size_t)(blockY / HIZ_BLOCK) * blocksPerRow + blockX / HIZ_BLOCK] = farthest;
+            }
+        }
+    }
+
+    void OcclusionCuller::render(const std::vector<Occluder> &occluders, WorkerPool *workers)
+    {
+        auto start = std::chrono::steady_clock::now();
+        statistics = Statistics();
+        if (size.x == 0)
+            return;
+
+        //. transform, clip and set up the triangles of all the occluders
+        triangles.clear();
+        for (const Occluder &occluder : occluders)
+        {
+            auto it = occluderMeshes.find(occluder.mesh);
+            if (it == occluderMeshes.end())
+                continue;
+            const OccluderMesh &mesh = it->second;
+            clipPositions.resize(mesh.positions.size());
+            for (size_t vertex = 0; vertex < mesh.positions.size(); vertex++)
+                clipPositions[vertex] = occluder.MVP * glm::vec4(mesh.positions[vertex], 1.0f);
+            for (size_t first = 0; first + 2 < mesh.elements.size(); first += 3)
+                addTriangle(clipPositions[mesh.elements[first]], clipPositions[mesh.elements[first + 1]], clipPositions[mesh.elements[first + 2]]);
+            statistics.occluders++;
+        }
+        statistics.triangles = (int)triangles.size();
+
+        //. bin every triangle to the tiles touched by its bounds so the tiles can be rasterized independently
+        for (auto &bin : tileTriangles)
+            bin.clear();
+        for (unsigned int index = 0; index < (unsigned int)triangles.size(); index++)
+        {
+            glm::ivec2 first = triangles[index].min / glm::ivec2(TILE_WIDTH, TILE_HEIGHT);
+            glm::ivec2 last = triangles[index].max / glm::ivec2(TILE_WIDTH, TILE_HEIGHT);
+            for (int tileY = first.y; tileY <= last.y; tileY++)
+                for (int tileX = first.x; tileX <= last.x; tileX++)
+                    tileTriangles[(size_t)tileY * tileCount.x + tileX].push_back(index);
+        }
+
+        size_t tiles = tileTriangles.size();
+        if (workers && workers->getThreadCount() > 1)
+        {
+            workers->run(tiles, [this](size_t tile)
+                         { rasterizeTile((int)tile); });
+        }
+        else
+        {
+            for (size_t tile = 0; tile < tiles; tile++)
+                rasterizeTile((int)tile);
+        }
+        statistics.rasterTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool OcclusionCuller::isBoxOccluded(const glm::mat4 &MVP, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+    {
+        if (size.x == 0)
+            return false;
+
+        //. find the screen rectangle and the nearest depth of the box
+        glm::vec2 rectangleMin(std::numeric_limits<float>::max()), rectangleMax(-std::numeric_limits<float>::max());
+        float nearest = 1.0f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x,
+                             (i & 2) ? boundsMax.y : boundsMin.y,
+                             (i & 4) ? boundsMax.z : boundsMin.z);
+            glm::vec4 clip = MVP * glm::vec4(corner, 1.0f);
+            //. a box that crosses the near plane surrounds the camera so nothing can hide it
+            if (clip.w <= 0 || clip.z < -clip.w)
+                return false;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            rectangleMin = glm::min(rectangleMin, glm::vec2(ndc));
+            rectangleMax = glm::max(rectangleMax, glm::vec2(ndc));
+            nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        glm::ivec2 first = glm::ivec2(glm::floor((rectangleMin * 0.5f + 0.5f) * glm::vec2(size))) - 1;
+        glm::ivec2 last = glm::ivec2(glm::floor((rectangleMax * 0.5f + 0.5f) * glm::vec2(size))) + 1;
+        first = glm::max(first, glm::ivec2(0));
+        last = glm::min(last, size - 1);
+        //. the box is outside the buffer (the frustum culling decides whether it is drawn)
+        if (first.x > last.x || first.y > last.y)
+            return false;
+
+        //. a block whose farthest depth is in front of the box hides the part of the box inside it
+        //. otherwise, the pixels of the block inside the rectangle are tested one by one
+        int blocksPerRow = size.x / HIZ_BLOCK;
+        for (int blockY = first.y / HIZ_BLOCK; blockY <= last.y / HIZ_BLOCK; blockY++)
+        {
+            for (int blockX = first.x / HIZ_BLOCK; blockX <= last.x / HIZ_BLOCK; blockX++)
+            {
+                if (nearest > blockDepth[(size_t)blockY * blocksPerRow + blockX])
+                    continue;
+                int rowFirst = std::max(first.y, blockY * HIZ_BLOCK), rowLast = std::min(last.y, blockY * HIZ_BLOCK + HIZ_BLOCK - 1);
+                int columnFirst = std::max(first.x, blockX * HIZ_BLOCK), columnLast = std::min(last.x, blockX * HIZ_BLOCK + HIZ_BLOCK - 1);
+                for (int y = rowFirst; y <= rowLast; y++)
+                {
+                    const float *row = depth.data() + (size_t)y * size.x;
+                    for (int x = columnFirst; x <= columnLast; x++)
+                        if (nearest <= row[x])
+                            return false;
+                }
+            }
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+#include "worker-pool.hpp"
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace our
+{
+
+    // Software occlusion culling: a few large occluders are rasterized every frame on the CPU into a small depth buffer,
+    // then the bounding box of every object is tested against it before its commands are emitted, so the objects hidden
+    // behind the road, the ground or the obstacles are never sent to the GPU. It doesn't call OpenGL after loading.
+    // - The occluders are copies of the positions of the meshes made at load time (see "addOccluderMesh")
+    //   They keep the full detail since a simplified mesh can bulge out of the original surface and hide the objects in front of it
+    // - The buffer is split into tiles that are rasterized in parallel (every triangle is binned to the tiles its bounds touch)
+    //   and the pixels of a row are rasterized 4 at a time using SSE2 (or a scalar loop where it isn't available)
+    // - Every tile also keeps the farthest depth of each block of pixels (a level of hierarchical Z)
+    //   so most boxes are accepted or rejected by reading a few blocks instead of all their pixels
+    //.--------------------------------------------------------------------
+    //. depth: the depth in [0, 1] (like the depth buffer, 1 is the far plane) of the nearest occluder of every pixel, row by row
+    //. blockDepth: the farthest depth of every HIZ_BLOCK x HIZ_BLOCK block, row by row
+    //.--------------------------------------------------------------------
+    // A box is occluded only if its nearest depth is behind the depth of every pixel it may cover (the covered rectangle is grown
+    // by a pixel since an occluder covers the whole pixel when it covers its center)
+    class OcclusionCuller
+    {
+    public:
+        static constexpr int TILE_WIDTH = 64, TILE_HEIGHT = 32, HIZ_BLOCK = 8;
+
+        // An occluder to rasterize in the next frame
+        struct Occluder
+        {
+            const Mesh *mesh;
+            glm::mat4 MVP;
+        };
+
+        // Some numbers about the last frame
+        struct Statistics
+        {
+            int occluders = 0;        // The number of occluders rasterized
+            int triangles = 0;        // The number of their triangles that reached the screen (after clipping)
+            double rasterTime = 0;    // The CPU time (in milliseconds) spent rasterizing them
+        };
+
+    private:
+        // The copy of the positions of a mesh (in its local space)
+        struct OccluderMesh
+        {
+            std::vector<glm::vec3> positions;
+            std::vector<unsigned int> elements;
+        };
+        // A triangle ready to be rasterized: its edge functions and its depth plane in pixel coordinates
+        // (the edge functions are positive inside the triangle) and its bounds in pixels
+        struct ScreenTriangle
+        {
+            glm::vec3 edges[3]; // a * x + b * y + c for every edge
+            glm::vec3 depth;    // a * x + b * y + c
+            glm::ivec2 min, max;
+        };
+
+        glm::ivec2 size = glm::ivec2(0);
+        glm::ivec2 tileCount = glm::ivec2(0);
+        std::vector<float> depth, blockDepth;
+        std::unordered_map<const Mesh *, OccluderMesh> occluderMeshes;
+
+        // These are kept between frames to avoid reallocating them
+        std::vector<ScreenTriangle> triangles;
+        std::vector<std::vector<unsigned int>> tileTriangles; // The triangles binned to every tile
+        std::vector<glm::vec4> clipPositions;
+
+        // Clips the triangle against the near plane and adds the parts that reach the screen to "triangles"
+        void addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+        // Clears the tile, rasterizes its triangles and computes the farthest depth of its blocks
+        void rasterizeTile(int tile);
+
+    public:
+        // The statistics of the last frame
+        Statistics statistics;
+
+        // Allocates the depth buffer (the size is rounded up to whole tiles)
+        void initialize(glm::ivec2 size);
+        // Forgets the occluder meshes and releases the buffers
+        void destroy();
+
+        // Copies the positions of the full detail level of the mesh to use it as an occluder
+        // Returns false (and the mesh is not an occluder) if it has more than "maxTriangles" triangles, since it would take too long to rasterize
+        // It reads the mesh back from the arena so it must be called while loading, on the thread that owns the OpenGL context
+        bool addOccluderMesh(const Mesh *mesh, size_t maxTriangles);
+        bool hasOccluderMesh(const Mesh *mesh) const { return occluderMeshes.count(mesh) != 0; }
+
+        // Clears the depth buffer and rasterizes the given occluders (the tiles are spread over the workers if "workers" isn't null)
+        void render(const std::vector<Occluder> &occluders, WorkerPool *workers);
+
+        // Returns true if the box (in the space that MVP transforms to the clip space) is behind the occluders of the last frame
+        // It only reads the depth buffer so it can be called by many threads at once
+        bool isBoxOccluded(const glm::mat4 &MVP, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const;
+
+        glm::ivec2 getSize() const { return size; }
+    };
+
+}
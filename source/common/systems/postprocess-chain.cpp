@@ -0,0 +1,192 @@
+#include "postprocess-chain.hpp"
+#include "../deserialize-utils.hpp"
+
+#include <iostream>
+#include <map>
+
+namespace our
+{
+    bool PostprocessChain::initialize(glm::ivec2 windowSize, const nlohmann::json &config)
+    {
+        //. a single shader path is a chain of one pass that reads the scene
+        nlohmann::json passesConfig = config.is_string() ? nlohmann::json::array({{{"shader", config}}}) : config;
+        if (!passesConfig.is_array() || passesConfig.empty())
+        {
+            std::cerr << "ERROR: The postprocess config must be a shader path or a list of passes" << std::endl;
+            return false;
+        }
+
+        std::map<std::string, int> passIndices = {{"scene", SCENE_COLOR}, {"depth", SCENE_DEPTH}};
+        for (size_t index = 0; index < passesConfig.size(); index++)
+        {
+            const nlohmann::json &passConfig = passesConfig[index];
+            Pass pass;
+            pass.name = passConfig.value("name", "pass" + std::to_string(index));
+
+            std::string shaderPath = passConfig.value("shader", "");
+            std::vector<std::string> defines = passConfig.value("defines", std::vector<std::string>());
+            pass.program = new ShaderProgram();
+            bool compiled = pass.program->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER) &&
+                            pass.program->attach(shaderPath, GL_FRAGMENT_SHADER, defines) &&
+                            pass.program->link();
+            passes.push_back(pass); // pushed before checking so "destroy" deletes its program
+            if (!compiled)
+            {
+                std::cerr << "ERROR: Couldn't create the postprocess pass \"" << pass.name << "\"" << std::endl;
+                return false;
+            }
+
+            //. by default, a pass reads the output of the one before it as "tex"
+            nlohmann::json inputs = passConfig.value("inputs", nlohmann::json::object({{"tex", index == 0 ? "scene" : passes[index - 1].name}}));
+            for (auto &[uniform, source] : inputs.items())
+            {
+                auto it = passIndices.find(source.get<std::string>());
+                if (it == passIndices.end())
+                {
+                    std::cerr << "ERROR: The postprocess pass \"" << pass.name << "\" reads \"" << source.get<std::string>()
+                              << "\" which isn't the scene or a pass before it" << std::endl;
+                    return false;
+                }
+                passes.back().inputs.push_back({uniform, it->second});
+            }
+            passIndices[pass.name] = (int)index;
+
+            float scale = 1.0f;
+            if (nlohmann::json scaleConfig = passConfig.value("scale", nlohmann::json("full")); scaleConfig.is_number())
+                scale = scaleConfig.get<float>();
+            else
+                scale = scaleConfig == "quarter" ? 0.25f : (scaleConfig == "half" ? 0.5f : 1.0f);
+            passes.back().size = glm::max(glm::ivec2(glm::vec2(windowSize) * scale), glm::ivec2(1));
+            passes.back().format = GL_RGBA8;
+            glGenQueries(2, passes.back().timeQueries);
+            if (auto format = gl_enum_deserialize::render_target_formats.find(passConfig.value("format", "GL_RGBA8"));
+                format != gl_enum_deserialize::render_target_formats.end())
+                passes.back().format = format->second;
+
+            //. the uniforms never change so they are set once
+            ShaderProgram *program = passes.back().program;
+            program->use();
+            nlohmann::json uniforms = passConfig.value("uniforms", nlohmann::json::object());
+            for (auto &[uniform, value] : uniforms.items())
+            {
+                if (value.is_number())
+                    program->set(uniform, value.get<float>());
+                else if (value.is_array() && value.size() == 2)
+                    program->set(uniform, value.get<glm::vec2>());
+                else if (value.is_array() && value.size() == 3)
+                    program->set(uniform, value.get<glm::vec3>());
+                else if (value.is_array() && value.size() == 4)
+                    program->set(uniform, value.get<glm::vec4>());
+            }
+        }
+
+        //. find the last pass that reads the output of every pass
+        std::vector<size_t> lastReader(passes.size());
+        for (size_t index = 0; index < passes.size(); index++)
+        {
+            lastReader[index] = index;
+            for (auto &[uniform, source] : passes[index].inputs)
+                if (source >= 0)
+                    lastReader[source] = index;
+        }
+        //. assign the targets in the order of the passes: a pass takes a target from the pool for its output
+        //. then the targets of the outputs it was the last one to read go back to the pool
+        //. (the output is taken first so a pass never writes to a target it reads)
+        for (size_t index = 0; index < passes.size(); index++)
+        {
+            if (index + 1 < passes.size())
+                passes[index].output = pool.acquire(passes[index].size, passes[index].format);
+            for (size_t source = 0; source <= index; source++)
+                if (lastReader[source] == index && passes[source].output)
+                    pool.release(passes[source].output);
+        }
+
+        sampler = new Sampler();
+        sampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        sampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenVertexArrays(1, &vertexArray);
+        pipelineState.depthMask = false;
+        return true;
+    }
+
+    void PostprocessChain::destroy()
+    {
+        for (Pass &pass : passes)
+        {
+            delete pass.program;
+            glDeleteQueries(2, pass.timeQueries);
+        }
+        passes.clear();
+        pool.destroy();
+        delete sampler;
+        sampler = nullptr;
+        glDeleteVertexArrays(1, &vertexArray);
+        vertexArray = 0;
+    }
+
+    void PostprocessChain::render(Texture2D *sceneColor, Texture2D *sceneDepth, GLuint finalFramebuffer, glm::ivec2 windowSize)
+    {
+        pipelineState.setup();
+        glBindVertexArray(vertexArray);
+        for (Pass &pass : passes)
+        {
+            //. read the query we are about to reuse, if it isn't done yet, this pass isn't timed in this frame instead of waiting
+            bool timed = true;
+            if (pass.timeQueryPending[timeQueryIndex])
+            {
+                GLuint available = 0;
+                glGetQueryObjectuiv(pass.timeQueries[timeQueryIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint64 nanoseconds = 0;
+                    glGetQueryObjectui64v(pass.timeQueries[timeQueryIndex], GL_QUERY_RESULT, &nanoseconds);
+                    pass.gpuTime = nanoseconds * 1e-6;
+                    pass.timeQueryPending[timeQueryIndex] = false;
+                }
+                else
+                {
+                    timed = false;
+                }
+            }
+            if (timed)
+                glBeginQuery(GL_TIME_ELAPSED, pass.timeQueries[timeQueryIndex]);
+
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pass.output ? pass.output->framebuffer : finalFramebuffer);
+            glViewport(0, 0, pass.output ? pass.size.x : windowSize.x, pass.output ? pass.size.y : windowSize.y);
+            pass.program->use();
+            for (size_t unit = 0; unit < pass.inputs.size(); unit++)
+            {
+                auto &[uniform, source] = pass.inputs[unit];
+                Texture2D *texture = source == SCENE_COLOR ? sceneColor : (source == SCENE_DEPTH ? sceneDepth : passes[source].output->texture);
+                glActiveTexture(GL_TEXTURE0 + (GLenum)unit);
+                texture->bind();
+                sampler->bind((GLuint)unit);
+                pass.program->set(uniform, (GLint)unit);
+            }
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            if (timed)
+            {
+                glEndQuery(GL_TIME_ELAPSED);
+                pass.timeQueryPending[timeQueryIndex] = true;
+            }
+        }
+        timeQueryIndex = 1 - timeQueryIndex;
+        glViewport(0, 0, windowSize.x, windowSize.y);
+    }
+
+    double PostprocessChain::getGpuTime() const
+    {
+        double total = 0;
+        for (const Pass &pass : passes)
+        {
+            if (pass.gpuTime < 0)
+                return -1;
+            total += pass.gpuTime;
+        }
+        return total;
+    }
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "framebuffer-pool.hpp"
+#include "../shader/shader.hpp"
+#include "../texture/sampler.hpp"
+#include "../material/pipeline-state.hpp"
+
+#include <json/json.hpp>
+#include <string>
+#include <vector>
+
+namespace our
+{
+
+    // A post-processing chain is a list of fullscreen passes applied to the scene after it is drawn
+    // Every pass reads some textures (the scene color, the scene depth or the outputs of the passes before it)
+    // and writes to its own target, except the last pass which writes to the screen
+    // A pass can run at a lower resolution than the window (e.g. a blur at half resolution does a quarter of the work)
+    // The targets of the passes are taken from a framebuffer pool when the chain is created: once no later pass reads the output
+    // of a pass, its target is given back to the pool so a later pass with the same size and format can write to it
+    //.--------------------------------------------------------------------
+    //. the config is either the path of a fragment shader (a chain of one pass) or a list of passes, each pass may contain:
+    //.     - shader: the path of the fragment shader (the vertex shader is "assets/shaders/fullscreen.vert")
+    //.     - name: (default: "pass<index>") the name used by the later passes to read the output of this pass
+    //.     - inputs: (default: {"tex": the previous pass or "scene" for the first pass}) maps the sampler uniforms of the shader
+    //.               to the name of a pass before this one, "scene" (the scene color) or "depth" (the scene depth)
+    //.     - scale: (default: "full") "full", "half", "quarter" or a number (e.g. 0.125), the size of the output relative to the window
+    //.     - format: (default: "GL_RGBA8") the format of the output (e.g. "GL_RGBA16F" to keep the values above 1)
+    //.     - defines: (default: []) the defines used to compile the shader
+    //.     - uniforms: (default: {}) the values of the float (or vector) uniforms of the shader, they are set once
+    //. The GPU time of every pass is measured with timer queries (GL_TIME_ELAPSED) which are read 2 frames later so they never stall
+    //.--------------------------------------------------------------------
+    class PostprocessChain
+    {
+        // The inputs that aren't outputs of a pass
+        static constexpr int SCENE_COLOR = -1, SCENE_DEPTH = -2;
+
+        struct Pass
+        {
+            std::string name;
+            ShaderProgram *program = nullptr;
+            // The sampler uniform of every input and where it is read from (the index of a pass, SCENE_COLOR or SCENE_DEPTH)
+            std::vector<std::pair<std::string, int>> inputs;
+            glm::ivec2 size;
+            GLenum format;
+            RenderTarget *output = nullptr; // nullptr for the last pass (it draws to the framebuffer bound by the caller)
+            // Two timer queries used alternately, a query is only read when it is reused (if its result is available)
+            GLuint timeQueries[2] = {};
+            bool timeQueryPending[2] = {};
+            double gpuTime = -1; // The last GPU time (in milliseconds) read from the queries (-1 if it isn't known yet)
+        };
+
+        std::vector<Pass> passes;
+        FramebufferPool pool;
+        Sampler *sampler = nullptr;
+        GLuint vertexArray = 0;
+        // The passes don't use depth testing, blending or face culling, and they don't write to the depth buffer
+        PipelineState pipelineState;
+        int timeQueryIndex = 0;
+
+    public:
+        // Creates the passes described by the config and assigns their targets
+        // Returns false if a shader fails to compile or an input can't be found (the chain should not be used then)
+        bool initialize(glm::ivec2 windowSize, const nlohmann::json &config);
+        void destroy();
+
+        // Applies the passes to the given scene textures, the last pass draws to "finalFramebuffer" (0 for the screen)
+        // The viewport is set to the size of every pass and returned to the window size at the end
+        void render(Texture2D *sceneColor, Texture2D *sceneDepth, GLuint finalFramebuffer, glm::ivec2 windowSize);
+
+        // The number of passes and the number of targets they share
+        size_t getPassCount() const { return passes.size(); }
+        size_t getTargetCount() const { return pool.getTargetCount(); }
+        // The name of the pass and its last measured GPU time in milliseconds (-1 if it isn't known yet)
+        const std::string &getPassName(size_t index) const { return passes[index].name; }
+        double getPassTime(size_t index) const { return passes[index].gpuTime; }
+        // The sum of the GPU times of all the passes (-1 if any of them isn't known yet)
+        double getGpuTime() const;
+
+        PostprocessChain() = default;
+        ~PostprocessChain() { destroy(); }
+
+        PostprocessChain(const PostprocessChain &) = delete;
+        PostprocessChain &operator=(const PostprocessChain &) = delete;
+    };
+
+}
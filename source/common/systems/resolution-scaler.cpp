@@ -0,0 +1,78 @@
+#include "resolution-scaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace our
+{
+    void ResolutionScaler::initialize(const nlohmann::json &config)
+    {
+        targetFrameTime = config.value("targetFrameTime", targetFrameTime);
+        minScale = std::clamp(config.value("minScale", minScale), 0.1f, 1.0f);
+        maxScale = std::clamp(config.value("maxScale", maxScale), minScale, 1.0f);
+        scale = maxScale;
+        smoothedTime = gpuTime = -1;
+        cooldown = 0;
+        glGenQueries(QUERY_FRAMES, startQueries);
+        glGenQueries(QUERY_FRAMES, endQueries);
+    }
+
+    void ResolutionScaler::destroy()
+    {
+        glDeleteQueries(QUERY_FRAMES, startQueries);
+        glDeleteQueries(QUERY_FRAMES, endQueries);
+        for (int index = 0; index < QUERY_FRAMES; index++)
+        {
+            startQueries[index] = endQueries[index] = 0;
+            queryPending[index] = false;
+        }
+    }
+
+    void ResolutionScaler::adjust()
+    {
+        if (cooldown > 0)
+        {
+            cooldown--;
+            return;
+        }
+        if (smoothedTime <= targetFrameTime && smoothedTime >= targetFrameTime * HEADROOM)
+            return;
+        //. aim at the middle of the band so a change doesn't land right on its border
+        double aim = targetFrameTime * (1.0f + HEADROOM) * 0.5f;
+        float wanted = scale * (float)std::sqrt(aim / std::max(smoothedTime, 1e-3));
+        float next = std::clamp(std::clamp(wanted, scale - MAX_STEP, scale + MAX_STEP), minScale, maxScale);
+        if (std::abs(next - scale) < MIN_STEP)
+            return;
+        scale = next;
+        cooldown = QUERY_FRAMES;
+    }
+
+    void ResolutionScaler::beginFrame()
+    {
+        //. read the frame that used these queries QUERY_FRAMES frames ago, if it isn't done yet, it isn't measured instead of waiting
+        if (queryPending[queryIndex])
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(endQueries[queryIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 start = 0, end = 0;
+                glGetQueryObjectui64v(startQueries[queryIndex], GL_QUERY_RESULT, &start);
+                glGetQueryObjectui64v(endQueries[queryIndex], GL_QUERY_RESULT, &end);
+                gpuTime = (end - start) * 1e-6;
+                smoothedTime = smoothedTime < 0 ? gpuTime : smoothedTime + (gpuTime - smoothedTime) * SMOOTHING;
+                adjust();
+            }
+            queryPending[queryIndex] = false;
+        }
+        glQueryCounter(startQueries[queryIndex], GL_TIMESTAMP);
+    }
+
+    void ResolutionScaler::endFrame()
+    {
+        glQueryCounter(endQueries[queryIndex], GL_TIMESTAMP);
+        queryPending[queryIndex] = true;
+        queryIndex = (queryIndex + 1) % QUERY_FRAMES;
+    }
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+
+namespace our
+{
+
+    // Dynamic resolution: the renderer draws the scene to the bottom left part of its offscreen targets whose size is the window size
+    // times "scale", then stretches it to the window (see "ForwardRenderer::submit"). The scaler measures the GPU time of every frame
+    // and adjusts the scale so this time stays near the target: the number of shaded pixels grows with the square of the scale
+    // so the scale is multiplied by sqrt(target / time) (by small steps, since a frame is only measured a few frames after it is drawn)
+    //.--------------------------------------------------------------------
+    //. the config may contain:
+    //.     - targetFrameTime: (default: 16.6) the GPU time (in milliseconds) that a frame should take
+    //.     - minScale: (default: 0.5) the smallest scale of the resolution
+    //.     - maxScale: (default: 1.0) the largest scale of the resolution
+    //. The GPU time is measured with two GL_TIMESTAMP queries per frame (GL_TIME_ELAPSED queries can't be nested
+    //. inside the timer queries of the postprocess passes) which are read QUERY_FRAMES frames later so they never stall
+    //.--------------------------------------------------------------------
+    class ResolutionScaler
+    {
+    public:
+        static constexpr int QUERY_FRAMES = 3;
+        // The scale isn't changed while the time is between HEADROOM * target and the target (so it doesn't keep bouncing)
+        static constexpr float HEADROOM = 0.85f;
+        // The largest change of the scale in a single step and the smallest one worth a change
+        static constexpr float MAX_STEP = 0.05f, MIN_STEP = 0.01f;
+        // The weight of a new measurement in the smoothed time
+        static constexpr float SMOOTHING = 0.2f;
+
+    private:
+        float targetFrameTime = 16.6f;
+        float minScale = 0.5f, maxScale = 1.0f;
+        float scale = 1.0f;
+        double smoothedTime = -1; // The smoothed GPU time of the frames (-1 if no frame was measured yet)
+        double gpuTime = -1;      // The GPU time of the last measured frame
+
+        GLuint startQueries[QUERY_FRAMES] = {}, endQueries[QUERY_FRAMES] = {};
+        bool queryPending[QUERY_FRAMES] = {};
+        int queryIndex = 0;
+        // The number of measurements left before the scale can change again (the frames drawn before a change don't show its effect)
+        int cooldown = 0;
+
+        // Changes the scale using the smoothed time
+        void adjust();
+
+    public:
+        // Reads the config and creates the queries
+        void initialize(const nlohmann::json &config);
+        void destroy();
+
+        // Reads the queries of the oldest frame (if the GPU is done with it), adjusts the scale then starts timing a new frame
+        // This should be called before the first command of the frame
+        void beginFrame();
+        // Stops timing the frame (after its last command)
+        void endFrame();
+
+        float getScale() const { return scale; }
+        // The size of the part of the targets that the scene is drawn to
+        glm::ivec2 getRenderSize(glm::ivec2 windowSize) const { return glm::max(glm::ivec2(glm::vec2(windowSize) * scale + 0.5f), glm::ivec2(1)); }
+        float getTargetFrameTime() const { return targetFrameTime; }
+        // The GPU time (in milliseconds) of the last measured frame (-1 if it isn't known yet)
+        double getGpuTime() const { return gpuTime; }
+    };
+
+}
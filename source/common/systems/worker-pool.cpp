@@ -0,0 +1,83 @@
+#include "worker-pool.hpp"
+
+#include <algorithm>
+
+namespace our
+{
+    WorkerPool::WorkerPool(unsigned int threadCount)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int index = 1; index < threadCount; index++)
+            workers.emplace_back(&WorkerPool::work, this);
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    void WorkerPool::run(size_t count, const std::function<void(size_t)> &task)
+    {
+        //. a single index (or a pool without workers) isn't worth waking the workers
+        if (workers.empty() || count <= 1)
+        {
+            for (size_t index = 0; index < count; index++)
+                task(index);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->task = &task;
+            taskCount = count;
+            nextIndex = 0;
+            busyWorkers = workers.size();
+            generation++;
+        }
+        wakeWorkers.notify_all();
+
+        for (size_t index = nextIndex++; index < count; index = nextIndex++)
+            task(index);
+
+        //. the task is owned by the caller so we must wait till no worker can still be running it
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeCaller.wait(lock, [this]() { return busyWorkers == 0; });
+        this->task = nullptr;
+    }
+
+    void WorkerPool::work()
+    {
+        unsigned int seenGeneration = 0;
+        while (true)
+        {
+            const std::function<void(size_t)> *currentTask;
+            size_t count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeWorkers.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+                if (stopping)
+                    return;
+                seenGeneration = generation;
+                currentTask = task;
+                count = taskCount;
+            }
+
+            for (size_t index = nextIndex++; index < count; index = nextIndex++)
+                (*currentTask)(index);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busyWorkers--;
+            }
+            wakeCaller.notify_one();
+        }
+    }
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace our
+{
+
+    // A pool of worker threads that stay alive between the calls to "run" so work done every frame
+    // doesn't pay for creating threads every frame (unlike the OBJ parser which creates its threads once per file)
+    // The calling thread works too, so a pool of N threads has N - 1 workers
+    class WorkerPool
+    {
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeWorkers, wakeCaller;
+
+        // The task being run, the number of its indices and the next index that wasn't taken yet
+        const std::function<void(size_t)> *task = nullptr;
+        size_t taskCount = 0;
+        std::atomic<size_t> nextIndex{0};
+        size_t busyWorkers = 0;       // The workers that didn't finish the current task yet (protected by "mutex")
+        unsigned int generation = 0;  // Incremented by every "run" so the workers know there is a new task (protected by "mutex")
+        bool stopping = false;
+
+        // The loop of the worker threads (waits for a task, takes its indices till none is left, then waits again)
+        void work();
+
+    public:
+        // Creates a pool of "threadCount" threads (including the caller), 0 uses all the hardware threads
+        explicit WorkerPool(unsigned int threadCount = 0);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        // The number of threads that run the tasks (including the caller)
+        size_t getThreadCount() const { return workers.size() + 1; }
+
+        // Runs "task(index)" for every index in [0, count) on the workers and the calling thread
+        // The indices are taken one by one so a slow index doesn't hold up the others, and this returns once all of them are done
+        void run(size_t count, const std::function<void(size_t)> &task);
+    };
+
+}
@@ -0,0 +1,332 @@
+#include "frame-capture.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace our
+{
+
+    // Makes sure the directory that will hold the file exists
+    static bool createParentDirectory(const std::string &filename)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), ec);
+        return !ec;
+    }
+
+    void FrameCapture::initialize()
+    {
+        if (writer.joinable())
+            return;
+        for (auto &readbackBuffer : readbackBuffers)
+            glGenBuffers(1, &readbackBuffer.buffer);
+        stopping = false;
+        writer = std::thread(&FrameCapture::work, this);
+    }
+
+    void FrameCapture::destroy()
+    {
+        if (!writer.joinable())
+            return;
+        stopStream();
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWriter.notify_all();
+        writer.join();
+        for (auto &readbackBuffer : readbackBuffers)
+        {
+            glDeleteBuffers(1, &readbackBuffer.buffer);
+            readbackBuffer = ReadbackBuffer();
+        }
+        firstPending = pendingCount = 0;
+        freePixels.clear();
+    }
+
+    void FrameCapture::work()
+    {
+        while (true)
+        {
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeWriter.wait(lock, [this]() { return stopping || !frames.empty(); });
+                // The frames that are already queued are written before stopping
+                if (frames.empty())
+                    return;
+                frame = std::move(frames.front());
+                frames.pop_front();
+                writing = true;
+            }
+            // There is room for another frame now
+            wakeMain.notify_all();
+
+            if (!frame.filename.empty())
+                writePNG(frame);
+            else
+                writeStreamFrame(frame);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                writing = false;
+                freePixels.push_back(std::move(frame.pixels));
+            }
+            wakeMain.notify_all();
+        }
+    }
+
+    void FrameCapture::writePNG(const Frame &frame)
+    {
+        // Drop the alpha (the default framebuffer's alpha is whatever the blending left there) but keep the rows bottom first
+        // and let stb flip them while writing
+        size_t pixelCount = (size_t)frame.size.x * frame.size.y;
+        convertedPixels.resize(3 * pixelCount);
+        for (size_t pixel = 0; pixel < pixelCount; ++pixel)
+            std::memcpy(&convertedPixels[3 * pixel], &frame.pixels[4 * pixel], 3);
+        stbi_flip_vertically_on_write(true);
+        if (createParentDirectory(frame.filename) &&
+            stbi_write_png(frame.filename.c_str(), frame.size.x, frame.size.y, 3, convertedPixels.data(), 0))
+        {
+            std::cout << "Screenshot saved to: " << frame.filename << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to save a screenshot to: " << frame.filename << std::endl;
+        }
+    }
+
+    void FrameCapture::writeStreamFrame(const Frame &frame)
+    {
+        if (!stream)
+            return;
+        // The formats can't change the size in the middle of the stream
+        if (streamSize == glm::ivec2(0))
+        {
+            streamSize = frame.size;
+            if (streamFormat == StreamFormat::Y4M)
+                fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", streamSize.x, streamSize.y, streamFps);
+        }
+        else if (frame.size != streamSize)
+        {
+            ++skippedFrames;
+            return;
+        }
+
+        int width = streamSize.x, height = streamSize.y;
+        // The rows are read back bottom first while both formats store them top first
+        auto pixel = [&](int x, int y) { return &frame.pixels[4 * ((size_t)(height - 1 - y) * width + x)]; };
+        if (streamFormat == StreamFormat::PPM)
+        {
+            fprintf(stream, "P6\n%d %d\n255\n", width, height);
+            convertedPixels.resize(3 * (size_t)width * height);
+            unsigned char *output = convertedPixels.data();
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x, output += 3)
+                    std::memcpy(output, pixel(x, y), 3);
+        }
+        else
+        {
+            fputs("FRAME\n", stream);
+            // Full range BT.601 (as in JPEG) with the chroma of every 2x2 block averaged (the last block is smaller if the size is odd)
+            int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+            size_t lumaSize = (size_t)width * height, chromaSize = (size_t)chromaWidth * chromaHeight;
+            convertedPixels.resize(lumaSize + 2 * chromaSize);
+            unsigned char *luma = convertedPixels.data(), *cb = luma + lumaSize, *cr = cb + chromaSize;
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                {
+                    const unsigned char *rgb = pixel(x, y);
+                    luma[(size_t)y * width + x] = (unsigned char)std::clamp(0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2] + 0.5f, 0.0f, 255.0f);
+                }
+            for (int cy = 0; cy < chromaHeight; ++cy)
+                for (int cx = 0; cx < chromaWidth; ++cx)
+                {
+                    float r = 0, g = 0, b = 0;
+                    int count = 0;
+                    for (int y = 2 * cy; y < std::min(2 * cy + 2, height); ++y)
+                        for (int x = 2 * cx; x < std::min(2 * cx + 2, width); ++x, ++count)
+                        {
+                            const unsigned char *rgb = pixel(x, y);
+                            r += rgb[0], g += rgb[1], b += rgb[2];
+                        }
+                    r /= count, g /= count, b /= count;
+                    size_t index = (size_t)cy * chromaWidth + cx;
+                    cb[index] = (unsigned char)std::clamp(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 0.0f, 255.0f);
+                    cr[index] = (unsigned char)std::clamp(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 0.0f, 255.0f);
+                }
+        }
+        if (fwrite(convertedPixels.data(), 1, convertedPixels.size(), stream) == convertedPixels.size())
+            ++streamFrames;
+        else
+            ++skippedFrames;
+    }
+
+    void FrameCapture::readback(glm::ivec2 size, const std::string &filename)
+    {
+        if (!writer.joinable() || size.x <= 0 || size.y <= 0)
+            return;
+        // If the whole ring is still in flight, the oldest readback must arrive before its buffer is reused
+        if (pendingCount == READBACK_BUFFER_COUNT)
+            collect(true);
+
+        ReadbackBuffer &readbackBuffer = readbackBuffers[(firstPending + pendingCount) % READBACK_BUFFER_COUNT];
+        GLsizeiptr byteSize = 4 * (GLsizeiptr)size.x * size.y;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer.buffer);
+        if (readbackBuffer.capacity < byteSize)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, byteSize, nullptr, GL_STREAM_READ);
+            readbackBuffer.capacity = byteSize;
+        }
+        // RGBA rows are always aligned to 4 bytes, and reading RGBA lets the driver copy the pixels without converting them
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadBuffer(GL_BACK);
+        glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readbackBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readbackBuffer.size = size;
+        readbackBuffer.filename = filename;
+        ++pendingCount;
+    }
+
+    bool FrameCapture::collect(bool wait)
+    {
+        if (pendingCount == 0)
+            return false;
+        ReadbackBuffer &readbackBuffer = readbackBuffers[firstPending];
+        // Waiting must flush the commands or the fence may never be signaled
+        GLenum status = glClientWaitSync(readbackBuffer.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            if (!wait)
+                return false;
+            // Something is very wrong with the GPU if a copy takes a second, so wait without a limit
+            glFinish();
+        }
+        glDeleteSync(readbackBuffer.fence);
+        readbackBuffer.fence = 0;
+        // If the wait failed, the copy may still be writing to the buffer, so its pixels can't be trusted and the frame is dropped
+        if (status == GL_WAIT_FAILED)
+        {
+            if (!reportedWaitFailure)
+                std::cerr << "Failed to wait for a frame capture readback, its frame is dropped (reported once)" << std::endl;
+            reportedWaitFailure = true;
+            readbackBuffer.filename.clear();
+            firstPending = (firstPending + 1) % READBACK_BUFFER_COUNT;
+            --pendingCount;
+            return true;
+        }
+
+        Frame frame;
+        frame.filename = std::move(readbackBuffer.filename);
+        frame.size = readbackBuffer.size;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freePixels.empty())
+            {
+                frame.pixels = std::move(freePixels.back());
+                freePixels.pop_back();
+            }
+        }
+        size_t byteSize = 4 * (size_t)frame.size.x * frame.size.y;
+        frame.pixels.resize(byteSize);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer.buffer);
+        if (void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)byteSize, GL_MAP_READ_BIT))
+        {
+            std::memcpy(frame.pixels.data(), data, byteSize);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        else
+        {
+            std::cerr << "Failed to map a frame capture buffer" << std::endl;
+            frame.pixels.clear();
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        firstPending = (firstPending + 1) % READBACK_BUFFER_COUNT;
+        --pendingCount;
+
+        if (frame.pixels.empty())
+            return true;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (frames.size() >= MAX_QUEUED_FRAMES)
+            {
+                ++stalls;
+                wakeMain.wait(lock, [this]() { return frames.size() < MAX_QUEUED_FRAMES; });
+            }
+            frames.push_back(std::move(frame));
+        }
+        wakeWriter.notify_one();
+        return true;
+    }
+
+    void FrameCapture::flush()
+    {
+        while (collect(true));
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeMain.wait(lock, [this]() { return frames.empty() && !writing; });
+    }
+
+    void FrameCapture::screenshot(const std::string &filename, glm::ivec2 size)
+    {
+        readback(size, filename);
+    }
+
+    bool FrameCapture::startStream(const std::string &filename, int fps)
+    {
+        if (!writer.joinable())
+            return false;
+        stopStream();
+        std::string extension = std::filesystem::path(filename).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        // The writer isn't touching the stream since there is none, so it can be set up here
+        if (!createParentDirectory(filename) || !(stream = fopen(filename.c_str(), "wb")))
+        {
+            std::cerr << "Failed to open the capture file: " << filename << std::endl;
+            return false;
+        }
+        streamFilename = filename;
+        streamFormat = extension == ".ppm" ? StreamFormat::PPM : StreamFormat::Y4M;
+        streamFps = std::max(1, fps);
+        streamSize = glm::ivec2(0);
+        streamFrames = skippedFrames = stalls = 0;
+        std::cout << "Capturing the frames to: " << filename << std::endl;
+        return true;
+    }
+
+    void FrameCapture::stopStream()
+    {
+        if (!stream)
+            return;
+        // The frames in flight still belong to the stream
+        flush();
+        fclose(stream);
+        stream = nullptr;
+        std::cout << "Captured " << streamFrames << " frames to: " << streamFilename;
+        if (skippedFrames > 0)
+            std::cout << " (" << skippedFrames << " skipped)";
+        if (stalls > 0)
+            std::cout << " (waited " << stalls << " times for the disk)";
+        std::cout << std::endl;
+    }
+
+    void FrameCapture::captureFrame(glm::ivec2 size)
+    {
+        if (stream)
+            readback(size, "");
+    }
+
+    void FrameCapture::update()
+    {
+        while (collect(false));
+    }
+
+}
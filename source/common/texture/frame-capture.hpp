@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace our
+{
+
+    // The frame capture reads the default framebuffer back without stalling the frame that asked for it.
+    // - "glReadPixels" writes into a ring of pixel pack buffers (PBOs) so it only queues a copy on the GPU,
+    //   and every readback is protected by a fence. "update" maps the readbacks whose fence is signaled (a few frames later)
+    //   and copies their pixels out, so the CPU never waits for the GPU unless the whole ring is still in flight.
+    // - The pixels are handed to a writer thread which encodes the screenshots to PNG or appends the frames to the stream.
+    //   At most "MAX_QUEUED_FRAMES" frames wait for the writer: if the disk can't keep up, the frame that hands over
+    //   the next one waits for it instead of piling the frames up in memory (these waits are counted as stalls).
+    // A stream stores every frame uncompressed in a single file (so nothing is lost and writing it costs almost nothing):
+    //.--------------------------------------------------------------------
+    //. Y4M: the YUV4MPEG2 format (full range BT.601 YCbCr with 4:2:0 chroma) which most video tools read directly
+    //. PPM: binary PPM images (P6) one after the other, e.g. "ffmpeg -f image2pipe -c:v ppm -i capture.ppm ..."
+    //.--------------------------------------------------------------------
+    // Everything except the writer thread must be called on the thread that owns the OpenGL context (e.g. in a render job).
+    class FrameCapture
+    {
+    public:
+        enum class StreamFormat
+        {
+            Y4M,
+            PPM
+        };
+
+        static constexpr int READBACK_BUFFER_COUNT = 3;
+        static constexpr size_t MAX_QUEUED_FRAMES = 4;
+
+    private:
+        // A pixel pack buffer of the ring and the readback it holds
+        struct ReadbackBuffer
+        {
+            GLuint buffer = 0;
+            GLsizeiptr capacity = 0;
+            GLsync fence = 0;
+            glm::ivec2 size = glm::ivec2(0);
+            std::string filename; // The screenshot file (empty if the readback is a frame of the stream)
+        };
+
+        // Pixels read back (RGBA8, bottom row first) waiting for the writer
+        struct Frame
+        {
+            std::string filename; // Same as in "ReadbackBuffer"
+            glm::ivec2 size = glm::ivec2(0);
+            std::vector<unsigned char> pixels;
+        };
+
+        ReadbackBuffer readbackBuffers[READBACK_BUFFER_COUNT];
+        int firstPending = 0, pendingCount = 0; // The readbacks in flight are consecutive in the ring (oldest first)
+        bool reportedWaitFailure = false;       // The frames whose fence can't be waited for are dropped, but only the first one is reported
+
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable wakeWriter, wakeMain;
+        std::deque<Frame> frames;                          // Waiting to be written (protected by "mutex")
+        std::vector<std::vector<unsigned char>> freePixels; // Pixel vectors given back by the writer to be reused (protected by "mutex")
+        bool writing = false;                              // True while the writer works on a frame (protected by "mutex")
+        bool stopping = false;
+
+        // The stream (only touched by the writer while it is open, except by "startStream" and "stopStream")
+        FILE *stream = nullptr;
+        std::string streamFilename;
+        StreamFormat streamFormat = StreamFormat::Y4M;
+        int streamFps = 60;
+        glm::ivec2 streamSize = glm::ivec2(0); // The size of the first frame (0 till it is written)
+        long long streamFrames = 0, skippedFrames = 0, stalls = 0;
+        std::vector<unsigned char> convertedPixels; // The writer's conversion buffer
+
+        // The loop of the writer thread (writes the frames till the capture is destroyed)
+        void work();
+        void writePNG(const Frame &frame);
+        void writeStreamFrame(const Frame &frame);
+        // Queues a readback of the default framebuffer into the next buffer of the ring (waiting for the oldest one if the ring is full)
+        void readback(glm::ivec2 size, const std::string &filename);
+        // Copies the oldest readback out of its buffer and hands it to the writer
+        // If its fence isn't signaled yet, it either waits for it (if "wait" is true) or returns false
+        // If waiting for the fence fails, the readback is dropped (its buffer may still be written to)
+        bool collect(bool wait);
+        // Collects all the readbacks then waits till the writer has written everything
+        void flush();
+
+    public:
+        // Creates the buffers of the ring and starts the writer thread
+        void initialize();
+        // Writes everything that was captured, closes the stream then deletes the buffers and stops the writer thread
+        void destroy();
+
+        // Reads the default framebuffer back and saves it (without its alpha) to a PNG file once its pixels arrive
+        // This should be called after drawing the frame and before swapping the buffers
+        void screenshot(const std::string &filename, glm::ivec2 size);
+
+        // Starts writing every frame passed to "captureFrame" to the given file (the format is picked from its extension: ".ppm" or else Y4M)
+        // "fps" is only written in the Y4M header as the frame rate at which the video plays
+        bool startStream(const std::string &filename, int fps);
+        // Writes the frames in flight and closes the stream
+        void stopStream();
+        [[nodiscard]] bool isStreaming() const { return stream != nullptr; }
+        // Reads the default framebuffer back and appends it to the stream (if any)
+        // All the frames should have the size of the first one, the others are skipped
+        void captureFrame(glm::ivec2 size);
+
+        // Hands the readbacks that arrived to the writer (should be called once per frame)
+        void update();
+
+        FrameCapture() = default;
+        ~FrameCapture() { destroy(); }
+
+        FrameCapture(const FrameCapture &) = delete;
+        FrameCapture &operator=(const FrameCapture &) = delete;
+    };
+
+}
@@ -0,0 +1,170 @@
+#include "texture-array.hpp"
+#include "texture-compression.hpp"
+
+#include <glm/common.hpp>
+#include <map>
+#include <tuple>
+
+namespace our
+{
+    //. finds the block format of a compressed internal format, returns false if it isn't one of ours
+    static bool findBlockFormat(GLenum internalFormat, texture_compression::BlockFormat &format)
+    {
+        for (std::uint32_t index = 0; index < (std::uint32_t)texture_compression::BlockFormat::COUNT; index++)
+        {
+            if (texture_compression::getInternalFormat((texture_compression::BlockFormat)index) == internalFormat)
+            {
+                format = (texture_compression::BlockFormat)index;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //. the number of bytes of a single layer of the given level
+    static size_t getLayerSize(GLenum internalFormat, glm::ivec2 size)
+    {
+        texture_compression::BlockFormat blockFormat;
+        if (findBlockFormat(internalFormat, blockFormat))
+            return texture_compression::getCompressedSize(blockFormat, size);
+        return 4 * (size_t)size.x * size.y; //. RGBA8 is the only uncompressed format we pack
+    }
+
+    TextureArray::TextureArray(GLenum format, glm::ivec2 size, GLsizei levelCount, GLsizei layerCount, const GLint swizzle[4])
+        : format(format), size(size), levelCount(levelCount), layerCount(layerCount)
+    {
+        glGenTextures(1, &name);
+        bind();
+        //. every level is allocated without data (we don't use glTexStorage3D since it needs OpenGL 4.2)
+        texture_compression::BlockFormat blockFormat;
+        bool compressed = findBlockFormat(format, blockFormat);
+        glm::ivec2 levelSize = size;
+        for (GLsizei level = 0; level < levelCount; level++)
+        {
+            if (compressed)
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelSize.x, levelSize.y, layerCount, 0,
+                                       (GLsizei)(getLayerSize(format, levelSize) * layerCount), nullptr);
+            else
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelSize.x, levelSize.y, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    void TextureArray::copyLayer(GLint layer, Texture2D *texture)
+    {
+        glm::ivec2 levelSize = size;
+        if (GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_copy_image)
+        {
+            //. a GPU to GPU copy (the depth of the copy is the number of layers so we copy one layer per level)
+            for (GLsizei level = 0; level < levelCount; level++)
+            {
+                glCopyImageSubData(texture->getOpenGLName(), GL_TEXTURE_2D, level, 0, 0, 0,
+                                   name, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelSize.x, levelSize.y, 1);
+                levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+            }
+            return;
+        }
+
+        //. otherwise, every level is read back to the RAM then sent to the layer
+        texture_compression::BlockFormat blockFormat;
+        bool compressed = findBlockFormat(format, blockFormat);
+        std::vector<unsigned char> data;
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (GLsizei level = 0; level < levelCount; level++)
+        {
+            data.resize(getLayerSize(format, levelSize));
+            texture->bind();
+            if (compressed)
+                glGetCompressedTexImage(GL_TEXTURE_2D, level, data.data());
+            else
+                glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+            bind();
+            if (compressed)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelSize.x, levelSize.y, 1, format,
+                                          (GLsizei)data.size(), data.data());
+            else
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelSize.x, levelSize.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+            levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+        }
+        Texture2D::unbind();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    std::vector<TextureArray *> buildTextureArrays(const std::vector<Texture2D *> &textures,
+                                                   std::unordered_map<Texture2D *, TextureArrayLayer> &layers)
+    {
+        //. the properties that every layer of an array must share
+        //. (the swizzle is a property of the array so it must match too, e.g. a BC4 map is spread to all the color channels)
+        using ArrayKey = std::tuple<GLenum, int, int, GLsizei, GLint, GLint, GLint, GLint>;
+        std::map<ArrayKey, std::vector<Texture2D *>> groups;
+
+        glActiveTexture(GL_TEXTURE0);
+        for (Texture2D *texture : textures)
+        {
+            if (texture == nullptr || layers.count(texture))
+                continue;
+            texture->bind();
+            GLint internalFormat, width, height, maxLevel;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+            glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+            texture_compression::BlockFormat blockFormat;
+            if (width == 0 || height == 0 || (internalFormat != GL_RGBA8 && !findBlockFormat(internalFormat, blockFormat)))
+                continue;
+
+            //. only the levels that were specified are copied (e.g. a texture loaded without mipmaps has only level 0
+            //. even though its max level is still the default 1000)
+            GLsizei levelCount = 1;
+            for (glm::ivec2 levelSize(width, height); levelCount <= maxLevel && (levelSize.x > 1 || levelSize.y > 1); levelCount++)
+            {
+                levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+                GLint levelWidth;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, levelCount, GL_TEXTURE_WIDTH, &levelWidth);
+                if (levelWidth != levelSize.x)
+                    break;
+            }
+
+            GLint swizzle[4];
+            glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+            std::vector<Texture2D *> &group = groups[{(GLenum)internalFormat, width, height, levelCount, swizzle[0], swizzle[1], swizzle[2], swizzle[3]}];
+            //. mark the texture as seen so a texture listed twice gets a single layer
+            layers[texture] = {nullptr, (GLint)group.size()};
+            group.push_back(texture);
+        }
+        Texture2D::unbind();
+
+        std::vector<TextureArray *> arrays;
+        for (auto &[key, group] : groups)
+        {
+            auto &[format, width, height, levelCount, swizzleR, swizzleG, swizzleB, swizzleA] = key;
+            GLint swizzle[4] = {swizzleR, swizzleG, swizzleB, swizzleA};
+            TextureArray *array = new TextureArray(format, {width, height}, levelCount, (GLsizei)group.size(), swizzle);
+            for (Texture2D *texture : group)
+            {
+                TextureArrayLayer &layer = layers[texture];
+                layer.array = array;
+                array->copyLayer(layer.layer, texture);
+            }
+            arrays.push_back(array);
+        }
+        return arrays;
+    }
+
+    TextureArray *createPlaceholderArray()
+    {
+        const GLint swizzle[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+        const unsigned char white[4] = {255, 255, 255, 255};
+        TextureArray *array = new TextureArray(GL_RGBA8, {1, 1}, 1, 1, swizzle);
+        array->bind();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return array;
+    }
+
+}
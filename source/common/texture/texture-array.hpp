@@ -0,0 +1,74 @@
+#pragma once
+
+#include "texture2d.hpp"
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace our
+{
+
+    // This class defines an OpenGL texture which will be used as a GL_TEXTURE_2D_ARRAY
+    // All the layers of an array share the same internal format, size and number of mip levels,
+    // so textures that match in these properties can be packed into one array and bound together with a single bind
+    // (the shader then picks the texture by its layer instead of by its texture unit)
+    class TextureArray
+    {
+        // The OpenGL object name of this texture
+        GLuint name = 0;
+        GLenum format;
+        glm::ivec2 size;
+        GLsizei levelCount, layerCount;
+
+    public:
+        // Creates an array with undefined content (the layers are filled by "copyLayer")
+        // @param swizzle: the texture swizzle (GL_TEXTURE_SWIZZLE_RGBA) applied when the array is sampled
+        TextureArray(GLenum format, glm::ivec2 size, GLsizei levelCount, GLsizei layerCount, const GLint swizzle[4]);
+        ~TextureArray()
+        {
+            glDeleteTextures(1, &name);
+        }
+
+        GLuint getOpenGLName() const { return name; }
+        GLenum getFormat() const { return format; }
+        glm::ivec2 getSize() const { return size; }
+        GLsizei getLevelCount() const { return levelCount; }
+        GLsizei getLayerCount() const { return layerCount; }
+
+        // This method binds this texture to GL_TEXTURE_2D_ARRAY
+        // NOTE: the active texture unit should be chosen before calling this function
+        void bind() const
+        {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, name);
+        }
+
+        // Copies all the levels of the given texture (which must have the format, size and level count of the array) into a layer
+        // The copy stays on the GPU if the driver has glCopyImageSubData (OpenGL 4.3), otherwise it is read back through the RAM
+        void copyLayer(GLint layer, Texture2D *texture);
+
+        TextureArray(const TextureArray &) = delete;
+        TextureArray &operator=(const TextureArray &) = delete;
+    };
+
+    // The place of a texture inside the arrays built by "buildTextureArrays"
+    struct TextureArrayLayer
+    {
+        TextureArray *array = nullptr;
+        GLint layer = 0;
+    };
+
+    // Packs the given textures into texture arrays: the textures with the same format, size, level count and swizzle
+    // share an array (and a texture that matches no other gets an array of one layer)
+    // The textures are read as they are now so the streamed textures must be uploaded first (see "TextureStreamer::isLoading")
+    // A texture whose format can't be copied (neither RGBA8 nor a compressed format) is left out of "layers"
+    // @return: the created arrays (owned by the caller)
+    std::vector<TextureArray *> buildTextureArrays(const std::vector<Texture2D *> &textures,
+                                                   std::unordered_map<Texture2D *, TextureArrayLayer> &layers);
+
+    // Creates an array of a single white RGBA8 texel (one layer, one level) to bind while the real arrays can't be built yet
+    // (the same placeholder as the streamed textures, see "TextureStreamer::load")
+    TextureArray *createPlaceholderArray();
+
+}
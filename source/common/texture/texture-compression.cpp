@@ -0,0 +1,416 @@
+#include "texture-compression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace our::texture_compression
+{
+
+    static const char *FORMAT_NAMES[(int)BlockFormat::COUNT] = {"bc1", "bc3", "bc4", "bc5"};
+
+    GLenum getInternalFormat(BlockFormat format)
+    {
+        switch (format)
+        {
+        case BlockFormat::BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        default:
+            return GL_COMPRESSED_RG_RGTC2;
+        }
+    }
+
+    const char *getFormatName(BlockFormat format)
+    {
+        return FORMAT_NAMES[(int)format];
+    }
+
+    bool parseFormatName(const std::string &name, BlockFormat &format)
+    {
+        for (int index = 0; index < (int)BlockFormat::COUNT; index++)
+        {
+            if (name == FORMAT_NAMES[index])
+            {
+                format = (BlockFormat)index;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The number of bytes in a single block
+    static size_t getBlockSize(BlockFormat format)
+    {
+        return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+    }
+
+    size_t getCompressedSize(BlockFormat format, glm::ivec2 size)
+    {
+        return (size_t)((size.x + 3) / 4) * ((size.y + 3) / 4) * getBlockSize(format);
+    }
+
+    BlockFormat chooseFormat(const unsigned char *pixels, glm::ivec2 size)
+    {
+        bool grayscale = true, opaque = true;
+        for (size_t index = 0, count = (size_t)size.x * size.y; index < count; index++)
+        {
+            const unsigned char *texel = pixels + 4 * index;
+            //. allow a small difference between the channels since JPEG doesn't keep gray images exactly gray
+            if (std::abs(texel[0] - texel[1]) > 3 || std::abs(texel[1] - texel[2]) > 3)
+                grayscale = false;
+            if (texel[3] != 255)
+                opaque = false;
+        }
+        if (!opaque)
+            return BlockFormat::BC3;
+        return grayscale ? BlockFormat::BC4 : BlockFormat::BC1;
+    }
+
+    //. ---------------------------------------------- BC1 (color) ----------------------------------------------
+
+    // Converts a color to 5:6:5 (with rounding) and back to 8 bits per channel (by replicating the high bits)
+    static std::uint16_t packColor(const float color[3])
+    {
+        int r = (int)std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f);
+        int g = (int)std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f);
+        int b = (int)std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f);
+        return (std::uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackColor(std::uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // The 4 colors of a BC1 block in the 4-color mode (the endpoints then the two colors in between)
+    static void getColorPalette(std::uint16_t color0, std::uint16_t color1, int palette[4][3])
+    {
+        unpackColor(color0, palette[0]);
+        unpackColor(color1, palette[1]);
+        for (int channel = 0; channel < 3; channel++)
+        {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+    }
+
+    // Picks the closest palette color for every texel and returns the total squared error
+    static int findColorIndices(const unsigned char texels[16][4], std::uint16_t color0, std::uint16_t color1, int indices[16])
+    {
+        int palette[4][3];
+        getColorPalette(color0, color1, palette);
+        int error = 0;
+        for (int texel = 0; texel < 16; texel++)
+        {
+            int best = 0, bestDistance = INT32_MAX;
+            for (int index = 0; index < 4; index++)
+            {
+                int distance = 0;
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    int difference = texels[texel][channel] - palette[index][channel];
+                    distance += difference * difference;
+                }
+                if (distance < bestDistance)
+                {
+                    best = index;
+                    bestDistance = distance;
+                }
+            }
+            indices[texel] = best;
+            error += bestDistance;
+        }
+        return error;
+    }
+
+    // Finds the endpoints that best fit the texels for the given indices (least squares)
+    // Returns false if all the texels use the same weight (so the endpoints can't be solved)
+    static bool fitColorEndpoints(const unsigned char texels[16][4], const int indices[16], float endpoint0[3], float endpoint1[3])
+    {
+        //. every texel is approximated as "weight * endpoint0 + (1 - weight) * endpoint1"
+        static const float WEIGHTS[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0, ab = 0, bb = 0, ax[3] = {}, bx[3] = {};
+        for (int texel = 0; texel < 16; texel++)
+        {
+            float a = WEIGHTS[indices[texel]], b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int channel = 0; channel < 3; channel++)
+            {
+                ax[channel] += a * texels[texel][channel];
+                bx[channel] += b * texels[texel][channel];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+        for (int channel = 0; channel < 3; channel++)
+        {
+            endpoint0[channel] = (ax[channel] * bb - bx[channel] * ab) / determinant;
+            endpoint1[channel] = (bx[channel] * aa - ax[channel] * ab) / determinant;
+        }
+        return true;
+    }
+
+    // Writes the endpoints and indices of a BC1 block while making sure it uses the 4-color mode (color0 > color1)
+    static void writeColorBlock(std::uint16_t color0, std::uint16_t color1, const int indices[16], unsigned char *block)
+    {
+        //. swapping the endpoints swaps the index pairs (0, 1) and (2, 3)
+        int flip = color0 < color1 ? 1 : 0;
+        if (flip)
+            std::swap(color0, color1);
+        std::uint32_t bits = 0;
+        for (int texel = 0; texel < 16; texel++)
+            bits |= (std::uint32_t)(color0 == color1 ? 0 : indices[texel] ^ flip) << (2 * texel);
+        std::memcpy(block, &color0, 2);
+        std::memcpy(block + 2, &color1, 2);
+        std::memcpy(block + 4, &bits, 4);
+    }
+
+    // Compresses the colors of the 16 texels into a BC1 block (8 bytes)
+    // The endpoints start at the extremes of the colors along their principal axis, then are refined once by least squares
+    static void encodeColorBlock(const unsigned char texels[16][4], unsigned char *block)
+    {
+        float mean[3] = {};
+        for (int texel = 0; texel < 16; texel++)
+            for (int channel = 0; channel < 3; channel++)
+                mean[channel] += texels[texel][channel] / 16.0f;
+        float covariance[3][3] = {};
+        for (int texel = 0; texel < 16; texel++)
+            for (int row = 0; row < 3; row++)
+                for (int column = 0; column < 3; column++)
+                    covariance[row][column] += (texels[texel][row] - mean[row]) * (texels[texel][column] - mean[column]);
+
+        //. the principal axis is found by power iteration (starting from the luminance axis which is usually close)
+        float axis[3] = {0.3f, 0.6f, 0.1f};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3] = {};
+            for (int row = 0; row < 3; row++)
+                for (int column = 0; column < 3; column++)
+                    next[row] += covariance[row][column] * axis[column];
+            float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+            if (length < 1e-6f)
+                break;
+            for (int channel = 0; channel < 3; channel++)
+                axis[channel] = next[channel] / length;
+        }
+        float low = 0, high = 0;
+        for (int texel = 0; texel < 16; texel++)
+        {
+            float projection = 0;
+            for (int channel = 0; channel < 3; channel++)
+                projection += (texels[texel][channel] - mean[channel]) * axis[channel];
+            low = std::min(low, projection);
+            high = std::max(high, projection);
+        }
+        float endpoint0[3], endpoint1[3];
+        for (int channel = 0; channel < 3; channel++)
+        {
+            endpoint0[channel] = mean[channel] + high * axis[channel];
+            endpoint1[channel] = mean[channel] + low * axis[channel];
+        }
+
+        std::uint16_t color0 = packColor(endpoint0), color1 = packColor(endpoint1);
+        int indices[16];
+        int error = findColorIndices(texels, color0, color1, indices);
+        if (error > 0 && fitColorEndpoints(texels, indices, endpoint0, endpoint1))
+        {
+            std::uint16_t fitted0 = packColor(endpoint0), fitted1 = packColor(endpoint1);
+            int fittedIndices[16];
+            if (findColorIndices(texels, fitted0, fitted1, fittedIndices) < error)
+            {
+                color0 = fitted0;
+                color1 = fitted1;
+                std::memcpy(indices, fittedIndices, sizeof(indices));
+            }
+        }
+        writeColorBlock(color0, color1, indices, block);
+    }
+
+    static void decodeColorBlock(const unsigned char *block, unsigned char texels[16][4])
+    {
+        std::uint16_t color0, color1;
+        std::uint32_t bits;
+        std::memcpy(&color0, block, 2);
+        std::memcpy(&color1, block + 2, 2);
+        std::memcpy(&bits, block + 4, 4);
+        int palette[4][3];
+        getColorPalette(color0, color1, palette);
+        //. in the 3-color mode (color0 <= color1), index 2 is the average and index 3 is black
+        if (color0 <= color1)
+            for (int channel = 0; channel < 3; channel++)
+            {
+                palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+                palette[3][channel] = 0;
+            }
+        for (int texel = 0; texel < 16; texel++)
+        {
+            int index = (bits >> (2 * texel)) & 3;
+            for (int channel = 0; channel < 3; channel++)
+                texels[texel][channel] = (unsigned char)palette[index][channel];
+        }
+    }
+
+    //. ---------------------------------------------- BC4 (single channel) ----------------------------------------------
+
+    // The 8 values of a BC4 block (in the 8-value mode if value0 > value1, otherwise the 6-value mode with 0 and 255)
+    static void getValuePalette(int value0, int value1, int palette[8])
+    {
+        palette[0] = value0;
+        palette[1] = value1;
+        if (value0 > value1)
+        {
+            for (int index = 1; index < 7; index++)
+                palette[index + 1] = ((7 - index) * value0 + index * value1) / 7;
+        }
+        else
+        {
+            for (int index = 1; index < 5; index++)
+                palette[index + 1] = ((5 - index) * value0 + index * value1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // Compresses one channel of the 16 texels into a BC4 block (8 bytes) using their minimum and maximum as the endpoints
+    static void encodeValueBlock(const unsigned char texels[16][4], int channel, unsigned char *block)
+    {
+        int low = 255, high = 0;
+        for (int texel = 0; texel < 16; texel++)
+        {
+            low = std::min(low, (int)texels[texel][channel]);
+            high = std::max(high, (int)texels[texel][channel]);
+        }
+        std::uint64_t bits = 0;
+        if (high > low)
+        {
+            int palette[8];
+            getValuePalette(high, low, palette);
+            for (int texel = 0; texel < 16; texel++)
+            {
+                int best = 0;
+                for (int index = 1; index < 8; index++)
+                    if (std::abs(texels[texel][channel] - palette[index]) < std::abs(texels[texel][channel] - palette[best]))
+                        best = index;
+                bits |= (std::uint64_t)best << (3 * texel);
+            }
+        }
+        block[0] = (unsigned char)high;
+        block[1] = (unsigned char)low;
+        //. the 48 bits of indices are stored in little endian order
+        for (int byte = 0; byte < 6; byte++)
+            block[2 + byte] = (unsigned char)(bits >> (8 * byte));
+    }
+
+    static void decodeValueBlock(const unsigned char *block, unsigned char texels[16][4], int channel)
+    {
+        int palette[8];
+        getValuePalette(block[0], block[1], palette);
+        std::uint64_t bits = 0;
+        for (int byte = 0; byte < 6; byte++)
+            bits |= (std::uint64_t)block[2 + byte] << (8 * byte);
+        for (int texel = 0; texel < 16; texel++)
+            texels[texel][channel] = (unsigned char)palette[(bits >> (3 * texel)) & 7];
+    }
+
+    //. ---------------------------------------------- Images ----------------------------------------------
+
+    void compress(BlockFormat format, const unsigned char *pixels, glm::ivec2 size, unsigned char *blocks)
+    {
+        size_t blockSize = getBlockSize(format);
+        for (int blockY = 0; blockY < size.y; blockY += 4)
+        {
+            for (int blockX = 0; blockX < size.x; blockX += 4)
+            {
+                //. the texels outside the image (in the partial blocks at the edges) repeat the last row and column
+                unsigned char texels[16][4];
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sourceX = std::min(blockX + x, size.x - 1), sourceY = std::min(blockY + y, size.y - 1);
+                        std::memcpy(texels[4 * y + x], pixels + 4 * ((size_t)sourceY * size.x + sourceX), 4);
+                    }
+                switch (format)
+                {
+                case BlockFormat::BC1:
+                    encodeColorBlock(texels, blocks);
+                    break;
+                case BlockFormat::BC3:
+                    encodeValueBlock(texels, 3, blocks);
+                    encodeColorBlock(texels, blocks + 8);
+                    break;
+                case BlockFormat::BC4:
+                    encodeValueBlock(texels, 0, blocks);
+                    break;
+                default:
+                    encodeValueBlock(texels, 0, blocks);
+                    encodeValueBlock(texels, 1, blocks + 8);
+                    break;
+                }
+                blocks += blockSize;
+            }
+        }
+    }
+
+    void decompress(BlockFormat format, const unsigned char *blocks, glm::ivec2 size, unsigned char *pixels)
+    {
+        size_t blockSize = getBlockSize(format);
+        for (int blockY = 0; blockY < size.y; blockY += 4)
+        {
+            for (int blockX = 0; blockX < size.x; blockX += 4)
+            {
+                unsigned char texels[16][4];
+                switch (format)
+                {
+                case BlockFormat::BC1:
+                    decodeColorBlock(blocks, texels);
+                    for (auto &texel : texels)
+                        texel[3] = 255;
+                    break;
+                case BlockFormat::BC3:
+                    decodeValueBlock(blocks, texels, 3);
+                    decodeColorBlock(blocks + 8, texels);
+                    break;
+                case BlockFormat::BC4:
+                    decodeValueBlock(blocks, texels, 0);
+                    for (auto &texel : texels)
+                        texel[1] = texel[2] = texel[0], texel[3] = 255;
+                    break;
+                default:
+                    decodeValueBlock(blocks, texels, 0);
+                    decodeValueBlock(blocks + 8, texels, 1);
+                    for (auto &texel : texels)
+                        texel[2] = 0, texel[3] = 255;
+                    break;
+                }
+                for (int y = 0; y < 4 && blockY + y < size.y; y++)
+                    for (int x = 0; x < 4 && blockX + x < size.x; x++)
+                        std::memcpy(pixels + 4 * ((size_t)(blockY + y) * size.x + blockX + x), texels[4 * y + x], 4);
+                blocks += blockSize;
+            }
+        }
+    }
+
+    void getSwizzle(BlockFormat format, GLint swizzle[4])
+    {
+        GLint red = GL_RED, green = GL_GREEN, blue = GL_BLUE, alpha = GL_ALPHA;
+        if (format == BlockFormat::BC4)
+            green = blue = GL_RED, alpha = GL_ONE;
+        else if (format == BlockFormat::BC5)
+            blue = GL_ZERO, alpha = GL_ONE;
+        swizzle[0] = red;
+        swizzle[1] = green;
+        swizzle[2] = blue;
+        swizzle[3] = alpha;
+    }
+
+}
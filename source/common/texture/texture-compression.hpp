@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <cstdint>
+#include <string>
+
+// CPU encoders and decoders for the block compressed texture formats.
+// Every format splits the image into blocks of 4x4 texels and stores each block in a fixed number of bytes,
+// so the GPU can sample the texture without decompressing it first (and it takes 4 to 8 times less memory than RGBA8).
+// The images are always given and returned as RGBA8 (4 bytes per texel, rows from bottom to top as in OpenGL).
+namespace our::texture_compression
+{
+    enum class BlockFormat : std::uint32_t
+    {
+        BC1,   // RGB in 8 bytes per block (two 5:6:5 endpoints and 2-bit indices), for opaque color maps
+        BC3,   // RGBA in 16 bytes per block (a BC4 block for the alpha then a BC1 block for the color), for color maps with alpha
+        BC4,   // A single channel in 8 bytes per block (RGTC1: two 8-bit endpoints and 3-bit indices), for grayscale maps
+        BC5,   // Two channels in 16 bytes per block (RGTC2: a BC4 block for each channel), for tangent-space normal maps (XY only)
+        COUNT
+    };
+
+    // The OpenGL internal format of the block format (e.g. GL_COMPRESSED_RGB_S3TC_DXT1_EXT for BC1)
+    GLenum getInternalFormat(BlockFormat format);
+    // The lower case name of the format (e.g. "bc1")
+    const char *getFormatName(BlockFormat format);
+    // Finds the format with the given name, returns false if there is none
+    bool parseFormatName(const std::string &name, BlockFormat &format);
+    // The number of bytes needed to store an image of the given size (a partial block at the edges takes a whole block)
+    size_t getCompressedSize(BlockFormat format, glm::ivec2 size);
+
+    // Picks the smallest format that keeps the information of the image:
+    // BC4 if it is grayscale and opaque, BC3 if it has transparent texels and BC1 otherwise
+    BlockFormat chooseFormat(const unsigned char *pixels, glm::ivec2 size);
+
+    // Compresses the RGBA8 image into "blocks" (which must hold "getCompressedSize" bytes)
+    // BC4 keeps the red channel and BC5 keeps the red and green channels
+    void compress(BlockFormat format, const unsigned char *pixels, glm::ivec2 size, unsigned char *blocks);
+    // Decompresses the blocks into an RGBA8 image, the channels that the format doesn't store are filled
+    // the same way the texture swizzle fills them on the GPU (see "getSwizzle")
+    void decompress(BlockFormat format, const unsigned char *blocks, glm::ivec2 size, unsigned char *pixels);
+    // The texture swizzle (GL_TEXTURE_SWIZZLE_RGBA) that gives the format the look of its source when it is sampled:
+    // BC4 is spread to all the color channels so a grayscale map still works with ".rgb", and BC5 gets a zero blue channel
+    void getSwizzle(BlockFormat format, GLint swizzle[4]);
+}
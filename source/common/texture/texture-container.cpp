@@ -0,0 +1,210 @@
+#include "texture-container.hpp"
+#include "texture-utils.hpp"
+
+#include <stb/stb_image.h>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace our::texture_container
+{
+    // The container starts with this header (all the fields are little endian since we only target x86 and ARM)
+    // The version must be increased whenever the header or the encoders change
+    struct ContainerHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t sourceSize;
+        std::int64_t sourceTime;
+        std::uint64_t sourceHash;
+        std::uint32_t format;
+        std::uint32_t width, height;
+        std::uint32_t levelCount;
+    };
+
+    // Where the blocks of a level are in the file
+    struct LevelEntry
+    {
+        std::uint64_t offset, size;
+    };
+
+    static const char CONTAINER_MAGIC[4] = {'W', 'R', 'T', 'X'};
+    static const std::uint32_t CONTAINER_VERSION = 1;
+    static const std::uint64_t LEVEL_ALIGNMENT = 16;
+    //. the largest side that a cooked texture may have (the minimum GL_MAX_TEXTURE_SIZE of the GPUs we target)
+    static const std::uint32_t MAX_DIMENSION = 16384;
+    //. "writeFileStamp" writes the three fields of the stamp one after the other
+    static_assert(offsetof(ContainerHeader, sourceHash) == offsetof(ContainerHeader, sourceSize) + 16, "The source stamp must be contiguous");
+
+    std::string getCookedPath(const std::string &source)
+    {
+        return source + ".ctex";
+    }
+
+    bool read(const MappedFile &file, const std::string &source, CookedTexture &texture)
+    {
+        if (!file.isOpen() || file.size() < sizeof(ContainerHeader))
+            return false;
+        const unsigned char *bytes = static_cast<const unsigned char *>(file.data());
+        ContainerHeader header;
+        std::memcpy(&header, bytes, sizeof(ContainerHeader));
+        if (std::memcmp(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0 || header.version != CONTAINER_VERSION ||
+            header.format >= (std::uint32_t)texture_compression::BlockFormat::COUNT)
+            return false;
+        //. the size and level count are checked before reading the level table, so a corrupt header can't make us walk past the file
+        //. (a full mip chain has floor(log2(max(width, height))) + 1 levels)
+        if (header.width == 0 || header.height == 0 || header.width > MAX_DIMENSION || header.height > MAX_DIMENSION)
+            return false;
+        std::uint32_t maxLevelCount = 1;
+        for (std::uint32_t side = std::max(header.width, header.height); side > 1; side /= 2)
+            maxLevelCount++;
+        if (header.levelCount == 0 || header.levelCount > maxLevelCount ||
+            sizeof(ContainerHeader) + header.levelCount * sizeof(LevelEntry) > file.size())
+            return false;
+        //. (a missing source is fine, since the cooked texture can be shipped without the source)
+        texture.sourceStamp = {header.sourceSize, header.sourceTime, header.sourceHash};
+        if (!matchesFileStamp(source, texture.sourceStamp))
+            return false;
+        texture.stampChanged = texture.sourceStamp.time != header.sourceTime;
+
+        texture.format = (texture_compression::BlockFormat)header.format;
+        texture.levelSizes.clear();
+        texture.levelBlocks.clear();
+        texture.levelByteCounts.clear();
+        glm::ivec2 size(header.width, header.height);
+        for (std::uint32_t level = 0; level < header.levelCount; level++)
+        {
+            LevelEntry entry;
+            std::memcpy(&entry, bytes + sizeof(ContainerHeader) + level * sizeof(LevelEntry), sizeof(LevelEntry));
+            //. every level must have the expected size and lie inside the file
+            //. (the size is compared with what is left of the file so the sum can't overflow)
+            if (entry.size != texture_compression::getCompressedSize(texture.format, size) || entry.offset > file.size() ||
+                entry.size > file.size() - entry.offset)
+                return false;
+            texture.levelSizes.push_back(size);
+            texture.levelBlocks.push_back(bytes + entry.offset);
+            texture.levelByteCounts.push_back(entry.size);
+            size = glm::max(size / 2, glm::ivec2(1));
+        }
+        return true;
+    }
+
+    bool writeStamp(const std::string &source, const CookedTexture &texture)
+    {
+        return writeFileStamp(getCookedPath(source), offsetof(ContainerHeader, sourceSize), texture.sourceStamp);
+    }
+
+    bool cook(const std::string &source, const texture_compression::BlockFormat *format, CookReport &report)
+    {
+        ContainerHeader header = {};
+        std::memcpy(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+        header.version = CONTAINER_VERSION;
+        FileStamp stamp;
+        if (!readFileStamp(source, stamp))
+        {
+            std::cerr << "Failed to load image: " << source << std::endl;
+            return false;
+        }
+        header.sourceSize = stamp.size;
+        header.sourceTime = stamp.time;
+        header.sourceHash = stamp.hash;
+
+        //. decode and generate the mips exactly like the runtime does, and time it since this is the work that cooking saves
+        auto start = std::chrono::steady_clock::now();
+        glm::ivec2 size;
+        int channels;
+        stbi_set_flip_vertically_on_load(true);
+        unsigned char *decoded = stbi_load(source.c_str(), &size.x, &size.y, &channels, 4);
+        if (decoded == nullptr)
+        {
+            std::cerr << "Failed to load image: " << source << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> pixels(decoded, decoded + 4 * (size_t)size.x * size.y);
+        stbi_image_free(decoded);
+        std::vector<glm::ivec2> levelSizes = texture_utils::generateMipmaps(pixels, size);
+        report.decodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        report.format = format ? *format : texture_compression::chooseFormat(pixels.data(), size);
+        report.size = size;
+        report.levelCount = levelSizes.size();
+        report.uncompressedBytes = pixels.size();
+        header.format = (std::uint32_t)report.format;
+        header.width = size.x;
+        header.height = size.y;
+        header.levelCount = (std::uint32_t)levelSizes.size();
+
+        //. compress every level into one blob and note where each level starts
+        std::vector<LevelEntry> entries;
+        std::vector<unsigned char> blocks;
+        std::uint64_t offset = sizeof(ContainerHeader) + levelSizes.size() * sizeof(LevelEntry);
+        size_t pixelOffset = 0;
+        for (glm::ivec2 levelSize : levelSizes)
+        {
+            offset = (offset + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+            size_t byteCount = texture_compression::getCompressedSize(report.format, levelSize);
+            entries.push_back({offset, byteCount});
+            blocks.resize(offset + byteCount - entries[0].offset);
+            texture_compression::compress(report.format, &pixels[pixelOffset], levelSize, &blocks[offset - entries[0].offset]);
+            offset += byteCount;
+            pixelOffset += 4 * (size_t)levelSize.x * levelSize.y;
+            report.compressedBytes += byteCount;
+        }
+
+        //. measure the quality of level 0 on the channels that the format keeps
+        std::vector<unsigned char> decompressed(4 * (size_t)size.x * size.y);
+        texture_compression::decompress(report.format, blocks.data(), size, decompressed.data());
+        using texture_compression::BlockFormat;
+        int channelCount = report.format == BlockFormat::BC1 ? 3 : report.format == BlockFormat::BC3 ? 4 : report.format == BlockFormat::BC4 ? 1 : 2;
+        double squaredError = 0;
+        for (size_t texel = 0; texel < decompressed.size() / 4; texel++)
+            for (int channel = 0; channel < channelCount; channel++)
+            {
+                double difference = (double)pixels[4 * texel + channel] - decompressed[4 * texel + channel];
+                squaredError += difference * difference;
+            }
+        double meanSquaredError = squaredError / ((double)size.x * size.y * channelCount);
+        report.psnr = meanSquaredError > 0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+
+        //. we write to a temporary file then rename it, so a crash can never leave a half written container behind
+        std::string path = getCookedPath(source), temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                std::cerr << "Failed to write the cooked texture \"" << path << "\"" << std::endl;
+                return false;
+            }
+            file.write(reinterpret_cast<const char *>(&header), sizeof(ContainerHeader));
+            file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(LevelEntry));
+            while ((std::uint64_t)file.tellp() < entries[0].offset)
+                file.put(0);
+            file.write(reinterpret_cast<const char *>(blocks.data()), blocks.size());
+            if (!file)
+            {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(temporaryPath, error);
+                std::cerr << "Failed to write the cooked texture \"" << path << "\"" << std::endl;
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            std::cerr << "Failed to write the cooked texture \"" << path << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+}
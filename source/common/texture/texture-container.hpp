@@ -0,0 +1,61 @@
+#pragma once
+
+#include "texture-compression.hpp"
+#include "../mapped-file.hpp"
+#include "../file-stamp.hpp"
+
+#include <glm/vec2.hpp>
+#include <string>
+#include <vector>
+
+// The cooked texture container (".ctex") stores an image already compressed to a block format with its whole mip chain,
+// so loading it needs neither image decoding nor mip generation: the levels are handed to the GPU straight from the file mapping.
+// It is written next to its source by the texture cook tool (e.g. "assets/textures/moon.jpg.ctex"). The file contains:
+//.--------------------------------------------------------------------
+//. header: magic, version, the source size, modification time and hash, the block format, the size and the level count
+//. the offset and size of every level
+//. the blocks of every level (each aligned to 16 bytes), from the largest level to 1x1
+//.--------------------------------------------------------------------
+namespace our::texture_container
+{
+    // A view of the levels of a cooked texture inside its mapped file
+    struct CookedTexture
+    {
+        texture_compression::BlockFormat format;
+        std::vector<glm::ivec2> levelSizes;
+        std::vector<const unsigned char *> levelBlocks;
+        std::vector<size_t> levelByteCounts;
+        // The stamp of the source, with its new modification time if the source was only touched since it was cooked
+        FileStamp sourceStamp;
+        bool stampChanged = false; // Whether the stamp should be written back to the container (see "writeStamp")
+    };
+
+    // What the cook did to a texture (to report the savings)
+    struct CookReport
+    {
+        texture_compression::BlockFormat format;
+        glm::ivec2 size;
+        size_t levelCount = 0;
+        size_t uncompressedBytes = 0; // The size of the mip chain in RGBA8
+        size_t compressedBytes = 0;
+        double decodeMilliseconds = 0; // The time needed to decode the source and generate its mips (what the cook saves at runtime)
+        double psnr = 0;               // The peak signal to noise ratio (in dB) of the compressed level 0 compared to the source
+    };
+
+    // Returns the path of the cooked texture of the given source image
+    std::string getCookedPath(const std::string &source);
+
+    // Reads the cooked texture of the given source from its mapped file
+    // Returns false if the file was made by another version, from another source or is truncated
+    // The cooked texture is still valid if only the source modification time changed but its content (hash) is the same
+    bool read(const MappedFile &file, const std::string &source, CookedTexture &texture);
+
+    // Writes the new modification time of the source found by "read" into the cooked texture
+    // so the next reads don't hash the source again (the cooked texture must be unmapped first)
+    bool writeStamp(const std::string &source, const CookedTexture &texture);
+
+    // Decodes the source image, generates its mip chain, compresses every level and writes the cooked texture
+    // If "format" is nullptr, the format is picked from the image content (see "texture_compression::chooseFormat")
+    // Returns false (after printing the error) if the source can't be read or the cooked texture can't be written
+    bool cook(const std::string &source, const texture_compression::BlockFormat *format, CookReport &report);
+}
@@ -0,0 +1,232 @@
+#include "texture-streamer.hpp"
+#include "texture-utils.hpp"
+
+#include <stb/stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace our
+{
+
+    TextureStreamer &TextureStreamer::get()
+    {
+        if (!instance)
+            instance = new TextureStreamer();
+        return *instance;
+    }
+
+    void TextureStreamer::destroy()
+    {
+        delete instance;
+        instance = nullptr;
+    }
+
+    TextureStreamer::TextureStreamer()
+    {
+        for (auto &uploadBuffer : uploadBuffers)
+            glGenBuffers(1, &uploadBuffer.buffer);
+        //. keep a core for the main thread (which is also busy loading the other assets)
+        unsigned int threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned int index = 0; index < threadCount; ++index)
+            workers.emplace_back(&TextureStreamer::work, this);
+    }
+
+    TextureStreamer::~TextureStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+        for (auto &uploadBuffer : uploadBuffers)
+        {
+            if (uploadBuffer.fence)
+                glDeleteSync(uploadBuffer.fence);
+            glDeleteBuffers(1, &uploadBuffer.buffer);
+        }
+    }
+
+    void TextureStreamer::work()
+    {
+        // Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
+        // we need to tell stb to flip images vertically after loading them (this flag is per thread)
+        stbi_set_flip_vertically_on_load_thread(true);
+        while (true)
+        {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeWorkers.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+                request = std::move(requests.front());
+                requests.pop_front();
+                ++inFlight;
+            }
+
+            DecodedImage image;
+            image.texture = request.texture;
+            image.filename = std::move(request.filename);
+            image.generation = request.generation;
+            glm::ivec2 size;
+            int channels;
+            if (unsigned char *pixels = stbi_load(image.filename.c_str(), &size.x, &size.y, &channels, 4))
+            {
+                image.pixels.assign(pixels, pixels + 4 * (size_t)size.x * size.y);
+                stbi_image_free(pixels);
+                if (request.generateMipmap)
+                    image.levelSizes = texture_utils::generateMipmaps(image.pixels, size);
+                else
+                    image.levelSizes = {size};
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --inFlight;
+                //. the texture may have been deleted if the streamer was cancelled while we were decoding
+                if (image.generation == generation)
+                    decoded.push_back(std::move(image));
+            }
+            wakeMain.notify_all();
+        }
+    }
+
+    Texture2D *TextureStreamer::load(const std::string &filename, bool generateMipmap)
+    {
+        Texture2D *texture = new Texture2D();
+        //. fill the texture with a single white texel so that it can be sampled until its image arrives
+        //. the max level is 0 so the texture is complete even if the sampler uses mipmaps
+        const unsigned char placeholder[4] = {255, 255, 255, 255};
+        texture->bind();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        Texture2D::unbind();
+        loading.insert(texture);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({texture, filename, generateMipmap, generation});
+        }
+        wakeWorkers.notify_one();
+        return texture;
+    }
+
+    bool TextureStreamer::upload(const DecodedImage &image, bool wait)
+    {
+        UploadBuffer &uploadBuffer = uploadBuffers[nextUploadBuffer];
+        if (uploadBuffer.fence)
+        {
+            //. when waiting, the commands must be flushed otherwise the fence may never be signaled
+            GLenum status;
+            do
+                status = glClientWaitSync(uploadBuffer.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+            while (wait && status == GL_TIMEOUT_EXPIRED);
+            if (status == GL_TIMEOUT_EXPIRED)
+                return false;
+            glDeleteSync(uploadBuffer.fence);
+            uploadBuffer.fence = 0;
+        }
+
+        GLsizeiptr size = (GLsizeiptr)image.pixels.size();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer.buffer);
+        if (uploadBuffer.capacity < size)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            uploadBuffer.capacity = size;
+        }
+        //. the fence guarantees that the GPU is done with the buffer, so the driver doesn't need to synchronize the mapping
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped)
+            std::memcpy(mapped, image.pixels.data(), image.pixels.size());
+        //. if the mapping failed (or its content was lost while it was mapped), copy the pixels the slow way
+        if (!mapped || glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE)
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, size, image.pixels.data());
+
+        //. while a pixel unpack buffer is bound, the data pointer of glTexImage2D is an offset into it
+        image.texture->bind();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t offset = 0;
+        for (size_t level = 0; level < image.levelSizes.size(); ++level)
+        {
+            glm::ivec2 levelSize = image.levelSizes[level];
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, levelSize.x, levelSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         (void *)offset);
+            offset += 4 * (size_t)levelSize.x * levelSize.y;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levelSizes.size() - 1);
+        Texture2D::unbind();
+        //. unbind the buffer so the other texture uploads read their data from the RAM again
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        uploadBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        nextUploadBuffer = (nextUploadBuffer + 1) % UPLOAD_BUFFER_COUNT;
+        return true;
+    }
+
+    void TextureStreamer::uploadDecoded(size_t byteBudget, bool wait)
+    {
+        size_t uploaded = 0;
+        while (uploaded < byteBudget)
+        {
+            DecodedImage image;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (decoded.empty())
+                    return;
+                image = std::move(decoded.front());
+                decoded.pop_front();
+            }
+            if (image.levelSizes.empty())
+            {
+                std::cerr << "Failed to load image: " << image.filename << std::endl;
+                loading.erase(image.texture);
+                continue;
+            }
+            if (!upload(image, wait))
+            {
+                //. the ring is full, so put the image back and try again in the next update
+                std::lock_guard<std::mutex> lock(mutex);
+                if (image.generation == generation)
+                    decoded.push_front(std::move(image));
+                return;
+            }
+            loading.erase(image.texture);
+            uploaded += image.pixels.size();
+        }
+    }
+
+    void TextureStreamer::update()
+    {
+        uploadDecoded(UPLOAD_BYTES_PER_UPDATE, false);
+    }
+
+    void TextureStreamer::finish()
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeMain.wait(lock, [this]() { return !decoded.empty() || (requests.empty() && inFlight == 0); });
+                if (decoded.empty())
+                    return;
+            }
+            uploadDecoded(SIZE_MAX, true);
+        }
+    }
+
+    void TextureStreamer::cancelAll()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        requests.clear();
+        decoded.clear();
+        loading.clear();
+    }
+
+}
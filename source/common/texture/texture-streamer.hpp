@@ -0,0 +1,111 @@
+#pragma once
+
+#include "texture2d.hpp"
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace our
+{
+
+    // The texture streamer loads image files in the background instead of stalling the main thread.
+    // - The images are decoded (and their mip levels are generated) by a pool of worker threads.
+    // - The main thread copies the decoded images into a ring of pixel unpack buffers (PBOs) and uploads them from there,
+    //   so "glTexImage2D" only queues a copy on the GPU instead of reading the pixels from the RAM.
+    //   Every PBO is protected by a fence so it is only rewritten after the GPU has finished reading it.
+    // The textures returned by "load" can be used right away: they hold a 1x1 white placeholder until their image is uploaded.
+    class TextureStreamer
+    {
+        // An image decoded by a worker with all its mip levels stored consecutively in "pixels" (RGBA8)
+        struct DecodedImage
+        {
+            Texture2D *texture = nullptr;
+            std::string filename;
+            unsigned int generation = 0;
+            std::vector<glm::ivec2> levelSizes; // Empty if the image couldn't be decoded
+            std::vector<unsigned char> pixels;
+        };
+
+        // A job for the workers (the image to decode and the texture that will receive it)
+        struct Request
+        {
+            Texture2D *texture;
+            std::string filename;
+            bool generateMipmap;
+            unsigned int generation;
+        };
+
+        // A pixel unpack buffer of the ring and the fence of the last upload that read from it (0 if none)
+        struct UploadBuffer
+        {
+            GLuint buffer = 0;
+            GLsizeiptr capacity = 0;
+            GLsync fence = 0;
+        };
+
+        static constexpr int UPLOAD_BUFFER_COUNT = 3;
+        // The maximum number of bytes uploaded in a single "update" (a bigger image is still uploaded alone)
+        static constexpr size_t UPLOAD_BYTES_PER_UPDATE = 32 << 20;
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeWorkers, wakeMain;
+        std::deque<Request> requests;     // Waiting to be decoded (protected by "mutex")
+        std::deque<DecodedImage> decoded; // Waiting to be uploaded (protected by "mutex")
+        size_t inFlight = 0;              // The number of requests that are being decoded now (protected by "mutex")
+        bool stopping = false;
+        // Incremented by "cancelAll" so that the images requested before it are dropped when they are decoded
+        unsigned int generation = 0;
+
+        UploadBuffer uploadBuffers[UPLOAD_BUFFER_COUNT];
+        int nextUploadBuffer = 0;
+
+        // The textures returned by "load" that still show their placeholder (only touched by the thread that owns the context)
+        std::unordered_set<const Texture2D *> loading;
+
+        static inline TextureStreamer *instance = nullptr;
+
+        TextureStreamer();
+        ~TextureStreamer();
+
+        // The loop of the worker threads (decodes the requests till the streamer is destroyed)
+        void work();
+        // Copies the image into the next buffer of the ring and uploads it to its texture
+        // If the next buffer is still being read by the GPU, it either waits for it (if "wait" is true) or returns false
+        bool upload(const DecodedImage &image, bool wait);
+        // Uploads the decoded images (in the order they were decoded) till "byteBudget" bytes are uploaded
+        // Stops early if the ring has no free buffer and "wait" is false
+        void uploadDecoded(size_t byteBudget, bool wait);
+
+    public:
+        // Returns the streamer (it is created on the first call so an OpenGL context must be current)
+        static TextureStreamer &get();
+        // Stops the workers and deletes the streamer (all the streamed textures should be deleted before calling this)
+        static void destroy();
+
+        // Creates a texture that shows a placeholder and queues the image file to be decoded in the background
+        // If "generateMipmap" is true, the mip levels are generated on the worker thread
+        Texture2D *load(const std::string &filename, bool generateMipmap = true);
+        // Uploads the images that have been decoded since the last call (should be called once per frame)
+        void update();
+        // Blocks until all the requested textures are uploaded
+        void finish();
+        // Returns true if the texture was returned by "load" and its image hasn't been uploaded yet
+        // (a texture whose image couldn't be decoded is done too, it keeps its placeholder)
+        [[nodiscard]] bool isLoading(const Texture2D *texture) const { return loading.count(texture) != 0; }
+        // Drops all the requests that haven't been uploaded yet
+        // This must be called before deleting textures that are still being streamed
+        void cancelAll();
+
+        TextureStreamer(TextureStreamer const &) = delete;
+        TextureStreamer &operator=(TextureStreamer const &) = delete;
+    };
+
+}
@@ -1,8 +1,12 @@
 #include "texture-utils.hpp"
+#include "texture-container.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
+#include <glm/common.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
 //. this function creates a new texture wit the given size and format
@@ -64,4 +68,104 @@ our::Texture2D *our::texture_utils::loadImage(const std::string &filename, bool
 
     stbi_image_free(pixels); // Free image data after uploading to GPU
     return texture;
-}
\ No newline at end of file
+}
+
+our::Texture2D *our::texture_utils::loadCooked(const std::string &filename)
+{
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    texture_container::CookedTexture cooked;
+    if (!file.open(texture_container::getCookedPath(filename)) || !texture_container::read(file, filename, cooked))
+        return nullptr;
+
+    //. S3TC (BC1 and BC3) is an extension (but every desktop driver has it, including Mesa's software renderers)
+    //. while RGTC (BC4 and BC5) is core since OpenGL 3.0
+    bool supported = cooked.format == texture_compression::BlockFormat::BC4 || cooked.format == texture_compression::BlockFormat::BC5
+                         ? GLAD_GL_VERSION_3_0 || GLAD_GL_ARB_texture_compression_rgtc
+                         : GLAD_GL_EXT_texture_compression_s3tc;
+
+    our::Texture2D *texture = new our::Texture2D();
+    texture->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t videoMemory = 0, uncompressedMemory = 0;
+    std::vector<unsigned char> pixels;
+    for (size_t level = 0; level < cooked.levelSizes.size(); level++)
+    {
+        glm::ivec2 size = cooked.levelSizes[level];
+        uncompressedMemory += 4 * (size_t)size.x * size.y;
+        if (supported)
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, texture_compression::getInternalFormat(cooked.format), size.x, size.y, 0,
+                                   (GLsizei)cooked.levelByteCounts[level], cooked.levelBlocks[level]);
+            videoMemory += cooked.levelByteCounts[level];
+        }
+        else
+        {
+            //. the decompressed texels already have the channels filled like the swizzle would do
+            pixels.resize(4 * (size_t)size.x * size.y);
+            texture_compression::decompress(cooked.format, cooked.levelBlocks[level], size, pixels.data());
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            videoMemory += pixels.size();
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.levelSizes.size() - 1);
+    if (supported)
+    {
+        GLint swizzle[4];
+        texture_compression::getSwizzle(cooked.format, swizzle);
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    Texture2D::unbind();
+    //. the levels are uploaded, so the container can be unmapped to store the new time of a touched source
+    if (cooked.stampChanged)
+    {
+        file.close();
+        texture_container::writeStamp(filename, cooked);
+    }
+
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Texture \"" << filename << "\": " << texture_compression::getFormatName(cooked.format)
+              << (supported ? "" : " (unsupported, decompressed to RGBA8)") << ", " << cooked.levelSizes[0].x << "x" << cooked.levelSizes[0].y
+              << ", VRAM " << videoMemory / 1024 << " KB (instead of " << uncompressedMemory / 1024 << " KB), loaded in "
+              << milliseconds << " ms" << std::endl;
+    return texture;
+}
+
+std::vector<glm::ivec2> our::texture_utils::generateMipmaps(std::vector<unsigned char> &pixels, glm::ivec2 size)
+{
+    std::vector<glm::ivec2> levelSizes = {size};
+    size_t byteCount = 4 * (size_t)size.x * size.y;
+    while (size.x > 1 || size.y > 1)
+    {
+        size = glm::max(size / 2, glm::ivec2(1));
+        levelSizes.push_back(size);
+        byteCount += 4 * (size_t)size.x * size.y;
+    }
+    pixels.resize(byteCount);
+
+    //. every texel of a level is the average of a 2x2 block of the level before it
+    //. for odd sizes, the last row and column of the previous level are repeated
+    size_t offset = 0;
+    for (size_t level = 1; level < levelSizes.size(); level++)
+    {
+        glm::ivec2 sourceSize = levelSizes[level - 1], destinationSize = levelSizes[level];
+        const unsigned char *source = &pixels[offset];
+        offset += 4 * (size_t)sourceSize.x * sourceSize.y;
+        unsigned char *destination = &pixels[offset];
+        for (int y = 0; y < destinationSize.y; ++y)
+        {
+            int y0 = std::min(2 * y, sourceSize.y - 1), y1 = std::min(2 * y + 1, sourceSize.y - 1);
+            for (int x = 0; x < destinationSize.x; ++x)
+            {
+                int x0 = std::min(2 * x, sourceSize.x - 1), x1 = std::min(2 * x + 1, sourceSize.x - 1);
+                for (int channel = 0; channel < 4; ++channel)
+                {
+                    int sum = source[4 * (y0 * sourceSize.x + x0) + channel] + source[4 * (y0 * sourceSize.x + x1) + channel] +
+                              source[4 * (y1 * sourceSize.x + x0) + channel] + source[4 * (y1 * sourceSize.x + x1) + channel];
+                    destination[4 * (y * destinationSize.x + x) + channel] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+    return levelSizes;
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "texture2d.hpp"
 #include <string>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/vec2.hpp>
@@ -19,4 +20,15 @@ namespace our::texture_utils
     // @param generate_mipmap: if true, the function will generate the mipmap for the texture
     // @return: the loaded texture
     Texture2D *loadImage(const std::string &filename, bool generate_mipmap = true);
+    // This function loads the cooked version of an image (see "texture-container.hpp") if it exists and is up to date
+    // The compressed levels are uploaded directly from the mapped file, unless the GPU doesn't support the block format
+    // in which case they are decompressed to RGBA8 on the CPU first
+    // @param filename: the path to the source image (not the cooked file)
+    // @return: the loaded texture or nullptr if the image has no valid cooked version
+    Texture2D *loadCooked(const std::string &filename);
+    // This function generates the mip chain of an RGBA8 image on the CPU by averaging blocks of 2x2 texels
+    // @param pixels: holds level 0 and the other levels are appended to it (each level right after the one before it)
+    // @param size: the size of level 0
+    // @return: the size of every level (from level 0 down to 1x1)
+    std::vector<glm::ivec2> generateMipmaps(std::vector<unsigned char> &pixels, glm::ivec2 size);
 }
\ No newline at end of file
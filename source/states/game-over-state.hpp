@@ -159,8 +159,8 @@ class GameOverstate : public our::State
     {
         // call the movementSystem to update the positions of the entities
         movementSystem.update(&world, (float)deltaTime);
-        // render the world using the renderer
-        renderer.render(&world);
+        // render the world using the renderer (the world is extracted now and drawn later if the render thread is running)
+        getApp()->submitRenderJob(renderer.extractFrame(&world));
         // Get a reference to the keyboard object
         auto &keyboard = getApp()->getKeyboard();
 
@@ -188,8 +188,6 @@ class GameOverstate : public our::State
         }
         // Get the framebuffer size to set the viewport and the create the projection matrix.
         glm::ivec2 size = getApp()->getFrameBufferSize();
-        // Make sure the viewport covers the whole size of the framebuffer.
-        glViewport(0, 0, size.x, size.y);
 
         // The view matrix is an identity (there is no camera that moves around).
         // The projection matrix apply an orthographic projection whose size is the framebuffer size in pixels
@@ -203,18 +201,30 @@ class GameOverstate : public our::State
 
         // First, we apply the fading effect.
         time += (float)deltaTime;
-        menuMaterial->tint = glm::vec4(glm::smoothstep(0.00f, 2.00f, time));
-        // Then we render the menu background
-        // Notice that I don't clear the screen first, since I assume that the menu rectangle will draw over the whole
-        // window anyway.
-        menuMaterial->setup();
-        menuMaterial->shader->set("transform", VP * M);
-        rectangle->draw();
+        glm::vec4 tint = glm::vec4(glm::smoothstep(0.00f, 2.00f, time));
 
         // For every button, check if the mouse is inside it. If the mouse is inside, we draw the highlight mouse-over over it.
+        std::vector<glm::mat4> highlightedButtons;
         for (auto &button : buttons)
         {
             if (button.isInside(mousePosition))
+                highlightedButtons.push_back(button.getLocalToWorld());
+        }
+
+        // The drawing only uses the values computed above so it can run on the render thread
+        getApp()->submitRenderJob([this, size, VP, M, tint, mousePosition, highlightedButtons]()
+                                  {
+            // Make sure the viewport covers the whole size of the framebuffer.
+            glViewport(0, 0, size.x, size.y);
+            // Then we render the menu background
+            // Notice that I don't clear the screen first, since I assume that the menu rectangle will draw over the whole
+            // window anyway.
+            menuMaterial->tint = tint;
+            menuMaterial->setup();
+            menuMaterial->shader->set("transform", VP * M);
+            rectangle->draw();
+
+            for (const glm::mat4 &buttonLocalToWorld : highlightedButtons)
             {
                 highlightMaterial->setup();
                 // set the mouse position uniform to the shader
@@ -222,10 +232,9 @@ class GameOverstate : public our::State
                 highlightMaterial->shader->set("mouse_pos",
                                                glm::vec2(mousePosition.x, size.y - mousePosition.y));
                 // set the transform uniform to the shader
-                highlightMaterial->shader->set("transform", VP * button.getLocalToWorld());
+                highlightMaterial->shader->set("transform", VP * buttonLocalToWorld);
                 rectangle->draw();
-            }
-        }
+            } });
     }
 
     void onDestroy() override
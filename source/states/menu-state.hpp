@@ -59,7 +59,7 @@ class Menustate : public our::State
         // movementSystem.update(&world, (float)deltaTime);
         // Delete all the entities that are marked for deletion
         world.deleteMarkedEntities();
-        renderer.render(&world);
+        getApp()->submitRenderJob(renderer.extractFrame(&world));
         // Get a reference to the keyboard object
         auto &keyboard = getApp()->getKeyboard();
 
@@ -3,7 +3,7 @@
 #include <application.hpp>
 #include <ecs/entity.hpp>
 #include <ecs/world.hpp>
-#include <systems/forward-renderer.hpp>
+#include <systems/deferred-renderer.hpp>
 #include <systems/free-camera-controller.hpp>
 #include <systems/movement.hpp>
 #include <systems/collision.hpp>
@@ -14,6 +14,7 @@
 #include <systems/obstacle-controller.hpp>
 #include <systems/cube-controller.hpp>
 #include <asset-loader.hpp>
+#include <shader/program-cache.hpp>
 #include <components/collision.hpp>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -29,7 +30,9 @@ using namespace irrklang;
 class Playstate : public our::State {
 
     our::World world;
-    our::ForwardRenderer renderer;
+    // the renderer is created from the "type" of the renderer config ("forward" or "deferred") so both can be compared on the same scene
+    our::ForwardRenderer *renderer = nullptr;
+    std::string rendererType;
     our::FreeCameraControllerSystem cameraController;
     our::MovementSystem movementSystem;
     our::CollisionSystem collisionSystem;
@@ -48,6 +51,8 @@ class Playstate : public our::State {
     clock_t start = 0;
     float time_diff = 0;
     int effectDuration = 100;
+    // showStatistics: if true, a small window shows the renderer statistics (enabled by "statistics" in the renderer config)
+    bool showStatistics = false;
 
     void onInitialize() override {
         SoundEngine->play2D("assets/sounds/theme.wav", true);
@@ -67,7 +72,15 @@ class Playstate : public our::State {
         cameraController.enter(getApp());
         // Then we initialize the renderer
         auto size = getApp()->getFrameBufferSize();
-        renderer.initialize(size, config["renderer"]);
+        rendererType = config["renderer"].value("type", "forward");
+        renderer = our::createRendererFromType(rendererType);
+        renderer->initialize(size, config["renderer"]);
+        showStatistics = config["renderer"].value("statistics", false);
+        // merge the meshes of the static entities (if any) to reduce the number of draw calls
+        // (the road, the obstacles and the lamps follow the player so none of the current entities is static)
+        renderer->buildStaticBatches(&world);
+        // simplify the meshes of the occluders (the road and the obstacles) for the occlusion culling
+        renderer->buildOccluders(&world);
         // init the required systems
         collisionSystem.OnInitialize();
         previewController.enter(getApp(), &world);
@@ -75,12 +88,12 @@ class Playstate : public our::State {
         // make sure that the preview camera reads the players avatars from the config file
         previewController.deserializePlayers(config["players-entities"]);
         //        SoundEngine->play2D("assets/sounds/theme.wav", true);
-        renderer.effect = false;
+        renderer->effect = false;
     }
 
     void onDraw(double deltaTime) override {
         // Here, we just run a bunch of systems to control the world logic
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        getApp()->submitRenderJob([]() { glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); });
 
         world.deleteMarkedEntities();
 
@@ -103,7 +116,7 @@ class Playstate : public our::State {
         if (CollidedObject == CollisionType::MONKEY) {
 
             start = clock();
-            renderer.effect = true;
+            renderer->effect = true;
             time_diff = 0;
             cameraController.shake = true;
         }
@@ -124,8 +137,8 @@ class Playstate : public our::State {
         
         // check if the time of post processing effect is finished then disable it and noise as well
         // make start and time_diff = 0 (initial state) to be ready for another collition
-        if (renderer.effect && time_diff >= effectDuration) {
-            renderer.effect = false;
+        if (renderer->effect && time_diff >= effectDuration) {
+            renderer->effect = false;
             start = 0;
             cameraController.shake = false;
             time_diff = 0;
@@ -137,7 +150,8 @@ class Playstate : public our::State {
             time_diff += float(clock() - start) / CLOCKS_PER_SEC;
         }
         // And finally we use the renderer system to draw the scene
-        renderer.render(&world);
+        // the world is extracted now and drawn later if the render thread is running (so the next frame can change the world)
+        getApp()->submitRenderJob(renderer->extractFrame(&world));
         // Get a reference to the keyboard object
         auto &keyboard = getApp()->getKeyboard();
 
@@ -167,6 +181,69 @@ class Playstate : public our::State {
         ImGui::Text(current_coins.c_str());
         ImGui::Text(current_lives.c_str());
         ImGui::End();
+
+        // show the renderer statistics so that the opaque submission paths can be compared while playing
+        if (showStatistics) {
+            ImGui::Begin("Renderer Statistics", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+            ImGui::Text("Renderer: %s", rendererType.c_str());
+            if (renderer->isIndirectSupported())
+                ImGui::Checkbox("Multi-draw indirect", &renderer->useIndirect);
+            else
+                ImGui::Text("Multi-draw indirect: not supported");
+            ImGui::Checkbox("Depth pre-pass", &renderer->depthPrepass);
+            ImGui::Checkbox("Overdraw view", &renderer->overdrawView);
+            if (renderer->isWeightedTransparencySupported())
+                ImGui::Checkbox("Weighted transparency", &renderer->weightedTransparency);
+            if (renderer->isOcclusionCullingSupported())
+                ImGui::Checkbox("Occlusion culling", &renderer->occlusionCulling);
+            if (renderer->isDynamicResolutionSupported())
+                ImGui::Checkbox("Dynamic resolution", &renderer->dynamicResolution);
+            // the statistics are copied since the render thread may be drawing the next frame
+            our::RendererStatistics statistics = renderer->getStatistics();
+            ImGui::Text("Draw calls: %d", statistics.drawCalls);
+            ImGui::Text("Material setups: %d", statistics.materialSetups);
+            ImGui::Text("Triangles: %lld", statistics.triangles);
+            // the memory of the loaded meshes compared to the standard vertex format with 32-bit indices
+            // (the vertex fetch bandwidth shrinks with it since every vertex shader invocation reads a whole vertex)
+            size_t meshMemory = 0, standardMemory = 0;
+            our::AssetLoader<our::Mesh>::forEach([&](const std::string &, our::Mesh *mesh) {
+                if (!mesh) return;
+                meshMemory += (size_t) mesh->getVertexCount() * mesh->getVertexSize() + (size_t) mesh->getElementCount() * mesh->getElementSize();
+                standardMemory += (size_t) mesh->getVertexCount() * sizeof(our::Vertex) + (size_t) mesh->getElementCount() * sizeof(GLuint);
+            });
+            ImGui::Text("Mesh memory: %zu KB (%zu KB in the standard format)", meshMemory / 1024, standardMemory / 1024);
+            ImGui::Text("Opaque submit: %.3f ms", statistics.opaqueSubmitTime);
+            ImGui::Text("Extraction: %.3f ms (%d objects culled)", statistics.extractTime, statistics.culledObjects);
+            ImGui::Text("Occlusion: %.3f ms (%d occluders, %d triangles, %d objects occluded)", statistics.occlusionTime,
+                        statistics.occluders, statistics.occluderTriangles, statistics.occludedObjects);
+            if (statistics.shadedSamples >= 0) {
+                // the overdraw is the average number of samples shaded per pixel of the window
+                auto size = getApp()->getFrameBufferSize();
+                ImGui::Text("Shaded samples: %lld (%.2f per pixel)", statistics.shadedSamples,
+                            (double) statistics.shadedSamples / std::max(size.x * size.y, 1));
+            }
+            ImGui::Text("Lights: %d (%d global), %d cluster assignments, at most %d per cluster, binned in %.3f ms",
+                        statistics.lights.lightCount, statistics.lights.globalLightCount,
+                        statistics.lights.assignments, statistics.lights.maxClusterLights,
+                        statistics.lights.binTime);
+            ImGui::Text("Postprocess: %d passes, %d intermediate targets", statistics.postprocessPasses,
+                        statistics.postprocessTargets);
+            if (statistics.frameGpuTime >= 0)
+                ImGui::Text("Resolution scale: %.2f (GPU frame: %.3f ms)", statistics.renderScale, statistics.frameGpuTime);
+            // the GPU time of every postprocessing pass (measured with timer queries) so the effects can be compared
+            if (statistics.postprocessGpuTime >= 0) {
+                ImGui::Text("Postprocess GPU: %.3f ms", statistics.postprocessGpuTime);
+                for (auto &[name, time]: statistics.postprocessPassTimes)
+                    ImGui::BulletText("%s: %.3f ms", name.c_str(), time);
+            }
+            // the programs linked by all the states so far (the states after the first one should load most of theirs from the cache)
+            if (our::ProgramCache *cache = our::ProgramCache::get()) {
+                const our::ProgramCache::Statistics &programs = cache->statistics;
+                ImGui::Text("Program cache: %d from memory, %d from disk, %d compiled (%d binaries refused)",
+                            programs.memoryHits.load(), programs.diskHits.load(), programs.misses.load(), programs.rejected.load());
+            }
+            ImGui::End();
+        }
     }
 
     void onDestroy() override {
@@ -184,7 +261,9 @@ class Playstate : public our::State {
         // destroy the road controller
         roadController.cleanUp();
         // Don't forget to destroy the renderer
-        renderer.destroy();
+        renderer->destroy();
+        delete renderer;
+        renderer = nullptr;
         // On exit, we call exit for the camera controller system to make sure that the mouse is unlocked
         cameraController.exit();
         // Clear the world
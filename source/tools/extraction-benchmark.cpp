@@ -0,0 +1,209 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <map>
+#include <cstring>
+#include <flags/flags.h>
+
+#include <systems/forward-renderer.hpp>
+#include <components/camera.hpp>
+#include <components/light.hpp>
+#include <components/mesh-renderer.hpp>
+
+// The benchmark measures "ForwardRenderer::extract" on a large generated world with different numbers of extraction threads
+// and chunk sizes. The extraction never calls OpenGL, so the benchmark doesn't open a window: the meshes only need their bounds,
+// so the few OpenGL functions that the mesh arena calls while creating them are replaced by stubs. The buffer stubs keep
+// the content of the buffers in the RAM, so the static batching can read the meshes back and merge them.
+static GLuint nextName = 1;
+static std::map<GLuint, std::vector<char>> bufferContents;
+static std::map<GLenum, GLuint> boundBuffers;
+static void GLAD_API_PTR genNames(GLsizei count, GLuint *names) { for (GLsizei index = 0; index < count; index++) names[index] = nextName++; }
+static void GLAD_API_PTR deleteBuffers(GLsizei count, const GLuint *names) { for (GLsizei index = 0; index < count; index++) bufferContents.erase(names[index]); }
+static void GLAD_API_PTR bindBuffer(GLenum target, GLuint buffer) { boundBuffers[target] = buffer; }
+static void GLAD_API_PTR bindVertexArray(GLuint) {}
+static void GLAD_API_PTR bufferData(GLenum target, GLsizeiptr size, const void *data, GLenum) {
+    std::vector<char> &content = bufferContents[boundBuffers[target]];
+    content.assign(size, 0);
+    if (data) std::memcpy(content.data(), data, size);
+}
+static void GLAD_API_PTR bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+    std::memcpy(bufferContents[boundBuffers[target]].data() + offset, data, size);
+}
+static void GLAD_API_PTR getBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void *data) {
+    std::memcpy(data, bufferContents[boundBuffers[target]].data() + offset, size);
+}
+static void GLAD_API_PTR copyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+    std::memcpy(bufferContents[boundBuffers[writeTarget]].data() + writeOffset, bufferContents[boundBuffers[readTarget]].data() + readOffset, size);
+}
+static void GLAD_API_PTR enableVertexAttribArray(GLuint) {}
+static void GLAD_API_PTR vertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void *) {}
+static void GLAD_API_PTR vertexAttribIPointer(GLuint, GLint, GLenum, GLsizei, const void *) {}
+static void GLAD_API_PTR vertexAttribDivisor(GLuint, GLuint) {}
+static void GLAD_API_PTR vertexAttrib4f(GLuint, GLfloat, GLfloat, GLfloat, GLfloat) {}
+
+static void stubMeshArenaFunctions() {
+    glad_glGenBuffers = genNames;
+    glad_glGenVertexArrays = genNames;
+    glad_glDeleteBuffers = deleteBuffers;
+    glad_glBindBuffer = bindBuffer;
+    glad_glBindVertexArray = bindVertexArray;
+    glad_glBufferData = bufferData;
+    glad_glBufferSubData = bufferSubData;
+    glad_glGetBufferSubData = getBufferSubData;
+    glad_glCopyBufferSubData = copyBufferSubData;
+    glad_glEnableVertexAttribArray = enableVertexAttribArray;
+    glad_glVertexAttribPointer = vertexAttribPointer;
+    glad_glVertexAttribIPointer = vertexAttribIPointer;
+    glad_glVertexAttribDivisor = vertexAttribDivisor;
+    glad_glVertexAttrib4f = vertexAttrib4f;
+}
+
+// Opens the extraction settings of the renderer (the renderer is never initialized since that needs an OpenGL context)
+class BenchmarkRenderer : public our::ForwardRenderer {
+public:
+    void configure(glm::ivec2 size, unsigned int threads, size_t minEntities, size_t chunks) {
+        windowSize = renderSize = size;
+        extractionWorkers.reset(threads == 1 ? nullptr : new our::WorkerPool(threads));
+        minEntitiesPerChunk = minEntities;
+        chunksPerThread = chunks;
+    }
+    size_t getThreadCount() const { return extractionWorkers ? extractionWorkers->getThreadCount() : 1; }
+    size_t getChunkCount(size_t entityCount) const {
+        if (!extractionWorkers) return 1;
+        return std::clamp<size_t>(entityCount / minEntitiesPerChunk, 1, extractionWorkers->getThreadCount() * chunksPerThread);
+    }
+};
+
+// A box mesh between -0.5 and 0.5 on every axis
+static our::Mesh *makeBox() {
+    std::vector<our::Vertex> vertices;
+    for (int corner = 0; corner < 8; corner++) {
+        our::Vertex vertex = {};
+        vertex.position = glm::vec3(corner & 1 ? 0.5f : -0.5f, corner & 2 ? 0.5f : -0.5f, corner & 4 ? 0.5f : -0.5f);
+        vertex.normal = glm::normalize(vertex.position);
+        vertex.color = {255, 255, 255, 255};
+        vertices.push_back(vertex);
+    }
+    std::vector<unsigned int> elements = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                          2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    return new our::Mesh(vertices, elements);
+}
+
+// Fills the world with a grid of mesh renderers (a few of them transparent) in front of a camera, with a point light every 100 entities
+// The camera sees about a third of the grid so the frustum culling has work to do as in a real scene
+static void buildWorld(our::World &world, int entityCount, const std::vector<our::Mesh *> &meshes, const std::vector<our::Material *> &materials) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> jitter(-0.4f, 0.4f);
+    int side = (int) std::ceil(std::sqrt((float) entityCount));
+    for (int index = 0; index < entityCount; index++) {
+        our::Entity *entity = world.add();
+        entity->localTransform.position = glm::vec3((index % side - side / 2) * 2.0f + jitter(random), 0.0f,
+                                                    -(index / side) * 2.0f + jitter(random));
+        entity->localTransform.rotation.y = jitter(random);
+        auto meshRenderer = entity->addComponent<our::MeshRendererComponent>();
+        meshRenderer->mesh = meshes[index % meshes.size()];
+        meshRenderer->material = materials[(index / 7) % materials.size()];
+        meshRenderer->materials = {meshRenderer->material};
+        if (index % 100 == 0) {
+            auto light = entity->addComponent<our::LightComponent>();
+            light->lightType = our::LightType::POINT;
+            light->isOn = true;
+            light->color = glm::vec3(1.0f);
+            light->attenuation = glm::vec3(0.1f, 0.0f, 1.0f);
+        }
+    }
+    our::Entity *cameraEntity = world.add();
+    cameraEntity->localTransform.position = glm::vec3(0.0f, 10.0f, 5.0f);
+    cameraEntity->localTransform.rotation.x = glm::radians(-10.0f);
+    auto camera = cameraEntity->addComponent<our::CameraComponent>();
+    camera->cameraType = our::CameraType::PERSPECTIVE;
+    camera->fovY = glm::radians(60.0f);
+    camera->near = 0.1f;
+    camera->far = 300.0f;
+}
+
+// Returns the best and the median time (in milliseconds) of "runs" extractions
+static std::pair<double, double> measure(BenchmarkRenderer &renderer, our::World &world, int runs, our::RenderSnapshot &snapshot) {
+    std::vector<double> times;
+    renderer.extract(&world, snapshot); // warm up the chunk lists and the workers
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        renderer.extract(&world, snapshot);
+        auto end = std::chrono::high_resolution_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return {times.front(), times[times.size() / 2]};
+}
+
+// Usage: EXTRACTION_BENCHMARK [-n 100000] [-r 20] [-t 0]
+// -n: the number of mesh renderers, -r: the number of extractions per setting (the best and the median are reported),
+// -t: the largest number of threads to try (0 means one per hardware thread)
+int main(int argc, char **argv) {
+    flags::args args(argc, argv);
+    int entityCount = std::max(1, args.get<int>("n", 100000));
+    int runs = std::max(1, args.get<int>("r", 20));
+    unsigned int maxThreads = (unsigned int) std::max(0, args.get<int>("t", 0));
+    if (maxThreads == 0) maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    stubMeshArenaFunctions();
+    std::vector<our::Mesh *> meshes = {makeBox(), makeBox(), makeBox(), makeBox()};
+    std::vector<our::Material *> materials;
+    for (int index = 0; index < 8; index++) {
+        auto material = new our::Material();
+        material->shader = nullptr;
+        material->transparent = index == 7;
+        materials.push_back(material);
+    }
+    our::World world;
+    buildWorld(world, entityCount, meshes, materials);
+    // The renderer is never destroyed since its destructor would delete OpenGL objects that were never created
+    auto renderer = new BenchmarkRenderer();
+    our::RenderSnapshot snapshot;
+
+    std::cout << entityCount << " mesh renderers, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << std::right << std::setw(8) << "threads" << std::setw(12) << "min chunk" << std::setw(12) << "chunks/thr"
+              << std::setw(8) << "chunks" << std::setw(10) << "best ms" << std::setw(12) << "median ms" << std::setw(10) << "speedup"
+              << std::setw(10) << "culled" << std::setw(10) << "commands" << std::endl;
+    double singleThreaded = 0;
+    auto report = [&](unsigned int threads, size_t minEntities, size_t chunks) {
+        renderer->configure(glm::ivec2(1280, 720), threads, minEntities, chunks);
+        auto [best, median] = measure(*renderer, world, runs, snapshot);
+        if (threads == 1) singleThreaded = median;
+        std::cout << std::setw(8) << renderer->getThreadCount() << std::setw(12) << minEntities << std::setw(12) << chunks
+                  << std::setw(8) << renderer->getChunkCount(world.getEntities().size()) << std::fixed << std::setprecision(2)
+                  << std::setw(10) << best << std::setw(12) << median << std::setw(9) << singleThreaded / median << "x"
+                  << std::setw(10) << snapshot.culledCommands << std::setw(10)
+                  << snapshot.opaqueCommands.size() + snapshot.transparentCommands.size() << std::endl;
+    };
+    // The scaling with the default chunking
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+        report(threads, 1024, 4);
+    if ((maxThreads & (maxThreads - 1)) != 0)
+        report(maxThreads, 1024, 4);
+    // Then the chunking with all the threads (a chunk must be big enough to pay for waking a worker,
+    // and small enough that there are a few chunks per thread to balance the load)
+    for (size_t minEntities : {256, 1024, 4096, 16384})
+        for (size_t chunks : {1, 2, 4, 8})
+            report(std::max(2u, maxThreads), minEntities, chunks);
+
+    // Finally, the same world with every entity marked as static: the opaque meshes are merged into one mesh per material
+    // (the transparent ones are left out), so the opaque commands should fall to one per visible material
+    renderer->configure(glm::ivec2(1280, 720), 1, 1024, 4);
+    renderer->extract(&world, snapshot);
+    size_t opaqueBefore = snapshot.opaqueCommands.size(), transparentBefore = snapshot.transparentCommands.size();
+    for (auto entity : world.getEntities())
+        entity->isStatic = true;
+    auto start = std::chrono::high_resolution_clock::now();
+    renderer->buildStaticBatches(&world);
+    double batchingTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    auto [best, median] = measure(*renderer, world, runs, snapshot);
+    std::cout << "static batching: built in " << std::fixed << std::setprecision(2) << batchingTime << " ms, extraction best/median "
+              << best << "/" << median << " ms, opaque commands " << opaqueBefore << " -> " << snapshot.opaqueCommands.size()
+              << " (" << materials.size() - 1 << " opaque materials), transparent commands " << transparentBefore << " -> "
+              << snapshot.transparentCommands.size() << std::endl;
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <glad/gl.h>
+
+#include <iostream>
+
+// The GPU benchmarks don't open a window: they create an OpenGL core context with EGL without any surface
+// (EGL_MESA_platform_surfaceless) and draw to their own framebuffers, so they also run on machines without a display
+// (e.g. with Mesa's software renderer). The context is never destroyed since the benchmarks exit right after using it.
+// Returns false (after printing the error) if no OpenGL 4.5 or 3.3 core context can be created
+inline bool createHeadlessContext() {
+    EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "Couldn't initialize a surfaceless EGL display" << std::endl;
+        return false;
+    }
+    // The newest version first, since the indirect programs and the timer queries of some passes need more than 3.3
+    const EGLint versions[][2] = {{4, 5}, {3, 3}};
+    for (auto &version: versions) {
+        EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION, version[0], EGL_CONTEXT_MINOR_VERSION, version[1],
+                               EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+        EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+        if (context == EGL_NO_CONTEXT) continue;
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) continue;
+        if (!gladLoadGL((GLADloadfunc) eglGetProcAddress)) break;
+        std::cout << "OpenGL " << glGetString(GL_VERSION) << " (" << glGetString(GL_RENDERER) << ")" << std::endl;
+        return true;
+    }
+    std::cerr << "Couldn't create a headless OpenGL context" << std::endl;
+    return false;
+}
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <fstream>
+#include <set>
+#include <flags/flags.h>
+#include <json/json.hpp>
+
+#include <mesh/mesh-utils.hpp>
+#include <mesh/mesh-cache.hpp>
+
+// The mesh cook tool writes the binary cache (see "mesh/mesh-cache.hpp") of every mesh used by the scenes of the config
+// so the game never has to parse or process an OBJ file at runtime. It doesn't need a window or an OpenGL context.
+// Usage: MESH_COOK [-c config/app.jsonc]
+int main(int argc, char **argv) {
+
+    flags::args args(argc, argv); // Parse the command line arguments
+    // config_path is the path to the json file containing the application configuration
+    std::string config_path = args.get<std::string>("c", "config/app.jsonc");
+
+    std::ifstream file_in(config_path);
+    if (!file_in) {
+        std::cerr << "Couldn't open file: " << config_path << std::endl;
+        return -1;
+    }
+    nlohmann::json app_config = nlohmann::json::parse(file_in, nullptr, true, true);
+    file_in.close();
+
+    // Every object in the config that has "assets" is a scene, and the same mesh can be used by more than one scene
+    std::set<std::string> cooked;
+    int failed = 0;
+    for (auto &[scene_name, scene]: app_config.items()) {
+        if (!scene.is_object() || !scene.contains("assets")) continue;
+        const nlohmann::json &assets = scene["assets"];
+        if (!assets.contains("meshes") || !assets["meshes"].is_object()) continue;
+        for (auto &[name, desc]: assets["meshes"].items()) {
+            // The options are read the same way as in "AssetLoader<Mesh>::deserialize"
+            std::string path;
+            our::mesh_utils::MeshLoadOptions options;
+            if (desc.is_object()) {
+                path = desc.value("path", "");
+                options.packed = desc.value("packed", false);
+                options.optimize = desc.value("optimize", false);
+                options.lods = desc.value("lods", 0);
+                options.cache = desc.value("cache", true);
+            } else {
+                path = desc.get<std::string>();
+            }
+            if (!options.cache) continue;
+            // Each source and options pair has its own cache file, so it only needs to be cooked once
+            std::string cache_path = our::mesh_cache::getCachePath(path, options);
+            if (!cooked.insert(cache_path).second) continue;
+
+            our::MeshData data;
+            if (!our::mesh_utils::buildOBJ(path, options, data) || !our::mesh_cache::save(path, options, data)) {
+                std::cerr << "Failed to cook \"" << path << "\"" << std::endl;
+                failed++;
+                continue;
+            }
+            std::cout << "Cooked \"" << path << "\" -> \"" << cache_path << "\" ("
+                      << data.vertexCount << " vertices, " << data.getTotalElementCount() / 3 << " triangles in "
+                      << data.levelElementCounts.size() << " levels, "
+                      << (data.getVertexDataSize() + data.getElementDataSize()) / 1024 << " KiB)" << std::endl;
+        }
+    }
+    return failed == 0 ? 0 : -1;
+}
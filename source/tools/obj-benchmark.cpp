@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <flags/flags.h>
+
+// The benchmark compares our OBJ parser against the loader we used before it (Tiny OBJ Loader + std::unordered_map welding)
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tinyobj/tiny_obj_loader.h>
+
+#include <mesh/obj-parser.hpp>
+#include <glm/gtx/hash.hpp>
+
+// The hash that std::unordered_map<our::Vertex> used before "our::hashVertex" (the glm hashes combined with h1 ^ (h2 << 1))
+struct LegacyVertexHash {
+    static size_t combine(size_t h1, size_t h2) { return h1 ^ (h2 << 1); }
+    size_t operator()(const our::Vertex &vertex) const {
+        size_t combined = std::hash<glm::vec3>()(vertex.position);
+        combined = combine(combined, std::hash<our::Color>()(vertex.color));
+        combined = combine(combined, std::hash<glm::vec2>()(vertex.tex_coord));
+        combined = combine(combined, std::hash<glm::vec3>()(vertex.normal));
+        return combined;
+    }
+};
+
+// The previous loader (as it was in "mesh-utils.cpp")
+static bool loadReference(const std::string &filename, std::vector<our::Vertex> &vertices, std::vector<GLuint> &elements) {
+    vertices.clear();
+    elements.clear();
+    std::unordered_map<our::Vertex, GLuint, LegacyVertexHash> vertex_map;
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str(), "assets/models")) return false;
+    for (const auto &shape: shapes) {
+        for (const auto &index: shape.mesh.indices) {
+            our::Vertex vertex = {};
+            vertex.position = {attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1],
+                               attrib.vertices[3 * index.vertex_index + 2]};
+            if (index.normal_index >= 0)
+                vertex.normal = {attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1],
+                                 attrib.normals[3 * index.normal_index + 2]};
+            if (index.texcoord_index >= 0)
+                vertex.tex_coord = {attrib.texcoords[2 * index.texcoord_index + 0], attrib.texcoords[2 * index.texcoord_index + 1]};
+            vertex.color = {attrib.colors[3 * index.vertex_index + 0] * 255, attrib.colors[3 * index.vertex_index + 1] * 255,
+                            attrib.colors[3 * index.vertex_index + 2] * 255, 255};
+            auto it = vertex_map.find(vertex);
+            if (it == vertex_map.end()) {
+                auto new_vertex_index = static_cast<GLuint>(vertices.size());
+                vertex_map[vertex] = new_vertex_index;
+                elements.push_back(new_vertex_index);
+                vertices.push_back(vertex);
+            } else {
+                elements.push_back(it->second);
+            }
+        }
+    }
+    return true;
+}
+
+// Returns the best time (in milliseconds) of "runs" calls of the loader
+template<typename Loader>
+static double measure(int runs, Loader loader) {
+    double best = 1e30;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        loader();
+        auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+// Both loaders should weld the same vertices and make the same number of triangles
+// (the order can differ since Tiny OBJ Loader sometimes splits a quad along the other diagonal)
+static bool sameMesh(std::vector<our::Vertex> referenceVertices, const std::vector<GLuint> &referenceElements,
+                     std::vector<our::Vertex> vertices, const std::vector<GLuint> &elements) {
+    auto byBytes = [](const our::Vertex &first, const our::Vertex &second) { return std::memcmp(&first, &second, sizeof(our::Vertex)) < 0; };
+    std::sort(referenceVertices.begin(), referenceVertices.end(), byBytes);
+    std::sort(vertices.begin(), vertices.end(), byBytes);
+    return referenceVertices == vertices && referenceElements.size() == elements.size();
+}
+
+// Checks the forms of the "v" line that the models in the directory may not use: the plain position, the position with
+// the optional weight "w" (which both loaders ignore) and the position with a vertex color (only read when there are 3 values)
+static bool checkVertexSyntax(unsigned int threads) {
+    const std::pair<const char *, const char *> cases[] = {
+            {"v x y z",       "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"},
+            {"v x y z w",     "v 0 0 0 1\nv 1 0 0 1\nv 0 1 0 0.5\nf 1 2 3\n"},
+            {"v x y z r g b", "v 0 0 0 1 0 0\nv 1 0 0 0 1 0\nv 0 1 0 0 0 1\nf 1 2 3\n"},
+    };
+    std::string file = (std::filesystem::temp_directory_path() / "obj-benchmark-vertex.obj").string();
+    bool allPassed = true;
+    for (const auto &[name, text]: cases) {
+        std::ofstream(file, std::ios::binary) << text;
+        std::vector<our::Vertex> referenceVertices, vertices;
+        std::vector<GLuint> referenceElements, elements;
+        bool passed = loadReference(file, referenceVertices, referenceElements) &&
+                      our::obj_parser::parse(file, vertices, elements, nullptr, threads) &&
+                      elements.size() == 3 && sameMesh(referenceVertices, referenceElements, vertices, elements);
+        std::cout << std::left << std::setw(40) << name << (passed ? "ok" : "FAILED") << std::endl;
+        allPassed = allPassed && passed;
+    }
+    std::filesystem::remove(file);
+    return allPassed;
+}
+
+// Usage: OBJ_BENCHMARK [-d assets/models] [-r 5] [-t 0]
+// -d: the directory of the ".obj" files, -r: the number of runs per file (the best is reported),
+// -t: the maximum number of threads of our parser (0 means one per hardware thread)
+int main(int argc, char **argv) {
+    flags::args args(argc, argv);
+    std::string directory = args.get<std::string>("d", "assets/models");
+    int runs = std::max(1, args.get<int>("r", 5));
+    unsigned int threads = (unsigned int) std::max(0, args.get<int>("t", 0));
+
+    std::vector<std::string> files;
+    for (const auto &entry: std::filesystem::directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".obj") files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+
+    bool syntaxPassed = checkVertexSyntax(threads);
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(40) << "file" << std::right << std::setw(10) << "KiB" << std::setw(12) << "vertices"
+              << std::setw(12) << "triangles" << std::setw(14) << "tinyobj ms" << std::setw(12) << "ours ms"
+              << std::setw(10) << "speedup" << std::setw(8) << "same" << std::endl;
+    double totalReference = 0, totalOurs = 0;
+    for (const std::string &file: files) {
+        std::vector<our::Vertex> referenceVertices, vertices;
+        std::vector<GLuint> referenceElements, elements;
+        bool referenceLoaded = true, loaded = true;
+        double referenceTime = measure(runs, [&]() { referenceLoaded = loadReference(file, referenceVertices, referenceElements); });
+        double time = measure(runs, [&]() { loaded = our::obj_parser::parse(file, vertices, elements, nullptr, threads); });
+        if (!referenceLoaded || !loaded) {
+            std::cout << std::left << std::setw(40) << file << " failed to load" << std::endl;
+            continue;
+        }
+        bool same = sameMesh(referenceVertices, referenceElements, vertices, elements);
+        totalReference += referenceTime;
+        totalOurs += time;
+        std::cout << std::left << std::setw(40) << std::filesystem::path(file).filename().string() << std::right
+                  << std::setw(10) << std::filesystem::file_size(file) / 1024 << std::setw(12) << vertices.size()
+                  << std::setw(12) << elements.size() / 3 << std::fixed << std::setprecision(2) << std::setw(14) << referenceTime
+                  << std::setw(12) << time << std::setw(9) << referenceTime / time << "x" << std::setw(8) << (same ? "yes" : "no")
+                  << std::endl;
+    }
+    std::cout << std::left << std::setw(74) << "total" << std::right << std::fixed << std::setprecision(2) << std::setw(14)
+              << totalReference << std::setw(12) << totalOurs << std::setw(9) << totalReference / std::max(totalOurs, 1e-9) << "x"
+              << std::endl;
+    return syntaxPassed ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <algorithm>
+#include <vector>
+#include <flags/flags.h>
+#include <json/json.hpp>
+
+#include "headless-context.hpp"
+#include <systems/postprocess-chain.hpp>
+#include <texture/texture2d.hpp>
+
+// The postprocess benchmark measures the postprocessing chain of the scene ("scene.renderer.postprocess" in the config)
+// against the old single pass bloom ("glow.frag") with a few radii, on the GPU of the machine and without a window.
+// Every chain is applied to a generated scene (a dark background with 200 bright squares) for a number of frames
+// and the median time of a frame (from the start of "render" to the end of glFinish) is printed with the median GPU time
+// of every pass (from the timer queries of the chain). The frame time is the one to compare: some drivers (e.g. Mesa's
+// software renderer) only draw when the commands are flushed, so the work of a pass can land in the query of a later pass
+// and the work of the last pass can miss the queries completely.
+// The reach of the bloom is measured on a second scene with a single 8x8 white square in the middle: it is the distance
+// from the edge of the square to the last pixel of its row that the bloom still brightens by 1% of its peak.
+// Usage: POSTPROCESS_BENCHMARK [-c config/app.jsonc] [-w 1280] [-h 720] [-f 40]
+
+// Fills the scene with the bright squares, or with the single white square if "single" is true
+static void generateScene(std::vector<unsigned char> &pixels, glm::ivec2 size, bool single) {
+    pixels.assign(4 * (size_t) size.x * size.y, 0);
+    for (size_t pixel = 0; pixel < (size_t) size.x * size.y; pixel++) {
+        unsigned char background[4] = {10, 12, 30, 255};
+        if (single) background[0] = background[1] = background[2] = 0;
+        std::copy(background, background + 4, &pixels[4 * pixel]);
+    }
+    if (single) {
+        for (int y = size.y / 2 - 4; y < size.y / 2 + 4; y++)
+            for (int x = size.x / 2 - 4; x < size.x / 2 + 4; x++)
+                std::fill_n(&pixels[4 * ((size_t) y * size.x + x)], 3, 255);
+        return;
+    }
+    std::mt19937 random(7);
+    for (int square = 0; square < 200; square++) {
+        int side = 4 + random() % 12, left = random() % (size.x - side), bottom = random() % (size.y - side);
+        unsigned char color[3] = {(unsigned char) (180 + random() % 76), (unsigned char) (180 + random() % 76), (unsigned char) (120 + random() % 136)};
+        for (int y = bottom; y < bottom + side; y++)
+            for (int x = left; x < left + side; x++)
+                std::copy(color, color + 3, &pixels[4 * ((size_t) y * size.x + x)]);
+    }
+}
+
+// Applies the chain to the scene and returns what it drew
+static std::vector<unsigned char> renderOnce(our::PostprocessChain &chain, our::Texture2D &scene, GLuint framebuffer, glm::ivec2 size) {
+    chain.render(&scene, nullptr, framebuffer, size);
+    std::vector<unsigned char> result(4 * (size_t) size.x * size.y);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, result.data());
+    return result;
+}
+
+static double median(std::vector<double> values) {
+    if (values.empty()) return -1;
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char **argv) {
+    flags::args args(argc, argv);
+    std::string config_path = args.get<std::string>("c", "config/app.jsonc");
+    glm::ivec2 size = {std::max(64, args.get<int>("w", 1280)), std::max(64, args.get<int>("h", 720))};
+    int frames = std::max(1, args.get<int>("f", 40));
+    std::ifstream file_in(config_path);
+    if (!file_in) {
+        std::cerr << "Couldn't open file: " << config_path << std::endl;
+        return -1;
+    }
+    nlohmann::json app_config = nlohmann::json::parse(file_in, nullptr, true, true);
+    file_in.close();
+    if (!app_config.contains("scene") || !app_config["scene"].contains("renderer") || !app_config["scene"]["renderer"].contains("postprocess")) {
+        std::cerr << "The config has no \"scene.renderer.postprocess\"" << std::endl;
+        return -1;
+    }
+    if (!createHeadlessContext()) return -1;
+
+    // The chains to compare: the one of the config then the old bloom (with the final intensity of the config's bloom)
+    std::vector<std::pair<std::string, nlohmann::json>> chains = {{"config", app_config["scene"]["renderer"]["postprocess"]}};
+    for (float radius: {1.0f, 4.0f, 8.0f}) {
+        chains.push_back({"glow.frag (radius " + std::to_string((int) radius) + ")",
+                          {{{"name", "glow"}, {"shader", "assets/shaders/postprocess/glow.frag"},
+                            {"uniforms", {{"bloomRadius", radius}, {"bloomIntensity", 0.5f}}}}}});
+    }
+
+    std::vector<unsigned char> squares, single;
+    generateScene(squares, size, false);
+    generateScene(single, size, true);
+    our::Texture2D scene;
+    scene.bind();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    GLuint output, framebuffer;
+    glGenTextures(1, &output);
+    glBindTexture(GL_TEXTURE_2D, output);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size.x, size.y);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output, 0);
+
+    std::cout << size.x << "x" << size.y << ", median of " << frames << " frames" << std::endl << std::fixed << std::setprecision(2);
+    for (auto &[name, config]: chains) {
+        our::PostprocessChain chain;
+        if (!chain.initialize(size, config)) {
+            std::cerr << "Couldn't create the chain \"" << name << "\"" << std::endl;
+            return -1;
+        }
+        scene.bind();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, squares.data());
+        // The first frames are skipped (the shaders are compiled lazily by some drivers and the queries are read 2 frames later)
+        std::vector<std::vector<double>> passTimes(chain.getPassCount());
+        std::vector<double> frameTimes, gpuTimes;
+        for (int frame = 0; frame < frames + 5; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            chain.render(&scene, nullptr, framebuffer, size);
+            glFinish();
+            double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (frame < 5 || chain.getGpuTime() < 0) continue;
+            frameTimes.push_back(frameTime);
+            gpuTimes.push_back(chain.getGpuTime());
+            for (size_t pass = 0; pass < chain.getPassCount(); pass++) passTimes[pass].push_back(chain.getPassTime(pass));
+        }
+
+        scene.bind();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, single.data());
+        std::vector<unsigned char> result = renderOnce(chain, scene, framebuffer, size);
+        size_t row = 4 * (size_t) (size.y / 2) * size.x;
+        int peak = 0, reach = 0;
+        for (int x = 0; x < size.x; x++) peak = std::max(peak, result[row + 4 * x] - single[row + 4 * x]);
+        for (int x = size.x / 2 + 4; x < size.x; x++)
+            if (peak > 0 && result[row + 4 * x] - single[row + 4 * x] >= std::max(1, peak / 100)) reach = x - (size.x / 2 + 4) + 1;
+
+        std::cout << name << ": " << median(frameTimes) << " ms per frame (" << median(gpuTimes) << " ms in the queries), "
+                  << chain.getPassCount() << " passes, " << chain.getTargetCount() << " targets, reach " << reach << " px" << std::endl;
+        for (size_t pass = 0; pass < chain.getPassCount(); pass++)
+            std::cout << "    " << std::left << std::setw(12) << chain.getPassName(pass) << std::right << median(passTimes[pass]) << " ms" << std::endl;
+        chain.destroy();
+    }
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &output);
+    return 0;
+}
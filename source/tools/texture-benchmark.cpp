@@ -0,0 +1,159 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <set>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <flags/flags.h>
+#include <json/json.hpp>
+
+#include "headless-context.hpp"
+#include <mapped-file.hpp>
+#include <texture/texture-utils.hpp>
+#include <texture/texture-container.hpp>
+
+// The texture benchmark measures the cooked textures (see "texture/texture-container.hpp") on the GPU of the machine.
+// Every texture of the config that was cooked by TEXTURE_COOK is loaded three ways:
+// - with "texture_utils::loadCooked" (the blocks are uploaded as they are),
+// - with "texture_utils::loadCooked" while pretending that the driver doesn't support the block formats (the CPU fallback),
+// - with "texture_utils::loadImage" (decoding the source, uploading RGBA8 and generating the mips on the GPU) as before cooking.
+// For each of them, it prints the video memory reported by the driver and the load time (each load ends with glFinish).
+// It also checks that the fallback decodes level 0 to exactly the texels that the driver decodes from the blocks.
+// Usage: TEXTURE_BENCHMARK [-c config/app.jsonc]
+
+// The video memory of all the levels of the texture bound to GL_TEXTURE_2D as reported by the driver
+static size_t getVideoMemory() {
+    GLint maxLevel = 0, compressed = 0;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    // an RGBA8 texture with generated mips keeps the default max level (1000) so we stop at the first missing level
+    size_t total = 0;
+    for (GLint level = 0; level <= maxLevel; level++) {
+        GLint width = 0, height = 0, size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0) break;
+        if (compressed) {
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            total += size;
+        } else {
+            total += 4 * (size_t) width * height;
+        }
+        if (width == 1 && height == 1) break;
+    }
+    return total;
+}
+
+// Loads the texture with the given function and returns it with its load time in milliseconds
+template<typename Load>
+static our::Texture2D *timeLoad(Load load, double &milliseconds) {
+    auto start = std::chrono::steady_clock::now();
+    our::Texture2D *texture = load();
+    glFinish();
+    milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return texture;
+}
+
+// Reads level 0 of the texture as RGBA8 (the driver decodes the blocks and applies no swizzle)
+static std::vector<unsigned char> readLevel0(our::Texture2D *texture) {
+    texture->bind();
+    GLint width = 0, height = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    std::vector<unsigned char> texels(4 * (size_t) width * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+    return texels;
+}
+
+int main(int argc, char **argv) {
+    flags::args args(argc, argv);
+    std::string config_path = args.get<std::string>("c", "config/app.jsonc");
+    std::ifstream file_in(config_path);
+    if (!file_in) {
+        std::cerr << "Couldn't open file: " << config_path << std::endl;
+        return -1;
+    }
+    nlohmann::json app_config = nlohmann::json::parse(file_in, nullptr, true, true);
+    file_in.close();
+    if (!createHeadlessContext()) return -1;
+    std::cout << "S3TC: " << (GLAD_GL_EXT_texture_compression_s3tc ? "yes" : "no") << ", RGTC: "
+              << (GLAD_GL_VERSION_3_0 || GLAD_GL_ARB_texture_compression_rgtc ? "yes" : "no") << std::endl;
+
+    std::set<std::string> measured;
+    int failed = 0;
+    size_t total_cooked = 0, total_fallback = 0, total_image = 0;
+    double time_cooked = 0, time_fallback = 0, time_image = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (auto &[scene_name, scene]: app_config.items()) {
+        if (!scene.is_object() || !scene.contains("assets")) continue;
+        const nlohmann::json &assets = scene["assets"];
+        if (!assets.contains("textures") || !assets["textures"].is_object()) continue;
+        for (auto &[name, desc]: assets["textures"].items()) {
+            std::string path = desc.is_object() ? desc.value("path", "") : desc.get<std::string>();
+            if (!measured.insert(path).second) continue;
+            // the format decides which channels are compared (the swizzle fills the others on the GPU only)
+            our::MappedFile file;
+            our::texture_container::CookedTexture cooked;
+            if (!file.open(our::texture_container::getCookedPath(path)) || !our::texture_container::read(file, path, cooked)) {
+                std::cout << "Skipped \"" << path << "\" (not cooked, run TEXTURE_COOK first)" << std::endl;
+                continue;
+            }
+            file.close();
+            using our::texture_compression::BlockFormat;
+            int channels = cooked.format == BlockFormat::BC1 ? 3 : cooked.format == BlockFormat::BC3 ? 4 : cooked.format == BlockFormat::BC4 ? 1 : 2;
+
+            double cooked_ms, fallback_ms, image_ms;
+            our::Texture2D *compressed = timeLoad([&] { return our::texture_utils::loadCooked(path); }, cooked_ms);
+            // the driver support is read from the flags that glad filled, so clearing them forces the fallback
+            int s3tc = GLAD_GL_EXT_texture_compression_s3tc, gl30 = GLAD_GL_VERSION_3_0, rgtc = GLAD_GL_ARB_texture_compression_rgtc;
+            GLAD_GL_EXT_texture_compression_s3tc = GLAD_GL_VERSION_3_0 = GLAD_GL_ARB_texture_compression_rgtc = 0;
+            our::Texture2D *fallback = timeLoad([&] { return our::texture_utils::loadCooked(path); }, fallback_ms);
+            GLAD_GL_EXT_texture_compression_s3tc = s3tc;
+            GLAD_GL_VERSION_3_0 = gl30;
+            GLAD_GL_ARB_texture_compression_rgtc = rgtc;
+            our::Texture2D *image = timeLoad([&] { return our::texture_utils::loadImage(path); }, image_ms);
+            if (!compressed || !fallback || !image) {
+                std::cerr << "Failed to load \"" << path << "\"" << std::endl;
+                failed++;
+                continue;
+            }
+
+            compressed->bind();
+            size_t cooked_memory = getVideoMemory();
+            fallback->bind();
+            size_t fallback_memory = getVideoMemory();
+            image->bind();
+            size_t image_memory = getVideoMemory();
+            std::vector<unsigned char> driver = readLevel0(compressed), decoded = readLevel0(fallback);
+            int max_difference = driver.size() == decoded.size() ? 0 : 255;
+            for (size_t texel = 0; texel < driver.size() / 4 && driver.size() == decoded.size(); texel++)
+                for (int channel = 0; channel < channels; channel++)
+                    max_difference = std::max(max_difference, std::abs((int) driver[4 * texel + channel] - (int) decoded[4 * texel + channel]));
+            if (max_difference != 0) failed++;
+
+            std::cout << "\"" << path << "\" (" << our::texture_compression::getFormatName(cooked.format) << ", "
+                      << cooked.levelSizes[0].x << "x" << cooked.levelSizes[0].y << "): cooked " << cooked_memory / 1024 << " KiB in "
+                      << cooked_ms << " ms, fallback " << fallback_memory / 1024 << " KiB in " << fallback_ms << " ms, image "
+                      << image_memory / 1024 << " KiB in " << image_ms << " ms, fallback difference " << max_difference << std::endl;
+            total_cooked += cooked_memory;
+            total_fallback += fallback_memory;
+            total_image += image_memory;
+            time_cooked += cooked_ms;
+            time_fallback += fallback_ms;
+            time_image += image_ms;
+            delete compressed;
+            delete fallback;
+            delete image;
+        }
+    }
+    if (total_image > 0) {
+        std::cout << "Total: cooked " << total_cooked / 1024 << " KiB in " << time_cooked << " ms ("
+                  << (total_image - std::min(total_cooked, total_image)) * 100 / total_image << "% less memory), fallback "
+                  << total_fallback / 1024 << " KiB in " << time_fallback << " ms, image " << total_image / 1024 << " KiB in "
+                  << time_image << " ms" << std::endl;
+    }
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <fstream>
+#include <set>
+#include <chrono>
+#include <algorithm>
+#include <flags/flags.h>
+#include <json/json.hpp>
+
+#include <mapped-file.hpp>
+#include <texture/texture-container.hpp>
+
+// The texture cook tool compresses every texture used by the scenes of the config into a cooked container
+// (see "texture/texture-container.hpp") so the game loads block compressed textures with precomputed mips instead of
+// decoding JPEG/PNG images into RGBA8. It doesn't need a window or an OpenGL context.
+// For every texture, it prints the chosen format, the memory saved, the decoding time saved and the quality (PSNR).
+// Usage: TEXTURE_COOK [-c config/app.jsonc]
+int main(int argc, char **argv) {
+
+    flags::args args(argc, argv); // Parse the command line arguments
+    // config_path is the path to the json file containing the application configuration
+    std::string config_path = args.get<std::string>("c", "config/app.jsonc");
+
+    std::ifstream file_in(config_path);
+    if (!file_in) {
+        std::cerr << "Couldn't open file: " << config_path << std::endl;
+        return -1;
+    }
+    nlohmann::json app_config = nlohmann::json::parse(file_in, nullptr, true, true);
+    file_in.close();
+
+    // Every object in the config that has "assets" is a scene, and the same texture can be used by more than one scene
+    std::set<std::string> cooked;
+    int failed = 0;
+    size_t total_uncompressed = 0, total_compressed = 0;
+    double total_decode = 0, total_load = 0;
+    for (auto &[scene_name, scene]: app_config.items()) {
+        if (!scene.is_object() || !scene.contains("assets")) continue;
+        const nlohmann::json &assets = scene["assets"];
+        if (!assets.contains("textures") || !assets["textures"].is_object()) continue;
+        for (auto &[name, desc]: assets["textures"].items()) {
+            // The description is read the same way as in "AssetLoader<Texture2D>::deserialize"
+            std::string path = desc.is_object() ? desc.value("path", "") : desc.get<std::string>();
+            std::string compression = desc.is_object() ? desc.value("compression", "auto") : "auto";
+            if (compression == "none" || !cooked.insert(path).second) continue;
+            our::texture_compression::BlockFormat format;
+            if (compression != "auto" && !our::texture_compression::parseFormatName(compression, format)) {
+                std::cerr << "Unknown compression \"" << compression << "\" for \"" << path << "\"" << std::endl;
+                failed++;
+                continue;
+            }
+
+            our::texture_container::CookReport report;
+            if (!our::texture_container::cook(path, compression == "auto" ? nullptr : &format, report)) {
+                std::cerr << "Failed to cook \"" << path << "\"" << std::endl;
+                failed++;
+                continue;
+            }
+            // Measure how long the game will need to read the cooked texture back (without the GPU upload)
+            auto start = std::chrono::steady_clock::now();
+            our::MappedFile file;
+            our::texture_container::CookedTexture texture;
+            if (!file.open(our::texture_container::getCookedPath(path)) || !our::texture_container::read(file, path, texture)) {
+                std::cerr << "Failed to read back \"" << our::texture_container::getCookedPath(path) << "\"" << std::endl;
+                failed++;
+                continue;
+            }
+            double load_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << "Cooked \"" << path << "\" -> \"" << our::texture_container::getCookedPath(path) << "\" ("
+                      << our::texture_compression::getFormatName(report.format) << ", " << report.size.x << "x" << report.size.y
+                      << ", " << report.levelCount << " levels, " << report.compressedBytes / 1024 << " KiB instead of "
+                      << report.uncompressedBytes / 1024 << " KiB, decode " << report.decodeMilliseconds << " ms -> load "
+                      << load_milliseconds << " ms, PSNR " << report.psnr << " dB)" << std::endl;
+            total_uncompressed += report.uncompressedBytes;
+            total_compressed += report.compressedBytes;
+            total_decode += report.decodeMilliseconds;
+            total_load += load_milliseconds;
+        }
+    }
+    if (!cooked.empty()) {
+        std::cout << "Total: " << total_compressed / 1024 << " KiB of VRAM instead of " << total_uncompressed / 1024 << " KiB ("
+                  << (total_uncompressed - total_compressed) * 100 / std::max<size_t>(total_uncompressed, 1) << "% saved), "
+                  << total_decode << " ms of decoding replaced by " << total_load << " ms of loading" << std::endl;
+    }
+    return failed == 0 ? 0 : -1;
+}